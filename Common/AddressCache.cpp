@@ -0,0 +1,144 @@
+#include "AddressCache.h"
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+constexpr unsigned CACHE_VERSION = 1;
+constexpr const char* ADDRESS_PREFIX = "Address.";
+
+uint64_t Fnv1a(const uint8_t* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+FILE* OpenFile(const char* path, const char* mode) {
+    FILE* file = nullptr;
+#ifdef _WIN32
+    if (fopen_s(&file, path, mode) != 0) file = nullptr;
+#else
+    file = fopen(path, mode);
+#endif
+    return file;
+}
+
+// A whole decimal or 0x-prefixed hexadecimal number, without sign or spaces
+bool ParseNumber(const char* text, unsigned long long& number) {
+    if (!isdigit((unsigned char)text[0])) return false;
+    char* end = nullptr;
+    errno = 0;
+    number = strtoull(text, &end, 0);
+    return errno == 0 && *end == '\0';
+}
+
+bool SameFingerprint(const ImageFingerprint& a, const ImageFingerprint& b) {
+    return a.timeDateStamp == b.timeDateStamp && a.sizeOfImage == b.sizeOfImage &&
+        a.checkSum == b.checkSum && a.headerHash == b.headerHash;
+}
+
+} // namespace
+
+bool FingerprintImage(const PeImage& image, ImageFingerprint& fingerprint) {
+    if (!image.data || !image.sizeOfHeaders || image.sizeOfHeaders > image.size) return false;
+
+    fingerprint.timeDateStamp = image.timeDateStamp;
+    fingerprint.sizeOfImage = image.sizeOfImage;
+    fingerprint.checkSum = image.checkSum;
+    fingerprint.headerHash = Fnv1a(image.data, image.sizeOfHeaders);
+    return true;
+}
+
+bool LoadAddressCache(const char* path, const ImageFingerprint& expected, AddressCache& cache) {
+    cache = AddressCache();
+
+    FILE* file = OpenFile(path, "r");
+    if (!file) return false;
+
+    unsigned version = 0;
+    ImageFingerprint stored;
+    bool valid = true;
+    unsigned long long number = 0;
+    char line[256];
+    while (valid && fgets(line, sizeof(line), file)) {
+        // Every line SaveAddressCache writes fits and ends in a newline: one
+        // that does not was cut short or is not ours
+        char* end = strchr(line, '\n');
+        if (!end) {
+            valid = false;
+            break;
+        }
+        if (end > line && end[-1] == '\r') end--;
+        *end = '\0';
+        if (line[0] == '#' || line[0] == '\0') continue;
+
+        char* value = strchr(line, '=');
+        if (!value || !ParseNumber(value + 1, number)) {
+            valid = false;
+            break;
+        }
+        *value = '\0';
+
+        if (strcmp(line, "Version") == 0) version = (unsigned)number;
+        else if (strcmp(line, "TimeDateStamp") == 0) stored.timeDateStamp = (uint32_t)number;
+        else if (strcmp(line, "SizeOfImage") == 0) stored.sizeOfImage = (uint32_t)number;
+        else if (strcmp(line, "CheckSum") == 0) stored.checkSum = (uint32_t)number;
+        else if (strcmp(line, "HeaderHash") == 0) stored.headerHash = number;
+        else if (strcmp(line, "ScanMicroseconds") == 0) cache.scanMicroseconds = number;
+        else if (strncmp(line, ADDRESS_PREFIX, strlen(ADDRESS_PREFIX)) == 0) {
+            valid = number <= UINT32_MAX;
+            SetCachedAddress(cache, line + strlen(ADDRESS_PREFIX), (uint32_t)number);
+        }
+    }
+    fclose(file);
+
+    if (!valid || version != CACHE_VERSION || !SameFingerprint(stored, expected)) {
+        cache = AddressCache();
+        return false;
+    }
+    cache.fingerprint = stored;
+    return true;
+}
+
+bool SaveAddressCache(const char* path, const AddressCache& cache) {
+    FILE* file = OpenFile(path, "w");
+    if (!file) return false;
+
+    const ImageFingerprint& fp = cache.fingerprint;
+    fprintf(file, "# Resolved patch sites, rebuilt automatically when the game changes\n");
+    fprintf(file, "Version=%u\n", CACHE_VERSION);
+    fprintf(file, "TimeDateStamp=0x%08X\n", (unsigned)fp.timeDateStamp);
+    fprintf(file, "SizeOfImage=0x%08X\n", (unsigned)fp.sizeOfImage);
+    fprintf(file, "CheckSum=0x%08X\n", (unsigned)fp.checkSum);
+    fprintf(file, "HeaderHash=0x%016llX\n", (unsigned long long)fp.headerHash);
+    fprintf(file, "ScanMicroseconds=%llu\n", (unsigned long long)cache.scanMicroseconds);
+    for (const CachedAddress& entry : cache.entries) {
+        fprintf(file, "%s%s=0x%08X\n", ADDRESS_PREFIX, entry.name.c_str(), (unsigned)entry.rva);
+    }
+
+    bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
+
+const CachedAddress* FindCachedAddress(const AddressCache& cache, const char* name) {
+    for (const CachedAddress& entry : cache.entries) {
+        if (entry.name == name) return &entry;
+    }
+    return nullptr;
+}
+
+void SetCachedAddress(AddressCache& cache, const char* name, uint32_t rva) {
+    for (CachedAddress& entry : cache.entries) {
+        if (entry.name == name) {
+            entry.rva = rva;
+            return;
+        }
+    }
+    cache.entries.push_back(CachedAddress{ name, rva });
+}
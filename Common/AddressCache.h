@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "PeImage.h"
+
+// On-disk cache of resolved patch-site RVAs, so the game image only has to be
+// scanned again when the executable changes.
+//
+// The cache is a small text file of Key=Value lines. It is keyed by a
+// fingerprint of the executable (PE timestamp, image size, checksum and a
+// hash of the headers, which include the section table); a cache written for
+// another build is ignored as a whole.
+//
+// This file is platform neutral.
+
+struct ImageFingerprint {
+    uint32_t timeDateStamp = 0;
+    uint32_t sizeOfImage = 0;
+    uint32_t checkSum = 0;
+    uint64_t headerHash = 0;
+};
+
+struct CachedAddress {
+    std::string name;
+    uint32_t rva;
+};
+
+struct AddressCache {
+    ImageFingerprint fingerprint;
+    uint64_t scanMicroseconds = 0;  // what resolving took without the cache
+    std::vector<CachedAddress> entries;
+};
+
+// Needs the headers (SizeOfHeaders bytes) to be inside the parsed view.
+bool FingerprintImage(const PeImage& image, ImageFingerprint& fingerprint);
+
+// False if the file is missing, malformed or written for another executable.
+// A line cut short or a value that is not a whole number makes it malformed,
+// so a cache truncated mid-line is ignored rather than read with bad entries.
+bool LoadAddressCache(const char* path, const ImageFingerprint& expected, AddressCache& cache);
+bool SaveAddressCache(const char* path, const AddressCache& cache);
+
+const CachedAddress* FindCachedAddress(const AddressCache& cache, const char* name);
+void SetCachedAddress(AddressCache& cache, const char* name, uint32_t rva);
@@ -0,0 +1,144 @@
+#pragma once
+#include "ComVtable.h"
+#include "HookStats.h"
+
+// Generated hook thunks for COM methods.
+//
+//   struct PresentCounter : ComHookHandler {
+//       static void Pre(IDirect3DDevice9*, const RECT*&, const RECT*&, HWND&, const RGNDATA*&) { ... }
+//   };
+//   typedef ComHook<COM_METHOD(IDirect3DDevice9, Present), PresentCounter> PresentHook;
+//   PresentHook::Request("IDirect3DDevice9::Present", device);      // Detours, see HookRegistry.h
+//   PresentHook::PatchVtable("IDirect3DDevice9::Present", device);  // or a vtable slot
+//
+// ComHook<M, Handler>::Thunk has exactly the signature of the method. It
+// calls Handler::Pre with the arguments by reference (so it may change them),
+// the original method, then Handler::Post with the result and the arguments.
+// A handler can also drop the call: when Handler::Skip (given the result to
+// return and the arguments) returns true, the thunk returns that result
+// without calling Pre, the original or Post. Handlers are static and resolved
+// at compile time: no allocation, no indirect call besides the original, and
+// empty handlers inline away. Each (method, handler) pair gets its own thunk
+// and original pointer.
+//
+// Unless PEGGLE_HOOK_STATS is 0, the thunk also times the original method and
+// records it under the hook's name (see HookStats.h).
+
+#ifndef PEGGLE_HOOK_STATS
+#define PEGGLE_HOOK_STATS 1
+#endif
+
+namespace ComHookDetail {
+
+// Times the original call when statistics are compiled in
+struct CallTimer {
+#if PEGGLE_HOOK_STATS
+    uint32_t hook;
+    uint64_t start;
+    // A hook without a statistics entry is not timed at all
+    explicit CallTimer(uint32_t hook) : hook(hook), start(hook != HOOK_STATS_NONE ? HookStatsNow() : 0) {}
+    void Stop() {
+        if (hook != HOOK_STATS_NONE) HookStatsRecord(hook, HookStatsNow() - start);
+    }
+#else
+    explicit CallTimer(uint32_t) {}
+    void Stop() {}
+#endif
+};
+
+inline uint32_t Register(const char* name) {
+#if PEGGLE_HOOK_STATS
+    return HookStatsRegister(name);
+#else
+    (void)name;
+    return HOOK_STATS_NONE;
+#endif
+}
+
+} // namespace ComHookDetail
+
+// Derive handlers from this; whichever of Skip/Pre/Post a handler does not
+// declare falls back to these no-ops.
+struct ComHookHandler {
+    template <typename... Args>
+    static bool Skip(Args&...) { return false; }
+
+    template <typename... Args>
+    static void Pre(Args&...) {}
+
+    template <typename... Args>
+    static void Post(Args&...) {}
+};
+
+template <typename M, typename Handler, typename Function = typename M::Function>
+struct ComHook;
+
+template <typename M, typename Handler, typename R, typename C, typename... Args>
+struct ComHook<M, Handler, R (COM_CALL*)(C*, Args...)> {
+    typedef typename M::Function Function;
+    static Function original;
+    static uint32_t stats;
+
+    static R COM_CALL Thunk(C* self, Args... args) {
+        R result{};
+        if (Handler::Skip(result, self, args...)) return result;
+
+        Handler::Pre(self, args...);
+        ComHookDetail::CallTimer timer(stats);
+        result = original(self, args...);
+        timer.Stop();
+        Handler::Post(result, self, args...);
+        return result;
+    }
+
+    static bool Request(const char* name, C* object) {
+        stats = ComHookDetail::Register(name);
+        return ComHookRequest<M>(name, &original, object, &Thunk);
+    }
+
+    static bool PatchVtable(const char* name, C* object) {
+        stats = ComHookDetail::Register(name);
+        return ComPatchVtable<M>(object, &Thunk, &original);
+    }
+};
+
+// Methods without a result (IDirect3DDevice9::SetGammaRamp and a few
+// others); Skip and Post get only the arguments
+template <typename M, typename Handler, typename C, typename... Args>
+struct ComHook<M, Handler, void (COM_CALL*)(C*, Args...)> {
+    typedef typename M::Function Function;
+    static Function original;
+    static uint32_t stats;
+
+    static void COM_CALL Thunk(C* self, Args... args) {
+        if (Handler::Skip(self, args...)) return;
+
+        Handler::Pre(self, args...);
+        ComHookDetail::CallTimer timer(stats);
+        original(self, args...);
+        timer.Stop();
+        Handler::Post(self, args...);
+    }
+
+    static bool Request(const char* name, C* object) {
+        stats = ComHookDetail::Register(name);
+        return ComHookRequest<M>(name, &original, object, &Thunk);
+    }
+
+    static bool PatchVtable(const char* name, C* object) {
+        stats = ComHookDetail::Register(name);
+        return ComPatchVtable<M>(object, &Thunk, &original);
+    }
+};
+
+template <typename M, typename Handler, typename R, typename C, typename... Args>
+typename M::Function ComHook<M, Handler, R (COM_CALL*)(C*, Args...)>::original = nullptr;
+
+template <typename M, typename Handler, typename C, typename... Args>
+typename M::Function ComHook<M, Handler, void (COM_CALL*)(C*, Args...)>::original = nullptr;
+
+template <typename M, typename Handler, typename R, typename C, typename... Args>
+uint32_t ComHook<M, Handler, R (COM_CALL*)(C*, Args...)>::stats = HOOK_STATS_NONE;
+
+template <typename M, typename Handler, typename C, typename... Args>
+uint32_t ComHook<M, Handler, void (COM_CALL*)(C*, Args...)>::stats = HOOK_STATS_NONE;
@@ -0,0 +1,34 @@
+#include "ComVtable.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <cstdint>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+bool PatchVtableSlot(void* object, size_t slot, void* replacement, void** original) {
+    void** entry = *reinterpret_cast<void***>(object) + slot;
+    if (*entry == replacement) return true;
+
+#ifdef _WIN32
+    DWORD oldProtect;
+    if (!VirtualProtect(entry, sizeof(void*), PAGE_READWRITE, &oldProtect)) return false;
+    *original = *entry;
+    *entry = replacement;
+    VirtualProtect(entry, sizeof(void*), oldProtect, &oldProtect);
+#else
+    // mprotect cannot report the old protection, so the page is left
+    // writable: it was either already, or is the read-only data of a vtable
+    uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+    void* page = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(entry) & ~(pageSize - 1));
+    if (mprotect(page, pageSize, PROT_READ | PROT_WRITE) != 0) return false;
+    *original = *entry;
+    *entry = replacement;
+#endif
+    return true;
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include <cstddef>
+#include "HookRegistry.h"
+
+// Vtable slot of every method of the COM interfaces we hook, generated from
+// the method lists below in declaration order (the order of d3d9.h and
+// ddraw.h), plus helpers that deduce the hook's function type from the
+// interface method so a detour with the wrong signature does not compile:
+//
+//   typedef COM_METHOD(IDirect3DDevice9, Present)::Function Present_t;
+//   ComHookRequest<COM_METHOD(IDirect3DDevice9, Present)>(
+//       "IDirect3DDevice9::Present", &OriginalPresent, device, PresentHook);
+//
+// The slot tables themselves are platform neutral; the helpers only need the
+// SDK header that declares the interface.
+
+#ifdef _WIN32
+#define COM_CALL __stdcall
+#else
+#define COM_CALL
+#endif
+
+#define COM_IUNKNOWN_METHODS(X) \
+    X(QueryInterface) X(AddRef) X(Release)
+
+#define COM_IDIRECT3D9_METHODS(X) COM_IUNKNOWN_METHODS(X) \
+    X(RegisterSoftwareDevice) X(GetAdapterCount) X(GetAdapterIdentifier) X(GetAdapterModeCount) \
+    X(EnumAdapterModes) X(GetAdapterDisplayMode) X(CheckDeviceType) X(CheckDeviceFormat) \
+    X(CheckDeviceMultiSampleType) X(CheckDepthStencilMatch) X(CheckDeviceFormatConversion) \
+    X(GetDeviceCaps) X(GetAdapterMonitor) X(CreateDevice)
+
+#define COM_IDIRECT3DDEVICE9_METHODS(X) COM_IUNKNOWN_METHODS(X) \
+    X(TestCooperativeLevel) X(GetAvailableTextureMem) X(EvictManagedResources) X(GetDirect3D) \
+    X(GetDeviceCaps) X(GetDisplayMode) X(GetCreationParameters) X(SetCursorProperties) \
+    X(SetCursorPosition) X(ShowCursor) X(CreateAdditionalSwapChain) X(GetSwapChain) \
+    X(GetNumberOfSwapChains) X(Reset) X(Present) X(GetBackBuffer) X(GetRasterStatus) \
+    X(SetDialogBoxMode) X(SetGammaRamp) X(GetGammaRamp) X(CreateTexture) X(CreateVolumeTexture) \
+    X(CreateCubeTexture) X(CreateVertexBuffer) X(CreateIndexBuffer) X(CreateRenderTarget) \
+    X(CreateDepthStencilSurface) X(UpdateSurface) X(UpdateTexture) X(GetRenderTargetData) \
+    X(GetFrontBufferData) X(StretchRect) X(ColorFill) X(CreateOffscreenPlainSurface) \
+    X(SetRenderTarget) X(GetRenderTarget) X(SetDepthStencilSurface) X(GetDepthStencilSurface) \
+    X(BeginScene) X(EndScene) X(Clear) X(SetTransform) X(GetTransform) X(MultiplyTransform) \
+    X(SetViewport) X(GetViewport) X(SetMaterial) X(GetMaterial) X(SetLight) X(GetLight) \
+    X(LightEnable) X(GetLightEnable) X(SetClipPlane) X(GetClipPlane) X(SetRenderState) \
+    X(GetRenderState) X(CreateStateBlock) X(BeginStateBlock) X(EndStateBlock) X(SetClipStatus) \
+    X(GetClipStatus) X(GetTexture) X(SetTexture) X(GetTextureStageState) X(SetTextureStageState) \
+    X(GetSamplerState) X(SetSamplerState) X(ValidateDevice) X(SetPaletteEntries) \
+    X(GetPaletteEntries) X(SetCurrentTexturePalette) X(GetCurrentTexturePalette) \
+    X(SetScissorRect) X(GetScissorRect) X(SetSoftwareVertexProcessing) \
+    X(GetSoftwareVertexProcessing) X(SetNPatchMode) X(GetNPatchMode) X(DrawPrimitive) \
+    X(DrawIndexedPrimitive) X(DrawPrimitiveUP) X(DrawIndexedPrimitiveUP) X(ProcessVertices) \
+    X(CreateVertexDeclaration) X(SetVertexDeclaration) X(GetVertexDeclaration) X(SetFVF) \
+    X(GetFVF) X(CreateVertexShader) X(SetVertexShader) X(GetVertexShader) \
+    X(SetVertexShaderConstantF) X(GetVertexShaderConstantF) X(SetVertexShaderConstantI) \
+    X(GetVertexShaderConstantI) X(SetVertexShaderConstantB) X(GetVertexShaderConstantB) \
+    X(SetStreamSource) X(GetStreamSource) X(SetStreamSourceFreq) X(GetStreamSourceFreq) \
+    X(SetIndices) X(GetIndices) X(CreatePixelShader) X(SetPixelShader) X(GetPixelShader) \
+    X(SetPixelShaderConstantF) X(GetPixelShaderConstantF) X(SetPixelShaderConstantI) \
+    X(GetPixelShaderConstantI) X(SetPixelShaderConstantB) X(GetPixelShaderConstantB) \
+    X(DrawRectPatch) X(DrawTriPatch) X(DeletePatch) X(CreateQuery)
+
+// Each DirectDraw revision appends to the previous one
+#define COM_IDIRECTDRAW_METHODS(X) COM_IUNKNOWN_METHODS(X) \
+    X(Compact) X(CreateClipper) X(CreatePalette) X(CreateSurface) X(DuplicateSurface) \
+    X(EnumDisplayModes) X(EnumSurfaces) X(FlipToGDISurface) X(GetCaps) X(GetDisplayMode) \
+    X(GetFourCCCodes) X(GetGDISurface) X(GetMonitorFrequency) X(GetScanLine) \
+    X(GetVerticalBlankStatus) X(Initialize) X(RestoreDisplayMode) X(SetCooperativeLevel) \
+    X(SetDisplayMode) X(WaitForVerticalBlank)
+
+#define COM_IDIRECTDRAW2_METHODS(X) COM_IDIRECTDRAW_METHODS(X) \
+    X(GetAvailableVidMem)
+
+#define COM_IDIRECTDRAW4_METHODS(X) COM_IDIRECTDRAW2_METHODS(X) \
+    X(GetSurfaceFromDC) X(RestoreAllSurfaces) X(TestCooperativeLevel) X(GetDeviceIdentifier)
+
+#define COM_IDIRECTDRAW7_METHODS(X) COM_IDIRECTDRAW4_METHODS(X) \
+    X(StartModeTest) X(EvaluateMode)
+
+#define COM_IDIRECTDRAWSURFACE_METHODS(X) COM_IUNKNOWN_METHODS(X) \
+    X(AddAttachedSurface) X(AddOverlayDirtyRect) X(Blt) X(BltBatch) X(BltFast) \
+    X(DeleteAttachedSurface) X(EnumAttachedSurfaces) X(EnumOverlayZOrders) X(Flip) \
+    X(GetAttachedSurface) X(GetBltStatus) X(GetCaps) X(GetClipper) X(GetColorKey) X(GetDC) \
+    X(GetFlipStatus) X(GetOverlayPosition) X(GetPalette) X(GetPixelFormat) X(GetSurfaceDesc) \
+    X(Initialize) X(IsLost) X(Lock) X(ReleaseDC) X(Restore) X(SetClipper) X(SetColorKey) \
+    X(SetOverlayPosition) X(SetPalette) X(Unlock) X(UpdateOverlay) X(UpdateOverlayDisplay) \
+    X(UpdateOverlayZOrder)
+
+#define COM_IDIRECTDRAWSURFACE7_METHODS(X) COM_IDIRECTDRAWSURFACE_METHODS(X) \
+    X(GetDDInterface) X(PageLock) X(PageUnlock) X(SetSurfaceDesc) X(SetPrivateData) \
+    X(GetPrivateData) X(FreePrivateData) X(GetUniquenessValue) X(ChangeUniquenessValue) \
+    X(SetPriority) X(GetPriority) X(SetLOD) X(GetLOD)
+
+#define COM_SLOT_ENUMERATOR(name) name,
+
+// ComSlot::IDirect3DDevice9::Present == 17, ComSlot::IDirect3DDevice9::Count == 119
+namespace ComSlot {
+namespace IDirect3D9 { enum : size_t { COM_IDIRECT3D9_METHODS(COM_SLOT_ENUMERATOR) Count }; }
+namespace IDirect3DDevice9 { enum : size_t { COM_IDIRECT3DDEVICE9_METHODS(COM_SLOT_ENUMERATOR) Count }; }
+namespace IDirectDraw { enum : size_t { COM_IDIRECTDRAW_METHODS(COM_SLOT_ENUMERATOR) Count }; }
+namespace IDirectDraw2 { enum : size_t { COM_IDIRECTDRAW2_METHODS(COM_SLOT_ENUMERATOR) Count }; }
+namespace IDirectDraw4 { enum : size_t { COM_IDIRECTDRAW4_METHODS(COM_SLOT_ENUMERATOR) Count }; }
+namespace IDirectDraw7 { enum : size_t { COM_IDIRECTDRAW7_METHODS(COM_SLOT_ENUMERATOR) Count }; }
+namespace IDirectDrawSurface { enum : size_t { COM_IDIRECTDRAWSURFACE_METHODS(COM_SLOT_ENUMERATOR) Count }; }
+namespace IDirectDrawSurface7 { enum : size_t { COM_IDIRECTDRAWSURFACE7_METHODS(COM_SLOT_ENUMERATOR) Count }; }
+} // namespace ComSlot
+
+#undef COM_SLOT_ENUMERATOR
+
+// Spot checks against the SDK headers
+static_assert(ComSlot::IDirect3D9::CreateDevice == 16 && ComSlot::IDirect3D9::Count == 17, "IDirect3D9 slots");
+static_assert(ComSlot::IDirect3DDevice9::Reset == 16 && ComSlot::IDirect3DDevice9::Present == 17 &&
+    ComSlot::IDirect3DDevice9::EndScene == 42 && ComSlot::IDirect3DDevice9::Count == 119, "IDirect3DDevice9 slots");
+static_assert(ComSlot::IDirectDraw::SetDisplayMode == 21 && ComSlot::IDirectDraw::Count == 23, "IDirectDraw slots");
+static_assert(ComSlot::IDirectDraw7::Count == 30, "IDirectDraw7 slots");
+static_assert(ComSlot::IDirectDrawSurface7::Blt == 5 && ComSlot::IDirectDrawSurface7::Flip == 11 &&
+    ComSlot::IDirectDrawSurface7::Lock == 25 && ComSlot::IDirectDrawSurface7::Count == 49, "IDirectDrawSurface7 slots");
+
+// Free function type of a method: the interface pointer becomes the first
+// argument, as in the C bindings of the SDK headers
+template <typename Method>
+struct ComMethodTraits;
+
+template <typename R, typename C, typename... Args>
+struct ComMethodTraits<R (COM_CALL C::*)(Args...)> {
+    typedef C Interface;
+    typedef R (COM_CALL* Function)(C*, Args...);
+};
+
+template <typename Method, size_t Slot>
+struct ComMethod : ComMethodTraits<Method> {
+    static constexpr size_t slot = Slot;
+};
+
+#define COM_METHOD(Interface, Name) ComMethod<decltype(&::Interface::Name), ComSlot::Interface::Name>
+
+// Current vtable entry of the method for this object.
+template <typename M>
+inline typename M::Function ComVtableEntry(typename M::Interface* object) {
+    void** vtable = *reinterpret_cast<void***>(object);
+    return reinterpret_cast<typename M::Function>(vtable[M::slot]);
+}
+
+// Queue a Detours hook of the method's implementation (see HookRegistry.h).
+template <typename M>
+inline bool ComHookRequest(const char* name, typename M::Function* original, typename M::Interface* object,
+    typename M::Function detour) {
+    return HookRequest(name, original, ComVtableEntry<M>(object), detour);
+}
+
+// Replace one vtable slot. Every object of the class shares the vtable, so
+// this hooks the method for all of them. *original receives the previous
+// entry before the slot is written; a slot that already holds replacement is
+// left alone so a second call cannot make the hook call itself.
+bool PatchVtableSlot(void* object, size_t slot, void* replacement, void** original);
+
+template <typename M>
+inline bool ComPatchVtable(typename M::Interface* object, typename M::Function replacement,
+    typename M::Function* original) {
+    return PatchVtableSlot(object, M::slot, reinterpret_cast<void*>(replacement),
+        reinterpret_cast<void**>(original));
+}
@@ -0,0 +1,81 @@
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(PEGGLE_X86)
+#include <cpuid.h>
+#endif
+
+namespace {
+
+struct CpuFeatures {
+    bool sse2 = false;
+    bool ssse3 = false;
+    bool avx2 = false;
+};
+
+#ifdef PEGGLE_X86
+void Cpuid(int leaf, int subleaf, int regs[4]) {
+#if defined(_MSC_VER)
+    __cpuidex(regs, leaf, subleaf);
+#else
+    unsigned a, b, c, d;
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+    regs[0] = (int)a;
+    regs[1] = (int)b;
+    regs[2] = (int)c;
+    regs[3] = (int)d;
+#endif
+}
+
+uint64_t ReadXcr0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t)hi << 32) | lo;
+#endif
+}
+#endif
+
+CpuFeatures Detect() {
+    CpuFeatures features;
+#ifdef PEGGLE_X86
+    int regs[4];
+    Cpuid(0, 0, regs);
+    int maxLeaf = regs[0];
+
+    Cpuid(1, 0, regs);
+    features.sse2 = (regs[3] & (1 << 26)) != 0;
+    features.ssse3 = (regs[2] & (1 << 9)) != 0;
+    bool osxsave = (regs[2] & (1 << 27)) != 0;
+    bool avx = (regs[2] & (1 << 28)) != 0;
+
+    // AVX2 also needs the OS to save the YMM registers
+    if (maxLeaf >= 7 && osxsave && avx && (ReadXcr0() & 6) == 6) {
+        Cpuid(7, 0, regs);
+        features.avx2 = (regs[1] & (1 << 5)) != 0;
+    }
+#endif
+    return features;
+}
+
+const CpuFeatures& Features() {
+    static const CpuFeatures features = Detect();
+    return features;
+}
+
+} // namespace
+
+bool CpuHasSse2() {
+    return Features().sse2;
+}
+
+bool CpuHasSsse3() {
+    return Features().ssse3;
+}
+
+bool CpuHasAvx2() {
+    return Features().avx2;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Runtime CPU feature detection and helpers shared by the SIMD code paths.
+//
+// Vector kernels are compiled for every x86/x64 build and selected at runtime.
+// MSVC accepts the intrinsics without special flags; GCC/Clang need the
+// per-function target attributes below.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PEGGLE_X86 1
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PEGGLE_TARGET_SSE2 __attribute__((target("sse2")))
+#define PEGGLE_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define PEGGLE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PEGGLE_TARGET_SSE2
+#define PEGGLE_TARGET_SSSE3
+#define PEGGLE_TARGET_AVX2
+#endif
+
+bool CpuHasSse2();
+bool CpuHasSsse3();
+bool CpuHasAvx2();
+
+// Index of the lowest set bit; value must not be zero.
+inline unsigned CountTrailingZeros(uint32_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(value);
+#endif
+}
+
+// Index of the highest set bit; value must not be zero.
+inline unsigned HighestSetBit(uint32_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, value);
+    return (unsigned)index;
+#else
+    return 31u - (unsigned)__builtin_clz(value);
+#endif
+}
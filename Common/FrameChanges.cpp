@@ -0,0 +1,113 @@
+#include "FrameChanges.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef PEGGLE_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr size_t PALETTE_BYTES = 256 * 4;
+
+bool SegmentChangedScalar(const uint8_t* a, const uint8_t* b, size_t bytes) {
+    return memcmp(a, b, bytes) != 0;
+}
+
+#ifdef PEGGLE_X86
+PEGGLE_TARGET_SSE2
+bool SegmentChangedSse2(const uint8_t* a, const uint8_t* b, size_t bytes) {
+    __m128i diff = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+        diff = _mm_or_si128(diff, _mm_xor_si128(x, y));
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF) return true;
+    return SegmentChangedScalar(a + i, b + i, bytes - i);
+}
+
+PEGGLE_TARGET_AVX2
+bool SegmentChangedAvx2(const uint8_t* a, const uint8_t* b, size_t bytes) {
+    __m256i diff = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        diff = _mm256_or_si256(diff, _mm256_xor_si256(x, y));
+    }
+    if (!_mm256_testz_si256(diff, diff)) return true;
+    return SegmentChangedScalar(a + i, b + i, bytes - i);
+}
+#endif
+
+bool SegmentChanged(ImageScalePath path, const uint8_t* a, const uint8_t* b, size_t bytes) {
+    switch (path) {
+#ifdef PEGGLE_X86
+    case IMAGE_SCALE_AVX2:
+        return SegmentChangedAvx2(a, b, bytes);
+    case IMAGE_SCALE_SSE2:
+        return SegmentChangedSse2(a, b, bytes);
+#endif
+    default:
+        return SegmentChangedScalar(a, b, bytes);
+    }
+}
+
+} // namespace
+
+void FrameChanges::Update(const ImageView& frame) {
+    if (frame.width != m_width || frame.height != m_height || frame.format != m_format) {
+        m_width = frame.width;
+        m_height = frame.height;
+        m_format = frame.format;
+        m_columns = (m_width + TILE_SIZE - 1) / TILE_SIZE;
+        m_rows = (m_height + TILE_SIZE - 1) / TILE_SIZE;
+        m_previous.resize(ImageFormatBytes(m_format) * (size_t)m_width * m_height);
+        m_changed.resize((size_t)m_columns * m_rows);
+        m_valid = false;
+    }
+
+    // A new palette changes every pixel without touching one
+    if (m_format == IMAGE_FORMAT_PALETTE8 && frame.palette) {
+        if (m_palette.empty() || memcmp(m_palette.data(), frame.palette, PALETTE_BYTES) != 0) {
+            m_palette.assign(frame.palette, frame.palette + PALETTE_BYTES / 4);
+            m_valid = false;
+        }
+    }
+
+    size_t pixelBytes = ImageFormatBytes(m_format);
+    size_t rowBytes = pixelBytes * m_width;
+    if (!m_valid) {
+        for (uint32_t y = 0; y < m_height; y++) {
+            memcpy(&m_previous[y * rowBytes], frame.pixels + (ptrdiff_t)y * frame.pitch, rowBytes);
+        }
+        std::fill(m_changed.begin(), m_changed.end(), (uint8_t)1);
+        m_changedCount = TileCount();
+        m_valid = true;
+        return;
+    }
+
+    ImageScalePath path = ImageScaleDefaultPath();
+    std::fill(m_changed.begin(), m_changed.end(), (uint8_t)0);
+    for (uint32_t y = 0; y < m_height; y++) {
+        const uint8_t* in = frame.pixels + (ptrdiff_t)y * frame.pitch;
+        uint8_t* previous = &m_previous[y * rowBytes];
+        uint8_t* changed = &m_changed[(size_t)(y / TILE_SIZE) * m_columns];
+
+        for (uint32_t column = 0; column < m_columns; column++) {
+            size_t offset = pixelBytes * column * TILE_SIZE;
+            size_t bytes = std::min(pixelBytes * TILE_SIZE, rowBytes - offset);
+
+            // The rows of a tile above the first difference already match, so
+            // from there on the rest only needs copying
+            if (changed[column] || SegmentChanged(path, in + offset, previous + offset, bytes)) {
+                memcpy(previous + offset, in + offset, bytes);
+                changed[column] = 1;
+            }
+        }
+    }
+    m_changedCount = (uint32_t)std::count(m_changed.begin(), m_changed.end(), (uint8_t)1);
+}
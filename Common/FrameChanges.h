@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "ImageScaler.h"
+
+// Which parts of a frame changed since the previous one, per square tile.
+//
+// Each frame is compared with a copy of the previous one, a tile row segment
+// at a time with wide compares; a segment that differs is copied over the
+// old one, so the copy is always the last frame and the comparison exact (no
+// hash collisions). ImageScaler uses the result to rescale only the target
+// pixels that depend on a changed tile; that relies on the target still
+// holding the previous result, so whoever owns the target calls Invalidate
+// when it is lost or replaced.
+//
+// This file is platform neutral.
+
+class FrameChanges {
+public:
+    static constexpr uint32_t TILE_SIZE = 32;  // pixels
+
+    // Compare frame with the previous one and remember it. Every tile counts
+    // as changed on the first frame, after a change of size or format, when
+    // a palettized frame's palette changes, and after Invalidate.
+    void Update(const ImageView& frame);
+    void Invalidate() { m_valid = false; }
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    uint32_t Columns() const { return m_columns; }
+    uint32_t Rows() const { return m_rows; }
+    bool Changed(uint32_t column, uint32_t row) const { return m_changed[(size_t)row * m_columns + column] != 0; }
+
+    // Of the last Update
+    uint32_t TileCount() const { return m_columns * m_rows; }
+    uint32_t ChangedCount() const { return m_changedCount; }
+    bool AllChanged() const { return m_changedCount == TileCount(); }
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    ImageFormat m_format = IMAGE_FORMAT_BGRX8888;
+    uint32_t m_columns = 0;
+    uint32_t m_rows = 0;
+    bool m_valid = false;
+    std::vector<uint8_t> m_previous;  // packed rows of m_width pixels
+    std::vector<uint32_t> m_palette;  // of the previous frame, if palettized
+    std::vector<uint8_t> m_changed;   // per tile, row by row
+    uint32_t m_changedCount = 0;
+};
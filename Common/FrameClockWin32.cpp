@@ -0,0 +1,61 @@
+#include "FrameClockWin32.h"
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <timeapi.h>
+
+#pragma comment(lib, "winmm.lib")
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+Win32FrameClock::Win32FrameClock() {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    m_frequency = frequency.QuadPart;
+
+    m_timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    m_highResolution = m_timer != nullptr;
+    if (!m_timer) {
+        m_timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+        timeBeginPeriod(1);
+    }
+}
+
+Win32FrameClock::~Win32FrameClock() {
+    if (m_timer) CloseHandle(m_timer);
+    if (!m_highResolution) timeEndPeriod(1);
+}
+
+int64_t Win32FrameClock::Now() {
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    // Split to avoid overflowing counter * 1e9
+    int64_t seconds = counter.QuadPart / m_frequency;
+    int64_t remainder = counter.QuadPart % m_frequency;
+    return seconds * 1000000000 + remainder * 1000000000 / m_frequency;
+}
+
+void Win32FrameClock::SleepUntil(int64_t deadline) {
+    int64_t remaining = deadline - Now();
+    if (remaining <= 0) return;
+
+    if (!m_timer) {
+        Sleep((DWORD)(remaining / 1000000));
+        return;
+    }
+
+    // Negative due times are relative, in 100 ns units
+    LARGE_INTEGER dueTime;
+    dueTime.QuadPart = -(remaining / 100);
+    if (SetWaitableTimerEx(m_timer, &dueTime, 0, nullptr, nullptr, nullptr, 0)) {
+        WaitForSingleObject(m_timer, INFINITE);
+    }
+}
+
+void Win32FrameClock::Relax() {
+    YieldProcessor();
+}
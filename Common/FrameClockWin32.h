@@ -0,0 +1,25 @@
+#pragma once
+#include "FramePacer.h"
+
+// FrameClock on QueryPerformanceCounter and a waitable timer. The timer is
+// created high resolution where Windows supports it (10 1803 and later);
+// otherwise the system timer period is raised to 1 ms while the clock exists.
+class Win32FrameClock : public FrameClock {
+public:
+    Win32FrameClock();
+    ~Win32FrameClock() override;
+
+    Win32FrameClock(const Win32FrameClock&) = delete;
+    Win32FrameClock& operator=(const Win32FrameClock&) = delete;
+
+    bool IsHighResolution() const { return m_highResolution; }
+
+    int64_t Now() override;
+    void SleepUntil(int64_t deadline) override;
+    void Relax() override;
+
+private:
+    void* m_timer;
+    bool m_highResolution;
+    int64_t m_frequency;
+};
@@ -0,0 +1,58 @@
+#include "FramePacer.h"
+#include <algorithm>
+
+namespace {
+
+constexpr int64_t INITIAL_SPIN_TAIL = 1000000;  // 1 ms until the timer is measured
+constexpr int64_t MIN_SPIN_TAIL = 50000;
+constexpr int64_t SPIN_TAIL_MARGIN = 20000;
+constexpr int SPIN_TAIL_DECAY_SHIFT = 4;         // shrink by 1/16 of the gap per frame
+
+} // namespace
+
+FramePacer::FramePacer(FrameClock& clock)
+    : m_clock(clock), m_spinTail(INITIAL_SPIN_TAIL) {
+}
+
+void FramePacer::SetFrameRate(double framesPerSecond) {
+    m_interval = framesPerSecond > 0.0 ? (int64_t)(1e9 / framesPerSecond) : 0;
+    m_started = false;
+}
+
+void FramePacer::UpdateSpinTail(int64_t overshoot) {
+    int64_t wanted = std::max<int64_t>(overshoot, 0) + SPIN_TAIL_MARGIN;
+    if (wanted > m_spinTail) {
+        m_spinTail = wanted;
+    }
+    else {
+        m_spinTail -= (m_spinTail - wanted) >> SPIN_TAIL_DECAY_SHIFT;
+    }
+    m_spinTail = std::min(std::max(m_spinTail, MIN_SPIN_TAIL), m_interval / 2);
+}
+
+void FramePacer::Wait() {
+    if (!m_interval) return;
+
+    int64_t now = m_clock.Now();
+    if (!m_started) {
+        m_started = true;
+        m_deadline = now + m_interval;
+        return;
+    }
+
+    if (now >= m_deadline) {
+        // Late already: present now, and restart the grid after a hitch
+        m_deadline = (now - m_deadline > m_interval) ? now + m_interval : m_deadline + m_interval;
+        return;
+    }
+
+    int64_t wake = m_deadline - m_spinTail;
+    if (now < wake) {
+        m_clock.SleepUntil(wake);
+        UpdateSpinTail(m_clock.Now() - wake);
+    }
+    while (m_clock.Now() < m_deadline) {
+        m_clock.Relax();
+    }
+    m_deadline += m_interval;
+}
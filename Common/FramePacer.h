@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+
+// Frame rate limiter for the Present hook.
+//
+// Frames are paced against a fixed grid of deadlines (previous deadline plus
+// the frame interval) rather than by sleeping a fixed time after each frame,
+// so the time spent rendering does not add to the interval and the average
+// rate is exact. Each wait sleeps until shortly before the deadline and spins
+// for the rest; the length of that spin tail follows how late the sleeps
+// actually wake (quick to grow, slow to shrink), so it stays as short as the
+// timer allows. A frame that is already late is not delayed, and after a
+// hitch of more than a whole frame the grid restarts from now instead of
+// rushing frames out to catch up.
+//
+// The pacer works against the FrameClock interface, so the algorithm is
+// platform neutral; Win32FrameClock (FrameClockWin32.h) implements it with a
+// high-resolution waitable timer.
+
+// Time source for FramePacer, in nanoseconds from an arbitrary epoch.
+class FrameClock {
+public:
+    virtual ~FrameClock() = default;
+
+    virtual int64_t Now() = 0;
+
+    // Block until about deadline. May wake late by the timer's granularity
+    // and should not wake much early.
+    virtual void SleepUntil(int64_t deadline) = 0;
+
+    // Called on every iteration of the spin tail.
+    virtual void Relax() {}
+};
+
+class FramePacer {
+public:
+    explicit FramePacer(FrameClock& clock);
+
+    // 0 turns the limiter off.
+    void SetFrameRate(double framesPerSecond);
+
+    // Return when the next frame is due. Call right before presenting.
+    void Wait();
+
+    int64_t Interval() const { return m_interval; }
+    int64_t SpinTail() const { return m_spinTail; }
+
+private:
+    void UpdateSpinTail(int64_t overshoot);
+
+    FrameClock& m_clock;
+    int64_t m_interval = 0;
+    int64_t m_deadline = 0;
+    bool m_started = false;
+    int64_t m_spinTail;
+};
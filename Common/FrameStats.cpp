@@ -0,0 +1,315 @@
+#include "FrameStats.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "HdrHistogram.h"
+#include "Log.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+constexpr uint64_t MAX_FRAME_MICROSECONDS = 60000000;  // longer gaps (loading, minimized) are clamped
+constexpr double PERCENTILES[] = { 50.0, 95.0, 99.0, 99.9 };
+constexpr auto WRITER_IDLE_SLEEP = std::chrono::milliseconds(500);
+constexpr int CLOSE_TIMEOUT_MS = 1000;  // FrameStatsClose waits this long at most per step
+
+struct FrameWindow {
+    HdrHistogram interval{ MAX_FRAME_MICROSECONDS };
+    HdrHistogram present{ MAX_FRAME_MICROSECONDS };
+    double startSeconds = 0.0;
+    double seconds = 0.0;
+
+    void Reset() {
+        interval.Reset();
+        present.Reset();
+        startSeconds = 0.0;
+        seconds = 0.0;
+    }
+
+    void Swap(FrameWindow& other) {
+        interval.Swap(other.interval);
+        present.Swap(other.present);
+        std::swap(startSeconds, other.startSeconds);
+        std::swap(seconds, other.seconds);
+    }
+
+    void Add(const FrameWindow& other) {
+        if (!seconds) startSeconds = other.startSeconds;
+        interval.Add(other.interval);
+        present.Add(other.present);
+        seconds += other.seconds;
+    }
+};
+
+std::atomic<bool> g_open{ false };
+// Set by the render thread while it records. Once g_open is cleared and this
+// is seen false, the render thread no longer touches g_window.
+std::atomic<bool> g_recording{ false };
+Clock::time_point g_openTime;
+Clock::duration g_windowLength;
+
+// Render thread only
+FrameWindow g_window;
+Clock::time_point g_windowStart;
+Clock::time_point g_lastPresent;
+Clock::time_point g_presentStart;
+bool g_havePresent = false;
+
+// Handed to the writer under g_pendingLock
+std::mutex g_pendingLock;
+std::condition_variable g_pendingReady;
+FrameWindow g_pending;
+bool g_hasPending = false;
+
+// Writer only (or FrameStatsClose once the writer has stopped)
+std::mutex g_writerLock;
+FrameWindow g_written;
+FrameWindow g_total;
+FILE* g_csv = nullptr;
+std::string g_jsonPath;
+std::atomic<bool> g_stopWriter{ false };
+std::atomic<bool> g_writerRunning{ false };
+
+double Seconds(Clock::duration duration) {
+    return std::chrono::duration<double>(duration).count();
+}
+
+uint64_t Microseconds(Clock::duration duration) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+double Milliseconds(uint64_t microseconds) {
+    return (double)microseconds / 1000.0;
+}
+
+void WriteCsvRow(const FrameWindow& window) {
+    uint64_t frames = window.interval.Count();
+    fprintf(g_csv, "%.3f,%.3f,%llu,%.2f", window.startSeconds, window.seconds, (unsigned long long)frames,
+        window.seconds > 0.0 ? frames / window.seconds : 0.0);
+    for (const HdrHistogram* histogram : { &window.interval, &window.present }) {
+        for (double percentile : PERCENTILES) {
+            fprintf(g_csv, ",%.3f", Milliseconds(histogram->Percentile(percentile)));
+        }
+        fprintf(g_csv, ",%.3f", Milliseconds(histogram->Max()));
+    }
+    fprintf(g_csv, "\n");
+    fflush(g_csv);
+}
+
+void WriteJsonHistogram(FILE* file, const char* name, const HdrHistogram& histogram) {
+    fprintf(file, "\"%s\": { \"mean\": %.3f", name, histogram.Mean() / 1000.0);
+    for (double percentile : PERCENTILES) {
+        fprintf(file, ", \"p%g\": %.3f", percentile, Milliseconds(histogram.Percentile(percentile)));
+    }
+    fprintf(file, ", \"max\": %.3f }", Milliseconds(histogram.Max()));
+}
+
+void WriteJsonWindow(FILE* file, const char* name, const FrameWindow& window) {
+    uint64_t frames = window.interval.Count();
+    fprintf(file, "  \"%s\": { \"start_s\": %.3f, \"seconds\": %.3f, \"frames\": %llu, \"fps\": %.2f,\n    ",
+        name, window.startSeconds, window.seconds, (unsigned long long)frames,
+        window.seconds > 0.0 ? frames / window.seconds : 0.0);
+    WriteJsonHistogram(file, "interval_ms", window.interval);
+    fprintf(file, ",\n    ");
+    WriteJsonHistogram(file, "present_ms", window.present);
+    fprintf(file, " }");
+}
+
+void WriteJson() {
+    FILE* file = nullptr;
+#ifdef _WIN32
+    if (fopen_s(&file, g_jsonPath.c_str(), "w") != 0) file = nullptr;
+#else
+    file = fopen(g_jsonPath.c_str(), "w");
+#endif
+    if (!file) return;
+
+    fprintf(file, "{\n");
+    WriteJsonWindow(file, "window", g_written);
+    fprintf(file, ",\n");
+    WriteJsonWindow(file, "total", g_total);
+    fprintf(file, "\n}\n");
+    fclose(file);
+}
+
+// Called with g_writerLock held
+void WritePending() {
+    {
+        std::lock_guard<std::mutex> lock(g_pendingLock);
+        if (!g_hasPending) return;
+        g_written.Reset();
+        g_written.Swap(g_pending);
+        g_hasPending = false;
+    }
+
+    g_total.Add(g_written);
+    WriteCsvRow(g_written);
+    WriteJson();
+}
+
+void WriterLoop() {
+    for (;;) {
+        while (!g_stopWriter.load()) {
+            {
+                std::unique_lock<std::mutex> wait(g_pendingLock);
+                g_pendingReady.wait_for(wait, WRITER_IDLE_SLEEP,
+                    [] { return g_hasPending || g_stopWriter.load(); });
+            }
+            std::lock_guard<std::mutex> lock(g_writerLock);
+            WritePending();
+        }
+        g_writerRunning.store(false);
+
+        // Reopened before this writer got to leave; it stays for the new session
+        if (g_stopWriter.load() || g_writerRunning.exchange(true)) return;
+    }
+}
+
+#ifdef _WIN32
+// Leaves through ExitThread, so once g_writerRunning is cleared no more code
+// of this module runs on the thread and the module may be unloaded
+DWORD WINAPI WriterThreadProc(LPVOID) {
+    WriterLoop();
+    ExitThread(0);
+}
+#endif
+
+// Never joined: DllMain would have to do it under the loader lock
+void StartWriter() {
+#ifdef _WIN32
+    HANDLE thread = CreateThread(nullptr, 0, WriterThreadProc, nullptr, 0, nullptr);
+    if (thread) {
+        CloseHandle(thread);
+    }
+    else {
+        g_writerRunning.store(false);
+    }
+#else
+    std::thread(WriterLoop).detach();
+#endif
+}
+
+// Poll for up to CLOSE_TIMEOUT_MS until flag is false
+bool WaitForClear(const std::atomic<bool>& flag) {
+    for (int waited = 0; flag.load(); waited++) {
+        if (waited >= CLOSE_TIMEOUT_MS) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// Hand the current window to the writer and start a new one
+void PublishWindow(Clock::time_point now) {
+    g_window.startSeconds = Seconds(g_windowStart - g_openTime);
+    g_window.seconds = Seconds(now - g_windowStart);
+    {
+        std::lock_guard<std::mutex> lock(g_pendingLock);
+        if (g_hasPending) {
+            g_pending.Add(g_window);  // the writer fell behind; merge
+        }
+        else {
+            g_pending.Swap(g_window);
+            g_hasPending = true;
+        }
+    }
+    g_pendingReady.notify_one();
+    g_window.Reset();
+    g_windowStart = now;
+}
+
+} // namespace
+
+bool FrameStatsOpen(const char* csvPath, const char* jsonPath, unsigned windowSeconds) {
+    std::lock_guard<std::mutex> lock(g_writerLock);
+    if (g_open.load(std::memory_order_relaxed)) return true;
+
+#ifdef _WIN32
+    if (fopen_s(&g_csv, csvPath, "w") != 0) g_csv = nullptr;
+#else
+    g_csv = fopen(csvPath, "w");
+#endif
+    if (!g_csv) {
+        LogError("Cannot open frame statistics file %s", csvPath);
+        return false;
+    }
+    fprintf(g_csv, "start_s,window_s,frames,fps,"
+        "interval_p50_ms,interval_p95_ms,interval_p99_ms,interval_p99.9_ms,interval_max_ms,"
+        "present_p50_ms,present_p95_ms,present_p99_ms,present_p99.9_ms,present_max_ms\n");
+    fflush(g_csv);
+
+    g_jsonPath = jsonPath;
+    g_openTime = Clock::now();
+    g_windowStart = g_openTime;
+    g_windowLength = std::chrono::seconds(windowSeconds ? windowSeconds : 1);
+    g_havePresent = false;
+    g_total.Reset();
+
+    g_stopWriter.store(false);
+    if (!g_writerRunning.exchange(true)) {
+        StartWriter();
+    }
+
+    g_open.store(true);
+    LogInfo("Frame statistics every %u s to %s and %s", windowSeconds, csvPath, jsonPath);
+    return true;
+}
+
+void FrameStatsClose() {
+    if (!g_open.exchange(false)) return;
+
+    // Stop the render thread recording, then hand over what it recorded
+    bool quiet = WaitForClear(g_recording);
+    if (quiet && g_window.interval.Count()) PublishWindow(Clock::now());
+
+    // The writer drains the pending window on its way out
+    g_stopWriter.store(true);
+    g_pendingReady.notify_one();
+    if (!WaitForClear(g_writerRunning)) {
+        LogWarn("Frame statistics writer did not stop");
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(g_writerLock);
+    WritePending();
+    fclose(g_csv);
+    g_csv = nullptr;
+}
+
+void FrameStatsPresentBegin() {
+    g_recording.store(true);
+    if (g_open.load()) {
+        Clock::time_point now = Clock::now();
+        if (g_havePresent) {
+            g_window.interval.Record(Microseconds(now - g_lastPresent));
+        }
+        g_lastPresent = now;
+        g_presentStart = now;
+        g_havePresent = true;
+    }
+    g_recording.store(false);
+}
+
+void FrameStatsPresentEnd() {
+    g_recording.store(true);
+    if (g_open.load() && g_havePresent) {
+        Clock::time_point now = Clock::now();
+        g_window.present.Record(Microseconds(now - g_presentStart));
+        if (now - g_windowStart >= g_windowLength) {
+            PublishWindow(now);
+        }
+    }
+    g_recording.store(false);
+}
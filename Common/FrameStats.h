@@ -0,0 +1,25 @@
+#pragma once
+
+// Frame-time telemetry recorded from the Present hook.
+//
+// Two quantities are kept per frame: the interval between consecutive
+// presents (what the player perceives as stutter) and the time spent inside
+// the original Present. Both go into HDR histograms in microseconds. Every
+// window (a few seconds) the histograms are handed to a background writer,
+// which appends one CSV row for the window and rewrites a JSON file with the
+// window and the whole session, each with p50/p95/p99/p99.9, mean and max.
+//
+// The render thread only records into its own histograms and swaps them
+// with the writer at the end of a window; it never formats or touches files.
+
+bool FrameStatsOpen(const char* csvPath, const char* jsonPath, unsigned windowSeconds);
+
+// Stop recording, write out the partial window and wait (bounded) for the
+// writer to exit. For unloading the module only (DllMain with lpReserved ==
+// nullptr); at process exit the writer is already gone.
+void FrameStatsClose();
+
+// Call on the render thread right before and right after the original
+// Present. Both do nothing until FrameStatsOpen.
+void FrameStatsPresentBegin();
+void FrameStatsPresentEnd();
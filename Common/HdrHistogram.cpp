@@ -0,0 +1,91 @@
+#include "HdrHistogram.h"
+#include <algorithm>
+#include "CpuFeatures.h"
+
+namespace {
+
+unsigned Log2(uint64_t value) {
+    uint32_t high = (uint32_t)(value >> 32);
+    return high ? 32 + HighestSetBit(high) : HighestSetBit((uint32_t)value);
+}
+
+} // namespace
+
+HdrHistogram::HdrHistogram(uint64_t maxValue, unsigned precisionBits)
+    : m_precisionBits(precisionBits), m_maxValue(std::max<uint64_t>(maxValue, 1)) {
+    m_counts.resize(IndexOf(m_maxValue) + 1);
+}
+
+// [0, 2^(bits+1)) maps to itself; above that, values with highest bit
+// e + bits share 2^bits sub-buckets of width 2^e starting at (e + 1) << bits
+size_t HdrHistogram::IndexOf(uint64_t value) const {
+    size_t linear = (size_t)2 << m_precisionBits;
+    if (value < linear) return (size_t)value;
+
+    unsigned shift = Log2(value) - m_precisionBits;
+    size_t half = (size_t)1 << m_precisionBits;
+    return ((size_t)(shift + 1) << m_precisionBits) + (size_t)(value >> shift) - half;
+}
+
+uint64_t HdrHistogram::HighestValueAt(size_t index) const {
+    size_t linear = (size_t)2 << m_precisionBits;
+    if (index < linear) return index;
+
+    unsigned shift = (unsigned)(index >> m_precisionBits) - 1;
+    size_t half = (size_t)1 << m_precisionBits;
+    uint64_t sub = (uint64_t)(index & (half - 1)) + half;
+    return ((sub + 1) << shift) - 1;
+}
+
+void HdrHistogram::Record(uint64_t value) {
+    if (value > m_maxValue) value = m_maxValue;
+    m_counts[IndexOf(value)]++;
+    m_count++;
+    m_sum += value;
+    if (value < m_min) m_min = value;
+    if (value > m_max) m_max = value;
+}
+
+void HdrHistogram::Add(const HdrHistogram& other) {
+    size_t count = std::min(m_counts.size(), other.m_counts.size());
+    for (size_t i = 0; i < count; i++) m_counts[i] += other.m_counts[i];
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    if (other.m_count) {
+        m_min = std::min(m_min, other.m_min);
+        m_max = std::max(m_max, other.m_max);
+    }
+}
+
+void HdrHistogram::Reset() {
+    std::fill(m_counts.begin(), m_counts.end(), 0);
+    m_count = 0;
+    m_sum = 0;
+    m_min = UINT64_MAX;
+    m_max = 0;
+}
+
+void HdrHistogram::Swap(HdrHistogram& other) {
+    std::swap(m_precisionBits, other.m_precisionBits);
+    std::swap(m_maxValue, other.m_maxValue);
+    m_counts.swap(other.m_counts);
+    std::swap(m_count, other.m_count);
+    std::swap(m_sum, other.m_sum);
+    std::swap(m_min, other.m_min);
+    std::swap(m_max, other.m_max);
+}
+
+uint64_t HdrHistogram::Percentile(double percent) const {
+    if (!m_count) return 0;
+
+    percent = std::min(std::max(percent, 0.0), 100.0);
+    uint64_t target = (uint64_t)(percent / 100.0 * (double)m_count + 0.5);
+    if (target < 1) target = 1;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < m_counts.size(); i++) {
+        seen += m_counts[i];
+        if (seen >= target) return std::min(HighestValueAt(i), m_max);
+    }
+    return m_max;
+}
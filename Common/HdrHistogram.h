@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// High-dynamic-range histogram of integer values (HdrHistogram layout).
+//
+// Values below 2^(precisionBits+1) are counted exactly; above that each power
+// of two is split into 2^precisionBits linear sub-buckets, so any recorded
+// value is known to within a relative error of 2^-precisionBits over the whole
+// range. Recording is an index computation and an increment, with no
+// allocation after construction. Not thread safe.
+//
+// This file is platform neutral.
+
+class HdrHistogram {
+public:
+    // Values above maxValue are counted as maxValue.
+    explicit HdrHistogram(uint64_t maxValue, unsigned precisionBits = 7);
+
+    void Record(uint64_t value);
+    void Add(const HdrHistogram& other);  // other must have the same range and precision
+    void Reset();
+    void Swap(HdrHistogram& other);
+
+    uint64_t Count() const { return m_count; }
+    uint64_t Min() const { return m_count ? m_min : 0; }
+    uint64_t Max() const { return m_max; }
+    double Mean() const { return m_count ? (double)m_sum / (double)m_count : 0.0; }
+
+    // Smallest value that percent (0..100) of the recorded values do not
+    // exceed, rounded up to the end of its sub-bucket and capped at Max().
+    uint64_t Percentile(double percent) const;
+
+private:
+    size_t IndexOf(uint64_t value) const;
+    uint64_t HighestValueAt(size_t index) const;
+
+    unsigned m_precisionBits;
+    uint64_t m_maxValue;
+    std::vector<uint64_t> m_counts;
+    uint64_t m_count = 0;
+    uint64_t m_sum = 0;
+    uint64_t m_min = UINT64_MAX;
+    uint64_t m_max = 0;
+};
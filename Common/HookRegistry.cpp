@@ -0,0 +1,158 @@
+#include "HookRegistry.h"
+#include <mutex>
+#include "Log.h"
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <detours.h>
+
+namespace {
+
+constexpr size_t MAX_HOOKS = 64;
+
+struct HookEntry {
+    const char* name;
+    void** original;
+    void* detour;
+    HookState state;
+    LONG error;
+};
+
+HookEntry g_hooks[MAX_HOOKS];
+size_t g_hookCount = 0;
+std::mutex g_hookLock;  // also keeps Detours transactions from overlapping
+
+HookEntry* FindHook(const void* original) {
+    for (size_t i = 0; i < g_hookCount; i++) {
+        if (g_hooks[i].original == original) return &g_hooks[i];
+    }
+    return nullptr;
+}
+
+double MillisecondsSince(const LARGE_INTEGER& start) {
+    LARGE_INTEGER now, frequency;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&frequency);
+    return (now.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart;
+}
+
+} // namespace
+
+bool HookRequest(const char* name, void** original, void* target, void* detour) {
+    std::lock_guard<std::mutex> lock(g_hookLock);
+
+    HookEntry* entry = FindHook(original);
+    if (entry && entry->state != HOOK_DETACHED && entry->state != HOOK_FAILED) {
+        LogDebug("Hook %s already requested", name);
+        return false;
+    }
+    if (!target) {
+        LogError("Hook %s has no target", name);
+        return false;
+    }
+    if (!entry) {
+        if (g_hookCount == MAX_HOOKS) {
+            LogError("Hook registry full, %s not installed", name);
+            return false;
+        }
+        entry = &g_hooks[g_hookCount++];
+    }
+
+    *original = target;
+    *entry = HookEntry{ name, original, detour, HOOK_PENDING, NO_ERROR };
+    return true;
+}
+
+size_t HookCommit() {
+    std::lock_guard<std::mutex> lock(g_hookLock);
+
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+
+    // A rejected attach fails the whole transaction in Detours; drop the
+    // offending hook and retry with the rest
+    for (;;) {
+        size_t pending = 0;
+        HookEntry* rejected = nullptr;
+
+        DetourTransactionBegin();
+        DetourUpdateThread(GetCurrentThread());
+        for (size_t i = 0; i < g_hookCount && !rejected; i++) {
+            HookEntry& entry = g_hooks[i];
+            if (entry.state != HOOK_PENDING) continue;
+            entry.error = DetourAttach(entry.original, entry.detour);
+            if (entry.error != NO_ERROR) rejected = &entry;
+            pending++;
+        }
+
+        if (rejected) {
+            DetourTransactionAbort();
+            rejected->state = HOOK_FAILED;
+            LogError("DetourAttach failed for %s: %d", rejected->name, rejected->error);
+            continue;
+        }
+        if (!pending) {
+            DetourTransactionAbort();
+            return 0;
+        }
+
+        LONG error = DetourTransactionCommit();
+        HookState state = (error == NO_ERROR) ? HOOK_ATTACHED : HOOK_FAILED;
+        for (size_t i = 0; i < g_hookCount; i++) {
+            HookEntry& entry = g_hooks[i];
+            if (entry.state != HOOK_PENDING) continue;
+            entry.state = state;
+            entry.error = error;
+            LogDebug("Hook %s %s", entry.name, state == HOOK_ATTACHED ? "attached" : "failed");
+        }
+
+        if (error != NO_ERROR) {
+            LogError("Hook transaction failed: %d", error);
+            return 0;
+        }
+        LogInfo("Hook transaction: %u attached in %.3f ms", (unsigned)pending, MillisecondsSince(start));
+        return pending;
+    }
+}
+
+size_t HookDetachAll() {
+    std::lock_guard<std::mutex> lock(g_hookLock);
+
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+
+    size_t attached = 0;
+    DetourTransactionBegin();
+    DetourUpdateThread(GetCurrentThread());
+    for (size_t i = 0; i < g_hookCount; i++) {
+        HookEntry& entry = g_hooks[i];
+        if (entry.state != HOOK_ATTACHED) continue;
+        DetourDetach(entry.original, entry.detour);
+        attached++;
+    }
+
+    if (!attached) {
+        DetourTransactionAbort();
+        return 0;
+    }
+
+    LONG error = DetourTransactionCommit();
+    if (error != NO_ERROR) {
+        LogError("Unhook transaction failed: %d", error);
+        return 0;
+    }
+
+    for (size_t i = 0; i < g_hookCount; i++) {
+        if (g_hooks[i].state == HOOK_ATTACHED) g_hooks[i].state = HOOK_DETACHED;
+    }
+    LogInfo("Hook transaction: %u detached in %.3f ms", (unsigned)attached, MillisecondsSince(start));
+    return attached;
+}
+
+HookState HookGetState(const void* original) {
+    std::lock_guard<std::mutex> lock(g_hookLock);
+    HookEntry* entry = FindHook(original);
+    return entry ? entry->state : HOOK_DETACHED;
+}
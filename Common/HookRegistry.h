@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+
+// Central list of Detours hooks for a DLL.
+//
+// Hooks are queued with HookRequest() and installed together by HookCommit()
+// in a single Detours transaction, so the game's threads are only updated
+// once per batch. Each hook's state is tracked, a function that is already
+// hooked is never hooked a second time, and HookDetachAll() removes exactly
+// the hooks that were attached. Every transaction is timed and logged.
+
+enum HookState {
+    HOOK_PENDING,   // queued, waiting for HookCommit
+    HOOK_ATTACHED,
+    HOOK_FAILED,    // DetourAttach or the commit failed
+    HOOK_DETACHED,
+};
+
+// Queue a hook of target. *original is set to target now and to the Detours
+// trampoline once attached. Returns false if original is already in use (the
+// hook was requested before) or the registry is full.
+bool HookRequest(const char* name, void** original, void* target, void* detour);
+
+template <typename Fn>
+inline bool HookRequest(const char* name, Fn* original, Fn target, Fn detour) {
+    return HookRequest(name, reinterpret_cast<void**>(original), reinterpret_cast<void*>(target),
+        reinterpret_cast<void*>(detour));
+}
+
+// Attach every pending hook in one transaction. A hook that Detours rejects
+// is marked failed and the rest are committed without it. Returns the number
+// of hooks attached.
+size_t HookCommit();
+
+// Detach every attached hook in one transaction. Returns the number detached.
+size_t HookDetachAll();
+
+HookState HookGetState(const void* original);
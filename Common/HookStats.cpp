@@ -0,0 +1,274 @@
+#include "HookStats.h"
+#include <cstring>
+#include <mutex>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace HookStatsDetail {
+
+static HookStatsRegion g_privateRegion;
+std::atomic<HookStatsRegion*> g_region(&g_privateRegion);
+thread_local uint32_t t_shard = HOOK_STATS_NONE;
+
+static std::atomic<uint32_t> g_nextShard(0);
+
+uint32_t ClaimShard() {
+    uint32_t shard = g_nextShard.fetch_add(1, std::memory_order_relaxed);
+    if (shard >= HOOK_STATS_SHARDS) shard = HOOK_STATS_SHARDS - 1;
+    t_shard = shard;
+    return shard;
+}
+
+} // namespace HookStatsDetail
+
+using namespace HookStatsDetail;
+
+namespace {
+
+std::mutex g_registerLock;
+HookStatsRegion* g_sharedRegion = nullptr;
+void* g_sharedHandle = nullptr;
+
+constexpr auto CALIBRATION_TIME = std::chrono::milliseconds(5);
+
+uint64_t CalibrateTicksPerSecond() {
+#ifdef PEGGLE_X86
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    uint64_t startTicks = HookStatsNow();
+    Clock::time_point now;
+    do {
+        now = Clock::now();
+    } while (now - start < CALIBRATION_TIME);
+    uint64_t ticks = HookStatsNow() - startTicks;
+    double seconds = std::chrono::duration<double>(now - start).count();
+    return (uint64_t)(ticks / seconds);
+#else
+    return 1000000000;
+#endif
+}
+
+uint64_t CurrentProcessId() {
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return (uint64_t)getpid();
+#endif
+}
+
+void InitHeader(HookStatsHeader& header, uint32_t hookCount) {
+    header.version = HOOK_STATS_VERSION;
+    header.headerSize = sizeof(HookStatsHeader);
+    header.entrySize = sizeof(HookStatsEntry);
+    header.maxHooks = HOOK_STATS_MAX_HOOKS;
+    header.shards = HOOK_STATS_SHARDS;
+    header.buckets = HOOK_STATS_BUCKETS;
+    header.hookCount.store(hookCount, std::memory_order_relaxed);
+    header.ticksPerSecond = CalibrateTicksPerSecond();
+    header.processId = CurrentProcessId();
+}
+
+} // namespace
+
+std::string HookStatsRegionName(uint64_t processId) {
+#ifdef _WIN32
+    return "Local\\PeggleHookStats." + std::to_string(processId);
+#else
+    return "PeggleHookStats." + std::to_string(processId) + ".shm";
+#endif
+}
+
+bool HookStatsOpen(const char* name) {
+    std::lock_guard<std::mutex> lock(g_registerLock);
+    if (g_sharedRegion) return true;
+
+    std::string regionName = name ? name : HookStatsRegionName(CurrentProcessId());
+    void* memory = nullptr;
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0,
+        (DWORD)sizeof(HookStatsRegion), regionName.c_str());
+    if (!mapping) return false;
+    // Published by another hook DLL in this process: its entries and
+    // counters are not ours to overwrite
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(mapping);
+        return false;
+    }
+    memory = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(HookStatsRegion));
+    if (!memory) {
+        CloseHandle(mapping);
+        return false;
+    }
+    g_sharedHandle = mapping;
+#else
+    // The lock is held until HookStatsClose: a file someone else has locked
+    // is a region being published. One left by a process that ended is
+    // cleared and reused.
+    int fd = open(regionName.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return false;
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0 || ftruncate(fd, 0) != 0 ||
+        ftruncate(fd, sizeof(HookStatsRegion)) != 0) {
+        close(fd);
+        return false;
+    }
+    memory = mmap(nullptr, sizeof(HookStatsRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    g_sharedHandle = (void*)(intptr_t)fd;
+#endif
+
+    // Carry over hooks registered (and calls counted) before the region
+    // existed; a call racing with the switch may be lost
+    HookStatsRegion* region = (HookStatsRegion*)memory;
+    uint32_t hookCount = g_privateRegion.header.hookCount.load(std::memory_order_relaxed);
+    memcpy((void*)region->entries, (const void*)g_privateRegion.entries, sizeof(region->entries));
+    InitHeader(region->header, hookCount);
+    region->header.magic.store(HOOK_STATS_MAGIC, std::memory_order_release);
+
+    g_sharedRegion = region;
+    g_region.store(region, std::memory_order_release);
+    return true;
+}
+
+void HookStatsClose() {
+    std::lock_guard<std::mutex> lock(g_registerLock);
+    if (!g_sharedRegion) return;
+
+    // Hooks must be removed first; anything still counting goes to the
+    // private region from here on, which takes over the hooks and calls of
+    // the shared one so their ids stay valid
+    uint32_t hookCount = g_sharedRegion->header.hookCount.load(std::memory_order_relaxed);
+    memcpy((void*)g_privateRegion.entries, (const void*)g_sharedRegion->entries, sizeof(g_privateRegion.entries));
+    g_privateRegion.header.hookCount.store(hookCount, std::memory_order_relaxed);
+    g_region.store(&g_privateRegion, std::memory_order_release);
+
+#ifdef _WIN32
+    UnmapViewOfFile(g_sharedRegion);
+    CloseHandle((HANDLE)g_sharedHandle);
+#else
+    munmap(g_sharedRegion, sizeof(HookStatsRegion));
+    close((int)(intptr_t)g_sharedHandle);
+#endif
+    g_sharedRegion = nullptr;
+    g_sharedHandle = nullptr;
+}
+
+uint32_t HookStatsRegister(const char* name) {
+    std::lock_guard<std::mutex> lock(g_registerLock);
+    HookStatsRegion* region = g_region.load(std::memory_order_relaxed);
+
+    uint32_t count = region->header.hookCount.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < count; i++) {
+        if (strncmp(region->entries[i].name, name, HOOK_STATS_NAME_SIZE - 1) == 0) return i;
+    }
+    if (count == HOOK_STATS_MAX_HOOKS) return HOOK_STATS_NONE;
+
+    HookStatsEntry& entry = region->entries[count];
+    strncpy(entry.name, name, HOOK_STATS_NAME_SIZE - 1);
+    entry.name[HOOK_STATS_NAME_SIZE - 1] = '\0';
+    region->header.hookCount.store(count + 1, std::memory_order_release);
+    return count;
+}
+
+bool HookStatsMap(const char* name, HookStatsView& view) {
+    view = HookStatsView();
+
+#ifdef _WIN32
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+    if (!mapping) return false;
+    const void* memory = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(HookStatsRegion));
+    if (!memory) {
+        CloseHandle(mapping);
+        return false;
+    }
+    view.handle = mapping;
+#else
+    int fd = open(name, O_RDONLY);
+    if (fd < 0) return false;
+    const void* memory = mmap(nullptr, sizeof(HookStatsRegion), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) return false;
+#endif
+
+    view.data = (const uint8_t*)memory;
+    view.size = sizeof(HookStatsRegion);
+    return true;
+}
+
+void HookStatsUnmap(HookStatsView& view) {
+    if (!view.data) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(view.data);
+    CloseHandle((HANDLE)view.handle);
+#else
+    munmap((void*)view.data, view.size);
+#endif
+    view = HookStatsView();
+}
+
+bool HookStatsRead(const uint8_t* data, size_t size, std::vector<HookStatsSummary>& hooks,
+    uint64_t& ticksPerSecond) {
+    hooks.clear();
+    if (size < sizeof(HookStatsRegion)) return false;
+
+    const HookStatsRegion* region = (const HookStatsRegion*)data;
+    const HookStatsHeader& header = region->header;
+    if (header.magic.load(std::memory_order_acquire) != HOOK_STATS_MAGIC ||
+        header.version != HOOK_STATS_VERSION ||
+        header.headerSize != sizeof(HookStatsHeader) ||
+        header.entrySize != sizeof(HookStatsEntry) ||
+        header.maxHooks != HOOK_STATS_MAX_HOOKS ||
+        header.shards != HOOK_STATS_SHARDS ||
+        header.buckets != HOOK_STATS_BUCKETS) {
+        return false;
+    }
+
+    ticksPerSecond = header.ticksPerSecond;
+    uint32_t count = header.hookCount.load(std::memory_order_acquire);
+    if (count > HOOK_STATS_MAX_HOOKS) count = HOOK_STATS_MAX_HOOKS;
+
+    hooks.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        const HookStatsEntry& entry = region->entries[i];
+        HookStatsSummary& hook = hooks[i];
+        hook.name.assign(entry.name, strnlen(entry.name, HOOK_STATS_NAME_SIZE));
+
+        for (const HookStatsShard& shard : entry.shards) {
+            hook.calls += shard.calls.load(std::memory_order_relaxed);
+            hook.ticks += shard.ticks.load(std::memory_order_relaxed);
+            uint64_t max = shard.maxTicks.load(std::memory_order_relaxed);
+            if (max > hook.maxTicks) hook.maxTicks = max;
+            for (uint32_t b = 0; b < HOOK_STATS_BUCKETS; b++) {
+                hook.buckets[b] += shard.buckets[b].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    return true;
+}
+
+uint64_t HookStatsPercentile(const HookStatsSummary& hook, double fraction) {
+    uint64_t total = 0;
+    for (uint64_t count : hook.buckets) total += count;
+    if (!total) return 0;
+
+    uint64_t target = (uint64_t)(fraction * (double)total);
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < HOOK_STATS_BUCKETS; b++) {
+        seen += hook.buckets[b];
+        if (seen > target || seen == total) return b ? (uint64_t)1 << b : 0;
+    }
+    return hook.maxTicks;
+}
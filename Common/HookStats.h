@@ -0,0 +1,169 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "CpuFeatures.h"
+
+// Per-hook call counters and duration histograms, published in shared memory
+// so an external viewer (PeggleHookStats) can read them while the game runs.
+//
+// The region has a fixed, versioned layout: a header followed by one entry per
+// hook. Each entry is split into shards on separate cache lines; a thread
+// claims a shard of its own the first time it records, so the render thread
+// never contends with anyone and updates its counters with plain relaxed
+// stores. Threads beyond the last exclusive shard share the final one with
+// atomic adds. The reader sums the shards.
+//
+// Durations are in ticks of HookStatsNow() (the TSC on x86, calibrated against
+// the steady clock for a few milliseconds in HookStatsOpen) and are bucketed by
+// log2: bucket 0 holds zero-tick calls and bucket i holds [2^(i-1), 2^i) ticks.
+//
+// The region is named after the process that publishes it (see
+// HookStatsRegionName), so several games can run side by side. On Windows it
+// is a named file mapping; elsewhere it is a file mapped with mmap and locked
+// while published, which is also how the layout and the reader can be
+// exercised on Linux. Only one module per process publishes: a second hook DLL
+// finds the region taken and keeps its statistics private.
+
+constexpr uint32_t HOOK_STATS_MAGIC = 0x53484750;  // "PGHS"
+constexpr uint32_t HOOK_STATS_VERSION = 1;
+constexpr uint32_t HOOK_STATS_MAX_HOOKS = 32;
+constexpr uint32_t HOOK_STATS_SHARDS = 4;
+constexpr uint32_t HOOK_STATS_BUCKETS = 48;
+constexpr uint32_t HOOK_STATS_NAME_SIZE = 48;
+constexpr uint32_t HOOK_STATS_NONE = 0xFFFFFFFF;
+
+static_assert(sizeof(std::atomic<uint64_t>) == 8 && ATOMIC_LLONG_LOCK_FREE == 2,
+    "shared counters must be plain lock-free 64-bit words");
+
+struct alignas(64) HookStatsShard {
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> ticks;
+    std::atomic<uint64_t> maxTicks;
+    std::atomic<uint64_t> buckets[HOOK_STATS_BUCKETS];
+};
+
+struct alignas(64) HookStatsEntry {
+    char name[HOOK_STATS_NAME_SIZE];
+    HookStatsShard shards[HOOK_STATS_SHARDS];
+};
+
+struct alignas(64) HookStatsHeader {
+    std::atomic<uint32_t> magic;  // written last
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t entrySize;
+    uint32_t maxHooks;
+    uint32_t shards;
+    uint32_t buckets;
+    std::atomic<uint32_t> hookCount;  // entries below this have their name set
+    uint64_t ticksPerSecond;
+    uint64_t processId;
+};
+
+struct HookStatsRegion {
+    HookStatsHeader header;
+    HookStatsEntry entries[HOOK_STATS_MAX_HOOKS];
+};
+
+// Region of the process with this id: "Local\PeggleHookStats.<pid>" on
+// Windows, "PeggleHookStats.<pid>.shm" in the working directory elsewhere.
+std::string HookStatsRegionName(uint64_t processId);
+
+// Create the shared region, named after the current process unless a name is
+// given, and publish its header. Call before installing hooks; until then (or
+// if it fails) statistics go to a private region. Fails, leaving the region
+// alone, if another module already publishes one under that name.
+bool HookStatsOpen(const char* name = nullptr);
+void HookStatsClose();
+
+// Entry for a hook, by name; registering the same name again returns the same
+// entry. Returns HOOK_STATS_NONE when the region is full.
+uint32_t HookStatsRegister(const char* name);
+
+inline uint64_t HookStatsNow() {
+#if defined(PEGGLE_X86) && defined(_MSC_VER)
+    return __rdtsc();
+#elif defined(PEGGLE_X86)
+    return __builtin_ia32_rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+namespace HookStatsDetail {
+
+extern std::atomic<HookStatsRegion*> g_region;
+
+// Shard of the calling thread, claimed on first use
+uint32_t ClaimShard();
+extern thread_local uint32_t t_shard;
+
+inline uint32_t BucketOf(uint64_t ticks) {
+    if (!ticks) return 0;
+    uint32_t high = (uint32_t)(ticks >> 32);
+    uint32_t bucket = high ? 33 + HighestSetBit(high) : 1 + HighestSetBit((uint32_t)ticks);
+    return bucket < HOOK_STATS_BUCKETS ? bucket : HOOK_STATS_BUCKETS - 1;
+}
+
+inline void Add(std::atomic<uint64_t>& counter, uint64_t value, bool exclusive) {
+    if (exclusive) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+    else {
+        counter.fetch_add(value, std::memory_order_relaxed);
+    }
+}
+
+} // namespace HookStatsDetail
+
+// Count one call of the hook that took ticks.
+inline void HookStatsRecord(uint32_t hook, uint64_t ticks) {
+    using namespace HookStatsDetail;
+    if (hook >= HOOK_STATS_MAX_HOOKS) return;
+
+    uint32_t shard = t_shard;
+    if (shard == HOOK_STATS_NONE) shard = ClaimShard();
+    bool exclusive = shard < HOOK_STATS_SHARDS - 1;
+
+    HookStatsShard& s = g_region.load(std::memory_order_acquire)->entries[hook].shards[shard];
+    Add(s.calls, 1, exclusive);
+    Add(s.ticks, ticks, exclusive);
+    Add(s.buckets[BucketOf(ticks)], 1, exclusive);
+
+    uint64_t max = s.maxTicks.load(std::memory_order_relaxed);
+    while (ticks > max && !s.maxTicks.compare_exchange_weak(max, ticks, std::memory_order_relaxed)) {}
+}
+
+// Reader side
+
+struct HookStatsSummary {
+    std::string name;
+    uint64_t calls = 0;
+    uint64_t ticks = 0;
+    uint64_t maxTicks = 0;
+    uint64_t buckets[HOOK_STATS_BUCKETS] = {};
+};
+
+// Map a region published by HookStatsOpen read-only. data/size stay valid
+// until HookStatsUnmap.
+struct HookStatsView {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    void* handle = nullptr;
+};
+
+bool HookStatsMap(const char* name, HookStatsView& view);
+void HookStatsUnmap(HookStatsView& view);
+
+// Validate the layout and sum every hook's shards. Returns false if the data
+// is not a region of this version.
+bool HookStatsRead(const uint8_t* data, size_t size, std::vector<HookStatsSummary>& hooks,
+    uint64_t& ticksPerSecond);
+
+// Upper bound, in ticks, of the bucket holding the given fraction of calls.
+uint64_t HookStatsPercentile(const HookStatsSummary& hook, double fraction);
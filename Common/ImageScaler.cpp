@@ -0,0 +1,924 @@
+#include "ImageScaler.h"
+#include "CpuFeatures.h"
+#include "FrameChanges.h"
+#include "PixelConvert.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#ifdef PEGGLE_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr int WEIGHT_BITS = 7;
+constexpr int32_t ROUND = 1 << (2 * WEIGHT_BITS - 1);
+
+// Convolution filters: 14-bit weights, and 6 fractional bits in the
+// horizontally filtered rows (255 * 64 plus the overshoot of the negative
+// lobes stays well inside 16 bits). The vertical pass multiplies in 16 bits
+// with rounding, as pmulhrs does ((a * b + (1 << 14)) >> 15), which halves
+// the products and leaves one fractional bit fewer.
+constexpr int FILTER_BITS = 14;
+constexpr int INTERMEDIATE_BITS = 6;
+constexpr int HORIZONTAL_SHIFT = FILTER_BITS - INTERMEDIATE_BITS;
+constexpr int VERTICAL_SHIFT = INTERMEDIATE_BITS - 1;
+constexpr double PI = 3.14159265358979323846;
+constexpr uint32_t MAX_TAPS = 64;  // limits how far the kernels widen when shrinking
+constexpr size_t STRIP_VALUES = 2048;  // vertical pass; a multiple of every path's block
+
+// Bands per thread, and the fewest target rows in a band: a bilinear or
+// integer band repeats at most one source row of work, a convolution band
+// up to its number of taps
+constexpr uint32_t BANDS_PER_THREAD = 4;
+constexpr uint32_t MIN_BAND_ROWS = 8;
+constexpr uint32_t MIN_CONVOLUTION_BAND_ROWS = 32;
+
+std::atomic<int> g_forcedPath{ -1 };
+
+inline uint32_t PackWeights(uint32_t weight) {
+    return ((1u << WEIGHT_BITS) - weight) | (weight << 16);
+}
+
+// Pixel-centre aligned positions of the target pixels in the source, in
+// 16.16 fixed point, split into the left/top source pixel and its weights
+void ComputeTaps(uint32_t sourceSize, uint32_t targetSize, std::vector<uint32_t>& indices,
+    std::vector<uint32_t>& weights) {
+    indices.resize(targetSize);
+    weights.resize(targetSize);
+    int64_t last = (int64_t)(sourceSize - 1) << 16;
+
+    for (uint32_t i = 0; i < targetSize; i++) {
+        int64_t pos = (((int64_t)(2 * i + 1) * sourceSize) << 16) / (2 * (int64_t)targetSize) - 32768;
+        if (pos < 0) pos = 0;
+        if (pos > last) pos = last;
+        indices[i] = (uint32_t)(pos >> 16);
+        weights[i] = PackWeights((uint32_t)(pos >> (16 - WEIGHT_BITS)) & ((1u << WEIGHT_BITS) - 1));
+    }
+}
+
+// Vertical pass: channel * (128 - w) + channel * w, at most 255 * 128
+void BlendRowsScalar(const uint8_t* a, const uint8_t* b, size_t bytes, uint32_t weights, int16_t* out) {
+    int32_t w0 = (int32_t)(weights & 0xFFFF);
+    int32_t w1 = (int32_t)(weights >> 16);
+    for (size_t i = 0; i < bytes; i++) {
+        out[i] = (int16_t)(a[i] * w0 + b[i] * w1);
+    }
+}
+
+inline void BlendPixelScalar(const int16_t* row, uint32_t index, uint32_t weights, uint8_t* out) {
+    const int16_t* p = row + 4 * (size_t)index;
+    int32_t w0 = (int32_t)(weights & 0xFFFF);
+    int32_t w1 = (int32_t)(weights >> 16);
+    for (int c = 0; c < 4; c++) {
+        out[c] = (uint8_t)((p[c] * w0 + p[4 + c] * w1 + ROUND) >> (2 * WEIGHT_BITS));
+    }
+}
+
+// Horizontal pass over the blended row
+void BlendColumnsScalar(const int16_t* row, const uint32_t* indices, const uint32_t* weights,
+    uint32_t count, uint8_t* out) {
+    for (uint32_t x = 0; x < count; x++) {
+        BlendPixelScalar(row, indices[x], weights[x], out + 4 * (size_t)x);
+    }
+}
+
+double FilterRadius(ImageScaleFilter filter) {
+    return filter == IMAGE_FILTER_LANCZOS3 ? 3.0 : 2.0;
+}
+
+double Sinc(double x) {
+    if (x == 0.0) return 1.0;
+    x *= PI;
+    return sin(x) / x;
+}
+
+double FilterKernel(ImageScaleFilter filter, double x) {
+    x = fabs(x);
+    if (filter == IMAGE_FILTER_LANCZOS3) {
+        return x < 3.0 ? Sinc(x) * Sinc(x / 3.0) : 0.0;
+    }
+
+    // Catmull-Rom, the cubic with a = -0.5
+    if (x < 1.0) return (1.5 * x - 2.5) * x * x + 1.0;
+    if (x < 2.0) return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+    return 0.0;
+}
+
+inline int32_t LoadWeightPair(const int16_t* weights) {
+    int32_t pair;
+    memcpy(&pair, weights, sizeof(pair));
+    return pair;
+}
+
+// A source row widened to 16 bits as overlapping pairs of pixels: entry j
+// holds pixels j and j + 1 interleaved per channel (B B G G R R X X), so a
+// pair of taps is one load and one multiply-add. out points at entry 0;
+// entries from -pad to width + pad - 1 are written, repeating the edge pixels.
+inline void PairEntry(const uint8_t* row, uint32_t width, int64_t j, int16_t* out) {
+    const uint8_t* a = row + 4 * std::min(std::max(j, (int64_t)0), (int64_t)width - 1);
+    const uint8_t* b = row + 4 * std::min(std::max(j + 1, (int64_t)0), (int64_t)width - 1);
+    for (int c = 0; c < 4; c++) {
+        out[8 * j + 2 * c] = a[c];
+        out[8 * j + 2 * c + 1] = b[c];
+    }
+}
+
+void PairRowScalar(const uint8_t* row, uint32_t width, uint32_t pad, int16_t* out) {
+    for (int64_t j = -(int64_t)pad; j < (int64_t)width + pad; j++) PairEntry(row, width, j, out);
+}
+
+// Horizontal convolution of a paired source row into 16-bit values with
+// INTERMEDIATE_BITS fractional bits
+void ConvolveRowScalar(const int16_t* pairs, const int32_t* starts, const int16_t* weights, uint32_t taps,
+    uint32_t count, int16_t* out) {
+    for (uint32_t x = 0; x < count; x++) {
+        const int16_t* p = pairs + 8 * (ptrdiff_t)starts[x];
+        const int16_t* w = weights + (size_t)x * taps;
+        for (int c = 0; c < 4; c++) {
+            int32_t sum = 1 << (HORIZONTAL_SHIFT - 1);
+            for (uint32_t k = 0; k < taps; k += 2) {
+                sum += p[8 * k + 2 * c] * w[k] + p[8 * k + 2 * c + 1] * w[k + 1];
+            }
+            out[4 * (size_t)x + c] = (int16_t)(sum >> HORIZONTAL_SHIFT);
+        }
+    }
+}
+
+inline int32_t MulHrs(int32_t a, int32_t b) {
+    return (a * b + (1 << 14)) >> 15;
+}
+
+// Vertical convolution of the filtered rows into a target row. The sums stay
+// within 16 bits, so the vector paths accumulate in 16-bit lanes.
+void ConvolveColumnsScalar(const int16_t* const* rows, const int16_t* weights, uint32_t taps, size_t count,
+    uint8_t* out) {
+    for (size_t i = 0; i < count; i++) {
+        int32_t sum = 1 << (VERTICAL_SHIFT - 1);
+        for (uint32_t k = 0; k < taps; k++) sum += MulHrs(rows[k][i], weights[k]);
+        sum >>= VERTICAL_SHIFT;
+        out[i] = (uint8_t)(sum < 0 ? 0 : sum > 255 ? 255 : sum);
+    }
+}
+
+#ifdef PEGGLE_X86
+PEGGLE_TARGET_SSE2
+void BlendRowsSse2(const uint8_t* a, const uint8_t* b, size_t bytes, uint32_t weights, int16_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i w0 = _mm_set1_epi16((short)(weights & 0xFFFF));
+    const __m128i w1 = _mm_set1_epi16((short)(weights >> 16));
+
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), w0),
+            _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), w1));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), w0),
+            _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), w1));
+        _mm_storeu_si128((__m128i*)(out + i), lo);
+        _mm_storeu_si128((__m128i*)(out + i + 8), hi);
+    }
+    BlendRowsScalar(a + i, b + i, bytes - i, weights, out + i);
+}
+
+// Both source pixels of a target pixel are adjacent in the row buffer: one
+// load, interleave them per channel and multiply-add with the weight pair
+PEGGLE_TARGET_SSE2
+inline __m128i BlendPixelSse2(const int16_t* row, uint32_t index, uint32_t weights) {
+    __m128i q = _mm_loadu_si128((const __m128i*)(row + 4 * (size_t)index));
+    q = _mm_unpacklo_epi16(q, _mm_srli_si128(q, 8));
+    __m128i sum = _mm_madd_epi16(q, _mm_set1_epi32((int)weights));
+    return _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(ROUND)), 2 * WEIGHT_BITS);
+}
+
+PEGGLE_TARGET_SSE2
+void BlendColumnsSse2(const int16_t* row, const uint32_t* indices, const uint32_t* weights,
+    uint32_t count, uint8_t* out) {
+    uint32_t x = 0;
+    for (; x + 2 <= count; x += 2) {
+        __m128i a = BlendPixelSse2(row, indices[x], weights[x]);
+        __m128i b = BlendPixelSse2(row, indices[x + 1], weights[x + 1]);
+        __m128i packed = _mm_packs_epi32(a, b);
+        _mm_storel_epi64((__m128i*)(out + 4 * (size_t)x), _mm_packus_epi16(packed, packed));
+    }
+    BlendColumnsScalar(row, indices + x, weights + x, count - x, out + 4 * (size_t)x);
+}
+
+// Two entries per load of four pixels; the edges are left to the scalar path
+PEGGLE_TARGET_SSE2
+void PairRowSse2(const uint8_t* row, uint32_t width, uint32_t pad, int16_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    for (int64_t j = -(int64_t)pad; j < 0; j++) PairEntry(row, width, j, out);
+
+    uint32_t j = 0;
+    for (; j + 4 <= width; j += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(row + 4 * (size_t)j));
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        _mm_storeu_si128((__m128i*)(out + 8 * (size_t)j), _mm_unpacklo_epi16(lo, _mm_srli_si128(lo, 8)));
+        _mm_storeu_si128((__m128i*)(out + 8 * (size_t)j + 8), _mm_unpacklo_epi16(_mm_srli_si128(lo, 8), hi));
+    }
+
+    for (int64_t e = j; e < (int64_t)width + pad; e++) PairEntry(row, width, e, out);
+}
+
+PEGGLE_TARGET_SSE2
+inline __m128i ConvolvePixelSse2(const int16_t* p, const int16_t* w, uint32_t taps) {
+    __m128i sum = _mm_set1_epi32(1 << (HORIZONTAL_SHIFT - 1));
+    for (uint32_t k = 0; k < taps; k += 2) {
+        __m128i q = _mm_loadu_si128((const __m128i*)(p + 8 * k));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(q, _mm_set1_epi32(LoadWeightPair(w + k))));
+    }
+    return _mm_srai_epi32(sum, HORIZONTAL_SHIFT);
+}
+
+PEGGLE_TARGET_SSE2
+void ConvolveRowSse2(const int16_t* pairs, const int32_t* starts, const int16_t* weights, uint32_t taps,
+    uint32_t count, int16_t* out) {
+    uint32_t x = 0;
+    for (; x + 2 <= count; x += 2) {
+        __m128i a = ConvolvePixelSse2(pairs + 8 * (ptrdiff_t)starts[x], weights + (size_t)x * taps, taps);
+        __m128i b = ConvolvePixelSse2(pairs + 8 * (ptrdiff_t)starts[x + 1], weights + (size_t)(x + 1) * taps, taps);
+        _mm_storeu_si128((__m128i*)(out + 4 * (size_t)x), _mm_packs_epi32(a, b));
+    }
+    ConvolveRowScalar(pairs, starts + x, weights + (size_t)x * taps, taps, count - x, out + 4 * (size_t)x);
+}
+
+// pmulhrs is SSSE3; the same result from the high and low halves of the product
+PEGGLE_TARGET_SSE2
+inline __m128i MulHrsSse2(__m128i a, __m128i b) {
+    __m128i hi = _mm_slli_epi16(_mm_mulhi_epi16(a, b), 1);
+    __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(a, b), 14);
+    return _mm_add_epi16(hi, _mm_avg_epu16(lo, _mm_setzero_si128()));
+}
+
+PEGGLE_TARGET_SSE2
+void ConvolveColumnsSse2(const int16_t* const* rows, const int16_t* weights, uint32_t taps, size_t count,
+    uint8_t* out) {
+    const __m128i round = _mm_set1_epi16(1 << (VERTICAL_SHIFT - 1));
+    __m128i w[MAX_TAPS];
+    for (uint32_t k = 0; k < taps; k++) w[k] = _mm_set1_epi16(weights[k]);
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i lo = round;
+        __m128i hi = round;
+        for (uint32_t k = 0; k < taps; k++) {
+            lo = _mm_add_epi16(lo, MulHrsSse2(_mm_loadu_si128((const __m128i*)(rows[k] + i)), w[k]));
+            hi = _mm_add_epi16(hi, MulHrsSse2(_mm_loadu_si128((const __m128i*)(rows[k] + i + 8)), w[k]));
+        }
+        lo = _mm_srai_epi16(lo, VERTICAL_SHIFT);
+        hi = _mm_srai_epi16(hi, VERTICAL_SHIFT);
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(lo, hi));
+    }
+
+    const int16_t* tail[MAX_TAPS];
+    for (uint32_t k = 0; k < taps; k++) tail[k] = rows[k] + i;
+    ConvolveColumnsScalar(tail, weights, taps, count - i, out + i);
+}
+
+PEGGLE_TARGET_AVX2
+void BlendRowsAvx2(const uint8_t* a, const uint8_t* b, size_t bytes, uint32_t weights, int16_t* out) {
+    const __m256i w0 = _mm256_set1_epi16((short)(weights & 0xFFFF));
+    const __m256i w1 = _mm256_set1_epi16((short)(weights >> 16));
+
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(a + i)));
+        __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(b + i)));
+        __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(va, w0), _mm256_mullo_epi16(vb, w1));
+        _mm256_storeu_si256((__m256i*)(out + i), sum);
+    }
+    BlendRowsScalar(a + i, b + i, bytes - i, weights, out + i);
+}
+
+// Two target pixels, one per 128-bit lane
+PEGGLE_TARGET_AVX2
+inline __m256i BlendPixelsAvx2(const int16_t* row, uint32_t index0, uint32_t weights0,
+    uint32_t index1, uint32_t weights1) {
+    __m256i q = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(row + 4 * (size_t)index0))),
+        _mm_loadu_si128((const __m128i*)(row + 4 * (size_t)index1)), 1);
+    q = _mm256_unpacklo_epi16(q, _mm256_srli_si256(q, 8));
+    __m256i w = _mm256_setr_epi32((int)weights0, (int)weights0, (int)weights0, (int)weights0,
+        (int)weights1, (int)weights1, (int)weights1, (int)weights1);
+    __m256i sum = _mm256_madd_epi16(q, w);
+    return _mm256_srai_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(ROUND)), 2 * WEIGHT_BITS);
+}
+
+PEGGLE_TARGET_AVX2
+void BlendColumnsAvx2(const int16_t* row, const uint32_t* indices, const uint32_t* weights,
+    uint32_t count, uint8_t* out) {
+    uint32_t x = 0;
+    for (; x + 4 <= count; x += 4) {
+        // Lanes hold pixels 0|2 and 1|3 so packing leaves them in order
+        __m256i a = BlendPixelsAvx2(row, indices[x], weights[x], indices[x + 2], weights[x + 2]);
+        __m256i b = BlendPixelsAvx2(row, indices[x + 1], weights[x + 1], indices[x + 3], weights[x + 3]);
+        __m256i packed = _mm256_packs_epi32(a, b);
+        packed = _mm256_packus_epi16(packed, packed);
+        packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128((__m128i*)(out + 4 * (size_t)x), _mm256_castsi256_si128(packed));
+    }
+    BlendColumnsScalar(row, indices + x, weights + x, count - x, out + 4 * (size_t)x);
+}
+#endif
+
+// Integer scaling: each pixel repeated factor times. The vector paths store
+// whole vectors and let the next pixel overwrite the excess, so out needs
+// room for 7 pixels past the end.
+void ExpandRowScalar(const uint32_t* row, uint32_t count, uint32_t factor, uint32_t* out) {
+    for (uint32_t x = 0; x < count; x++) {
+        for (uint32_t i = 0; i < factor; i++) *out++ = row[x];
+    }
+}
+
+#ifdef PEGGLE_X86
+PEGGLE_TARGET_SSE2
+void ExpandRowSse2(const uint32_t* row, uint32_t count, uint32_t factor, uint32_t* out) {
+    uint32_t x = 0;
+    if (factor == 2) {
+        for (; x + 4 <= count; x += 4, out += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(row + x));
+            _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi32(v, v));
+            _mm_storeu_si128((__m128i*)(out + 4), _mm_unpackhi_epi32(v, v));
+        }
+    }
+    for (; x < count; x++, out += factor) {
+        __m128i v = _mm_set1_epi32((int)row[x]);
+        for (uint32_t i = 0; i < factor; i += 4) _mm_storeu_si128((__m128i*)(out + i), v);
+    }
+}
+
+PEGGLE_TARGET_AVX2
+void ExpandRowAvx2(const uint32_t* row, uint32_t count, uint32_t factor, uint32_t* out) {
+    uint32_t x = 0;
+    if (factor == 2) {
+        // Widen each pixel to 64 bits and copy it into the upper half
+        for (; x + 4 <= count; x += 4, out += 8) {
+            __m256i v = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*)(row + x)));
+            _mm256_storeu_si256((__m256i*)out, _mm256_or_si256(v, _mm256_slli_epi64(v, 32)));
+        }
+    }
+    for (; x < count; x++, out += factor) {
+        __m256i v = _mm256_set1_epi32((int)row[x]);
+        for (uint32_t i = 0; i < factor; i += 8) _mm256_storeu_si256((__m256i*)(out + i), v);
+    }
+}
+
+// Two target pixels, one per 128-bit lane
+PEGGLE_TARGET_AVX2
+inline __m256i ConvolvePixelsAvx2(const int16_t* p0, const int16_t* w0, const int16_t* p1, const int16_t* w1,
+    uint32_t taps) {
+    __m256i sum = _mm256_set1_epi32(1 << (HORIZONTAL_SHIFT - 1));
+    for (uint32_t k = 0; k < taps; k += 2) {
+        __m256i q = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(p0 + 8 * k))),
+            _mm_loadu_si128((const __m128i*)(p1 + 8 * k)), 1);
+        int32_t a = LoadWeightPair(w0 + k);
+        int32_t b = LoadWeightPair(w1 + k);
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(q, _mm256_setr_epi32(a, a, a, a, b, b, b, b)));
+    }
+    return _mm256_srai_epi32(sum, HORIZONTAL_SHIFT);
+}
+
+PEGGLE_TARGET_AVX2
+void ConvolveRowAvx2(const int16_t* pairs, const int32_t* starts, const int16_t* weights, uint32_t taps,
+    uint32_t count, int16_t* out) {
+    uint32_t x = 0;
+    for (; x + 4 <= count; x += 4) {
+        // Lanes hold pixels 0|2 and 1|3 so packing leaves them in order
+        const int16_t* w = weights + (size_t)x * taps;
+        __m256i a = ConvolvePixelsAvx2(pairs + 8 * (ptrdiff_t)starts[x], w,
+            pairs + 8 * (ptrdiff_t)starts[x + 2], w + 2 * taps, taps);
+        __m256i b = ConvolvePixelsAvx2(pairs + 8 * (ptrdiff_t)starts[x + 1], w + taps,
+            pairs + 8 * (ptrdiff_t)starts[x + 3], w + 3 * taps, taps);
+        _mm256_storeu_si256((__m256i*)(out + 4 * (size_t)x), _mm256_packs_epi32(a, b));
+    }
+    ConvolveRowScalar(pairs, starts + x, weights + (size_t)x * taps, taps, count - x, out + 4 * (size_t)x);
+}
+
+PEGGLE_TARGET_AVX2
+void ConvolveColumnsAvx2(const int16_t* const* rows, const int16_t* weights, uint32_t taps, size_t count,
+    uint8_t* out) {
+    const __m256i round = _mm256_set1_epi16(1 << (VERTICAL_SHIFT - 1));
+    __m256i w[MAX_TAPS];
+    for (uint32_t k = 0; k < taps; k++) w[k] = _mm256_set1_epi16(weights[k]);
+
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i lo = round;
+        __m256i hi = round;
+        for (uint32_t k = 0; k < taps; k++) {
+            lo = _mm256_add_epi16(lo, _mm256_mulhrs_epi16(_mm256_loadu_si256((const __m256i*)(rows[k] + i)), w[k]));
+            hi = _mm256_add_epi16(hi,
+                _mm256_mulhrs_epi16(_mm256_loadu_si256((const __m256i*)(rows[k] + i + 16)), w[k]));
+        }
+        // packus works within lanes: 64-bit blocks come out as lo0 hi0 lo1 hi1
+        __m256i packed = _mm256_packus_epi16(_mm256_srai_epi16(lo, VERTICAL_SHIFT),
+            _mm256_srai_epi16(hi, VERTICAL_SHIFT));
+        packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i*)(out + i), packed);
+    }
+
+    const int16_t* tail[MAX_TAPS];
+    for (uint32_t k = 0; k < taps; k++) tail[k] = rows[k] + i;
+    ConvolveColumnsScalar(tail, weights, taps, count - i, out + i);
+}
+#endif
+
+void BlendRows(ImageScalePath path, const uint8_t* a, const uint8_t* b, size_t bytes, uint32_t weights,
+    int16_t* out) {
+    switch (path) {
+#ifdef PEGGLE_X86
+    case IMAGE_SCALE_AVX2:
+        return BlendRowsAvx2(a, b, bytes, weights, out);
+    case IMAGE_SCALE_SSE2:
+        return BlendRowsSse2(a, b, bytes, weights, out);
+#endif
+    default:
+        return BlendRowsScalar(a, b, bytes, weights, out);
+    }
+}
+
+void BlendColumns(ImageScalePath path, const int16_t* row, const uint32_t* indices, const uint32_t* weights,
+    uint32_t count, uint8_t* out) {
+    switch (path) {
+#ifdef PEGGLE_X86
+    case IMAGE_SCALE_AVX2:
+        return BlendColumnsAvx2(row, indices, weights, count, out);
+    case IMAGE_SCALE_SSE2:
+        return BlendColumnsSse2(row, indices, weights, count, out);
+#endif
+    default:
+        return BlendColumnsScalar(row, indices, weights, count, out);
+    }
+}
+
+void ExpandRow(ImageScalePath path, const uint32_t* row, uint32_t count, uint32_t factor, uint32_t* out) {
+    switch (path) {
+#ifdef PEGGLE_X86
+    case IMAGE_SCALE_AVX2:
+        return ExpandRowAvx2(row, count, factor, out);
+    case IMAGE_SCALE_SSE2:
+        return ExpandRowSse2(row, count, factor, out);
+#endif
+    default:
+        return ExpandRowScalar(row, count, factor, out);
+    }
+}
+
+void PairRow(ImageScalePath path, const uint8_t* row, uint32_t width, uint32_t pad, int16_t* out) {
+    switch (path) {
+#ifdef PEGGLE_X86
+    case IMAGE_SCALE_AVX2:
+    case IMAGE_SCALE_SSE2:
+        return PairRowSse2(row, width, pad, out);
+#endif
+    default:
+        return PairRowScalar(row, width, pad, out);
+    }
+}
+
+void ConvolveRow(ImageScalePath path, const int16_t* pairs, const int32_t* starts, const int16_t* weights,
+    uint32_t taps, uint32_t count, int16_t* out) {
+    switch (path) {
+#ifdef PEGGLE_X86
+    case IMAGE_SCALE_AVX2:
+        return ConvolveRowAvx2(pairs, starts, weights, taps, count, out);
+    case IMAGE_SCALE_SSE2:
+        return ConvolveRowSse2(pairs, starts, weights, taps, count, out);
+#endif
+    default:
+        return ConvolveRowScalar(pairs, starts, weights, taps, count, out);
+    }
+}
+
+void ConvolveColumns(ImageScalePath path, const int16_t* const* rows, const int16_t* weights, uint32_t taps,
+    size_t count, uint8_t* out) {
+    switch (path) {
+#ifdef PEGGLE_X86
+    case IMAGE_SCALE_AVX2:
+        return ConvolveColumnsAvx2(rows, weights, taps, count, out);
+    case IMAGE_SCALE_SSE2:
+        return ConvolveColumnsSse2(rows, weights, taps, count, out);
+#endif
+    default:
+        return ConvolveColumnsScalar(rows, weights, taps, count, out);
+    }
+}
+
+void ClearRows(const ImageView& target, uint32_t first, uint32_t end, uint32_t left, uint32_t right) {
+    for (uint32_t y = first; y < end; y++) {
+        memset(target.pixels + (ptrdiff_t)y * target.pitch + 4 * (size_t)left, 0, 4 * (size_t)(right - left));
+    }
+}
+
+} // namespace
+
+uint32_t IntegerScaleFactor(uint32_t sourceWidth, uint32_t sourceHeight, uint32_t targetWidth,
+    uint32_t targetHeight) {
+    if (!sourceWidth || !sourceHeight) return 0;
+    uint32_t horizontal = targetWidth / sourceWidth;
+    uint32_t vertical = targetHeight / sourceHeight;
+    return horizontal < vertical ? horizontal : vertical;
+}
+
+void ImageScaler::PrepareFilter(FilterTable& table, ImageScaleFilter filter, uint32_t sourceSize,
+    uint32_t targetSize) {
+    table.filter = filter;
+    table.sourceSize = sourceSize;
+    table.targetSize = targetSize;
+
+    double scale = (double)sourceSize / (double)targetSize;
+    double radius = FilterRadius(filter);
+    double stretch = std::min(std::max(scale, 1.0), MAX_TAPS / (2.0 * radius));
+    double support = radius * stretch;
+
+    uint32_t taps = (uint32_t)ceil(2.0 * support);
+    taps += taps & 1;
+    table.taps = taps;
+    table.starts.resize(targetSize);
+    table.weights.resize((size_t)targetSize * taps);
+
+    double kernel[MAX_TAPS];
+    for (uint32_t i = 0; i < targetSize; i++) {
+        double center = (i + 0.5) * scale - 0.5;
+        int32_t start = (int32_t)floor(center - support) + 1;
+
+        double sum = 0.0;
+        for (uint32_t k = 0; k < taps; k++) {
+            kernel[k] = FilterKernel(filter, (start + (int32_t)k - center) / stretch);
+            sum += kernel[k];
+        }
+
+        // Rounded to fixed point, with the rounding error given to the
+        // largest weight so they sum exactly to one
+        int16_t* weights = &table.weights[(size_t)i * taps];
+        int32_t total = 0;
+        uint32_t largest = 0;
+        for (uint32_t k = 0; k < taps; k++) {
+            weights[k] = (int16_t)lround(kernel[k] / sum * (1 << FILTER_BITS));
+            total += weights[k];
+            if (abs(weights[k]) > abs(weights[largest])) largest = k;
+        }
+        weights[largest] = (int16_t)(weights[largest] + (1 << FILTER_BITS) - total);
+        table.starts[i] = start;
+    }
+}
+
+void ImageScaler::Prepare(uint32_t sourceWidth, uint32_t sourceHeight, uint32_t targetWidth, uint32_t targetHeight) {
+    m_sourceWidth = sourceWidth;
+    m_sourceHeight = sourceHeight;
+    m_targetWidth = targetWidth;
+    m_targetHeight = targetHeight;
+
+    ComputeTaps(sourceWidth, targetWidth, m_columnIndices, m_columnWeights);
+    ComputeTaps(sourceHeight, targetHeight, m_rowIndices, m_rowWeights);
+}
+
+bool ImageScaler::SourceRange(ImageScaleFilter filter, bool columns, uint32_t first, uint32_t last,
+    uint32_t& low, uint32_t& high) const {
+    switch (filter) {
+    case IMAGE_FILTER_INTEGER: {
+        // The bars read nothing
+        uint32_t offset = columns ? m_integerLeft : m_integerTop;
+        uint32_t size = (columns ? m_sourceWidth : m_sourceHeight) * m_integerFactor;
+        first = std::max(first, offset);
+        last = std::min(last, offset + size - 1);
+        if (first > last) return false;
+        low = (first - offset) / m_integerFactor;
+        high = (last - offset) / m_integerFactor;
+        return true;
+    }
+
+    case IMAGE_FILTER_BICUBIC:
+    case IMAGE_FILTER_LANCZOS3: {
+        const FilterTable& table = columns ? m_columnFilter : m_rowFilter;
+        int32_t limit = (int32_t)table.sourceSize - 1;
+        low = (uint32_t)std::min(std::max(table.starts[first], 0), limit);
+        high = (uint32_t)std::min(std::max(table.starts[last] + (int32_t)table.taps - 1, 0), limit);
+        return true;
+    }
+
+    default: {
+        const std::vector<uint32_t>& indices = columns ? m_columnIndices : m_rowIndices;
+        low = indices[first];
+        high = std::min(indices[last] + 1, (columns ? m_sourceWidth : m_sourceHeight) - 1);
+        return true;
+    }
+    }
+}
+
+template <typename Region>
+void ImageScaler::ScaleRegions(const ImageView& target, ImageScaleFilter filter, const FrameChanges* changes,
+    uint32_t minBandRows, Region& region) {
+    unsigned threads = m_pool ? m_pool->Threads() + 1 : 1;
+    if (m_scratch.size() < threads) m_scratch.resize(threads);
+
+    // Bands of about one row of tiles when only changes are scaled, else a
+    // few per thread
+    uint32_t perBand;
+    if (changes) {
+        uint32_t sourceHeight = changes->Height();
+        perBand = (FrameChanges::TILE_SIZE * target.height + sourceHeight - 1) / sourceHeight;
+    }
+    else {
+        perBand = (target.height + threads * BANDS_PER_THREAD - 1) / (threads * BANDS_PER_THREAD);
+    }
+    perBand = std::max(perBand, minBandRows);
+
+    auto band = [&](uint32_t index, unsigned worker) {
+        uint32_t first = index * perBand;
+        uint32_t end = std::min(first + perBand, target.height);
+        Scratch& scratch = m_scratch[worker];
+        if (!changes) {
+            region(first, end, 0, target.width, scratch);
+            return;
+        }
+
+        // Tile columns changed in any tile row this band reads
+        uint32_t low, high;
+        if (!SourceRange(filter, false, first, end - 1, low, high)) return;
+        scratch.changedColumns.assign(changes->Columns(), 0);
+        for (uint32_t row = low / FrameChanges::TILE_SIZE; row <= high / FrameChanges::TILE_SIZE; row++) {
+            for (uint32_t column = 0; column < changes->Columns(); column++) {
+                if (changes->Changed(column, row)) scratch.changedColumns[column] = 1;
+            }
+        }
+
+        // Runs of target columns that read one of them
+        auto changed = [&](uint32_t x) {
+            uint32_t left, right;
+            if (!SourceRange(filter, true, x, x, left, right)) return false;
+            for (uint32_t column = left / FrameChanges::TILE_SIZE; column <= right / FrameChanges::TILE_SIZE;
+                column++) {
+                if (scratch.changedColumns[column]) return true;
+            }
+            return false;
+        };
+        for (uint32_t x = 0; x < target.width;) {
+            while (x < target.width && !changed(x)) x++;
+            uint32_t start = x;
+            while (x < target.width && changed(x)) x++;
+            if (start < x) region(first, end, start, x, scratch);
+        }
+    };
+
+    uint32_t bands = (target.height + perBand - 1) / perBand;
+    if (threads == 1 || bands == 1) {
+        for (uint32_t i = 0; i < bands; i++) band(i, 0);
+    }
+    else {
+        m_pool->Run(bands, band);
+    }
+}
+
+bool ImageScaler::Scale(const ImageView& source, const ImageView& target, ImageScaleFilter filter,
+    const FrameChanges* changes) {
+    if (!source.pixels || !source.width || !source.height) return false;
+    if (!target.pixels || !target.width || !target.height) return false;
+    if (source.format == IMAGE_FORMAT_PALETTE8 && !source.palette) return false;
+    if (filter == IMAGE_FILTER_INTEGER &&
+        !IntegerScaleFactor(source.width, source.height, target.width, target.height)) {
+        return false;
+    }
+
+    // Changes only help when they describe this source and leave something
+    // unchanged
+    if (changes && (changes->Width() != source.width || changes->Height() != source.height ||
+        changes->AllChanged())) {
+        changes = nullptr;
+    }
+    if (changes && !changes->ChangedCount()) return true;
+
+    // Tables are shared by the bands, so they are built up front
+    switch (filter) {
+    case IMAGE_FILTER_INTEGER: {
+        uint32_t factor = IntegerScaleFactor(source.width, source.height, target.width, target.height);
+        m_sourceWidth = source.width;
+        m_sourceHeight = source.height;
+        m_integerFactor = factor;
+        m_integerLeft = (target.width - source.width * factor) / 2;
+        m_integerTop = (target.height - source.height * factor) / 2;
+
+        auto region = [&](uint32_t first, uint32_t end, uint32_t left, uint32_t right, Scratch& scratch) {
+            ScaleInteger(source, target, first, end, left, right, scratch);
+        };
+        ScaleRegions(target, filter, changes, MIN_BAND_ROWS, region);
+
+        // The bilinear tables are for other sizes now
+        m_targetWidth = 0;
+        return true;
+    }
+
+    case IMAGE_FILTER_BICUBIC:
+    case IMAGE_FILTER_LANCZOS3: {
+        FilterTable& columns = m_columnFilter;
+        FilterTable& rows = m_rowFilter;
+        if (columns.filter != filter || columns.sourceSize != source.width || columns.targetSize != target.width) {
+            PrepareFilter(columns, filter, source.width, target.width);
+        }
+        if (rows.filter != filter || rows.sourceSize != source.height || rows.targetSize != target.height) {
+            PrepareFilter(rows, filter, source.height, target.height);
+        }
+
+        auto region = [&](uint32_t first, uint32_t end, uint32_t left, uint32_t right, Scratch& scratch) {
+            ScaleConvolve(source, target, first, end, left, right, scratch);
+        };
+        ScaleRegions(target, filter, changes, MIN_CONVOLUTION_BAND_ROWS, region);
+        return true;
+    }
+
+    default: {
+        if (source.width != m_sourceWidth || source.height != m_sourceHeight ||
+            target.width != m_targetWidth || target.height != m_targetHeight) {
+            Prepare(source.width, source.height, target.width, target.height);
+        }
+
+        auto region = [&](uint32_t first, uint32_t end, uint32_t left, uint32_t right, Scratch& scratch) {
+            ScaleBilinear(source, target, first, end, left, right, scratch);
+        };
+        ScaleRegions(target, filter, changes, MIN_BAND_ROWS, region);
+        return true;
+    }
+    }
+}
+
+const uint8_t* ImageScaler::SourceRow(const ImageView& source, uint32_t y, uint32_t left, uint32_t right,
+    Scratch& scratch) {
+    const uint8_t* row = source.pixels + (ptrdiff_t)y * source.pitch;
+    if (source.format == IMAGE_FORMAT_BGRX8888) return row;
+
+    // The callers ask for the same columns until they start another region,
+    // which forgets the slots
+    unsigned slot;
+    if (scratch.convertedRows[0] == (int32_t)y) {
+        slot = 0;
+    }
+    else if (scratch.convertedRows[1] == (int32_t)y) {
+        slot = 1;
+    }
+    else {
+        slot = scratch.convertedLast ^ 1;
+        std::vector<uint32_t>& converted = scratch.converted[slot];
+        if (converted.size() < source.width) converted.resize(source.width);
+        ConvertPixels(ImageScaleDefaultPath(), source.format, row + (size_t)left * ImageFormatBytes(source.format),
+            source.palette, right - left + 1, converted.data() + left);
+        scratch.convertedRows[slot] = (int32_t)y;
+    }
+    scratch.convertedLast = slot;
+    return (const uint8_t*)scratch.converted[slot].data();
+}
+
+void ImageScaler::ScaleBilinear(const ImageView& source, const ImageView& target, uint32_t first, uint32_t end,
+    uint32_t left, uint32_t right, Scratch& scratch) {
+    ImageScalePath path = ImageScaleDefaultPath();
+    size_t rowBytes = 4 * (size_t)source.width;
+    scratch.rowBuffer.resize(rowBytes + 4);
+    int16_t* row = scratch.rowBuffer.data();
+
+    // Only the source columns these target columns read are blended
+    uint32_t low = m_columnIndices[left];
+    uint32_t high = std::min(m_columnIndices[right - 1] + 1, source.width - 1);
+    size_t offset = 4 * (size_t)low;
+    size_t bytes = 4 * (size_t)(high - low + 1);
+    scratch.convertedRows[0] = scratch.convertedRows[1] = -1;
+
+    for (uint32_t y = first; y < end; y++) {
+        uint32_t index = m_rowIndices[y];
+        uint32_t weights = m_rowWeights[y];
+
+        // Consecutive target rows often sample the same source rows when
+        // shrinking; the blended row is still in the buffer
+        if (y == first || index != m_rowIndices[y - 1] || weights != m_rowWeights[y - 1]) {
+            const uint8_t* a = SourceRow(source, index, low, high, scratch);
+            const uint8_t* b = index + 1 < source.height ? SourceRow(source, index + 1, low, high, scratch) : a;
+            BlendRows(path, a + offset, b + offset, bytes, weights, row + offset);
+
+            // The last column blends with a copy of itself
+            if (high == source.width - 1) {
+                for (int c = 0; c < 4; c++) row[rowBytes + c] = row[rowBytes - 4 + c];
+            }
+        }
+
+        BlendColumns(path, row, m_columnIndices.data() + left, m_columnWeights.data() + left, right - left,
+            target.pixels + (ptrdiff_t)y * target.pitch + 4 * (size_t)left);
+    }
+}
+
+void ImageScaler::ScaleInteger(const ImageView& source, const ImageView& target, uint32_t first, uint32_t end,
+    uint32_t left, uint32_t right, Scratch& scratch) {
+    uint32_t factor = m_integerFactor;
+    uint32_t width = source.width * factor;
+    uint32_t height = source.height * factor;
+
+    // Bars above and below the image
+    uint32_t imageFirst = std::min(std::max(first, m_integerTop), end);
+    uint32_t imageEnd = std::max(std::min(end, m_integerTop + height), imageFirst);
+    ClearRows(target, first, imageFirst, left, right);
+    ClearRows(target, imageEnd, end, left, right);
+
+    // Columns left and right of the image
+    uint32_t imageLeft = std::min(std::max(left, m_integerLeft), right);
+    uint32_t imageRight = std::max(std::min(right, m_integerLeft + width), imageLeft);
+
+    ImageScalePath path = ImageScaleDefaultPath();
+    if (factor > 1 && scratch.expandedRow.size() < (size_t)width + 8) {
+        scratch.expandedRow.resize((size_t)width + 8);
+    }
+
+    const uint8_t* row = nullptr;
+    uint32_t expanded = UINT32_MAX;
+    scratch.convertedRows[0] = scratch.convertedRows[1] = -1;
+    for (uint32_t y = imageFirst; y < imageEnd; y++) {
+        uint32_t sourceY = (y - m_integerTop) / factor;
+        if (sourceY != expanded) {
+            row = SourceRow(source, sourceY, 0, source.width - 1, scratch);
+            if (factor > 1) {
+                ExpandRow(path, (const uint32_t*)row, source.width, factor, scratch.expandedRow.data());
+                row = (const uint8_t*)scratch.expandedRow.data();
+            }
+            expanded = sourceY;
+        }
+
+        uint8_t* out = target.pixels + (ptrdiff_t)y * target.pitch;
+        memset(out + 4 * (size_t)left, 0, 4 * (size_t)(imageLeft - left));
+        memcpy(out + 4 * (size_t)imageLeft, row + 4 * (size_t)(imageLeft - m_integerLeft),
+            4 * (size_t)(imageRight - imageLeft));
+        memset(out + 4 * (size_t)imageRight, 0, 4 * (size_t)(right - imageRight));
+    }
+}
+
+void ImageScaler::ScaleConvolve(const ImageView& source, const ImageView& target, uint32_t first, uint32_t end,
+    uint32_t left, uint32_t right, Scratch& scratch) {
+    const FilterTable& columns = m_columnFilter;
+    const FilterTable& rows = m_rowFilter;
+    ImageScalePath path = ImageScaleDefaultPath();
+    size_t values = 4 * (size_t)target.width;
+    size_t firstValue = 4 * (size_t)left;
+    size_t endValue = 4 * (size_t)right;
+    uint32_t pad = columns.taps + 1;
+
+    // The ring holds the last rows.taps filtered rows, each in the slot of its
+    // row number modulo rows.taps; a target row never needs two rows that
+    // share a slot. Its contents are from another region, so start empty.
+    scratch.ring.resize((size_t)rows.taps * values);
+    scratch.ringRows.assign(rows.taps, -1);
+    scratch.convertedRows[0] = scratch.convertedRows[1] = -1;
+    scratch.pairedRow.resize(8 * ((size_t)source.width + 2 * pad));
+    int16_t* pairs = scratch.pairedRow.data() + 8 * (size_t)pad;
+
+    const int16_t* window[MAX_TAPS];
+    for (uint32_t y = first; y < end;) {
+        for (uint32_t k = 0; k < rows.taps; k++) {
+            int32_t r = std::min(std::max(rows.starts[y] + (int32_t)k, 0), (int32_t)source.height - 1);
+            uint32_t slot = (uint32_t)r % rows.taps;
+            int16_t* filtered = &scratch.ring[slot * values];
+
+            if (scratch.ringRows[slot] != r) {
+                PairRow(path, SourceRow(source, (uint32_t)r, 0, source.width - 1, scratch), source.width, pad, pairs);
+                ConvolveRow(path, pairs, columns.starts.data() + left,
+                    columns.weights.data() + (size_t)left * columns.taps, columns.taps, right - left,
+                    filtered + firstValue);
+                scratch.ringRows[slot] = r;
+            }
+            window[k] = filtered;
+        }
+
+        // When enlarging, several target rows share a window. They are done a
+        // strip at a time so the window's part of each row is read from L1.
+        uint32_t shared = y + 1;
+        while (shared < end && rows.starts[shared] == rows.starts[y]) shared++;
+
+        for (size_t strip = firstValue; strip < endValue; strip += STRIP_VALUES) {
+            size_t count = std::min(STRIP_VALUES, endValue - strip);
+            const int16_t* inputs[MAX_TAPS];
+            for (uint32_t k = 0; k < rows.taps; k++) inputs[k] = window[k] + strip;
+
+            for (uint32_t t = y; t < shared; t++) {
+                ConvolveColumns(path, inputs, &rows.weights[(size_t)t * rows.taps], rows.taps, count,
+                    target.pixels + (ptrdiff_t)t * target.pitch + strip);
+            }
+        }
+        y = shared;
+    }
+}
+
+ImageScalePath ImageScaleDefaultPath() {
+    int forced = g_forcedPath.load(std::memory_order_relaxed);
+    if (forced >= 0) return (ImageScalePath)forced;
+
+#ifdef PEGGLE_X86
+    if (CpuHasAvx2()) return IMAGE_SCALE_AVX2;
+    if (CpuHasSse2()) return IMAGE_SCALE_SSE2;
+#endif
+    return IMAGE_SCALE_SCALAR;
+}
+
+void ImageScaleForcePath(ImageScalePath path) {
+    g_forcedPath.store((int)path, std::memory_order_relaxed);
+}
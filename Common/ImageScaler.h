@@ -0,0 +1,192 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class FrameChanges;
+class WorkerPool;
+
+// Image scaling for presenting a game frame at a different size.
+//
+// Images are 32 bits per pixel, B G R X in memory as DirectDraw and GDI lay
+// them out; all four bytes are filtered alike. Bilinear filtering is
+// separable: each target row first blends its two source rows into a buffer
+// of 16-bit channels, then each target pixel blends two neighbouring
+// entries of that buffer. Sample positions are pixel-centre aligned, so
+// scaling to the same size is an exact copy. Weights have 7 fractional bits
+// and every path does the same integer arithmetic, so the scalar, SSE2 and
+// AVX2 paths give identical results.
+//
+// Integer scaling keeps pixel art sharp: each source pixel becomes a square
+// of the largest whole factor that fits the target, and the remainder is
+// left as black bars around the centred image. A source row is expanded once
+// with wide stores, then copied to each of its target rows.
+//
+// Bicubic (Catmull-Rom) and Lanczos-3 are separable convolutions with 14-bit
+// fixed-point weight tables, computed once per filter and size pair. Each
+// source row is filtered horizontally once, into a small ring of 16-bit rows
+// with 6 fractional bits, and each target row is a vertical convolution of
+// the ring's rows done with 16-bit rounding multiplies. When shrinking, the
+// kernels widen to cover each target pixel's whole footprint.
+//
+// With a WorkerPool the target is split into horizontal bands of rows, about
+// four per thread so a thread held up elsewhere does not hold up the frame,
+// and each band is scaled with its own thread's scratch buffers. Scale
+// returns once every band is done. A convolution band starts its ring afresh,
+// so bands are never thinner than a few dozen rows.
+//
+// Given the FrameChanges of the source since the previous call, only the
+// target pixels that read a changed tile are scaled again; the rest of the
+// target must still hold the previous result, with the same filter. Bands
+// are then about one row of tiles, and within each band the columns that
+// read a changed tile are scaled as runs.
+//
+// Targets are always 32 bits per pixel, but a source may also be 16-bit
+// RGB565 or RGB555, or 8-bit with a palette, as DirectDraw games draw in
+// lower display depths. Each source row a band reads is converted (see
+// PixelConvert.h) into the band's scratch space just before it is filtered,
+// while it is still in L1, rather than in a separate pass over the frame.
+//
+// This file is platform neutral; the vector paths are selected at runtime on
+// x86/x64 and a scalar path is used elsewhere.
+
+enum ImageScaleFilter {
+    IMAGE_FILTER_BILINEAR,
+    IMAGE_FILTER_INTEGER,
+    IMAGE_FILTER_BICUBIC,
+    IMAGE_FILTER_LANCZOS3,
+};
+
+enum ImageFormat {
+    IMAGE_FORMAT_BGRX8888,
+    IMAGE_FORMAT_RGB565,
+    IMAGE_FORMAT_RGB555,
+    IMAGE_FORMAT_PALETTE8,
+};
+
+inline uint32_t ImageFormatBytes(ImageFormat format) {
+    switch (format) {
+    case IMAGE_FORMAT_RGB565:
+    case IMAGE_FORMAT_RGB555:
+        return 2;
+    case IMAGE_FORMAT_PALETTE8:
+        return 1;
+    default:
+        return 4;
+    }
+}
+
+struct ImageView {
+    uint8_t* pixels = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    ptrdiff_t pitch = 0;  // bytes from one row to the next
+    ImageFormat format = IMAGE_FORMAT_BGRX8888;
+    const uint32_t* palette = nullptr;  // IMAGE_FORMAT_PALETTE8: 256 B G R X entries
+};
+
+class ImageScaler {
+public:
+    // Scale source (only read) into target, at their sizes; the target must
+    // be IMAGE_FORMAT_BGRX8888. Returns false if either is empty, if a
+    // palettized source has no palette, or for IMAGE_FILTER_INTEGER if the
+    // source is larger than the target. Sample positions are cached between
+    // calls with the same sizes. changes, if given, is what changed in source
+    // since the previous call (see above); it is ignored if it is for another
+    // size.
+    bool Scale(const ImageView& source, const ImageView& target, ImageScaleFilter filter = IMAGE_FILTER_BILINEAR,
+        const FrameChanges* changes = nullptr);
+
+    // Spread each Scale over pool's threads from now on; nullptr (the
+    // default) scales on the calling thread. The pool must outlive its use.
+    void SetWorkerPool(WorkerPool* pool) { m_pool = pool; }
+
+private:
+    // Buffers used while scaling a band, one set per worker thread
+    struct Scratch {
+        std::vector<int16_t> rowBuffer;      // source width + 1 pixels, the last repeated
+        std::vector<uint32_t> expandedRow;   // integer scaling, with room for overlapping stores
+        std::vector<int16_t> pairedRow;      // source row as overlapping pixel pairs, edges repeated
+        std::vector<int16_t> ring;           // horizontally filtered source rows
+        std::vector<int32_t> ringRows;       // source row held by each ring slot, -1 if none
+        std::vector<uint8_t> changedColumns; // per tile column, for the band being scaled
+        std::vector<uint32_t> converted[2];  // source rows converted to 32 bits
+        int32_t convertedRows[2] = { -1, -1 };
+        unsigned convertedLast = 0;          // slot used most recently
+    };
+
+    // Row y of source as 32-bit pixels, valid at least for columns [left,
+    // right]: the row itself, or those columns converted into one of the two
+    // slots of scratch, which are reused while the row is asked for again
+    static const uint8_t* SourceRow(const ImageView& source, uint32_t y, uint32_t left, uint32_t right,
+        Scratch& scratch);
+
+    // Call region(first, end, left, right, scratch) for the target rows
+    // [first, end) and columns [left, right) to scale: bands covering the
+    // whole target, or only what reads a changed tile
+    template <typename Region>
+    void ScaleRegions(const ImageView& target, ImageScaleFilter filter, const FrameChanges* changes,
+        uint32_t minBandRows, Region& region);
+
+    // Source columns (or rows) read by target columns (or rows) first to last
+    // with filter's current tables; false if none are
+    bool SourceRange(ImageScaleFilter filter, bool columns, uint32_t first, uint32_t last, uint32_t& low,
+        uint32_t& high) const;
+
+    void ScaleBilinear(const ImageView& source, const ImageView& target, uint32_t first, uint32_t end,
+        uint32_t left, uint32_t right, Scratch& scratch);
+    void ScaleInteger(const ImageView& source, const ImageView& target, uint32_t first, uint32_t end,
+        uint32_t left, uint32_t right, Scratch& scratch);
+    void ScaleConvolve(const ImageView& source, const ImageView& target, uint32_t first, uint32_t end,
+        uint32_t left, uint32_t right, Scratch& scratch);
+    void Prepare(uint32_t sourceWidth, uint32_t sourceHeight, uint32_t targetWidth, uint32_t targetHeight);
+
+    uint32_t m_sourceWidth = 0;
+    uint32_t m_sourceHeight = 0;
+    uint32_t m_targetWidth = 0;
+    uint32_t m_targetHeight = 0;
+    // Per target column and row: the first of the two source pixels, and
+    // their weights (128 - w in the low half, w in the high half)
+    std::vector<uint32_t> m_columnIndices;
+    std::vector<uint32_t> m_columnWeights;
+    std::vector<uint32_t> m_rowIndices;
+    std::vector<uint32_t> m_rowWeights;
+
+    // Integer scaling: the factor, and the width of the bars left and above
+    uint32_t m_integerFactor = 0;
+    uint32_t m_integerLeft = 0;
+    uint32_t m_integerTop = 0;
+
+    // Convolution along one axis: per target pixel, the first of `taps`
+    // source pixels and their weights, which sum to 1 << 14
+    struct FilterTable {
+        ImageScaleFilter filter = IMAGE_FILTER_BILINEAR;
+        uint32_t sourceSize = 0;
+        uint32_t targetSize = 0;
+        uint32_t taps = 0;  // even
+        std::vector<int32_t> starts;
+        std::vector<int16_t> weights;
+    };
+
+    static void PrepareFilter(FilterTable& table, ImageScaleFilter filter, uint32_t sourceSize, uint32_t targetSize);
+
+    FilterTable m_columnFilter;
+    FilterTable m_rowFilter;
+
+    WorkerPool* m_pool = nullptr;
+    std::vector<Scratch> m_scratch;  // indexed by worker, 0 for the calling thread
+};
+
+enum ImageScalePath {
+    IMAGE_SCALE_SCALAR,
+    IMAGE_SCALE_SSE2,
+    IMAGE_SCALE_AVX2,
+};
+
+// Largest whole factor at which source fits in target; 0 if it does not fit.
+uint32_t IntegerScaleFactor(uint32_t sourceWidth, uint32_t sourceHeight, uint32_t targetWidth,
+    uint32_t targetHeight);
+
+// Best path supported by this CPU; used unless overridden for measurement.
+ImageScalePath ImageScaleDefaultPath();
+void ImageScaleForcePath(ImageScalePath path);
@@ -0,0 +1,386 @@
+#include "Log.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#endif
+
+namespace {
+
+constexpr uint32_t SLOT_COUNT = 1024;  // must be a power of two
+constexpr uint32_t SLOT_MASK = SLOT_COUNT - 1;
+constexpr size_t MESSAGE_SIZE = 244;
+constexpr uint32_t FORMAT_TABLE_SIZE = 1024;  // must be a power of two
+constexpr size_t BATCH_SIZE = 64 * 1024;
+constexpr uint32_t WAKE_INTERVAL = SLOT_COUNT / 4;  // producers nudge the writer this often
+constexpr auto WRITER_IDLE_SLEEP = std::chrono::milliseconds(10);
+constexpr int WRITER_EXIT_TIMEOUT_MS = 500;  // LogClose(true) waits this long at most
+
+// One ring entry. The sequence number tells producers and the consumer who
+// owns the slot (bounded MPMC queue, single consumer here).
+struct Slot {
+    std::atomic<uint32_t> sequence;
+    uint32_t length;
+    uint32_t kind;  // LOG_RECORD_TEXT or a complete binary record
+    char text[MESSAGE_SIZE];
+};
+
+// Format strings are identified by address; the first use of each one also
+// queues a LOG_RECORD_FORMAT carrying its text.
+struct FormatEntry {
+    std::atomic<const char*> format;
+    std::atomic<bool> defined;
+};
+
+Slot g_ring[SLOT_COUNT];
+alignas(64) std::atomic<uint32_t> g_enqueuePos{ 0 };
+alignas(64) uint32_t g_dequeuePos = 0;
+alignas(64) std::atomic<uint64_t> g_dropped{ 0 };
+
+FormatEntry g_formats[FORMAT_TABLE_SIZE];
+
+std::atomic<bool> g_ringReady{ false };
+std::once_flag g_ringInit;
+
+std::mutex g_consumerLock;  // held by whoever drains the ring
+FILE* g_file = nullptr;
+unsigned g_flags = 0;
+bool g_fileBinary = false;
+std::atomic<bool> g_writerRunning{ false };
+std::atomic<bool> g_stopWriter{ false };
+std::mutex g_wakeLock;
+std::condition_variable g_wake;
+char g_batch[BATCH_SIZE];
+
+uint64_t Timestamp() {
+    return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+void InitRing() {
+    for (uint32_t i = 0; i < SLOT_COUNT; i++) {
+        g_ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    g_ringReady.store(true, std::memory_order_release);
+}
+
+Slot* ClaimSlot(uint32_t& pos) {
+    pos = g_enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot* slot = &g_ring[pos & SLOT_MASK];
+        uint32_t seq = slot->sequence.load(std::memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            if (g_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                return slot;
+            }
+        }
+        else if (diff < 0) {
+            return nullptr;  // full
+        }
+        else {
+            pos = g_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void Publish(Slot* slot, uint32_t pos) {
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    // Bursts would otherwise fill the ring before the writer's idle wait ends
+    if ((pos & (WAKE_INTERVAL - 1)) == 0) {
+        g_wake.notify_one();
+    }
+}
+
+// Look up (or assign) the ID of a format string. 0 means the table is full.
+uint32_t FormatId(const char* format) {
+    uint32_t hash = (uint32_t)(((uintptr_t)format >> 2) * 2654435761u);
+    for (uint32_t probe = 0; probe < FORMAT_TABLE_SIZE; probe++) {
+        uint32_t index = (hash + probe) & (FORMAT_TABLE_SIZE - 1);
+        FormatEntry& entry = g_formats[index];
+
+        const char* current = entry.format.load(std::memory_order_acquire);
+        if (!current &&
+            entry.format.compare_exchange_strong(current, format, std::memory_order_acq_rel)) {
+            current = format;
+        }
+        if (current != format) continue;
+
+        if (!entry.defined.load(std::memory_order_acquire)) {
+            // Queue the definition; if the ring is full, retry on the next use
+            uint32_t pos;
+            Slot* slot = ClaimSlot(pos);
+            if (slot) {
+                size_t textLength = strlen(format);
+                size_t room = MESSAGE_SIZE - sizeof(LogRecordHeader) - sizeof(uint32_t);
+                if (textLength > room) textLength = room;
+
+                LogRecordHeader header = { (uint16_t)(sizeof(header) + sizeof(uint32_t) + textLength),
+                    LOG_RECORD_FORMAT, 0 };
+                uint32_t id = index + 1;
+                memcpy(slot->text, &header, sizeof(header));
+                memcpy(slot->text + sizeof(header), &id, sizeof(id));
+                memcpy(slot->text + sizeof(header) + sizeof(id), format, textLength);
+                slot->length = header.size;
+                slot->kind = LOG_RECORD_FORMAT;
+                Publish(slot, pos);
+                entry.defined.store(true, std::memory_order_release);
+            }
+        }
+        return index + 1;
+    }
+    return 0;
+}
+
+void FlushBatch(size_t used) {
+    if (used && g_file) {
+        fwrite(g_batch, 1, used, g_file);
+        fflush(g_file);
+    }
+}
+
+// Move every published message out of the ring. Caller holds g_consumerLock.
+// Returns the number of messages written.
+size_t Drain() {
+    size_t count = 0;
+    size_t used = 0;
+
+    for (;;) {
+        Slot* slot = &g_ring[g_dequeuePos & SLOT_MASK];
+        uint32_t seq = slot->sequence.load(std::memory_order_acquire);
+        if ((int32_t)(seq - (g_dequeuePos + 1)) < 0) break;
+
+        if (used + slot->length + sizeof(LogRecordHeader) > BATCH_SIZE) {
+            FlushBatch(used);
+            used = 0;
+        }
+
+        if (slot->kind != LOG_RECORD_TEXT) {
+            // Binary records can only be produced once a binary file is open
+            memcpy(g_batch + used, slot->text, slot->length);
+            used += slot->length;
+        }
+        else if (g_fileBinary) {
+            // Text queued before the file was opened; wrap it without the newline
+            uint32_t textLength = slot->length - 1;
+            LogRecordHeader header = { (uint16_t)(sizeof(header) + textLength), LOG_RECORD_TEXT, 0 };
+            memcpy(g_batch + used, &header, sizeof(header));
+            memcpy(g_batch + used + sizeof(header), slot->text, textLength);
+            used += header.size;
+        }
+        else {
+            memcpy(g_batch + used, slot->text, slot->length);
+            used += slot->length;
+        }
+
+#ifdef _WIN32
+        if ((g_flags & LOG_DEBUG_OUTPUT) && slot->kind == LOG_RECORD_TEXT) {
+            OutputDebugStringA(slot->text);
+        }
+#endif
+
+        slot->sequence.store(g_dequeuePos + SLOT_COUNT, std::memory_order_release);
+        g_dequeuePos++;
+        count++;
+    }
+
+    FlushBatch(used);
+    return count;
+}
+
+void WriterLoop() {
+    for (;;) {
+        while (!g_stopWriter.load()) {
+            size_t written;
+            {
+                std::lock_guard<std::mutex> lock(g_consumerLock);
+                written = Drain();
+            }
+            if (!written) {
+                std::unique_lock<std::mutex> wait(g_wakeLock);
+                g_wake.wait_for(wait, WRITER_IDLE_SLEEP);
+            }
+        }
+        g_writerRunning.store(false);
+
+        // A LogOpen that ran after the stop request saw this writer still
+        // running and did not start another one, so keep going for it
+        if (g_stopWriter.load() || g_writerRunning.exchange(true)) return;
+    }
+}
+
+#ifdef _WIN32
+// Leaves through ExitThread, so once g_writerRunning is cleared no more code
+// of this module runs on the thread and the module may be unloaded
+DWORD WINAPI WriterThreadProc(LPVOID) {
+    WriterLoop();
+    ExitThread(0);
+}
+#endif
+
+// Never joined: DllMain would have to do it under the loader lock
+void StartWriter() {
+#ifdef _WIN32
+    HANDLE thread = CreateThread(nullptr, 0, WriterThreadProc, nullptr, 0, nullptr);
+    if (thread) {
+        CloseHandle(thread);
+    }
+    else {
+        g_writerRunning.store(false);
+    }
+#else
+    std::thread(WriterLoop).detach();
+#endif
+}
+
+} // namespace
+
+bool LogOpen(const char* path, unsigned flags) {
+    std::call_once(g_ringInit, InitRing);
+
+    std::lock_guard<std::mutex> lock(g_consumerLock);
+    if (g_file) fclose(g_file);
+
+#ifdef _WIN32
+    if (fopen_s(&g_file, path, "wb") != 0) g_file = nullptr;
+#else
+    g_file = fopen(path, "wb");
+#endif
+    g_flags = flags;
+    if (!g_file) return false;
+
+    g_fileBinary = (flags & LOG_BINARY) != 0;
+    if (g_fileBinary) {
+        LogFileHeader header = {};
+        memcpy(header.magic, LOG_BINARY_MAGIC, sizeof(header.magic));
+        header.version = LOG_BINARY_VERSION;
+        header.pointerSize = sizeof(void*);
+        header.ticksPerSecond = std::chrono::steady_clock::period::den / std::chrono::steady_clock::period::num;
+        header.startTicks = Timestamp();
+        header.startUnixTime = (int64_t)time(nullptr);
+        fwrite(&header, sizeof(header), 1, g_file);
+        fflush(g_file);
+
+        // Formats defined so far went to an earlier file; this one needs its
+        // own definitions, queued again by their next use
+        for (FormatEntry& entry : g_formats) entry.defined.store(false, std::memory_order_release);
+    }
+    LogDetail::g_binary.store(g_fileBinary, std::memory_order_release);
+
+    // Cleared first, so a writer still winding down from an earlier
+    // LogClose either sees it and stays, or has already let go of
+    // g_writerRunning and a new one is started
+    g_stopWriter.store(false);
+    if (!g_writerRunning.exchange(true)) {
+        StartWriter();
+    }
+    return true;
+}
+
+void LogClose(bool unloading) {
+    g_stopWriter.store(true);
+    LogDetail::g_binary.store(false, std::memory_order_release);
+
+    // The writer's code is about to be unmapped. At process exit it has
+    // already been terminated instead, and would never report back.
+    if (unloading) {
+        g_wake.notify_all();
+        for (int waited = 0; waited < WRITER_EXIT_TIMEOUT_MS && g_writerRunning.load(); waited++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // At process exit the writer may have been terminated while holding the
+    // lock, so never block on it here
+    for (int attempt = 0; attempt < 100; attempt++) {
+        if (g_consumerLock.try_lock()) {
+            if (g_ringReady.load(std::memory_order_acquire)) Drain();
+            if (g_file) {
+                fclose(g_file);
+                g_file = nullptr;
+            }
+            g_consumerLock.unlock();
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+uint64_t LogDroppedCount() {
+    return g_dropped.load(std::memory_order_relaxed);
+}
+
+namespace LogDetail {
+
+std::atomic<bool> g_binary{ false };
+
+void WriteText(const char* format, ...) {
+    if (!g_ringReady.load(std::memory_order_acquire)) {
+        std::call_once(g_ringInit, InitRing);
+    }
+
+    uint32_t pos;
+    Slot* slot = ClaimSlot(pos);
+    if (!slot) {
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(slot->text, MESSAGE_SIZE - 1, format, args);
+    va_end(args);
+
+    if (len < 0) len = 0;
+    if ((size_t)len > MESSAGE_SIZE - 2) len = (int)(MESSAGE_SIZE - 2);
+    slot->text[len++] = '\n';
+    slot->text[len] = '\0';
+    slot->length = (uint32_t)len;
+    slot->kind = LOG_RECORD_TEXT;
+
+    Publish(slot, pos);
+}
+
+bool BeginBinary(const char* format, BinaryWriter& w) {
+    uint32_t id = FormatId(format);
+    uint32_t pos;
+    Slot* slot = id ? ClaimSlot(pos) : nullptr;
+    if (!slot) {
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    uint64_t timestamp = Timestamp();
+    uint8_t* data = (uint8_t*)slot->text + sizeof(LogRecordHeader);
+    memcpy(data, &id, sizeof(id));
+    memcpy(data + sizeof(id), &timestamp, sizeof(timestamp));
+
+    w.pos = data + sizeof(id) + sizeof(timestamp);
+    w.end = (uint8_t*)slot->text + MESSAGE_SIZE;
+    w.count = 0;
+    w.slot = slot;
+    w.ticket = pos;
+    return true;
+}
+
+void CommitBinary(BinaryWriter& w) {
+    Slot* slot = (Slot*)w.slot;
+    LogRecordHeader header = { (uint16_t)(w.pos - (uint8_t*)slot->text), LOG_RECORD_MESSAGE, w.count };
+    memcpy(slot->text, &header, sizeof(header));
+    slot->length = header.size;
+    slot->kind = LOG_RECORD_MESSAGE;
+    Publish(slot, w.ticket);
+}
+
+} // namespace LogDetail
@@ -0,0 +1,230 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "LogFormat.h"
+
+// Asynchronous logging shared by all hook DLLs.
+//
+// Log() formats the message straight into a slot of a bounded lock-free ring
+// buffer and returns; a background writer thread drains the ring in batches,
+// writes them to the log file with a single flush per batch and forwards them
+// to the debugger. When the ring is full the message is dropped and counted
+// instead of blocking the calling hook.
+//
+// With LOG_BINARY nothing is formatted at all: the call records a format
+// string ID, a timestamp and the raw arguments (see LogFormat.h), and the
+// file is turned back into text offline with PeggleLogDecoder.
+//
+// LogTrace() .. LogError() filter by level at compile time: calls below the
+// threshold expand to an empty inline function and generate no code.
+//
+// This file is platform neutral so the ring can be built and measured outside
+// of Windows as well.
+
+enum LogLevel : int {
+    LOG_LEVEL_TRACE = 0,
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_OFF,
+};
+
+// Lowest level that is compiled in. Set per configuration in the vcxproj
+// (PEGGLE_LOG_LEVEL=n) or per translation unit by defining it before the
+// first include of this header.
+#ifndef PEGGLE_LOG_LEVEL
+#ifdef NDEBUG
+#define PEGGLE_LOG_LEVEL 2
+#else
+#define PEGGLE_LOG_LEVEL 0
+#endif
+#endif
+
+enum LogFlags : unsigned {
+    LOG_DEBUG_OUTPUT = 1 << 0,  // also forward every text message to OutputDebugStringA
+    LOG_BINARY = 1 << 1,        // deferred formatting, decode with PeggleLogDecoder
+};
+
+// Open (truncate) the log file and start the writer thread.
+bool LogOpen(const char* path, unsigned flags);
+
+// Drain everything still queued, then close the file and stop the writer.
+// Pass unloading when the module is being unloaded (DllMain with lpReserved
+// == nullptr): the writer is then given up to half a second to leave the
+// module's code first.
+void LogClose(bool unloading = false);
+
+// Messages lost because the ring was full.
+uint64_t LogDroppedCount();
+
+namespace LogDetail {
+
+extern std::atomic<bool> g_binary;
+
+struct BinaryWriter {
+    uint8_t* pos;
+    uint8_t* end;
+    uint8_t count;
+    void* slot;
+    uint32_t ticket;
+};
+
+void WriteText(const char* format, ...);
+
+// Claim a ring slot and write the message header. Returns false when the
+// message is dropped because the ring or the format table is full.
+bool BeginBinary(const char* format, BinaryWriter& w);
+void CommitBinary(BinaryWriter& w);
+
+inline void Put(BinaryWriter& w, LogArgTag tag, const void* value, size_t size) {
+    if ((size_t)(w.end - w.pos) < size + 1) {
+        w.end = w.pos;  // out of room: drop this and every following argument
+        return;
+    }
+    *w.pos++ = tag;
+    memcpy(w.pos, value, size);
+    w.pos += size;
+    w.count++;
+}
+
+template <typename Char>
+inline void PutString(BinaryWriter& w, LogArgTag tag, const Char* str) {
+    static const Char empty[1] = {};
+    if (!str) str = empty;
+    size_t unitSize = (tag == LOG_ARG_WSTR) ? 2 : 1;
+    size_t room = (size_t)(w.end - w.pos);
+    if (room < 3) {
+        w.end = w.pos;
+        return;
+    }
+
+    size_t maxUnits = (room - 3) / unitSize;
+    uint16_t units = 0;
+    while (units < maxUnits && str[units]) units++;
+
+    *w.pos++ = tag;
+    memcpy(w.pos, &units, sizeof(units));
+    w.pos += sizeof(units);
+    for (uint16_t i = 0; i < units; i++) {
+        uint16_t unit = (uint16_t)str[i];
+        memcpy(w.pos, &unit, unitSize);
+        w.pos += unitSize;
+    }
+    w.count++;
+}
+
+template <typename T, bool IsEnum = std::is_enum<T>::value>
+struct IntegerOf { typedef T type; };
+
+template <typename T>
+struct IntegerOf<T, true> { typedef typename std::underlying_type<T>::type type; };
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+EncodeArg(BinaryWriter& w, T value) {
+    typedef typename IntegerOf<T>::type Int;
+    if (sizeof(Int) > 4) {
+        if (std::is_signed<Int>::value) {
+            int64_t v = (int64_t)value;
+            Put(w, LOG_ARG_I64, &v, sizeof(v));
+        }
+        else {
+            uint64_t v = (uint64_t)value;
+            Put(w, LOG_ARG_U64, &v, sizeof(v));
+        }
+    }
+    else if (std::is_signed<Int>::value) {
+        int32_t v = (int32_t)value;
+        Put(w, LOG_ARG_I32, &v, sizeof(v));
+    }
+    else {
+        uint32_t v = (uint32_t)value;
+        Put(w, LOG_ARG_U32, &v, sizeof(v));
+    }
+}
+
+inline void EncodeArg(BinaryWriter& w, double value) {
+    Put(w, LOG_ARG_F64, &value, sizeof(value));
+}
+
+inline void EncodeArg(BinaryWriter& w, float value) {
+    EncodeArg(w, (double)value);
+}
+
+inline void EncodeArg(BinaryWriter& w, const char* str) { PutString(w, LOG_ARG_STR, str); }
+inline void EncodeArg(BinaryWriter& w, char* str) { PutString(w, LOG_ARG_STR, (const char*)str); }
+inline void EncodeArg(BinaryWriter& w, const wchar_t* str) { PutString(w, LOG_ARG_WSTR, str); }
+inline void EncodeArg(BinaryWriter& w, wchar_t* str) { PutString(w, LOG_ARG_WSTR, (const wchar_t*)str); }
+
+template <typename T>
+inline void EncodeArg(BinaryWriter& w, T* ptr) {
+    uint64_t v = (uint64_t)(uintptr_t)ptr;
+    Put(w, LOG_ARG_PTR, &v, sizeof(v));
+}
+
+inline void EncodeArg(BinaryWriter& w, std::nullptr_t) {
+    EncodeArg(w, (const void*)nullptr);
+}
+
+} // namespace LogDetail
+
+template <typename... Args>
+inline void Log(const char* format, Args... args) {
+    if (!LogDetail::g_binary.load(std::memory_order_relaxed)) {
+        LogDetail::WriteText(format, args...);
+        return;
+    }
+
+    LogDetail::BinaryWriter w;
+    if (!LogDetail::BeginBinary(format, w)) return;
+    int expand[] = { 0, (LogDetail::EncodeArg(w, args), 0)... };
+    (void)expand;
+    LogDetail::CommitBinary(w);
+}
+
+namespace LogDetail {
+
+template <bool Enabled>
+struct LogGate {
+    template <typename... Args>
+    static void Write(const char* format, Args... args) { Log(format, args...); }
+};
+
+template <>
+struct LogGate<false> {
+    template <typename... Args>
+    static void Write(const char*, Args...) {}
+};
+
+} // namespace LogDetail
+
+// Internal linkage so translation units with different thresholds do not
+// violate the one-definition rule.
+template <typename... Args>
+static inline void LogTrace(const char* format, Args... args) {
+    LogDetail::LogGate<(LOG_LEVEL_TRACE >= PEGGLE_LOG_LEVEL)>::Write(format, args...);
+}
+
+template <typename... Args>
+static inline void LogDebug(const char* format, Args... args) {
+    LogDetail::LogGate<(LOG_LEVEL_DEBUG >= PEGGLE_LOG_LEVEL)>::Write(format, args...);
+}
+
+template <typename... Args>
+static inline void LogInfo(const char* format, Args... args) {
+    LogDetail::LogGate<(LOG_LEVEL_INFO >= PEGGLE_LOG_LEVEL)>::Write(format, args...);
+}
+
+template <typename... Args>
+static inline void LogWarn(const char* format, Args... args) {
+    LogDetail::LogGate<(LOG_LEVEL_WARN >= PEGGLE_LOG_LEVEL)>::Write(format, args...);
+}
+
+template <typename... Args>
+static inline void LogError(const char* format, Args... args) {
+    LogDetail::LogGate<(LOG_LEVEL_ERROR >= PEGGLE_LOG_LEVEL)>::Write(format, args...);
+}
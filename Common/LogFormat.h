@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+
+// On-disk layout of binary log files, shared by the logger and the offline
+// decoder (PeggleLogDecoder). All values are little-endian and unaligned.
+//
+// File:   LogFileHeader, then a sequence of records.
+// Record: uint16 size (whole record), uint8 kind, uint8 argCount, payload.
+//
+//   LOG_RECORD_FORMAT   uint32 formatId, format string bytes (no terminator)
+//   LOG_RECORD_MESSAGE  uint32 formatId, uint64 timestamp, encoded arguments
+//   LOG_RECORD_TEXT     preformatted text bytes (messages logged before the
+//                       binary file was opened)
+//
+// Each argument is a one byte LogArgTag followed by its value: 4 or 8 bytes
+// for numbers and pointers, or a uint16 unit count followed by the units for
+// strings (narrow strings as bytes, wide strings as UTF-16 code units).
+// Format records can appear after the messages that use them; decoders are
+// expected to read the whole file before formatting.
+
+constexpr char LOG_BINARY_MAGIC[8] = { 'P', 'G', 'L', 'B', 'I', 'N', '1', '\0' };
+constexpr uint32_t LOG_BINARY_VERSION = 1;
+
+#pragma pack(push, 1)
+struct LogFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t pointerSize;      // size of pointers in the logging process
+    uint64_t ticksPerSecond;   // timestamp resolution
+    uint64_t startTicks;       // timestamp at LogOpen
+    int64_t startUnixTime;     // wall clock at LogOpen, seconds
+};
+
+struct LogRecordHeader {
+    uint16_t size;
+    uint8_t kind;
+    uint8_t argCount;
+};
+#pragma pack(pop)
+
+enum LogRecordKind : uint8_t {
+    LOG_RECORD_FORMAT = 1,
+    LOG_RECORD_MESSAGE = 2,
+    LOG_RECORD_TEXT = 3,
+};
+
+enum LogArgTag : uint8_t {
+    LOG_ARG_I32 = 1,
+    LOG_ARG_U32,
+    LOG_ARG_I64,
+    LOG_ARG_U64,
+    LOG_ARG_F64,
+    LOG_ARG_PTR,
+    LOG_ARG_STR,
+    LOG_ARG_WSTR,
+};
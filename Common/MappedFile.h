@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory mapping of a whole file (CreateFileMapping on Windows,
+// mmap elsewhere), used to parse executables on disk without reading them.
+
+struct MappedFile {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+};
+
+bool MapFileReadOnly(const char* path, MappedFile& file);
+void UnmapFile(MappedFile& file);
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// One patch site: the bytes to write at an address and, once written, the
+// bytes that were there before. PatchSet (PatchSet.h) applies and restores
+// groups of them as a transaction.
+
+constexpr size_t MAX_PATCH_SIZE = 16;
+
+struct MemoryPatch {
+    std::string name;
+    uintptr_t address;
+    uint32_t size;
+    uint8_t bytes[MAX_PATCH_SIZE];
+    uint8_t original[MAX_PATCH_SIZE];  // valid while applied
+    bool applied;
+};
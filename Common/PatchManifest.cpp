@@ -0,0 +1,434 @@
+#include "PatchManifest.h"
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+struct Cursor {
+    const char* p;
+    const char* end;
+    size_t line;
+};
+
+bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+bool IsWordChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || IsDigit(c) || c == '_' || c == '.';
+}
+
+void SkipSpaces(Cursor& c) {
+    while (c.p < c.end && IsSpace(*c.p)) c.p++;
+}
+
+bool AtLineEnd(Cursor& c) {
+    SkipSpaces(c);
+    return c.p >= c.end || *c.p == '\n' || *c.p == '#' || *c.p == ';';
+}
+
+void NextLine(Cursor& c) {
+    while (c.p < c.end && *c.p != '\n') c.p++;
+    if (c.p < c.end) c.p++;
+    c.line++;
+}
+
+struct Word {
+    const char* text;
+    size_t length;
+};
+
+bool ReadWord(Cursor& c, Word& word) {
+    SkipSpaces(c);
+    word.text = c.p;
+    while (c.p < c.end && IsWordChar(*c.p)) c.p++;
+    word.length = (size_t)(c.p - word.text);
+    return word.length != 0;
+}
+
+bool WordIs(const Word& word, const char* text) {
+    size_t length = strlen(text);
+    if (word.length != length) return false;
+    for (size_t i = 0; i < length; i++) {
+        char a = word.text[i], b = text[i];
+        if (a >= 'A' && a <= 'Z') a = (char)(a - 'A' + 'a');
+        if (b >= 'A' && b <= 'Z') b = (char)(b - 'A' + 'a');
+        if (a != b) return false;
+    }
+    return true;
+}
+
+bool Expect(Cursor& c, char ch) {
+    SkipSpaces(c);
+    if (c.p < c.end && *c.p == ch) {
+        c.p++;
+        return true;
+    }
+    return false;
+}
+
+// Decimal (optionally with a fraction) or 0x hexadecimal
+bool ReadNumber(Cursor& c, double& value, bool& integral) {
+    SkipSpaces(c);
+    const char* p = c.p;
+    if (p >= c.end || !IsDigit(*p)) return false;
+
+    integral = true;
+    if (c.end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        p += 2;
+        uint64_t number = 0;
+        const char* digits = p;
+        for (; p < c.end; p++) {
+            int digit;
+            if (IsDigit(*p)) digit = *p - '0';
+            else if (*p >= 'a' && *p <= 'f') digit = *p - 'a' + 10;
+            else if (*p >= 'A' && *p <= 'F') digit = *p - 'A' + 10;
+            else break;
+            number = number * 16 + (uint64_t)digit;
+        }
+        if (p == digits) return false;
+        value = (double)number;
+    }
+    else {
+        uint64_t whole = 0;
+        for (; p < c.end && IsDigit(*p); p++) whole = whole * 10 + (uint64_t)(*p - '0');
+        value = (double)whole;
+        if (p < c.end && *p == '.') {
+            integral = false;
+            double scale = 0.1;
+            for (p++; p < c.end && IsDigit(*p); p++, scale *= 0.1) value += (*p - '0') * scale;
+        }
+    }
+    if (p < c.end && IsWordChar(*p)) return false;
+    c.p = p;
+    return true;
+}
+
+bool ReadUnsigned32(Cursor& c, uint32_t& value) {
+    double number;
+    bool integral;
+    if (!ReadNumber(c, number, integral) || !integral || number > 4294967295.0) return false;
+    value = (uint32_t)number;
+    return true;
+}
+
+bool ParseValueType(const Word& word, PatchValueType& type) {
+    static const struct {
+        const char* name;
+        PatchValueType type;
+    } types[] = {
+        { "u8", PATCH_VALUE_U8 }, { "u16", PATCH_VALUE_U16 }, { "u32", PATCH_VALUE_U32 },
+        { "i32", PATCH_VALUE_I32 }, { "f32", PATCH_VALUE_F32 }, { "f64", PATCH_VALUE_F64 },
+    };
+    for (const auto& entry : types) {
+        if (WordIs(word, entry.name)) {
+            type = entry.type;
+            return true;
+        }
+    }
+    return false;
+}
+
+int Precedence(ExprOpKind kind) {
+    switch (kind) {
+    case EXPR_ADD: case EXPR_SUB: return 1;
+    case EXPR_MUL: case EXPR_DIV: return 2;
+    case EXPR_NEG: return 3;
+    default: return 0;
+    }
+}
+
+// Shunting-yard over the rest of the line. Operators waiting on the stack use
+// EXPR_CONST as the marker for an open parenthesis.
+const char* ParseExpression(Cursor& c, const char* const* variables, size_t variableCount, bool integerType,
+    std::vector<ExprOp>& out) {
+    ExprOp stack[32];
+    size_t depth = 0;
+    bool expectOperand = true;
+    int operands = 0;
+
+    auto popOperator = [&]() {
+        ExprOp op = stack[--depth];
+        out.push_back(op);
+        operands -= (op.kind == EXPR_NEG) ? 0 : 1;
+    };
+
+    while (!AtLineEnd(c)) {
+        char ch = *c.p;
+        if (expectOperand) {
+            if (ch == '(' || ch == '-') {
+                if (depth == sizeof(stack) / sizeof(stack[0])) return "expression too deep";
+                stack[depth++] = ExprOp{ ch == '(' ? EXPR_CONST : EXPR_NEG, 0, 0.0 };
+                c.p++;
+                continue;
+            }
+
+            ExprOp op = {};
+            bool integral;
+            Word word;
+            if (ReadNumber(c, op.value, integral)) {
+                if (integerType && !integral) return "fractional constant in an integer expression";
+                op.kind = EXPR_CONST;
+            }
+            else if (ReadWord(c, word)) {
+                size_t index = 0;
+                while (index < variableCount && !WordIs(word, variables[index])) index++;
+                if (index == variableCount) return "unknown variable";
+                op.kind = EXPR_VAR;
+                op.variable = (uint32_t)index;
+            }
+            else {
+                return "operand expected";
+            }
+            out.push_back(op);
+            operands++;
+            expectOperand = false;
+            continue;
+        }
+
+        if (ch == ')') {
+            while (depth && stack[depth - 1].kind != EXPR_CONST) popOperator();
+            if (!depth) return "unbalanced ')'";
+            depth--;
+            c.p++;
+            continue;
+        }
+
+        ExprOpKind kind;
+        switch (ch) {
+        case '+': kind = EXPR_ADD; break;
+        case '-': kind = EXPR_SUB; break;
+        case '*': kind = EXPR_MUL; break;
+        case '/': kind = EXPR_DIV; break;
+        default: return "operator expected";
+        }
+        while (depth && stack[depth - 1].kind != EXPR_CONST &&
+            Precedence(stack[depth - 1].kind) >= Precedence(kind)) {
+            popOperator();
+        }
+        if (depth == sizeof(stack) / sizeof(stack[0])) return "expression too deep";
+        stack[depth++] = ExprOp{ kind, 0, 0.0 };
+        c.p++;
+        expectOperand = true;
+    }
+
+    if (expectOperand) return "expression expected";
+    while (depth) {
+        if (stack[depth - 1].kind == EXPR_CONST) return "unbalanced '('";
+        popOperator();
+    }
+    return operands == 1 ? nullptr : "malformed expression";
+}
+
+// Site <name> = <locator...> <type> <expression>
+const char* ParseSite(Cursor& c, const char* const* variables, size_t variableCount, ManifestSite& site) {
+    Word word;
+    if (!ReadWord(c, word)) return "site name expected";
+    site.name.assign(word.text, word.length);
+    if (!Expect(c, '=')) return "'=' expected";
+
+    for (;;) {
+        SkipSpaces(c);
+        if (c.p < c.end && (*c.p == '+' || *c.p == '-')) {
+            bool negative = (*c.p++ == '-');
+            uint32_t offset;
+            if (!ReadUnsigned32(c, offset) || offset > 0x7FFFFFFF) return "bad offset";
+            site.offset = negative ? -(int32_t)offset : (int32_t)offset;
+            continue;
+        }
+
+        if (!ReadWord(c, word)) return "locator or value type expected";
+        if (WordIs(word, "rva")) {
+            if (!ReadUnsigned32(c, site.rva)) return "bad rva";
+            site.hasRva = true;
+        }
+        else if (WordIs(word, "sig") || WordIs(word, "codesig")) {
+            site.scope = WordIs(word, "sig") ? SIGNATURE_DATA : SIGNATURE_CODE;
+            if (!Expect(c, '"')) return "quoted signature expected";
+            const char* begin = c.p;
+            while (c.p < c.end && *c.p != '"' && *c.p != '\n') c.p++;
+            if (c.p >= c.end || *c.p != '"') return "unterminated signature";
+            std::string text(begin, c.p++);
+            if (!ParsePattern(text.c_str(), site.pattern)) return "bad signature";
+        }
+        else if (ParseValueType(word, site.type)) {
+            break;
+        }
+        else {
+            return "unknown locator";
+        }
+    }
+
+    if (!site.hasRva && site.scope == SIGNATURE_NONE) return "site needs an rva or a signature";
+    bool integerType = site.type != PATCH_VALUE_F32 && site.type != PATCH_VALUE_F64;
+    return ParseExpression(c, variables, variableCount, integerType, site.expression);
+}
+
+} // namespace
+
+bool ParsePatchManifest(const char* text, size_t length, const char* const* variables, size_t variableCount,
+    PatchManifest& manifest, std::string& error) {
+    manifest = PatchManifest();
+    error.clear();
+
+    Cursor c = { text, text + length, 1 };
+    std::vector<size_t> buildLines;
+    // Skip a UTF-8 byte order mark left by editors
+    if (length >= 3 && memcmp(text, "\xEF\xBB\xBF", 3) == 0) c.p += 3;
+
+    for (; c.p < c.end; NextLine(c)) {
+        if (AtLineEnd(c)) continue;
+
+        const char* problem = nullptr;
+        if (*c.p == '[') {
+            const char* begin = ++c.p;
+            while (c.p < c.end && *c.p != ']' && *c.p != '\n') c.p++;
+            if (c.p >= c.end || *c.p != ']') {
+                problem = "unterminated section";
+            }
+            else {
+                manifest.builds.emplace_back();
+                manifest.builds.back().name.assign(begin, c.p++);
+                buildLines.push_back(c.line);
+            }
+        }
+        else if (manifest.builds.empty()) {
+            problem = "entry outside of a [build] section";
+        }
+        else {
+            ManifestBuild& build = manifest.builds.back();
+            Word key;
+            if (!ReadWord(c, key)) {
+                problem = "key expected";
+            }
+            else if (WordIs(key, "Site")) {
+                build.sites.emplace_back();
+                problem = ParseSite(c, variables, variableCount, build.sites.back());
+            }
+            else if (!Expect(c, '=')) {
+                problem = "'=' expected";
+            }
+            else if (WordIs(key, "Module")) {
+                SkipSpaces(c);
+                const char* begin = c.p;
+                while (c.p < c.end && *c.p != '\n' && *c.p != '#' && *c.p != ';') c.p++;
+                const char* end = c.p;
+                while (end > begin && IsSpace(end[-1])) end--;
+                build.module.assign(begin, end);
+                if (build.module.empty()) problem = "module name expected";
+            }
+            else if (WordIs(key, "TimeDateStamp")) {
+                build.hasTimeDateStamp = ReadUnsigned32(c, build.timeDateStamp);
+                if (!build.hasTimeDateStamp) problem = "bad TimeDateStamp";
+            }
+            else if (WordIs(key, "SizeOfImage")) {
+                build.hasSizeOfImage = ReadUnsigned32(c, build.sizeOfImage);
+                if (!build.hasSizeOfImage) problem = "bad SizeOfImage";
+            }
+            else {
+                problem = "unknown key";
+            }
+        }
+
+        if (!problem && !AtLineEnd(c)) problem = "unexpected text at end of line";
+        if (problem) {
+            char message[128];
+            snprintf(message, sizeof(message), "line %u: %s", (unsigned)c.line, problem);
+            error = message;
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < manifest.builds.size(); i++) {
+        if (manifest.builds[i].module.empty()) {
+            error = "line " + std::to_string(buildLines[i]) + ": build [" + manifest.builds[i].name +
+                "] has no Module";
+            return false;
+        }
+    }
+    return true;
+}
+
+const ManifestBuild* SelectManifestBuild(const PatchManifest& manifest, const char* module,
+    uint32_t timeDateStamp, uint32_t sizeOfImage) {
+    const ManifestBuild* generic = nullptr;
+    for (const ManifestBuild& build : manifest.builds) {
+        Word name = { build.module.c_str(), build.module.size() };
+        if (!WordIs(name, module)) continue;
+        if (build.hasTimeDateStamp && build.timeDateStamp != timeDateStamp) continue;
+        if (build.hasSizeOfImage && build.sizeOfImage != sizeOfImage) continue;
+
+        if (build.hasTimeDateStamp || build.hasSizeOfImage) return &build;
+        if (!generic) generic = &build;
+    }
+    return generic;
+}
+
+size_t PatchValueSize(PatchValueType type) {
+    switch (type) {
+    case PATCH_VALUE_U8: return 1;
+    case PATCH_VALUE_U16: return 2;
+    case PATCH_VALUE_F64: return 8;
+    default: return 4;
+    }
+}
+
+bool EvaluateManifestSite(const ManifestSite& site, const double* variables, uint8_t* out) {
+    bool integerType = site.type != PATCH_VALUE_F32 && site.type != PATCH_VALUE_F64;
+    double real[32];
+    int64_t integer[32];
+    size_t depth = 0;
+
+    for (const ExprOp& op : site.expression) {
+        if (op.kind == EXPR_CONST || op.kind == EXPR_VAR) {
+            if (depth == 32) return false;
+            double value = (op.kind == EXPR_CONST) ? op.value : variables[op.variable];
+            real[depth] = value;
+            integer[depth] = integerType ? (int64_t)value : 0;
+            depth++;
+            continue;
+        }
+        if (op.kind == EXPR_NEG) {
+            real[depth - 1] = -real[depth - 1];
+            integer[depth - 1] = -integer[depth - 1];
+            continue;
+        }
+
+        depth--;
+        double& a = real[depth - 1];
+        double b = real[depth];
+        int64_t& ia = integer[depth - 1];
+        int64_t ib = integer[depth];
+        switch (op.kind) {
+        case EXPR_ADD: a += b; ia += ib; break;
+        case EXPR_SUB: a -= b; ia -= ib; break;
+        case EXPR_MUL: a *= b; ia *= ib; break;
+        case EXPR_DIV:
+            if ((integerType && ib == 0) || (!integerType && b == 0.0)) return false;
+            a /= b;
+            if (integerType) ia /= ib;
+            break;
+        default: break;
+        }
+    }
+    if (depth != 1) return false;
+
+    // A value the type cannot hold would be written truncated or wrapped
+    switch (site.type) {
+    case PATCH_VALUE_U8: if (integer[0] < 0 || integer[0] > UINT8_MAX) return false; break;
+    case PATCH_VALUE_U16: if (integer[0] < 0 || integer[0] > UINT16_MAX) return false; break;
+    case PATCH_VALUE_U32: if (integer[0] < 0 || integer[0] > UINT32_MAX) return false; break;
+    case PATCH_VALUE_I32: if (integer[0] < INT32_MIN || integer[0] > INT32_MAX) return false; break;
+    case PATCH_VALUE_F32: if (real[0] < -FLT_MAX || real[0] > FLT_MAX) return false; break;
+    case PATCH_VALUE_F64: break;
+    }
+
+    switch (site.type) {
+    case PATCH_VALUE_U8: { uint8_t v = (uint8_t)integer[0]; memcpy(out, &v, sizeof(v)); break; }
+    case PATCH_VALUE_U16: { uint16_t v = (uint16_t)integer[0]; memcpy(out, &v, sizeof(v)); break; }
+    case PATCH_VALUE_U32: { uint32_t v = (uint32_t)integer[0]; memcpy(out, &v, sizeof(v)); break; }
+    case PATCH_VALUE_I32: { int32_t v = (int32_t)integer[0]; memcpy(out, &v, sizeof(v)); break; }
+    case PATCH_VALUE_F32: { float v = (float)real[0]; memcpy(out, &v, sizeof(v)); break; }
+    case PATCH_VALUE_F64: memcpy(out, &real[0], sizeof(double)); break;
+    }
+    return true;
+}
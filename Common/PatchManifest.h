@@ -0,0 +1,103 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "PatternScan.h"
+
+// Declarative description of the patch sites for each supported game build.
+//
+//   # comment
+//   [Peggle Deluxe]
+//   Module = Peggle.exe
+//   TimeDateStamp = 0x4A0F1C2D      (optional: only use this build for it)
+//   SizeOfImage = 0x1A5000          (optional)
+//   Site Width  = sig "20 03 00 00 58 02 00 00" rva 0x15E034 u32 Width
+//   Site Aspect = rva 0x15E0A0 f32 Width/Height
+//
+// A site is located by any combination of:
+//   rva <n>          expected location; used directly if the signature (if
+//                    any) matches there, or as a last resort if it is not found
+//   sig "<bytes>"    signature searched in the writable data sections
+//   codesig "<bytes>" signature searched in the executable sections
+//   +<n> / -<n>      offset of the site from the start of the signature
+// followed by the value type (u8, u16, u32, i32, f32, f64) and an expression
+// over numbers, the variables passed to ParsePatchManifest, + - * / and
+// parentheses. Integer types use integer arithmetic like C.
+//
+// The text is parsed in a single pass; expressions are compiled to RPN so
+// evaluating them later costs a few operations each.
+//
+// This file is platform neutral.
+
+enum PatchValueType {
+    PATCH_VALUE_U8,
+    PATCH_VALUE_U16,
+    PATCH_VALUE_U32,
+    PATCH_VALUE_I32,
+    PATCH_VALUE_F32,
+    PATCH_VALUE_F64,
+};
+
+enum ExprOpKind : uint8_t {
+    EXPR_CONST,
+    EXPR_VAR,
+    EXPR_ADD,
+    EXPR_SUB,
+    EXPR_MUL,
+    EXPR_DIV,
+    EXPR_NEG,
+};
+
+struct ExprOp {
+    ExprOpKind kind;
+    uint32_t variable;  // EXPR_VAR: index into the variable list
+    double value;       // EXPR_CONST
+};
+
+enum SignatureScope {
+    SIGNATURE_NONE,
+    SIGNATURE_DATA,
+    SIGNATURE_CODE,
+};
+
+struct ManifestSite {
+    std::string name;
+    SignatureScope scope = SIGNATURE_NONE;
+    BytePattern pattern;
+    int32_t offset = 0;
+    bool hasRva = false;
+    uint32_t rva = 0;
+    PatchValueType type = PATCH_VALUE_U32;
+    std::vector<ExprOp> expression;  // RPN
+};
+
+struct ManifestBuild {
+    std::string name;
+    std::string module;
+    bool hasTimeDateStamp = false;
+    uint32_t timeDateStamp = 0;
+    bool hasSizeOfImage = false;
+    uint32_t sizeOfImage = 0;
+    std::vector<ManifestSite> sites;
+};
+
+struct PatchManifest {
+    std::vector<ManifestBuild> builds;
+};
+
+// On failure error describes the first problem, with its line number.
+bool ParsePatchManifest(const char* text, size_t length, const char* const* variables, size_t variableCount,
+    PatchManifest& manifest, std::string& error);
+
+// First build for this module whose optional TimeDateStamp/SizeOfImage match;
+// builds that pin them are preferred over generic ones.
+const ManifestBuild* SelectManifestBuild(const PatchManifest& manifest, const char* module,
+    uint32_t timeDateStamp, uint32_t sizeOfImage);
+
+size_t PatchValueSize(PatchValueType type);
+
+// Evaluate the site's expression and encode it as its value type. Returns
+// false on division by zero or a value outside the range of the type (u8
+// 1280, u32 -1). out must hold PatchValueSize(site.type) bytes.
+bool EvaluateManifestSite(const ManifestSite& site, const double* variables, uint8_t* out);
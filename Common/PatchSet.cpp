@@ -0,0 +1,240 @@
+#include "PatchSet.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "Log.h"
+
+namespace {
+
+struct ProtectSpan {
+    uintptr_t begin;
+    size_t length;
+    uint32_t protection;
+    uint32_t oldProtection;
+    bool changed;
+};
+
+// Page-aligned spans covering every site, merged across adjacent pages and
+// split wherever the current protection changes
+bool BuildSpans(PatchTarget& target, const std::vector<MemoryPatch*>& sites, std::vector<ProtectSpan>& spans) {
+    uintptr_t pageMask = (uintptr_t)target.PageSize() - 1;
+    uintptr_t runBegin = 0;
+    uintptr_t runEnd = 0;
+
+    auto addRun = [&]() {
+        for (uintptr_t begin = runBegin; begin < runEnd;) {
+            uintptr_t regionEnd;
+            uint32_t protection;
+            if (!target.Query(begin, regionEnd, protection) || regionEnd <= begin) {
+                LogError("Cannot query protection at 0x%p", (void*)begin);
+                return false;
+            }
+            uintptr_t end = std::min(runEnd, regionEnd);
+            spans.push_back(ProtectSpan{ begin, (size_t)(end - begin), protection, 0, false });
+            begin = end;
+        }
+        return true;
+    };
+
+    for (const MemoryPatch* site : sites) {
+        uintptr_t begin = site->address & ~pageMask;
+        uintptr_t end = (site->address + site->size + pageMask) & ~pageMask;
+        if (runEnd && begin <= runEnd) {
+            runEnd = std::max(runEnd, end);
+            continue;
+        }
+        if (runEnd && !addRun()) return false;
+        runBegin = begin;
+        runEnd = end;
+    }
+    return !runEnd || addRun();
+}
+
+enum SiteResult {
+    SITE_WRITTEN,
+    SITE_SKIPPED,  // restore only: the bytes were changed by someone else
+    SITE_FAILED,
+};
+
+SiteResult ApplySite(PatchTarget& target, MemoryPatch& site, bool& originalRead) {
+    uint8_t verify[MAX_PATCH_SIZE];
+    originalRead = target.Read(site.address, site.original, site.size);
+    if (!originalRead ||
+        !target.Write(site.address, site.bytes, site.size) ||
+        !target.Read(site.address, verify, site.size) || memcmp(verify, site.bytes, site.size) != 0) {
+        return SITE_FAILED;
+    }
+    return SITE_WRITTEN;
+}
+
+SiteResult RestoreSite(PatchTarget& target, MemoryPatch& site) {
+    uint8_t current[MAX_PATCH_SIZE];
+    if (!target.Read(site.address, current, site.size)) return SITE_FAILED;
+    if (memcmp(current, site.bytes, site.size) != 0) return SITE_SKIPPED;
+    if (!target.Write(site.address, site.original, site.size) ||
+        !target.Read(site.address, current, site.size) || memcmp(current, site.original, site.size) != 0) {
+        return SITE_FAILED;
+    }
+    return SITE_WRITTEN;
+}
+
+struct TransactionResult {
+    bool ok = true;
+    size_t written = 0;
+    size_t skipped = 0;
+    size_t protectCalls = 0;
+    size_t threads = 0;
+    MemoryPatch* failedSite = nullptr;
+};
+
+// Apply or restore the given sites with the other threads frozen. Everything
+// that allocates happens before SuspendThreads; errors are reported by the
+// caller once the threads run again.
+TransactionResult Transact(PatchTarget& target, std::vector<MemoryPatch*>& sites, bool restoring,
+    std::vector<SiteResult>& results) {
+    TransactionResult result;
+    std::sort(sites.begin(), sites.end(),
+        [](const MemoryPatch* a, const MemoryPatch* b) { return a->address < b->address; });
+
+    std::vector<ProtectSpan> spans;
+    if (!BuildSpans(target, sites, spans)) {
+        result.ok = false;
+        return result;
+    }
+    results.assign(sites.size(), SITE_FAILED);
+
+    result.threads = target.SuspendThreads();
+
+    for (ProtectSpan& span : spans) {
+        span.changed = target.SetProtection(span.begin, span.length,
+            target.WritableProtection(span.protection), span.oldProtection);
+        result.protectCalls++;
+        if (!span.changed) {
+            result.ok = false;
+            break;
+        }
+    }
+
+    size_t done = 0;
+    bool originalRead = false;
+    if (result.ok) {
+        for (; done < sites.size(); done++) {
+            results[done] = restoring ? RestoreSite(target, *sites[done])
+                : ApplySite(target, *sites[done], originalRead);
+            if (results[done] == SITE_FAILED && !restoring) {
+                result.ok = false;
+                result.failedSite = sites[done];
+                break;
+            }
+        }
+    }
+
+    // Roll back a failed apply so the set is never left half-applied. The
+    // site that failed may have been written before its verification read
+    // failed or differed, so it is put back too once its original is known.
+    if (!result.ok && !restoring) {
+        if (result.failedSite && originalRead) {
+            target.Write(sites[done]->address, sites[done]->original, sites[done]->size);
+        }
+        while (done-- > 0) {
+            target.Write(sites[done]->address, sites[done]->original, sites[done]->size);
+        }
+    }
+
+    for (const ProtectSpan& span : spans) {
+        uint32_t unused;
+        if (span.changed) target.SetProtection(span.begin, span.length, span.oldProtection, unused);
+    }
+    if (!sites.empty()) {
+        uintptr_t begin = sites.front()->address;
+        uintptr_t end = sites.back()->address + sites.back()->size;
+        target.FlushCode(begin, (size_t)(end - begin));
+    }
+
+    target.ResumeThreads();
+
+    for (SiteResult siteResult : results) {
+        if (siteResult == SITE_WRITTEN) result.written++;
+        else if (siteResult == SITE_SKIPPED) result.skipped++;
+    }
+    if (!result.ok && !restoring) result.written = 0;
+    return result;
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+bool PatchSet::Add(const char* name, uintptr_t address, const void* bytes, size_t size) {
+    if (m_applied || !size || size > MAX_PATCH_SIZE) return false;
+
+    MemoryPatch site = {};
+    site.name = name;
+    site.address = address;
+    site.size = (uint32_t)size;
+    memcpy(site.bytes, bytes, size);
+    m_sites.push_back(site);
+    return true;
+}
+
+bool PatchSet::Apply(PatchTarget& target) {
+    if (m_applied || m_sites.empty()) return m_applied;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<MemoryPatch*> sites;
+    for (MemoryPatch& site : m_sites) sites.push_back(&site);
+
+    std::vector<SiteResult> results;
+    TransactionResult result = Transact(target, sites, false, results);
+    if (!result.ok) {
+        if (result.failedSite) {
+            LogError("Patch %s at 0x%p failed, patch set rolled back",
+                result.failedSite->name.c_str(), (void*)result.failedSite->address);
+        }
+        else {
+            LogError("Could not make patch pages writable, patch set not applied");
+        }
+        return false;
+    }
+
+    for (MemoryPatch& site : m_sites) site.applied = true;
+    m_applied = true;
+    LogInfo("Patch set applied: %u sites, %u protection changes, %u threads suspended, %.3f ms",
+        (unsigned)result.written, (unsigned)result.protectCalls, (unsigned)result.threads,
+        MillisecondsSince(start));
+    return true;
+}
+
+size_t PatchSet::Restore(PatchTarget& target) {
+    if (!m_applied) return 0;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<MemoryPatch*> sites;
+    for (MemoryPatch& site : m_sites) {
+        if (site.applied) sites.push_back(&site);
+    }
+
+    std::vector<SiteResult> results;
+    TransactionResult result = Transact(target, sites, true, results);
+    for (size_t i = 0; i < results.size(); i++) {
+        MemoryPatch& site = *sites[i];
+        if (results[i] == SITE_WRITTEN) {
+            site.applied = false;
+        }
+        else if (results[i] == SITE_SKIPPED) {
+            site.applied = false;
+            LogWarn("Patch %s at 0x%p was changed since it was applied, left as is",
+                site.name.c_str(), (void*)site.address);
+        }
+        else {
+            LogError("Could not restore patch %s at 0x%p", site.name.c_str(), (void*)site.address);
+        }
+    }
+
+    m_applied = std::any_of(m_sites.begin(), m_sites.end(), [](const MemoryPatch& site) { return site.applied; });
+    LogInfo("Patch set restored: %u sites, %u skipped, %.3f ms",
+        (unsigned)result.written, (unsigned)result.skipped, MillisecondsSince(start));
+    return result.written;
+}
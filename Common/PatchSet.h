@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "MemoryPatch.h"
+
+// Transactional memory patching.
+//
+// A PatchSet groups named writes and applies them as one transaction: the
+// pages involved are made writable once per run of pages that share a
+// protection, the target's other threads are suspended for the duration, and
+// if any write fails the ones already made are rolled back. The original bytes
+// are kept so Restore() can undo the set when the DLL unloads.
+//
+// The set works against the PatchTarget interface rather than the OS, so the
+// transaction logic is platform neutral; Win32PatchTarget (PatchTargetWin32.h)
+// implements it for the current process or another one.
+
+class PatchTarget {
+public:
+    virtual ~PatchTarget() = default;
+
+    virtual size_t PageSize() const = 0;
+
+    // Protection of the region containing address, and where that region ends
+    virtual bool Query(uintptr_t address, uintptr_t& regionEnd, uint32_t& protection) = 0;
+    virtual bool SetProtection(uintptr_t address, size_t size, uint32_t protection, uint32_t& oldProtection) = 0;
+    // Writable protection that keeps the other access rights of protection
+    virtual uint32_t WritableProtection(uint32_t protection) const = 0;
+
+    virtual bool Read(uintptr_t address, void* buffer, size_t size) = 0;
+    virtual bool Write(uintptr_t address, const void* data, size_t size) = 0;
+    virtual void FlushCode(uintptr_t address, size_t size) = 0;
+
+    // Freeze every thread of the target except the caller while a transaction
+    // runs. Nothing may allocate or log between the two calls, since a
+    // suspended thread can hold the heap or CRT locks. Returns the number of
+    // threads suspended.
+    virtual size_t SuspendThreads() = 0;
+    virtual void ResumeThreads() = 0;
+};
+
+class PatchSet {
+public:
+    // Returns false if size is 0 or larger than MAX_PATCH_SIZE, or if the
+    // set has already been applied.
+    bool Add(const char* name, uintptr_t address, const void* bytes, size_t size);
+
+    template <typename T>
+    bool AddValue(const char* name, uintptr_t address, T value) {
+        return Add(name, address, &value, sizeof(value));
+    }
+
+    // All or nothing: on failure every site is left as it was.
+    bool Apply(PatchTarget& target);
+
+    // Put the original bytes back. Sites whose contents were changed by
+    // someone else since they were applied are left alone. Returns the
+    // number of sites restored.
+    size_t Restore(PatchTarget& target);
+
+    bool IsApplied() const { return m_applied; }
+    const std::vector<MemoryPatch>& Sites() const { return m_sites; }
+
+private:
+    std::vector<MemoryPatch> m_sites;
+    bool m_applied = false;
+};
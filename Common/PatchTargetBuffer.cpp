@@ -0,0 +1,86 @@
+#include "PatchTargetBuffer.h"
+#include <cstring>
+
+BufferPatchTarget::BufferPatchTarget(size_t pageCount, size_t pageSize)
+    : m_storage((pageCount + 1) * pageSize),
+      m_pageSize(pageSize),
+      m_protection(pageCount, BUFFER_READ) {
+    // Page-align the first page so spans line up as they do in a process
+    uintptr_t aligned = ((uintptr_t)m_storage.data() + pageSize - 1) & ~(uintptr_t)(pageSize - 1);
+    m_data = (uint8_t*)aligned;
+}
+
+bool BufferPatchTarget::Allows(uintptr_t address, size_t size, uint32_t access) const {
+    if (address < Base() || address - Base() > Size() || Size() - (address - Base()) < size) return false;
+    if (!size) return true;
+
+    size_t first = (address - Base()) / m_pageSize;
+    size_t last = (address - Base() + size - 1) / m_pageSize;
+    for (size_t page = first; page <= last; page++) {
+        if ((m_protection[page] & access) != access) return false;
+    }
+    return true;
+}
+
+void BufferPatchTarget::NoteAccess() {
+    if (!m_suspendDepth) m_touchedWhileRunning = true;
+}
+
+bool BufferPatchTarget::Query(uintptr_t address, uintptr_t& regionEnd, uint32_t& protection) {
+    if (address < Base() || address - Base() >= Size()) return false;
+
+    size_t page = (address - Base()) / m_pageSize;
+    protection = m_protection[page];
+    while (page < m_protection.size() && m_protection[page] == protection) page++;
+    regionEnd = Base() + page * m_pageSize;
+    return true;
+}
+
+bool BufferPatchTarget::SetProtection(uintptr_t address, size_t size, uint32_t protection,
+    uint32_t& oldProtection) {
+    NoteAccess();
+    if (m_setProtectionCalls++ == m_failSetProtection) return false;
+    if (!size || !Allows(address, size, BUFFER_NOACCESS)) return false;
+
+    size_t first = (address - Base()) / m_pageSize;
+    size_t last = (address - Base() + size - 1) / m_pageSize;
+    oldProtection = m_protection[first];
+    for (size_t page = first; page <= last; page++) m_protection[page] = protection;
+    return true;
+}
+
+uint32_t BufferPatchTarget::WritableProtection(uint32_t protection) const {
+    return (protection & BUFFER_EXECUTE) | BUFFER_READ | BUFFER_WRITE;
+}
+
+bool BufferPatchTarget::Read(uintptr_t address, void* buffer, size_t size) {
+    NoteAccess();
+    bool corrupt = m_readCalls++ == m_corruptRead;
+    if (!Allows(address, size, BUFFER_READ)) return false;
+    memcpy(buffer, (const void*)address, size);
+    if (corrupt) {
+        for (size_t i = 0; i < size; i++) static_cast<uint8_t*>(buffer)[i] ^= 0xFF;
+    }
+    return true;
+}
+
+bool BufferPatchTarget::Write(uintptr_t address, const void* data, size_t size) {
+    NoteAccess();
+    if (m_writeCalls++ == m_failWrite) return false;
+    if (!Allows(address, size, BUFFER_WRITE)) return false;
+    if (!m_dropWrites) memcpy((void*)address, data, size);
+    return true;
+}
+
+void BufferPatchTarget::FlushCode(uintptr_t, size_t) {
+    m_flushCalls++;
+}
+
+size_t BufferPatchTarget::SuspendThreads() {
+    m_suspendDepth++;
+    return 0;
+}
+
+void BufferPatchTarget::ResumeThreads() {
+    if (m_suspendDepth) m_suspendDepth--;
+}
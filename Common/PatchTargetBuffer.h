@@ -0,0 +1,91 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "PatchSet.h"
+
+// PatchTarget over a plain byte buffer, with page protection simulated in
+// software, so PatchSet transactions can be run and checked off Windows.
+//
+// The buffer is a run of page-aligned pages, each with its own protection.
+// Read and Write fail on pages that do not allow the access, as the Win32
+// target does for memory that is not committed or not accessible. Calls are
+// counted, and writes or protection changes can be made to fail, or reads to
+// come back corrupt, on purpose to exercise rollback.
+//
+// This file is platform neutral.
+
+enum BufferProtection : uint32_t {
+    BUFFER_NOACCESS = 0,
+    BUFFER_READ = 1 << 0,
+    BUFFER_WRITE = 1 << 1,
+    BUFFER_EXECUTE = 1 << 2,
+};
+
+constexpr size_t BUFFER_NEVER = SIZE_MAX;
+
+class BufferPatchTarget : public PatchTarget {
+public:
+    // Every page starts out BUFFER_READ and zero filled. pageSize must be a
+    // power of two.
+    explicit BufferPatchTarget(size_t pageCount, size_t pageSize = 0x1000);
+
+    uint8_t* Data() { return m_data; }
+    uintptr_t Base() const { return (uintptr_t)m_data; }
+    size_t Size() const { return m_protection.size() * m_pageSize; }
+
+    void Protect(size_t page, uint32_t protection) { m_protection[page] = protection; }
+    uint32_t Protection(size_t page) const { return m_protection[page]; }
+
+    // Make the Write or SetProtection call with this index (counted from 0)
+    // fail, BUFFER_NEVER for none.
+    void FailWrite(size_t call) { m_failWrite = call; }
+    void FailSetProtection(size_t call) { m_failSetProtection = call; }
+    // Make the Read call with this index return the bytes with their bits
+    // flipped, as a verification read of a write that did not stick would.
+    void CorruptRead(size_t call) { m_corruptRead = call; }
+    // Writes report success without changing anything, as a write the CPU
+    // never sees would.
+    void DropWrites(bool drop) { m_dropWrites = drop; }
+
+    size_t WriteCalls() const { return m_writeCalls; }
+    size_t SetProtectionCalls() const { return m_setProtectionCalls; }
+    size_t FlushCalls() const { return m_flushCalls; }
+    // Nesting depth of SuspendThreads; 0 outside a transaction
+    int SuspendDepth() const { return m_suspendDepth; }
+    // Whether any Read, Write or protection change happened while not suspended
+    bool TouchedWhileRunning() const { return m_touchedWhileRunning; }
+
+    size_t PageSize() const override { return m_pageSize; }
+    bool Query(uintptr_t address, uintptr_t& regionEnd, uint32_t& protection) override;
+    bool SetProtection(uintptr_t address, size_t size, uint32_t protection, uint32_t& oldProtection) override;
+    uint32_t WritableProtection(uint32_t protection) const override;
+    bool Read(uintptr_t address, void* buffer, size_t size) override;
+    bool Write(uintptr_t address, const void* data, size_t size) override;
+    void FlushCode(uintptr_t address, size_t size) override;
+    size_t SuspendThreads() override;
+    void ResumeThreads() override;
+
+private:
+    // Whether [address, address + size) is inside the buffer and every page
+    // of it allows access
+    bool Allows(uintptr_t address, size_t size, uint32_t access) const;
+    void NoteAccess();
+
+    std::vector<uint8_t> m_storage;
+    uint8_t* m_data;
+    size_t m_pageSize;
+    std::vector<uint32_t> m_protection;
+
+    size_t m_failWrite = BUFFER_NEVER;
+    size_t m_failSetProtection = BUFFER_NEVER;
+    size_t m_corruptRead = BUFFER_NEVER;
+    bool m_dropWrites = false;
+
+    size_t m_readCalls = 0;
+    size_t m_writeCalls = 0;
+    size_t m_setProtectionCalls = 0;
+    size_t m_flushCalls = 0;
+    int m_suspendDepth = 0;
+    bool m_touchedWhileRunning = false;
+};
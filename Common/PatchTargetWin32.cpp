@@ -0,0 +1,152 @@
+#include "PatchTargetWin32.h"
+#include <cstring>
+#include "Log.h"
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <TlHelp32.h>
+
+namespace {
+
+constexpr DWORD READABLE = PAGE_READONLY | PAGE_READWRITE | PAGE_WRITECOPY |
+    PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+constexpr DWORD WRITABLE = PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+
+// Whether all of [address, address + size) in this process is committed and
+// allows the access, so a bad address fails the call instead of faulting
+// with the other threads suspended
+bool RangeAccessible(uintptr_t address, size_t size, DWORD access) {
+    uintptr_t end = address + size;
+    if (end < address) return false;
+
+    while (address < end) {
+        MEMORY_BASIC_INFORMATION info;
+        if (!VirtualQuery((LPCVOID)address, &info, sizeof(info)) || info.State != MEM_COMMIT ||
+            (info.Protect & PAGE_GUARD) || !(info.Protect & access)) {
+            return false;
+        }
+        address = (uintptr_t)info.BaseAddress + info.RegionSize;
+    }
+    return true;
+}
+
+} // namespace
+
+Win32PatchTarget::Win32PatchTarget(uint32_t processId)
+    : m_processId(processId ? processId : GetCurrentProcessId()),
+      m_inProcess(m_processId == GetCurrentProcessId()),
+      m_process(nullptr),
+      m_pageSize(0x1000) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    m_pageSize = info.dwPageSize;
+
+    if (m_inProcess) {
+        m_process = GetCurrentProcess();
+    }
+    else {
+        m_process = OpenProcess(PROCESS_VM_OPERATION | PROCESS_VM_WRITE | PROCESS_VM_READ |
+            PROCESS_QUERY_INFORMATION, FALSE, m_processId);
+        if (!m_process) LogError("OpenProcess failed: %d", GetLastError());
+    }
+}
+
+Win32PatchTarget::~Win32PatchTarget() {
+    ResumeThreads();
+    if (m_process && !m_inProcess) CloseHandle(m_process);
+}
+
+size_t Win32PatchTarget::PageSize() const {
+    return m_pageSize;
+}
+
+bool Win32PatchTarget::Query(uintptr_t address, uintptr_t& regionEnd, uint32_t& protection) {
+    MEMORY_BASIC_INFORMATION info;
+    SIZE_T queried = m_inProcess ? VirtualQuery((LPCVOID)address, &info, sizeof(info))
+                                 : VirtualQueryEx(m_process, (LPCVOID)address, &info, sizeof(info));
+    if (!queried || info.State != MEM_COMMIT) return false;
+
+    regionEnd = (uintptr_t)info.BaseAddress + info.RegionSize;
+    protection = info.Protect;
+    return true;
+}
+
+bool Win32PatchTarget::SetProtection(uintptr_t address, size_t size, uint32_t protection, uint32_t& oldProtection) {
+    DWORD old = 0;
+    BOOL ok = m_inProcess ? VirtualProtect((LPVOID)address, size, protection, &old)
+                          : VirtualProtectEx(m_process, (LPVOID)address, size, protection, &old);
+    oldProtection = old;
+    return ok != FALSE;
+}
+
+uint32_t Win32PatchTarget::WritableProtection(uint32_t protection) const {
+    const DWORD executable = PAGE_EXECUTE | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+    return (protection & executable) ? PAGE_EXECUTE_READWRITE : PAGE_READWRITE;
+}
+
+bool Win32PatchTarget::Read(uintptr_t address, void* buffer, size_t size) {
+    if (m_inProcess) {
+        if (!RangeAccessible(address, size, READABLE)) return false;
+        memcpy(buffer, (const void*)address, size);
+        return true;
+    }
+    SIZE_T transferred = 0;
+    return ReadProcessMemory(m_process, (LPCVOID)address, buffer, size, &transferred) && transferred == size;
+}
+
+bool Win32PatchTarget::Write(uintptr_t address, const void* data, size_t size) {
+    if (m_inProcess) {
+        if (!RangeAccessible(address, size, WRITABLE)) return false;
+        memcpy((void*)address, data, size);
+        return true;
+    }
+    SIZE_T transferred = 0;
+    return WriteProcessMemory(m_process, (LPVOID)address, data, size, &transferred) && transferred == size;
+}
+
+void Win32PatchTarget::FlushCode(uintptr_t address, size_t size) {
+    FlushInstructionCache(m_process, (LPCVOID)address, size);
+}
+
+size_t Win32PatchTarget::SuspendThreads() {
+    ResumeThreads();
+
+    // Collect the thread IDs first so nothing allocates once threads are frozen
+    HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if (hSnapshot == INVALID_HANDLE_VALUE) return 0;
+
+    m_threadIds.clear();
+    THREADENTRY32 te32;
+    te32.dwSize = sizeof(te32);
+    DWORD self = GetCurrentThreadId();
+    if (Thread32First(hSnapshot, &te32)) {
+        do {
+            if (te32.th32OwnerProcessID == m_processId && te32.th32ThreadID != self) {
+                m_threadIds.push_back(te32.th32ThreadID);
+            }
+        } while (Thread32Next(hSnapshot, &te32));
+    }
+    CloseHandle(hSnapshot);
+
+    m_suspended.reserve(m_threadIds.size());
+    for (uint32_t threadId : m_threadIds) {
+        HANDLE hThread = OpenThread(THREAD_SUSPEND_RESUME, FALSE, threadId);
+        if (!hThread) continue;  // exited since the snapshot
+        if (SuspendThread(hThread) == (DWORD)-1) {
+            CloseHandle(hThread);
+            continue;
+        }
+        m_suspended.push_back(hThread);
+    }
+    return m_suspended.size();
+}
+
+void Win32PatchTarget::ResumeThreads() {
+    for (void* hThread : m_suspended) {
+        ResumeThread(hThread);
+        CloseHandle(hThread);
+    }
+    m_suspended.clear();
+}
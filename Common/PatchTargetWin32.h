@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "PatchSet.h"
+
+// PatchTarget for a Windows process: the current one (memory is accessed
+// directly) or another one through a process handle, as the external
+// injector needs.
+class Win32PatchTarget : public PatchTarget {
+public:
+    // 0 or the current process ID patches this process
+    explicit Win32PatchTarget(uint32_t processId);
+    ~Win32PatchTarget() override;
+
+    Win32PatchTarget(const Win32PatchTarget&) = delete;
+    Win32PatchTarget& operator=(const Win32PatchTarget&) = delete;
+
+    bool IsOpen() const { return m_process != nullptr; }
+
+    size_t PageSize() const override;
+    bool Query(uintptr_t address, uintptr_t& regionEnd, uint32_t& protection) override;
+    bool SetProtection(uintptr_t address, size_t size, uint32_t protection, uint32_t& oldProtection) override;
+    uint32_t WritableProtection(uint32_t protection) const override;
+    bool Read(uintptr_t address, void* buffer, size_t size) override;
+    bool Write(uintptr_t address, const void* data, size_t size) override;
+    void FlushCode(uintptr_t address, size_t size) override;
+    size_t SuspendThreads() override;
+    void ResumeThreads() override;
+
+private:
+    uint32_t m_processId;
+    bool m_inProcess;
+    void* m_process;
+    size_t m_pageSize;
+    std::vector<uint32_t> m_threadIds;
+    std::vector<void*> m_suspended;
+};
@@ -0,0 +1,181 @@
+#include "PatternScan.h"
+#include "CpuFeatures.h"
+#include <atomic>
+#include <cctype>
+#include <cstring>
+
+#ifdef PEGGLE_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+std::atomic<int> g_forcedPath{ -1 };
+
+int HexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+inline bool Verify(const uint8_t* p, const BytePattern& pattern) {
+    const uint8_t* bytes = pattern.bytes.data();
+    const uint8_t* mask = pattern.mask.data();
+    for (size_t i = 0, n = pattern.bytes.size(); i < n; i++) {
+        if ((p[i] & mask[i]) != bytes[i]) return false;
+    }
+    return true;
+}
+
+// Records a verified match; returns false once enough have been found
+inline bool Accept(const uint8_t* p, std::vector<const uint8_t*>* matches, size_t& found, size_t maxMatches) {
+    if (matches) matches->push_back(p);
+    return ++found < maxMatches;
+}
+
+// Scalar filtering on the first fixed byte, used for tails and non-x86 builds
+size_t ScanScalar(const uint8_t* begin, const uint8_t* last, const BytePattern& pattern,
+    std::vector<const uint8_t*>* matches, size_t& found, size_t maxMatches) {
+    const uint8_t first = pattern.bytes[pattern.firstFixed];
+    const uint8_t* p = begin + pattern.firstFixed;
+    const uint8_t* limit = last + pattern.firstFixed;
+
+    while (p <= limit) {
+        p = (const uint8_t*)memchr(p, first, (size_t)(limit - p) + 1);
+        if (!p) break;
+        const uint8_t* candidate = p - pattern.firstFixed;
+        if (Verify(candidate, pattern) && !Accept(candidate, matches, found, maxMatches)) break;
+        p++;
+    }
+    return found;
+}
+
+#ifdef PEGGLE_X86
+PEGGLE_TARGET_SSE2
+size_t ScanSse2(const uint8_t* begin, const uint8_t* last, const BytePattern& pattern,
+    std::vector<const uint8_t*>* matches, size_t& found, size_t maxMatches) {
+    const __m128i first = _mm_set1_epi8((char)pattern.bytes[pattern.firstFixed]);
+    const __m128i tail = _mm_set1_epi8((char)pattern.bytes[pattern.lastFixed]);
+    const uint8_t* p = begin;
+
+    for (; p + 15 <= last; p += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(p + pattern.firstFixed));
+        __m128i b = _mm_loadu_si128((const __m128i*)(p + pattern.lastFixed));
+        uint32_t bits = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, tail)));
+
+        while (bits) {
+            const uint8_t* candidate = p + CountTrailingZeros(bits);
+            if (Verify(candidate, pattern) && !Accept(candidate, matches, found, maxMatches)) return found;
+            bits &= bits - 1;
+        }
+    }
+    return ScanScalar(p, last, pattern, matches, found, maxMatches);
+}
+
+PEGGLE_TARGET_AVX2
+size_t ScanAvx2(const uint8_t* begin, const uint8_t* last, const BytePattern& pattern,
+    std::vector<const uint8_t*>* matches, size_t& found, size_t maxMatches) {
+    const __m256i first = _mm256_set1_epi8((char)pattern.bytes[pattern.firstFixed]);
+    const __m256i tail = _mm256_set1_epi8((char)pattern.bytes[pattern.lastFixed]);
+    const uint8_t* p = begin;
+
+    for (; p + 31 <= last; p += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(p + pattern.firstFixed));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(p + pattern.lastFixed));
+        uint32_t bits = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, tail)));
+
+        while (bits) {
+            const uint8_t* candidate = p + CountTrailingZeros(bits);
+            if (Verify(candidate, pattern) && !Accept(candidate, matches, found, maxMatches)) return found;
+            bits &= bits - 1;
+        }
+    }
+    return ScanScalar(p, last, pattern, matches, found, maxMatches);
+}
+#endif
+
+size_t Scan(const uint8_t* begin, const uint8_t* end, const BytePattern& pattern,
+    std::vector<const uint8_t*>* matches, size_t maxMatches) {
+    size_t found = 0;
+    size_t size = pattern.bytes.size();
+    if (!size || maxMatches == 0 || !begin || end < begin || (size_t)(end - begin) < size) return 0;
+
+    // Last valid start position
+    const uint8_t* last = end - size;
+
+    switch (PatternScanDefaultPath()) {
+#ifdef PEGGLE_X86
+    case PATTERN_SCAN_AVX2:
+        return ScanAvx2(begin, last, pattern, matches, found, maxMatches);
+    case PATTERN_SCAN_SSE2:
+        return ScanSse2(begin, last, pattern, matches, found, maxMatches);
+#endif
+    default:
+        return ScanScalar(begin, last, pattern, matches, found, maxMatches);
+    }
+}
+
+} // namespace
+
+bool ParsePattern(const char* text, BytePattern& pattern) {
+    pattern = BytePattern();
+    if (!text) return false;
+
+    const char* p = text;
+    while (*p) {
+        if (isspace((unsigned char)*p)) {
+            p++;
+            continue;
+        }
+
+        if (*p == '?') {
+            p++;
+            if (*p == '?') p++;
+            pattern.bytes.push_back(0);
+            pattern.mask.push_back(0);
+            continue;
+        }
+
+        int hi = HexDigit(p[0]);
+        int lo = hi >= 0 ? HexDigit(p[1]) : -1;
+        if (lo < 0) return false;
+        pattern.bytes.push_back((uint8_t)(hi * 16 + lo));
+        pattern.mask.push_back(0xFF);
+        p += 2;
+    }
+
+    bool haveFixed = false;
+    for (size_t i = 0; i < pattern.mask.size(); i++) {
+        if (!pattern.mask[i]) continue;
+        if (!haveFixed) pattern.firstFixed = i;
+        pattern.lastFixed = i;
+        haveFixed = true;
+    }
+    return haveFixed;
+}
+
+const uint8_t* FindPattern(const uint8_t* begin, const uint8_t* end, const BytePattern& pattern) {
+    std::vector<const uint8_t*> matches;
+    return Scan(begin, end, pattern, &matches, 1) ? matches[0] : nullptr;
+}
+
+size_t FindAllPatterns(const uint8_t* begin, const uint8_t* end, const BytePattern& pattern,
+    std::vector<const uint8_t*>& matches, size_t maxMatches) {
+    return Scan(begin, end, pattern, &matches, maxMatches);
+}
+
+PatternScanPath PatternScanDefaultPath() {
+    int forced = g_forcedPath.load(std::memory_order_relaxed);
+    if (forced >= 0) return (PatternScanPath)forced;
+
+#ifdef PEGGLE_X86
+    if (CpuHasAvx2()) return PATTERN_SCAN_AVX2;
+    if (CpuHasSse2()) return PATTERN_SCAN_SSE2;
+#endif
+    return PATTERN_SCAN_SCALAR;
+}
+
+void PatternScanForcePath(PatternScanPath path) {
+    g_forcedPath.store((int)path, std::memory_order_relaxed);
+}
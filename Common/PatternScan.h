@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Byte-pattern (AOB) scanner used to locate patch sites by signature instead
+// of fixed addresses.
+//
+// Patterns are written as hex bytes separated by spaces, with "?" or "??"
+// for wildcard bytes, e.g. "8B 0D ?? ?? ?? ?? 85 C9". Candidates are found
+// 16 (SSE2) or 32 (AVX2) positions at a time by comparing the first and last
+// fixed bytes of the pattern, and only those candidates are verified in full.
+//
+// This file is platform neutral; the vector paths are selected at runtime on
+// x86/x64 and a scalar path is used elsewhere.
+
+struct BytePattern {
+    std::vector<uint8_t> bytes;
+    std::vector<uint8_t> mask;  // 0xFF for fixed bytes, 0x00 for wildcards
+    size_t firstFixed = 0;      // offsets of the bytes used for filtering
+    size_t lastFixed = 0;
+};
+
+// Returns false if the text is malformed or has no fixed byte.
+bool ParsePattern(const char* text, BytePattern& pattern);
+
+// First match in [begin, end), or nullptr.
+const uint8_t* FindPattern(const uint8_t* begin, const uint8_t* end, const BytePattern& pattern);
+
+// Every match in [begin, end), up to maxMatches. Returns the number found.
+size_t FindAllPatterns(const uint8_t* begin, const uint8_t* end, const BytePattern& pattern,
+    std::vector<const uint8_t*>& matches, size_t maxMatches = SIZE_MAX);
+
+enum PatternScanPath {
+    PATTERN_SCAN_SCALAR,
+    PATTERN_SCAN_SSE2,
+    PATTERN_SCAN_AVX2,
+};
+
+// Best path supported by this CPU; used unless overridden for measurement.
+PatternScanPath PatternScanDefaultPath();
+void PatternScanForcePath(PatternScanPath path);
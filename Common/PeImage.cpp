@@ -0,0 +1,182 @@
+#include "PeImage.h"
+#include <cstring>
+
+namespace {
+
+constexpr uint16_t DOS_SIGNATURE = 0x5A4D;        // "MZ"
+constexpr uint32_t NT_SIGNATURE = 0x00004550;     // "PE\0\0"
+constexpr uint16_t OPTIONAL_MAGIC_PE32 = 0x10B;
+constexpr uint16_t OPTIONAL_MAGIC_PE32_PLUS = 0x20B;
+constexpr size_t HEADER_PAGE = 0x1000;
+
+#pragma pack(push, 1)
+struct CoffFileHeader {
+    uint16_t machine;
+    uint16_t numberOfSections;
+    uint32_t timeDateStamp;
+    uint32_t pointerToSymbolTable;
+    uint32_t numberOfSymbols;
+    uint16_t sizeOfOptionalHeader;
+    uint16_t characteristics;
+};
+
+// Fields shared by PE32 and PE32+ up to CheckSum, ImageBase excluded
+struct OptionalHeaderCommon {
+    uint16_t magic;
+    uint8_t majorLinkerVersion;
+    uint8_t minorLinkerVersion;
+    uint32_t sizeOfCode;
+    uint32_t sizeOfInitializedData;
+    uint32_t sizeOfUninitializedData;
+    uint32_t addressOfEntryPoint;
+    uint32_t baseOfCode;
+};
+
+struct OptionalHeaderTail {
+    uint32_t sectionAlignment;
+    uint32_t fileAlignment;
+    uint16_t versions[6];
+    uint32_t win32VersionValue;
+    uint32_t sizeOfImage;
+    uint32_t sizeOfHeaders;
+    uint32_t checkSum;
+};
+
+struct SectionHeader {
+    char name[8];
+    uint32_t virtualSize;
+    uint32_t virtualAddress;
+    uint32_t sizeOfRawData;
+    uint32_t pointerToRawData;
+    uint32_t pointerToRelocations;
+    uint32_t pointerToLinenumbers;
+    uint16_t numberOfRelocations;
+    uint16_t numberOfLinenumbers;
+    uint32_t characteristics;
+};
+#pragma pack(pop)
+
+template <typename T>
+bool ReadAt(const uint8_t* data, size_t size, size_t offset, T& out) {
+    if (offset > size || size - offset < sizeof(T)) return false;
+    memcpy(&out, data + offset, sizeof(T));
+    return true;
+}
+
+} // namespace
+
+bool ParsePeImage(const uint8_t* data, size_t size, PeLayout layout, PeImage& image) {
+    image = PeImage();
+    if (!data) return false;
+
+    bool liveModule = (layout == PE_LAYOUT_IMAGE && size == 0);
+    size_t headerSize = liveModule ? HEADER_PAGE : size;
+
+    uint16_t dosMagic;
+    uint32_t ntOffset;
+    if (!ReadAt(data, headerSize, 0, dosMagic) || dosMagic != DOS_SIGNATURE) return false;
+    if (!ReadAt(data, headerSize, 0x3C, ntOffset)) return false;
+
+    uint32_t ntSignature;
+    CoffFileHeader file;
+    if (!ReadAt(data, headerSize, ntOffset, ntSignature) || ntSignature != NT_SIGNATURE) return false;
+    if (!ReadAt(data, headerSize, ntOffset + 4, file)) return false;
+
+    size_t optionalOffset = ntOffset + 4 + sizeof(CoffFileHeader);
+    OptionalHeaderCommon common;
+    if (!ReadAt(data, headerSize, optionalOffset, common)) return false;
+
+    size_t tailOffset;
+    if (common.magic == OPTIONAL_MAGIC_PE32) {
+        uint32_t baseOfData, imageBase;
+        size_t offset = optionalOffset + sizeof(OptionalHeaderCommon);
+        if (!ReadAt(data, headerSize, offset, baseOfData) ||
+            !ReadAt(data, headerSize, offset + 4, imageBase)) {
+            return false;
+        }
+        image.imageBase = imageBase;
+        tailOffset = offset + 8;
+    }
+    else if (common.magic == OPTIONAL_MAGIC_PE32_PLUS) {
+        uint64_t imageBase;
+        size_t offset = optionalOffset + sizeof(OptionalHeaderCommon);
+        if (!ReadAt(data, headerSize, offset, imageBase)) return false;
+        image.imageBase = imageBase;
+        image.is64 = true;
+        tailOffset = offset + 8;
+    }
+    else {
+        return false;
+    }
+
+    OptionalHeaderTail tail;
+    if (!ReadAt(data, headerSize, tailOffset, tail)) return false;
+
+    image.data = data;
+    image.layout = layout;
+    image.size = liveModule ? tail.sizeOfImage : size;
+    image.machine = file.machine;
+    image.timeDateStamp = file.timeDateStamp;
+    image.sizeOfImage = tail.sizeOfImage;
+    image.sizeOfHeaders = tail.sizeOfHeaders;
+    image.checkSum = tail.checkSum;
+
+    // A live module's headers are mapped up to SizeOfHeaders
+    if (liveModule && tail.sizeOfHeaders > headerSize) headerSize = tail.sizeOfHeaders;
+
+    size_t sectionOffset = optionalOffset + file.sizeOfOptionalHeader;
+    image.sections.reserve(file.numberOfSections);
+    for (uint16_t i = 0; i < file.numberOfSections; i++) {
+        SectionHeader header;
+        if (!ReadAt(data, headerSize, sectionOffset + i * sizeof(SectionHeader), header)) return false;
+
+        PeSection section;
+        memcpy(section.name, header.name, 8);
+        section.name[8] = '\0';
+        section.virtualAddress = header.virtualAddress;
+        section.virtualSize = header.virtualSize ? header.virtualSize : header.sizeOfRawData;
+        section.rawOffset = header.pointerToRawData;
+        section.rawSize = header.sizeOfRawData;
+        section.characteristics = header.characteristics;
+        image.sections.push_back(section);
+    }
+    return true;
+}
+
+const PeSection* FindPeSection(const PeImage& image, const char* name) {
+    for (const PeSection& section : image.sections) {
+        if (strncmp(section.name, name, 8) == 0) return &section;
+    }
+    return nullptr;
+}
+
+const uint8_t* PeSectionData(const PeImage& image, const PeSection& section, size_t& size) {
+    size_t offset = (image.layout == PE_LAYOUT_IMAGE) ? section.virtualAddress : section.rawOffset;
+    size_t length = (image.layout == PE_LAYOUT_IMAGE) ? section.virtualSize : section.rawSize;
+
+    size = 0;
+    if (!image.data || !length || offset >= image.size || image.size - offset < length) return nullptr;
+    size = length;
+    return image.data + offset;
+}
+
+const uint8_t* PeRvaToPointer(const PeImage& image, uint32_t rva, size_t length) {
+    if (!image.data) return nullptr;
+
+    if (image.layout == PE_LAYOUT_IMAGE) {
+        if (rva >= image.size || image.size - rva < length) return nullptr;
+        return image.data + rva;
+    }
+
+    if (rva < image.sizeOfHeaders) {
+        return (rva + length <= image.size) ? image.data + rva : nullptr;
+    }
+    for (const PeSection& section : image.sections) {
+        if (rva < section.virtualAddress || rva - section.virtualAddress >= section.rawSize) continue;
+        uint32_t offset = section.rawOffset + (rva - section.virtualAddress);
+        if (section.rawSize - (rva - section.virtualAddress) < length) return nullptr;
+        if (offset >= image.size || image.size - offset < length) return nullptr;
+        return image.data + offset;
+    }
+    return nullptr;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Zero-copy PE/COFF header parser.
+//
+// Works on a module loaded in the current process (image layout, sections at
+// their RVAs) or on an executable mapped from disk (file layout, sections at
+// their raw file offsets). Only the header fields and the section table are
+// copied; section contents are returned as pointers into the caller's view.
+//
+// This file is platform neutral and does not depend on <Windows.h>.
+
+enum PeLayout {
+    PE_LAYOUT_FILE,   // mapped or read from disk
+    PE_LAYOUT_IMAGE,  // loaded by the Windows loader
+};
+
+struct PeSection {
+    char name[9];  // NUL-terminated copy of the 8-byte name
+    uint32_t virtualAddress;
+    uint32_t virtualSize;
+    uint32_t rawOffset;
+    uint32_t rawSize;
+    uint32_t characteristics;
+};
+
+// IMAGE_SCN_* flags used to pick sections
+constexpr uint32_t PE_SCN_CODE = 0x00000020;
+constexpr uint32_t PE_SCN_INITIALIZED_DATA = 0x00000040;
+constexpr uint32_t PE_SCN_MEM_EXECUTE = 0x20000000;
+constexpr uint32_t PE_SCN_MEM_READ = 0x40000000;
+constexpr uint32_t PE_SCN_MEM_WRITE = 0x80000000;
+
+struct PeImage {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    PeLayout layout = PE_LAYOUT_FILE;
+
+    bool is64 = false;
+    uint16_t machine = 0;
+    uint32_t timeDateStamp = 0;
+    uint32_t sizeOfImage = 0;
+    uint32_t sizeOfHeaders = 0;
+    uint32_t checkSum = 0;
+    uint64_t imageBase = 0;
+    std::vector<PeSection> sections;
+};
+
+// Parse the headers of a view. For PE_LAYOUT_IMAGE a size of 0 means "a live
+// module": the headers are trusted to be readable and SizeOfImage becomes the
+// size. Sections that lie outside the view are still listed but have no data,
+// so a view of just the header page is enough to enumerate sections.
+bool ParsePeImage(const uint8_t* data, size_t size, PeLayout layout, PeImage& image);
+
+const PeSection* FindPeSection(const PeImage& image, const char* name);
+
+// Contents of a section within the view, or nullptr if it is not covered.
+// In file layout only the raw data is available; in image layout the whole
+// virtual size is.
+const uint8_t* PeSectionData(const PeImage& image, const PeSection& section, size_t& size);
+
+// Pointer for an RVA within the view, or nullptr.
+const uint8_t* PeRvaToPointer(const PeImage& image, uint32_t rva, size_t length);
@@ -0,0 +1,164 @@
+#include "PixelConvert.h"
+#include "CpuFeatures.h"
+#include <cstring>
+
+#ifdef PEGGLE_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+inline uint32_t Widen5(uint32_t value) {
+    return (value << 3) | (value >> 2);
+}
+
+inline uint32_t Widen6(uint32_t value) {
+    return (value << 2) | (value >> 4);
+}
+
+void ConvertRgb565Scalar(const uint16_t* in, uint32_t count, uint32_t* out) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t p = in[i];
+        out[i] = Widen5(p & 31) | (Widen6((p >> 5) & 63) << 8) | (Widen5(p >> 11) << 16);
+    }
+}
+
+void ConvertRgb555Scalar(const uint16_t* in, uint32_t count, uint32_t* out) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t p = in[i];
+        out[i] = Widen5(p & 31) | (Widen5((p >> 5) & 31) << 8) | (Widen5((p >> 10) & 31) << 16);
+    }
+}
+
+void ConvertPalette8Scalar(const uint8_t* in, const uint32_t* palette, uint32_t count, uint32_t* out) {
+    for (uint32_t i = 0; i < count; i++) out[i] = palette[in[i]];
+}
+
+#ifdef PEGGLE_X86
+// Eight pixels in 16-bit lanes to B G R 0 in two registers of four
+PEGGLE_TARGET_SSE2
+inline void WidenSse2(__m128i p, bool green6, __m128i& low, __m128i& high) {
+    const __m128i five = _mm_set1_epi16(31);
+    __m128i b = _mm_and_si128(p, five);
+    __m128i g, r;
+    if (green6) {
+        g = _mm_and_si128(_mm_srli_epi16(p, 5), _mm_set1_epi16(63));
+        g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+        r = _mm_srli_epi16(p, 11);
+    }
+    else {
+        g = _mm_and_si128(_mm_srli_epi16(p, 5), five);
+        g = _mm_or_si128(_mm_slli_epi16(g, 3), _mm_srli_epi16(g, 2));
+        r = _mm_and_si128(_mm_srli_epi16(p, 10), five);
+    }
+    b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+    r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+
+    __m128i bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+    low = _mm_unpacklo_epi16(bg, r);
+    high = _mm_unpackhi_epi16(bg, r);
+}
+
+PEGGLE_TARGET_SSE2
+void ConvertRgb16Sse2(const uint16_t* in, bool green6, uint32_t count, uint32_t* out) {
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i low, high;
+        WidenSse2(_mm_loadu_si128((const __m128i*)(in + i)), green6, low, high);
+        _mm_storeu_si128((__m128i*)(out + i), low);
+        _mm_storeu_si128((__m128i*)(out + i + 4), high);
+    }
+    if (green6) {
+        ConvertRgb565Scalar(in + i, count - i, out + i);
+    }
+    else {
+        ConvertRgb555Scalar(in + i, count - i, out + i);
+    }
+}
+
+PEGGLE_TARGET_AVX2
+inline void WidenAvx2(__m256i p, bool green6, __m256i& low, __m256i& high) {
+    const __m256i five = _mm256_set1_epi16(31);
+    __m256i b = _mm256_and_si256(p, five);
+    __m256i g, r;
+    if (green6) {
+        g = _mm256_and_si256(_mm256_srli_epi16(p, 5), _mm256_set1_epi16(63));
+        g = _mm256_or_si256(_mm256_slli_epi16(g, 2), _mm256_srli_epi16(g, 4));
+        r = _mm256_srli_epi16(p, 11);
+    }
+    else {
+        g = _mm256_and_si256(_mm256_srli_epi16(p, 5), five);
+        g = _mm256_or_si256(_mm256_slli_epi16(g, 3), _mm256_srli_epi16(g, 2));
+        r = _mm256_and_si256(_mm256_srli_epi16(p, 10), five);
+    }
+    b = _mm256_or_si256(_mm256_slli_epi16(b, 3), _mm256_srli_epi16(b, 2));
+    r = _mm256_or_si256(_mm256_slli_epi16(r, 3), _mm256_srli_epi16(r, 2));
+
+    // The unpacks work within each 128-bit lane: pixels 0-3 and 8-11 in one,
+    // 4-7 and 12-15 in the other
+    __m256i bg = _mm256_or_si256(b, _mm256_slli_epi16(g, 8));
+    __m256i first = _mm256_unpacklo_epi16(bg, r);
+    __m256i second = _mm256_unpackhi_epi16(bg, r);
+    low = _mm256_permute2x128_si256(first, second, 0x20);
+    high = _mm256_permute2x128_si256(first, second, 0x31);
+}
+
+PEGGLE_TARGET_AVX2
+void ConvertRgb16Avx2(const uint16_t* in, bool green6, uint32_t count, uint32_t* out) {
+    uint32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i low, high;
+        WidenAvx2(_mm256_loadu_si256((const __m256i*)(in + i)), green6, low, high);
+        _mm256_storeu_si256((__m256i*)(out + i), low);
+        _mm256_storeu_si256((__m256i*)(out + i + 8), high);
+    }
+    ConvertRgb16Sse2(in + i, green6, count - i, out + i);
+}
+
+PEGGLE_TARGET_AVX2
+void ConvertPalette8Avx2(const uint8_t* in, const uint32_t* palette, uint32_t count, uint32_t* out) {
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(in + i)));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_i32gather_epi32((const int*)palette, indices, 4));
+    }
+    ConvertPalette8Scalar(in + i, palette, count - i, out + i);
+}
+#endif
+
+} // namespace
+
+void ConvertPixels(ImageScalePath path, ImageFormat format, const uint8_t* pixels, const uint32_t* palette,
+    uint32_t count, uint32_t* out) {
+    const uint16_t* wide = (const uint16_t*)pixels;
+    switch (format) {
+    case IMAGE_FORMAT_RGB565:
+    case IMAGE_FORMAT_RGB555: {
+        bool green6 = format == IMAGE_FORMAT_RGB565;
+        switch (path) {
+#ifdef PEGGLE_X86
+        case IMAGE_SCALE_AVX2:
+            return ConvertRgb16Avx2(wide, green6, count, out);
+        case IMAGE_SCALE_SSE2:
+            return ConvertRgb16Sse2(wide, green6, count, out);
+#endif
+        default:
+            return green6 ? ConvertRgb565Scalar(wide, count, out) : ConvertRgb555Scalar(wide, count, out);
+        }
+    }
+
+    case IMAGE_FORMAT_PALETTE8:
+        switch (path) {
+#ifdef PEGGLE_X86
+        case IMAGE_SCALE_AVX2:
+            return ConvertPalette8Avx2(pixels, palette, count, out);
+#endif
+        default:
+            return ConvertPalette8Scalar(pixels, palette, count, out);
+        }
+
+    default:
+        memcpy(out, pixels, 4 * (size_t)count);
+        return;
+    }
+}
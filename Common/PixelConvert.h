@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include "ImageScaler.h"
+
+// Conversion of 16-bit and palettized pixels to 32-bit B G R X.
+//
+// 5- and 6-bit channels are widened by repeating their top bits below them
+// (r5 -> r5 << 3 | r5 >> 2), so black and white stay exact and the steps
+// stay even. A palette entry is used as is. X is left 0.
+//
+// Every path gives identical results. SSE2 and AVX2 widen 8 and 16 pixels at
+// a time with shifts and unpacks. AVX2 looks up 8 palette entries with one
+// gather; SSE2 has no gather, so palette lookups stay scalar there.
+//
+// This file is platform neutral.
+
+// Convert count pixels of format, starting at pixels, into out. palette is
+// only used for IMAGE_FORMAT_PALETTE8.
+void ConvertPixels(ImageScalePath path, ImageFormat format, const uint8_t* pixels, const uint32_t* palette,
+    uint32_t count, uint32_t* out);
+
+// DirectDraw's PALETTEENTRY (R G B flags) as the B G R X entries ImageView
+// takes
+inline uint32_t PaletteEntryToBgrx(uint32_t entry) {
+    return ((entry & 0xFF) << 16) | (entry & 0xFF00) | ((entry >> 16) & 0xFF);
+}
@@ -0,0 +1,73 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned threads) {
+    m_threads.reserve(threads);
+    for (unsigned i = 0; i < threads; i++) {
+        m_threads.emplace_back(&WorkerPool::ThreadMain, this, i + 1);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& thread : m_threads) thread.join();
+}
+
+void WorkerPool::Dispatch(uint32_t count, JobFunction function, void* context) {
+    if (m_threads.empty() || count <= 1) {
+        for (uint32_t i = 0; i < count; i++) function(context, i, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_function = function;
+        m_context = context;
+        m_count = count;
+        m_next.store(0, std::memory_order_relaxed);
+        m_busy = (unsigned)m_threads.size();
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    Work(0);
+
+    // Every pool thread has to leave the run, not just the last piece finish:
+    // the next run reuses the same state
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_done.wait(lock, [this] { return m_busy == 0; });
+}
+
+void WorkerPool::Work(unsigned worker) {
+    for (;;) {
+        uint32_t index = m_next.fetch_add(1, std::memory_order_relaxed);
+        if (index >= m_count) return;
+        m_function(m_context, index, worker);
+    }
+}
+
+void WorkerPool::ThreadMain(unsigned worker) {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(m_lock);
+    for (;;) {
+        m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+        if (m_stop) return;
+        seen = m_generation;
+
+        lock.unlock();
+        Work(worker);
+        lock.lock();
+
+        if (--m_busy == 0) m_done.notify_one();
+    }
+}
+
+unsigned WorkerPoolThreadCount(unsigned configured, unsigned maxAuto) {
+    if (configured) return configured;
+    unsigned cores = std::thread::hardware_concurrency();
+    return std::max(1u, std::min(cores, maxAuto));
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads for splitting one frame's work into pieces.
+//
+// Run(count, job) calls job(index, worker) once for every index below count,
+// spread over the pool's threads and the calling thread, and returns only
+// when every call has finished, so it doubles as the barrier before the
+// result is used. Indices are claimed one at a time from a shared counter: a
+// thread that finishes early, or starts late, simply takes over the pieces
+// nobody has reached yet. worker is 0 for the calling thread and 1 to
+// Threads() for the pool's own, so jobs can keep scratch space per worker.
+//
+// The threads are started once and sleep between runs; a run costs a wake-up
+// and a wait, with no allocation. Runs must not overlap (one caller at a
+// time), and job must not call Run.
+//
+// The destructor stops and joins the threads, so a pool must not be
+// destroyed under the loader lock (from DllMain or a static destructor of a
+// DLL). The hooks create theirs on the render thread and keep it until the
+// process exits.
+//
+// This file is platform neutral.
+
+class WorkerPool {
+public:
+    explicit WorkerPool(unsigned threads);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    unsigned Threads() const { return (unsigned)m_threads.size(); }
+
+    template <typename Job>
+    void Run(uint32_t count, Job& job) {
+        Dispatch(count, [](void* context, uint32_t index, unsigned worker) {
+            (*static_cast<Job*>(context))(index, worker);
+        }, &job);
+    }
+
+private:
+    typedef void (*JobFunction)(void* context, uint32_t index, unsigned worker);
+
+    void Dispatch(uint32_t count, JobFunction function, void* context);
+    void Work(unsigned worker);
+    void ThreadMain(unsigned worker);
+
+    std::vector<std::thread> m_threads;
+
+    // The current run, written under m_lock before the workers are woken
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    JobFunction m_function = nullptr;
+    void* m_context = nullptr;
+    uint32_t m_count = 0;
+    uint64_t m_generation = 0;
+    unsigned m_busy = 0;  // pool threads still in the current run
+    bool m_stop = false;
+
+    std::atomic<uint32_t> m_next{ 0 };
+};
+
+// Number of threads, the caller included, to use for a task that should
+// leave room for the game: configured if nonzero, else one per core up to
+// maxAuto.
+unsigned WorkerPoolThreadCount(unsigned configured, unsigned maxAuto);
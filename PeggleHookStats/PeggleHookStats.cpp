@@ -0,0 +1,75 @@
+// Prints the per-hook statistics a hook DLL publishes with HookStatsOpen,
+// while the game keeps running.
+//
+//   PeggleHookStats <game process id | region name or file> [refresh interval in ms]
+//
+// Each game process publishes its own region, named after its id (see
+// HookStatsRegionName). On Linux the region is a file and this builds with
+// the tests (tests/CMakeLists.txt), or on its own with:
+//   g++ -std=c++14 -O2 -o PeggleHookStats PeggleHookStats.cpp ../Common/HookStats.cpp
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../Common/HookStats.h"
+
+static double TicksToMicroseconds(uint64_t ticks, uint64_t ticksPerSecond) {
+    return ticksPerSecond ? (double)ticks * 1e6 / (double)ticksPerSecond : 0.0;
+}
+
+static void Print(const std::vector<HookStatsSummary>& hooks, uint64_t ticksPerSecond) {
+    printf("%-40s %12s %10s %10s %10s %10s\n", "hook", "calls", "mean us", "p50 us", "p99 us", "max us");
+    for (const HookStatsSummary& hook : hooks) {
+        uint64_t mean = hook.calls ? hook.ticks / hook.calls : 0;
+        printf("%-40s %12llu %10.2f %10.2f %10.2f %10.2f\n", hook.name.c_str(),
+            (unsigned long long)hook.calls,
+            TicksToMicroseconds(mean, ticksPerSecond),
+            TicksToMicroseconds(HookStatsPercentile(hook, 0.50), ticksPerSecond),
+            TicksToMicroseconds(HookStatsPercentile(hook, 0.99), ticksPerSecond),
+            TicksToMicroseconds(hook.maxTicks, ticksPerSecond));
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: PeggleHookStats <game process id | region name or file> [refresh interval in ms]\n");
+        return 1;
+    }
+
+    // A number is the id of the game process; anything else names the region
+    std::string region = argv[1];
+    if (strspn(argv[1], "0123456789") == region.size()) {
+        region = HookStatsRegionName(strtoull(argv[1], nullptr, 10));
+    }
+    const char* name = region.c_str();
+    int interval = argc > 2 ? atoi(argv[2]) : 0;
+
+    HookStatsView view;
+    if (!HookStatsMap(name, view)) {
+        fprintf(stderr, "Cannot open %s (is the game running with the hook?)\n", name);
+        return 1;
+    }
+
+    std::vector<HookStatsSummary> hooks;
+    uint64_t ticksPerSecond = 0;
+    for (;;) {
+        if (!HookStatsRead(view.data, view.size, hooks, ticksPerSecond)) {
+            fprintf(stderr, "%s is not a hook statistics region of version %u\n", name, HOOK_STATS_VERSION);
+            HookStatsUnmap(view);
+            return 1;
+        }
+        Print(hooks, ticksPerSecond);
+
+        if (interval <= 0) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+        printf("\n");
+    }
+
+    HookStatsUnmap(view);
+    return 0;
+}
@@ -0,0 +1,299 @@
+// Turns binary hook logs (LogOpen with LOG_BINARY) back into text.
+//
+//   PeggleLogDecoder <binary log> [output file]
+//
+// Only uses the C++ standard library, so it also builds on Linux:
+//   g++ -std=c++14 -O2 -o PeggleLogDecoder PeggleLogDecoder.cpp
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../Common/LogFormat.h"
+
+struct Arg {
+    uint8_t tag = 0;
+    uint64_t bits = 0;
+    double real = 0.0;
+    std::string text;
+};
+
+static void AppendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += (char)cp;
+    }
+    else if (cp < 0x800) {
+        out += (char)(0xC0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+    else if (cp < 0x10000) {
+        out += (char)(0xE0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+    else {
+        out += (char)(0xF0 | (cp >> 18));
+        out += (char)(0x80 | ((cp >> 12) & 0x3F));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+}
+
+static bool ReadArgs(const uint8_t* p, const uint8_t* end, int count, std::vector<Arg>& args) {
+    args.clear();
+    for (int i = 0; i < count; i++) {
+        if (p >= end) return false;
+        Arg arg;
+        arg.tag = *p++;
+
+        switch (arg.tag) {
+        case LOG_ARG_I32: {
+            if (end - p < 4) return false;
+            int32_t v;
+            memcpy(&v, p, 4);
+            p += 4;
+            arg.bits = (uint64_t)(int64_t)v;
+            break;
+        }
+        case LOG_ARG_U32: {
+            if (end - p < 4) return false;
+            uint32_t v;
+            memcpy(&v, p, 4);
+            p += 4;
+            arg.bits = v;
+            break;
+        }
+        case LOG_ARG_I64:
+        case LOG_ARG_U64:
+        case LOG_ARG_PTR:
+            if (end - p < 8) return false;
+            memcpy(&arg.bits, p, 8);
+            p += 8;
+            break;
+        case LOG_ARG_F64:
+            if (end - p < 8) return false;
+            memcpy(&arg.real, p, 8);
+            p += 8;
+            break;
+        case LOG_ARG_STR:
+        case LOG_ARG_WSTR: {
+            if (end - p < 2) return false;
+            uint16_t units;
+            memcpy(&units, p, 2);
+            p += 2;
+            size_t unitSize = (arg.tag == LOG_ARG_WSTR) ? 2 : 1;
+            if ((size_t)(end - p) < units * unitSize) return false;
+
+            if (unitSize == 1) {
+                arg.text.assign((const char*)p, units);
+            }
+            else {
+                for (uint16_t u = 0; u < units; u++) {
+                    uint16_t unit;
+                    memcpy(&unit, p + u * 2, 2);
+                    uint32_t cp = unit;
+                    if (unit >= 0xD800 && unit < 0xDC00 && u + 1 < units) {
+                        uint16_t low;
+                        memcpy(&low, p + (u + 1) * 2, 2);
+                        if (low >= 0xDC00 && low < 0xE000) {
+                            cp = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+                            u++;
+                        }
+                    }
+                    AppendUtf8(arg.text, cp);
+                }
+            }
+            p += units * unitSize;
+            break;
+        }
+        default:
+            return false;
+        }
+        args.push_back(arg);
+    }
+    return true;
+}
+
+// printf the recorded arguments with the original format string. Integer
+// conversions are widened to 64 bits so the argument sizes of the logging
+// process do not matter.
+static std::string Format(const std::string& format, const std::vector<Arg>& args, uint32_t pointerSize) {
+    std::string out;
+    size_t next = 0;
+    char buffer[512];
+
+    for (size_t i = 0; i < format.size(); i++) {
+        char c = format[i];
+        if (c != '%') {
+            out += c;
+            continue;
+        }
+        if (i + 1 < format.size() && format[i + 1] == '%') {
+            out += '%';
+            i++;
+            continue;
+        }
+
+        // Split the specification into flags/width/precision, length and conversion
+        size_t start = i++;
+        while (i < format.size() && strchr("-+ #0123456789.*", format[i])) i++;
+        std::string prefix = format.substr(start, i - start);
+        bool wide64 = false;
+        while (i < format.size() && strchr("hlLqjztwI", format[i])) {
+            if (format.compare(i, 2, "ll") == 0 || format.compare(i, 3, "I64") == 0 ||
+                format[i] == 'j' || format[i] == 'q') {
+                wide64 = true;
+            }
+            if (format.compare(i, 3, "I64") == 0 || format.compare(i, 3, "I32") == 0) i += 2;
+            i++;
+        }
+        if (i >= format.size()) break;
+        char conv = format[i];
+
+        if (next >= args.size()) {
+            out += "<missing>";
+            continue;
+        }
+        const Arg& arg = args[next++];
+
+        switch (conv) {
+        case 'd': case 'i': {
+            long long v = wide64 ? (long long)arg.bits : (long long)(int32_t)arg.bits;
+            snprintf(buffer, sizeof(buffer), (prefix + "ll" + conv).c_str(), v);
+            out += buffer;
+            break;
+        }
+        case 'u': case 'x': case 'X': case 'o': {
+            unsigned long long v = wide64 ? arg.bits : (uint32_t)arg.bits;
+            snprintf(buffer, sizeof(buffer), (prefix + "ll" + conv).c_str(), v);
+            out += buffer;
+            break;
+        }
+        case 'c':
+            out += (char)arg.bits;
+            break;
+        case 'p':
+            snprintf(buffer, sizeof(buffer), pointerSize == 8 ? "%016llX" : "%08llX",
+                (unsigned long long)arg.bits);
+            out += buffer;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            snprintf(buffer, sizeof(buffer), (prefix + conv).c_str(), arg.real);
+            out += buffer;
+            break;
+        case 's': case 'S':
+            snprintf(buffer, sizeof(buffer), (prefix + 's').c_str(), arg.text.c_str());
+            out += buffer;
+            break;
+        default:
+            out += format.substr(start, i - start + 1);
+            break;
+        }
+    }
+    return out;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <binary log> [output file]\n", argv[0]);
+        return 1;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        fprintf(stderr, "Cannot open %s\n", argv[1]);
+        return 1;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    LogFileHeader header;
+    if (data.size() < sizeof(header)) {
+        fprintf(stderr, "File too small\n");
+        return 1;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, LOG_BINARY_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != LOG_BINARY_VERSION || header.ticksPerSecond == 0) {
+        fprintf(stderr, "%s is not a binary hook log\n", argv[1]);
+        return 1;
+    }
+
+    FILE* out = stdout;
+    if (argc > 2) {
+#ifdef _WIN32
+        if (fopen_s(&out, argv[2], "w") != 0) out = nullptr;
+#else
+        out = fopen(argv[2], "w");
+#endif
+        if (!out) {
+            fprintf(stderr, "Cannot create %s\n", argv[2]);
+            return 1;
+        }
+    }
+
+    const uint8_t* begin = data.data() + sizeof(header);
+    const uint8_t* end = data.data() + data.size();
+
+    // Pass 1: format definitions may follow the messages that use them
+    std::unordered_map<uint32_t, std::string> formats;
+    for (const uint8_t* p = begin; end - p >= (ptrdiff_t)sizeof(LogRecordHeader);) {
+        LogRecordHeader record;
+        memcpy(&record, p, sizeof(record));
+        if (record.size < sizeof(record) || record.size > end - p) break;
+
+        if (record.kind == LOG_RECORD_FORMAT && record.size >= sizeof(record) + 4) {
+            uint32_t id;
+            memcpy(&id, p + sizeof(record), 4);
+            formats[id].assign((const char*)p + sizeof(record) + 4, record.size - sizeof(record) - 4);
+        }
+        p += record.size;
+    }
+
+    // Pass 2: messages in order
+    size_t messages = 0;
+    size_t corrupt = 0;
+    std::vector<Arg> args;
+    const uint8_t* p = begin;
+    while (end - p >= (ptrdiff_t)sizeof(LogRecordHeader)) {
+        LogRecordHeader record;
+        memcpy(&record, p, sizeof(record));
+        if (record.size < sizeof(record) || record.size > end - p) {
+            fprintf(stderr, "Truncated record at offset %zu\n", (size_t)(p - data.data()));
+            break;
+        }
+        const uint8_t* payload = p + sizeof(record);
+        const uint8_t* recordEnd = p + record.size;
+        p = recordEnd;
+
+        if (record.kind == LOG_RECORD_TEXT) {
+            fprintf(out, "%.*s\n", (int)(recordEnd - payload), (const char*)payload);
+            messages++;
+            continue;
+        }
+        if (record.kind != LOG_RECORD_MESSAGE || recordEnd - payload < 12) continue;
+
+        uint32_t id;
+        uint64_t timestamp;
+        memcpy(&id, payload, 4);
+        memcpy(&timestamp, payload + 4, 8);
+
+        auto format = formats.find(id);
+        if (format == formats.end() || !ReadArgs(payload + 12, recordEnd, record.argCount, args)) {
+            corrupt++;
+            continue;
+        }
+
+        double seconds = (double)(int64_t)(timestamp - header.startTicks) / (double)header.ticksPerSecond;
+        fprintf(out, "[%12.6f] %s\n", seconds, Format(format->second, args, header.pointerSize).c_str());
+        messages++;
+    }
+
+    if (out != stdout) fclose(out);
+    fprintf(stderr, "%zu messages decoded, %zu formats, %zu undecodable\n",
+        messages, formats.size(), corrupt);
+    return 0;
+}
@@ -5,32 +5,114 @@
 #include <cmath>
 #include <detours.h>
 #include <TlHelp32.h>
-#include <fstream>
 #include <Psapi.h>
-#include <cstdarg>
 #include <string>
+#include <vector>
+#include "../Common/Log.h"
+#include "../Common/PatternScan.h"
+#include "../Common/PeImage.h"
+#include "../Common/AddressCache.h"
+#include "../Common/MappedFile.h"
+#include "../Common/PatchManifest.h"
+#include "../Common/PatchSet.h"
+#include "../Common/PatchTargetWin32.h"
 
 constexpr DWORD DESIRED_WIDTH = 1280;
 constexpr DWORD DESIRED_HEIGHT = 720;
-constexpr const char* TARGET_PROCESS = "Peggle.exe";
 constexpr const char* TARGET_CLASS = "PeggleClass";
 constexpr DWORD MAX_WAIT_TIME = 10000;
 
-std::ofstream logFile;
+// Used when there is no PeggleResolution.patches next to the game executable.
+// The width/height globals hold the game's default 800x600 as two consecutive
+// 32-bit integers in a writable data section; the RVAs are those of the Steam
+// build of Peggle Deluxe, preferred when the signature matches more than once.
+constexpr const char* DEFAULT_MANIFEST =
+    "[Peggle Deluxe]\n"
+    "Module = Peggle.exe\n"
+    "Site Width  = sig \"20 03 00 00 58 02 00 00\" rva 0x15E034 u32 Width\n"
+    "Site Height = sig \"20 03 00 00 58 02 00 00\" +4 rva 0x15E038 u32 Height\n";
+
+// Variables available to manifest expressions, in this order
+const char* const MANIFEST_VARIABLES[] = { "Width", "Height" };
+
 uintptr_t g_peggleBase = 0;
 DWORD g_pegglePID = 0;
+std::string g_peggleModule;
+DWORD g_targetWidth = DESIRED_WIDTH;
+DWORD g_targetHeight = DESIRED_HEIGHT;
+PatchManifest g_manifest;
+PatchSet g_resolutionPatches;
+
+// Path of a file next to the game executable
+void GetConfigPath(char (&path)[MAX_PATH], const char* name) {
+    GetModuleFileNameA(nullptr, path, MAX_PATH);
+    char* fileName = strrchr(path, '\\');
+    fileName = fileName ? fileName + 1 : path;
+    strcpy_s(fileName, MAX_PATH - (fileName - path), name);
+}
 
-void Log(const char* format, ...) {
-    if (!logFile.is_open()) return;
+// BinaryLog=1 in PeggleResolution.ini (next to the game executable) switches to
+// binary logging, decoded offline with PeggleLogDecoder
+unsigned GetLogFlags(unsigned flags) {
+    char path[MAX_PATH];
+    GetConfigPath(path, "PeggleResolution.ini");
 
-    char buffer[1024];
-    va_list args;
-    va_start(args, format);
-    vsprintf_s(buffer, sizeof(buffer), format, args);
-    va_end(args);
+    if (GetPrivateProfileIntA("Settings", "BinaryLog", 0, path)) {
+        flags |= LOG_BINARY;
+    }
+    return flags;
+}
 
-    logFile << buffer << std::endl;
-    logFile.flush();
+// Width/Height in PeggleResolution.ini, shared with the other mod DLLs
+void LoadSettings() {
+    char path[MAX_PATH];
+    GetConfigPath(path, "PeggleResolution.ini");
+
+    g_targetWidth = GetPrivateProfileIntA("Settings", "Width", DESIRED_WIDTH, path);
+    g_targetHeight = GetPrivateProfileIntA("Settings", "Height", DESIRED_HEIGHT, path);
+    LogInfo("Target resolution: %ux%u", g_targetWidth, g_targetHeight);
+}
+
+uint64_t ElapsedMicroseconds(const LARGE_INTEGER& start) {
+    LARGE_INTEGER now, frequency;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)(now.QuadPart - start.QuadPart) * 1000000 / frequency.QuadPart;
+}
+
+// Parse PeggleResolution.patches (or the built-in manifest) once at startup
+bool LoadManifest() {
+    char path[MAX_PATH];
+    GetConfigPath(path, "PeggleResolution.patches");
+
+    MappedFile file;
+    const char* source = "built-in manifest";
+    const char* text = DEFAULT_MANIFEST;
+    size_t length = strlen(DEFAULT_MANIFEST);
+    if (MapFileReadOnly(path, file)) {
+        source = path;
+        text = (const char*)file.data;
+        length = file.size;
+    }
+
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+    std::string error;
+    bool parsed = ParsePatchManifest(text, length, MANIFEST_VARIABLES,
+        sizeof(MANIFEST_VARIABLES) / sizeof(MANIFEST_VARIABLES[0]), g_manifest, error);
+    uint64_t elapsed = ElapsedMicroseconds(start);
+    UnmapFile(file);
+
+    if (!parsed) {
+        LogError("%s: %s", source, error.c_str());
+        return false;
+    }
+
+    size_t sites = 0;
+    for (const ManifestBuild& build : g_manifest.builds) sites += build.sites.size();
+    LogInfo("Loaded %s: %u builds, %u sites in %.3f ms", source,
+        (unsigned)g_manifest.builds.size(), (unsigned)sites, elapsed / 1000.0);
+    return !g_manifest.builds.empty();
 }
 
 DWORD FindPeggleProcess() {
@@ -39,27 +121,30 @@ DWORD FindPeggleProcess() {
 
     HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
     if (hSnapshot == INVALID_HANDLE_VALUE) {
-        Log("CreateToolhelp32Snapshot failed: %d", GetLastError());
+        LogError("CreateToolhelp32Snapshot failed: %d", GetLastError());
         return 0;
     }
 
     if (!Process32First(hSnapshot, &pe32)) {
         CloseHandle(hSnapshot);
-        Log("Process32First failed: %d", GetLastError());
+        LogError("Process32First failed: %d", GetLastError());
         return 0;
     }
 
     do {
-        if (_stricmp(pe32.szExeFile, TARGET_PROCESS) == 0) {
-            g_pegglePID = pe32.th32ProcessID;
-            Log("Found Peggle process: PID=%d", g_pegglePID);
-            CloseHandle(hSnapshot);
-            return g_pegglePID;
+        for (const ManifestBuild& build : g_manifest.builds) {
+            if (_stricmp(pe32.szExeFile, build.module.c_str()) == 0) {
+                g_pegglePID = pe32.th32ProcessID;
+                g_peggleModule = build.module;
+                LogInfo("Found Peggle process: %s PID=%d", pe32.szExeFile, g_pegglePID);
+                CloseHandle(hSnapshot);
+                return g_pegglePID;
+            }
         }
     } while (Process32Next(hSnapshot, &pe32));
 
     CloseHandle(hSnapshot);
-    Log("Peggle process not found");
+    LogDebug("Peggle process not found");
     return 0;
 }
 
@@ -68,7 +153,7 @@ uintptr_t GetPeggleBaseAddress() {
 
     HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, g_pegglePID);
     if (!hProcess) {
-        Log("OpenProcess failed: %d", GetLastError());
+        LogError("OpenProcess failed: %d", GetLastError());
         return 0;
     }
 
@@ -79,9 +164,11 @@ uintptr_t GetPeggleBaseAddress() {
         char modName[MAX_PATH];
         for (DWORD i = 0; i < (cbNeeded / sizeof(HMODULE)); i++) {
             if (GetModuleFileNameExA(hProcess, hMods[i], modName, sizeof(modName))) {
-                if (strstr(modName, TARGET_PROCESS)) {
+                const char* fileName = strrchr(modName, '\\');
+                fileName = fileName ? fileName + 1 : modName;
+                if (_stricmp(fileName, g_peggleModule.c_str()) == 0) {
                     g_peggleBase = (uintptr_t)hMods[i];
-                    Log("Peggle base address: 0x%p", (void*)g_peggleBase);
+                    LogInfo("Peggle base address: 0x%p", (void*)g_peggleBase);
                     CloseHandle(hProcess);
                     return g_peggleBase;
                 }
@@ -89,85 +176,224 @@ uintptr_t GetPeggleBaseAddress() {
         }
     }
     else {
-        Log("EnumProcessModules failed: %d", GetLastError());
+        LogError("EnumProcessModules failed: %d", GetLastError());
     }
 
     CloseHandle(hProcess);
     return 0;
 }
 
-uintptr_t CalculatePeggleAddress(uintptr_t offset) {
-    if (!g_peggleBase) {
-        Log("Cannot calculate address: base not set");
-        return 0;
-    }
-
-    // Adjust for ASLR: offset - default base (0x400000) + actual base
-    uintptr_t actualAddr = g_peggleBase + (offset - 0x00400000);
-    Log("Calculated address: 0x%p = 0x%p + (0x%p - 0x00400000)",
-        (void*)actualAddr, (void*)g_peggleBase, (void*)offset);
-
-    return actualAddr;
+bool IsWritableData(const PeSection& section) {
+    const uint32_t wanted = PE_SCN_INITIALIZED_DATA | PE_SCN_MEM_WRITE;
+    return (section.characteristics & wanted) == wanted;
 }
 
-bool PatchMemory(uintptr_t address, uint32_t value) {
-    if (!g_pegglePID) {
-        Log("PatchMemory failed: no PID");
-        return false;
-    }
+bool IsCode(const PeSection& section) {
+    return (section.characteristics & (PE_SCN_CODE | PE_SCN_MEM_EXECUTE)) != 0;
+}
 
-    HANDLE hProcess = OpenProcess(PROCESS_VM_OPERATION | PROCESS_VM_WRITE | PROCESS_VM_READ, FALSE, g_pegglePID);
+// Read from the game, which may be this process or another one
+bool ReadPeggleMemory(uintptr_t address, void* buffer, size_t size, SIZE_T* bytesRead = nullptr) {
+    bool inProcess = (g_pegglePID == GetCurrentProcessId());
+    HANDLE hProcess = inProcess ? GetCurrentProcess() : OpenProcess(PROCESS_VM_READ, FALSE, g_pegglePID);
     if (!hProcess) {
-        Log("OpenProcess failed: %d", GetLastError());
+        LogError("OpenProcess failed: %d", GetLastError());
         return false;
     }
 
-    uint32_t originalValue = 0;
-    SIZE_T bytesRead;
-    if (ReadProcessMemory(hProcess, (LPCVOID)address, &originalValue, sizeof(originalValue), &bytesRead)) {
-        Log("Original value at 0x%p: %d (0x%X)", (void*)address, originalValue, originalValue);
+    SIZE_T read = 0;
+    BOOL ok = ReadProcessMemory(hProcess, (LPCVOID)address, buffer, size, &read);
+    if (!ok) LogError("ReadProcessMemory failed at 0x%p: %d", (void*)address, GetLastError());
+    if (!inProcess) CloseHandle(hProcess);
+    if (bytesRead) *bytesRead = read;
+    return ok != FALSE;
+}
+
+// Parse the headers of the running image. In-process the module is used in
+// place; otherwise the header page is copied into the caller's buffer.
+bool ReadPeggleHeaders(BYTE (&headers)[0x1000], PeImage& image) {
+    bool parsed;
+    if (g_pegglePID == GetCurrentProcessId()) {
+        parsed = ParsePeImage((const uint8_t*)g_peggleBase, 0, PE_LAYOUT_IMAGE, image);
     }
     else {
-        Log("ReadProcessMemory failed: %d", GetLastError());
+        SIZE_T bytesRead = 0;
+        if (!ReadPeggleMemory(g_peggleBase, headers, sizeof(headers), &bytesRead)) return false;
+        parsed = ParsePeImage(headers, bytesRead, PE_LAYOUT_IMAGE, image);
     }
 
-    DWORD oldProtect;
-    if (!VirtualProtectEx(hProcess, (LPVOID)address, sizeof(value), PAGE_EXECUTE_READWRITE, &oldProtect)) {
-        Log("VirtualProtectEx failed: %d", GetLastError());
-        CloseHandle(hProcess);
-        return false;
+    if (!parsed) LogError("Peggle image has no valid PE header");
+    return parsed;
+}
+
+// Section contents for signature scans, shared by all sites of a build. In
+// process the sections are scanned in place; otherwise each one is copied once.
+struct ScanSection {
+    const PeSection* section;
+    uintptr_t start;
+    const uint8_t* data;
+    size_t size;
+    std::vector<BYTE> copy;
+};
+
+struct ImageSections {
+    const PeImage* image;
+    bool loaded = false;
+    std::vector<ScanSection> sections;
+};
+
+void LoadImageSections(ImageSections& sections) {
+    if (sections.loaded) return;
+    sections.loaded = true;
+
+    for (const PeSection& section : sections.image->sections) {
+        if (!IsWritableData(section) && !IsCode(section)) continue;
+
+        ScanSection scan;
+        scan.section = &section;
+        scan.start = g_peggleBase + section.virtualAddress;
+        scan.data = PeSectionData(*sections.image, section, scan.size);
+        if (!scan.data) {
+            SIZE_T bytesRead = 0;
+            scan.copy.resize(section.virtualSize);
+            if (!ReadPeggleMemory(scan.start, scan.copy.data(), scan.copy.size(), &bytesRead)) continue;
+            scan.size = bytesRead;
+        }
+        sections.sections.push_back(std::move(scan));
     }
+    for (ScanSection& scan : sections.sections) {
+        if (!scan.data) scan.data = scan.copy.data();
+    }
+}
 
-    SIZE_T bytesWritten;
-    if (!WriteProcessMemory(hProcess, (LPVOID)address, &value, sizeof(value), &bytesWritten)) {
-        Log("WriteProcessMemory failed: %d", GetLastError());
-        CloseHandle(hProcess);
-        return false;
+// Does the site's signature start at address - offset?
+bool SignatureMatchesAt(const ManifestSite& site, uintptr_t address) {
+    size_t length = site.pattern.bytes.size();
+    std::vector<BYTE> bytes(length);
+    SIZE_T bytesRead = 0;
+    uintptr_t start = address - site.offset;
+    return ReadPeggleMemory(start, bytes.data(), length, &bytesRead) && bytesRead == length &&
+        FindPattern(bytes.data(), bytes.data() + length, site.pattern) == bytes.data();
+}
+
+// Locate a manifest site: the expected RVA if the signature is there, else the
+// first signature match in the sections of its scope, else the RVA as is
+uintptr_t LocateSite(const ManifestSite& site, ImageSections& sections) {
+    if (site.hasRva && (site.scope == SIGNATURE_NONE || SignatureMatchesAt(site, g_peggleBase + site.rva))) {
+        return g_peggleBase + site.rva;
     }
 
-    // Verify write
-    uint32_t newValue = 0;
-    if (ReadProcessMemory(hProcess, (LPCVOID)address, &newValue, sizeof(newValue), &bytesRead)) {
-        Log("New value at 0x%p: %d (0x%X)", (void*)address, newValue, newValue);
+    if (site.scope != SIGNATURE_NONE) {
+        LoadImageSections(sections);
+        for (const ScanSection& scan : sections.sections) {
+            bool inScope = (site.scope == SIGNATURE_CODE) ? IsCode(*scan.section) : IsWritableData(*scan.section);
+            if (!inScope) continue;
+
+            const uint8_t* match = FindPattern(scan.data, scan.data + scan.size, site.pattern);
+            LogDebug("Scanned section %s for %s: %u bytes, %s", scan.section->name,
+                site.name.c_str(), (unsigned)scan.size, match ? "found" : "no match");
+            if (match) return scan.start + (match - scan.data) + site.offset;
+        }
+        LogWarn("Signature for %s not found", site.name.c_str());
     }
 
-    VirtualProtectEx(hProcess, (LPVOID)address, sizeof(value), oldProtect, &oldProtect);
-    CloseHandle(hProcess);
+    if (site.hasRva) {
+        LogWarn("Using the manifest RVA for %s unverified", site.name.c_str());
+        return g_peggleBase + site.rva;
+    }
+    return 0;
+}
+
+// A cached address is only trusted if the signature is still there, or the
+// site already holds the value we are about to write
+bool ValidateCachedSite(const ManifestSite& site, uintptr_t address, const uint8_t* value) {
+    if (SignatureMatchesAt(site, address)) return true;
+
+    uint8_t current[8];
+    size_t size = PatchValueSize(site.type);
+    return ReadPeggleMemory(address, current, size) && memcmp(current, value, size) == 0;
+}
+
+// Resolve every site of the build into g_resolutionPatches. Signature sites go
+// through PeggleResolution.cache, so the image is only scanned when the cache
+// is missing, stale or wrong.
+bool ResolveManifestSites(const PeImage& image, const ManifestBuild& build) {
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+
+    char cachePath[MAX_PATH];
+    GetConfigPath(cachePath, "PeggleResolution.cache");
+
+    ImageFingerprint fingerprint;
+    AddressCache cache;
+    bool haveFingerprint = FingerprintImage(image, fingerprint);
+    bool cacheLoaded = haveFingerprint && LoadAddressCache(cachePath, fingerprint, cache);
+
+    ImageSections sections;
+    sections.image = &image;
+    double variables[] = { (double)g_targetWidth, (double)g_targetHeight };
+    size_t resolved = 0;
+    size_t fromCache = 0;
+    size_t scanned = 0;
+
+    for (const ManifestSite& site : build.sites) {
+        uint8_t value[8];
+        if (!EvaluateManifestSite(site, variables, value)) {
+            LogError("Cannot evaluate the value of %s: division by zero or out of range", site.name.c_str());
+            continue;
+        }
+
+        uintptr_t address = 0;
+        if (site.scope != SIGNATURE_NONE) {
+            const CachedAddress* entry = FindCachedAddress(cache, site.name.c_str());
+            if (entry && entry->rva < image.sizeOfImage &&
+                ValidateCachedSite(site, g_peggleBase + entry->rva, value)) {
+                address = g_peggleBase + entry->rva;
+                fromCache++;
+            }
+            else {
+                address = LocateSite(site, sections);
+                if (address) SetCachedAddress(cache, site.name.c_str(), (uint32_t)(address - g_peggleBase));
+                scanned++;
+            }
+        }
+        else {
+            address = LocateSite(site, sections);
+        }
 
-    if (newValue == value) {
-        Log("Successfully patched 0x%p: %d -> %d", (void*)address, originalValue, value);
-        return true;
+        if (!address) {
+            LogError("Could not locate %s", site.name.c_str());
+            continue;
+        }
+        g_resolutionPatches.Add(site.name.c_str(), address, value, PatchValueSize(site.type));
+        resolved++;
+    }
+
+    uint64_t elapsed = ElapsedMicroseconds(start);
+    if (!scanned && fromCache) {
+        uint64_t saved = cache.scanMicroseconds > elapsed ? cache.scanMicroseconds - elapsed : 0;
+        LogInfo("Address cache hit: %u sites resolved in %.3f ms, %.3f ms saved",
+            (unsigned)resolved, elapsed / 1000.0, saved / 1000.0);
+    }
+    else {
+        LogInfo("Address cache %s: %u/%u sites resolved in %.3f ms (%u from cache, %u located)",
+            cacheLoaded ? "partial hit" : "miss", (unsigned)resolved, (unsigned)build.sites.size(),
+            elapsed / 1000.0, (unsigned)fromCache, (unsigned)scanned);
     }
 
-    Log("Patch verification failed");
-    return false;
+    if (scanned && haveFingerprint) {
+        cache.fingerprint = fingerprint;
+        cache.scanMicroseconds = elapsed;
+        if (!SaveAddressCache(cachePath, cache)) LogWarn("Could not write %s", cachePath);
+    }
+    return resolved != 0;
 }
 
 // Window management
 void CenterGameWindow() {
     HWND hwnd = FindWindowA(TARGET_CLASS, NULL);
     if (!hwnd) {
-        Log("Game window not found");
+        LogWarn("Game window not found");
         return;
     }
 
@@ -179,14 +405,16 @@ void CenterGameWindow() {
     int screenWidth = GetSystemMetrics(SM_CXSCREEN);
     int screenHeight = GetSystemMetrics(SM_CYSCREEN);
 
-    int x = (screenWidth - DESIRED_WIDTH) / 2;
-    int y = (screenHeight - DESIRED_HEIGHT) / 2;
+    int targetWidth = (int)g_targetWidth;
+    int targetHeight = (int)g_targetHeight;
+    int x = (screenWidth - targetWidth) / 2;
+    int y = (screenHeight - targetHeight) / 2;
 
-    if (width != DESIRED_WIDTH || height != DESIRED_HEIGHT || rc.left != x || rc.top != y) {
-        Log("Adjusting window: %dx%d -> %dx%d at (%d,%d)",
-            width, height, DESIRED_WIDTH, DESIRED_HEIGHT, x, y);
+    if (width != targetWidth || height != targetHeight || rc.left != x || rc.top != y) {
+        LogDebug("Adjusting window: %dx%d -> %dx%d at (%d,%d)",
+            width, height, targetWidth, targetHeight, x, y);
 
-        SetWindowPos(hwnd, NULL, x, y, DESIRED_WIDTH, DESIRED_HEIGHT,
+        SetWindowPos(hwnd, NULL, x, y, targetWidth, targetHeight,
             SWP_NOZORDER | SWP_NOACTIVATE | SWP_NOOWNERZORDER);
     }
 }
@@ -197,18 +425,40 @@ VOID CALLBACK TimerProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime) {
 }
 
 void ApplyResolutionPatches() {
-    // Get absolute addresses
-    uintptr_t widthAddr = CalculatePeggleAddress(0x0055E034);
-    uintptr_t heightAddr = CalculatePeggleAddress(0x0055E038);
+    BYTE headers[0x1000];
+    PeImage image;
+    if (!ReadPeggleHeaders(headers, image)) return;
+
+    const ManifestBuild* build = SelectManifestBuild(g_manifest, g_peggleModule.c_str(),
+        image.timeDateStamp, image.sizeOfImage);
+    if (!build) {
+        LogError("No manifest entry for %s (TimeDateStamp=0x%08X SizeOfImage=0x%X)",
+            g_peggleModule.c_str(), image.timeDateStamp, image.sizeOfImage);
+        return;
+    }
+    LogInfo("Using manifest build [%s]", build->name.c_str());
 
-    if (!widthAddr || !heightAddr) {
-        Log("Failed to calculate addresses");
+    if (!ResolveManifestSites(image, *build)) {
+        LogError("Failed to calculate addresses");
         return;
     }
 
-    // Patch memory
-    PatchMemory(widthAddr, DESIRED_WIDTH);
-    PatchMemory(heightAddr, DESIRED_HEIGHT);
+    // Patch memory as one transaction: written directly when running inside
+    // the game, undone again on unload
+    Win32PatchTarget target(g_pegglePID);
+    if (target.IsOpen() && g_resolutionPatches.Apply(target)) {
+        for (const MemoryPatch& site : g_resolutionPatches.Sites()) {
+            if (site.size == sizeof(uint32_t)) {
+                uint32_t from, to;
+                memcpy(&from, site.original, sizeof(from));
+                memcpy(&to, site.bytes, sizeof(to));
+                LogInfo("Successfully patched %s at 0x%p: %d -> %d", site.name.c_str(), (void*)site.address, from, to);
+            }
+            else {
+                LogInfo("Successfully patched %s at 0x%p (%u bytes)", site.name.c_str(), (void*)site.address, site.size);
+            }
+        }
+    }
 
     // Set up periodic window centering
     SetTimer(NULL, 0, 1000, TimerProc);
@@ -216,8 +466,14 @@ void ApplyResolutionPatches() {
 
 DWORD WINAPI InitThread(LPVOID) {
     // Initialize logging
-    logFile.open("PeggleResolutionHook.log", std::ios::out | std::ios::trunc);
-    Log("==== Peggle Resolution Hook Initializing ====");
+    LogOpen("PeggleResolutionHook.log", GetLogFlags(0));
+    LogInfo("==== Peggle Resolution Hook Initializing ====");
+
+    LoadSettings();
+    if (!LoadManifest()) {
+        LogError("No usable patch manifest");
+        return 0;
+    }
 
     // Wait for Peggle to launch
     DWORD startTime = GetTickCount();
@@ -229,14 +485,14 @@ DWORD WINAPI InitThread(LPVOID) {
     }
 
     if (!g_pegglePID || !g_peggleBase) {
-        Log("Failed to locate Peggle process");
+        LogError("Failed to locate Peggle process");
         return 0;
     }
 
     // Apply patches and set up window management
     ApplyResolutionPatches();
 
-    Log("==== Hook Initialization Complete ====");
+    LogInfo("==== Hook Initialization Complete ====");
     return 0;
 }
 
@@ -247,8 +503,13 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD reason, LPVOID lpReserved) {
         if (hThread) CloseHandle(hThread);
     }
     else if (reason == DLL_PROCESS_DETACH) {
-        Log("DLL unloaded");
-        if (logFile.is_open()) logFile.close();
+        // Only on FreeLibrary; when the process is exiting there is nothing to undo
+        if (!lpReserved && g_resolutionPatches.IsApplied()) {
+            Win32PatchTarget target(g_pegglePID);
+            g_resolutionPatches.Restore(target);
+        }
+        LogInfo("DLL unloaded");
+        LogClose(lpReserved == nullptr);
     }
     return TRUE;
 }
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "pch.h"
+#include "BackgroundThrottle.h"
+#include "WindowManager.h"
+#include "../Common/HookStats.h"
+#include "../Common/Log.h"
+
+#ifndef S_PRESENT_OCCLUDED
+#define S_PRESENT_OCCLUDED ((HRESULT)0x08760868)
+#endif
+
+static DWORD g_intervalMs = 0;
+static bool g_skipMinimized = true;
+static bool g_occluded = false;
+static ULONGLONG g_lastPresent = 0;
+
+static uint32_t g_inactiveStats = HOOK_STATS_NONE;
+static uint32_t g_minimizedStats = HOOK_STATS_NONE;
+
+// The spell of the current activity state, for the log
+static WindowActivity g_activity = WINDOW_ACTIVE;
+static ULONGLONG g_spellStart = 0;
+static ULONGLONG g_spellCpuStart = 0;
+static ULONGLONG g_spellHeldMs = 0;
+
+static const char* ActivityName(WindowActivity activity) {
+    switch (activity) {
+    case WINDOW_ACTIVE: return "active";
+    case WINDOW_INACTIVE: return "inactive";
+    case WINDOW_MINIMIZED: return "minimized";
+    }
+    return "?";
+}
+
+// Kernel plus user time of the whole process, in milliseconds
+static ULONGLONG ProcessCpuMs() {
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) return 0;
+
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) / 10000;
+}
+
+static void ChangeActivity(WindowActivity activity) {
+    ULONGLONG now = GetTickCount64();
+    ULONGLONG cpu = ProcessCpuMs();
+
+    if (g_spellStart) {
+        ULONGLONG elapsed = now - g_spellStart;
+        double load = elapsed ? 100.0 * (double)(cpu - g_spellCpuStart) / (double)elapsed : 0.0;
+        LogInfo("Window %s for %.1f s: process CPU %.1f%% of one core, render thread held %.1f s",
+            ActivityName(g_activity), elapsed / 1000.0, load, g_spellHeldMs / 1000.0);
+    }
+
+    g_activity = activity;
+    g_spellStart = now;
+    g_spellCpuStart = cpu;
+    g_spellHeldMs = 0;
+}
+
+void BackgroundThrottleConfigure(UINT backgroundFps, bool skipMinimized) {
+    g_intervalMs = backgroundFps ? 1000 / backgroundFps : 0;
+    g_skipMinimized = skipMinimized;
+    if (!g_intervalMs) return;
+
+    g_inactiveStats = HookStatsRegister("Throttle: inactive");
+    g_minimizedStats = HookStatsRegister("Throttle: minimized");
+    LogInfo("Background throttling at %u fps%s", backgroundFps,
+        skipMinimized ? ", presents dropped while minimized" : "");
+}
+
+bool BackgroundThrottleWait() {
+    if (!g_intervalMs) return false;
+
+    WindowActivity activity = WindowManagerGetActivity();
+    bool occluded = activity == WINDOW_ACTIVE && g_occluded;
+    if (occluded) activity = WINDOW_INACTIVE;
+    if (activity != g_activity || !g_spellStart) ChangeActivity(activity);
+    if (activity == WINDOW_ACTIVE) return false;
+
+    bool skip = activity == WINDOW_MINIMIZED && g_skipMinimized;
+
+    ULONGLONG now = GetTickCount64();
+    ULONGLONG due = g_lastPresent + g_intervalMs;
+    if (now < due) {
+        uint64_t start = HookStatsNow();
+        if (occluded) {
+            // Active but hidden: nothing to be woken by
+            Sleep((DWORD)(due - now));
+        }
+        else {
+            WindowManagerWaitForActivity((DWORD)(due - now));
+        }
+        HookStatsRecord(activity == WINDOW_MINIMIZED ? g_minimizedStats : g_inactiveStats,
+            HookStatsNow() - start);
+        g_spellHeldMs += GetTickCount64() - now;
+    }
+    g_lastPresent = GetTickCount64();
+    return skip;
+}
+
+void BackgroundThrottleRecordPresent(HRESULT hr) {
+    g_occluded = hr == S_PRESENT_OCCLUDED;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <Windows.h>
+
+// Throttling of the game while its window is in the background.
+//
+// While the window is inactive, or Direct3D reports it occluded, presents are
+// held to a low rate; while it is minimized they can be dropped altogether,
+// the render thread still waking at that rate so the game loop does not spin.
+// Waits end as soon as the window is activated or restored (see
+// WindowManagerWaitForActivity), so the next frame is back at full rate.
+//
+// The time the render thread is held back is recorded in the hook statistics
+// under "Throttle: inactive" and "Throttle: minimized", and the process CPU use
+// of each background and foreground spell is logged when it ends.
+
+// backgroundFps 0 turns throttling off.
+void BackgroundThrottleConfigure(UINT backgroundFps, bool skipMinimized);
+
+// Call from the Present hook before presenting. Returns true if the present
+// should be dropped.
+bool BackgroundThrottleWait();
+
+// Result of the original Present; S_PRESENT_OCCLUDED throttles until a
+// present succeeds again.
+void BackgroundThrottleRecordPresent(HRESULT hr);
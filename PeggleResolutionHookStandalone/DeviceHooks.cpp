@@ -0,0 +1,273 @@
+#include "pch.h"
+#include "DeviceHooks.h"
+#include <cstdint>
+#include <cstring>
+#include "BackgroundThrottle.h"
+#include "WindowManager.h"
+#include "../Common/ComHook.h"
+#include "../Common/FrameClockWin32.h"
+#include "../Common/FrameStats.h"
+#include "../Common/HookRegistry.h"
+#include "../Common/Log.h"
+
+// Configuration
+constexpr DWORD DEFAULT_WIDTH = 1280;  // client area without Width/Height in the ini
+constexpr DWORD DEFAULT_HEIGHT = 960;
+
+// Global variables
+IDirect3DDevice9* pDevice = nullptr;
+static D3DPRESENT_PARAMETERS g_pp = {};  // as the game last asked, before ForceDesiredResolution
+static bool g_viewportSet = false;
+
+// Backbuffer size, and where Present puts it in the client area when it is
+// letterboxed (see ConfigureLetterbox)
+static DWORD g_backBufferWidth = 0;
+static DWORD g_backBufferHeight = 0;
+static RECT g_imageRect = {};
+static bool g_letterboxed = false;
+
+// PeggleResolution.ini, next to the game executable
+void GetConfigPath(char (&path)[MAX_PATH]) {
+    GetModuleFileNameA(nullptr, path, MAX_PATH);
+    char* fileName = strrchr(path, '\\');
+    fileName = fileName ? fileName + 1 : path;
+    strcpy_s(fileName, MAX_PATH - (fileName - path), "PeggleResolution.ini");
+}
+
+ClientSize LoadClientSize() {
+    char path[MAX_PATH];
+    GetConfigPath(path);
+
+    ClientSize size;
+    size.width = GetPrivateProfileIntA("Settings", "Width", DEFAULT_WIDTH, path);
+    size.height = GetPrivateProfileIntA("Settings", "Height", DEFAULT_HEIGHT, path);
+    if (!size.width || !size.height) {
+        size.width = DEFAULT_WIDTH;
+        size.height = DEFAULT_HEIGHT;
+    }
+    LogInfo("Client area %ux%u", size.width, size.height);
+    return size;
+}
+
+// Width x Height is the client area the game is shown in. Read by whichever
+// of the init thread and the render thread gets here first.
+const ClientSize& DesiredClientSize() {
+    static const ClientSize size = LoadClientSize();
+    return size;
+}
+
+// FrameCap=<fps> limits the frame rate in the Present hook; 0 (the default)
+// leaves it to the game. Returns nullptr when there is no cap.
+FramePacer* CreateFramePacer() {
+    char path[MAX_PATH];
+    GetConfigPath(path);
+
+    UINT cap = GetPrivateProfileIntA("Settings", "FrameCap", 0, path);
+    if (!cap) return nullptr;
+
+    // Lives until the process exits, like the hooks that use it
+    Win32FrameClock* clock = new Win32FrameClock();
+    FramePacer* pacer = new FramePacer(*clock);
+    pacer->SetFrameRate(cap);
+    LogInfo("Frame rate capped at %u fps (%s timer)", cap,
+        clock->IsHighResolution() ? "high resolution" : "1 ms");
+    return pacer;
+}
+
+// Created on the render thread by the first Present
+void LimitFrameRate() {
+    static FramePacer* pacer = CreateFramePacer();
+    if (pacer) pacer->Wait();
+}
+
+// BackgroundFps=<fps> (default 10, 0 = off) is the frame rate while the game
+// window is in the background; SkipMinimized=1 (the default) drops presents
+// entirely while it is minimized
+bool ConfigureBackgroundThrottle() {
+    char path[MAX_PATH];
+    GetConfigPath(path);
+
+    UINT fps = GetPrivateProfileIntA("Settings", "BackgroundFps", 10, path);
+    bool skipMinimized = GetPrivateProfileIntA("Settings", "SkipMinimized", 1, path) != 0;
+    BackgroundThrottleConfigure(fps, skipMinimized);
+    return fps != 0;
+}
+
+// Configured on the render thread by the first Present. Returns true if the
+// present should be dropped.
+bool ThrottleInBackground() {
+    static bool enabled = ConfigureBackgroundThrottle();
+    return enabled && BackgroundThrottleWait();
+}
+
+// Letterbox=1 keeps the game's aspect ratio instead of stretching its frame
+// over the window: the backbuffer becomes the largest size of that aspect
+// that fits the client area and is presented 1:1 into the middle of it, and
+// the window procedure paints the bars around it black
+bool ConfigureLetterbox() {
+    char path[MAX_PATH];
+    GetConfigPath(path);
+
+    bool enabled = GetPrivateProfileIntA("Settings", "Letterbox", 0, path) != 0;
+    if (enabled) LogInfo("Letterboxing to the game's aspect ratio");
+    return enabled;
+}
+
+// Largest size with the aspect ratio of width x height that fits client
+void FitAspect(DWORD width, DWORD height, const ClientSize& client, DWORD& fitWidth, DWORD& fitHeight) {
+    fitWidth = client.width;
+    fitHeight = (DWORD)(((uint64_t)client.width * height + width / 2) / width);
+    if (fitHeight > client.height) {
+        fitHeight = client.height;
+        fitWidth = (DWORD)(((uint64_t)client.height * width + height / 2) / height);
+    }
+}
+
+// The hooks below are ComHook handlers (see ComHook.h): the thunks call
+// Pre/Post around the original method, so the handlers only hold our logic
+// and can be driven by any object with the interface's vtable layout.
+
+// Called with the parameters as the game asked for them. The destination
+// rect is only worked out here, so presenting costs nothing more per frame.
+void ForceDesiredResolution(D3DPRESENT_PARAMETERS* params) {
+    static bool letterbox = ConfigureLetterbox();
+    const ClientSize& client = DesiredClientSize();
+
+    // A size of 0 is the window's, which has no aspect ratio of its own
+    DWORD width = client.width;
+    DWORD height = client.height;
+    if (letterbox && params->BackBufferWidth && params->BackBufferHeight) {
+        FitAspect(params->BackBufferWidth, params->BackBufferHeight, client, width, height);
+    }
+
+    if (width != g_backBufferWidth || height != g_backBufferHeight) {
+        g_backBufferWidth = width;
+        g_backBufferHeight = height;
+        LONG left = (LONG)(client.width - width) / 2;
+        LONG top = (LONG)(client.height - height) / 2;
+        SetRect(&g_imageRect, left, top, left + (LONG)width, top + (LONG)height);
+        g_letterboxed = width != client.width || height != client.height;
+        WindowManagerSetImageRect(g_imageRect);
+        LogInfo("Backbuffer %ux%u at (%d,%d) for a %ux%u frame", width, height, left, top,
+            params->BackBufferWidth, params->BackBufferHeight);
+    }
+
+    params->BackBufferWidth = width;
+    params->BackBufferHeight = height;
+    params->Windowed = TRUE;
+}
+
+// Direct3D hook to modify presentation parameters and time frames
+struct PresentHandler : ComHookHandler {
+    template <typename... Rest>
+    static bool Skip(HRESULT& hr, IDirect3DDevice9*, Rest&...) {
+        hr = D3D_OK;
+        return ThrottleInBackground();
+    }
+
+    static void Pre(IDirect3DDevice9* device, const RECT*&, const RECT*& destRect, HWND&, const RGNDATA*&) {
+        if (device && !g_viewportSet) {
+            D3DVIEWPORT9 vp;
+            vp.X = 0;
+            vp.Y = 0;
+            vp.Width = g_backBufferWidth;
+            vp.Height = g_backBufferHeight;
+            vp.MinZ = 0.0f;
+            vp.MaxZ = 1.0f;
+
+            device->SetViewport(&vp);
+            LogDebug("Custom viewport applied %dx%d", vp.Width, vp.Height);
+            g_viewportSet = true;
+        }
+
+        // Geometry changes are detected by the window subclass; the Reset itself
+        // is issued here, on the render thread, at most once per change.
+        if (device && WindowManagerTakeResetRequest()) {
+            D3DPRESENT_PARAMETERS pp = g_pp;
+            HRESULT result = device->Reset(&pp);
+            if (SUCCEEDED(result)) {
+                WindowManagerRecordReset();
+                LogInfo("Reset issued after window geometry change");
+            }
+            else {
+                LogError("Reset after window geometry change failed: 0x%X", result);
+            }
+        }
+
+        if (g_letterboxed && !destRect) destRect = &g_imageRect;
+
+        LimitFrameRate();
+        FrameStatsPresentBegin();
+    }
+
+    template <typename... Rest>
+    static void Post(HRESULT& hr, IDirect3DDevice9*, Rest&...) {
+        FrameStatsPresentEnd();
+        BackgroundThrottleRecordPresent(hr);
+    }
+};
+
+// Direct3D hook to handle device reset
+struct ResetHandler : ComHookHandler {
+    static void Pre(IDirect3DDevice9*, D3DPRESENT_PARAMETERS*& pPresentationParameters) {
+        LogDebug("Reset called - modifying resolution");
+        g_pp = *pPresentationParameters;
+        ForceDesiredResolution(pPresentationParameters);
+
+        // Reset sets the viewport back to the whole backbuffer, whose size
+        // may have changed
+        g_viewportSet = false;
+    }
+
+    static void Post(HRESULT& hr, IDirect3DDevice9*, D3DPRESENT_PARAMETERS*&) {
+        if (SUCCEEDED(hr)) {
+            LogDebug("Resolution set to %dx%d", g_backBufferWidth, g_backBufferHeight);
+        }
+        else {
+            LogError("Reset failed: 0x%X", hr);
+        }
+    }
+};
+
+typedef ComHook<COM_METHOD(IDirect3DDevice9, Present), PresentHandler> PresentHook;
+typedef ComHook<COM_METHOD(IDirect3DDevice9, Reset), ResetHandler> ResetHook;
+
+// Hook for device creation
+struct CreateDeviceHandler : ComHookHandler {
+    static void Pre(IDirect3D9*, UINT&, D3DDEVTYPE&, HWND& hFocusWindow, DWORD&,
+        D3DPRESENT_PARAMETERS*& pPresentationParameters, IDirect3DDevice9**&) {
+        LogDebug("CreateDevice called - modifying resolution");
+
+        g_pp = *pPresentationParameters;
+        ForceDesiredResolution(pPresentationParameters);
+
+        HWND hwnd = pPresentationParameters->hDeviceWindow ? pPresentationParameters->hDeviceWindow : hFocusWindow;
+        WindowManagerAttach(hwnd, DesiredClientSize().width, DesiredClientSize().height);
+    }
+
+    static void Post(HRESULT& hr, IDirect3D9*, UINT&, D3DDEVTYPE&, HWND&, DWORD&,
+        D3DPRESENT_PARAMETERS*&, IDirect3DDevice9**& ppReturnedDeviceInterface) {
+        if (FAILED(hr)) {
+            LogError("CreateDevice failed: 0x%X", hr);
+            return;
+        }
+
+        LogInfo("Device created at %dx%d", g_backBufferWidth, g_backBufferHeight);
+        pDevice = *ppReturnedDeviceInterface;
+        g_viewportSet = false;
+
+        // Hook Reset and Present functions; a recreated device shares the
+        // vtable, so they are only queued the first time
+        ResetHook::Request("IDirect3DDevice9::Reset", pDevice);
+        PresentHook::Request("IDirect3DDevice9::Present", pDevice);
+        if (HookCommit()) {
+            LogInfo("Device hooks installed");
+        }
+    }
+};
+
+typedef ComHook<COM_METHOD(IDirect3D9, CreateDevice), CreateDeviceHandler> CreateDeviceHook;
+
+bool RequestCreateDeviceHook(IDirect3D9* d3d) {
+    return CreateDeviceHook::Request("IDirect3D9::CreateDevice", d3d);
+}
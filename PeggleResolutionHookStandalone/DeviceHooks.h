@@ -0,0 +1,31 @@
+#pragma once
+#include <Windows.h>
+#include <d3d9.h>
+
+// Direct3D 9 hooks of the standalone hook.
+//
+// IDirect3D9::CreateDevice, and Reset and Present of the device it creates,
+// are ComHook handlers (see ComHook.h). They force the backbuffer to the
+// configured client area (letterboxed to the game's aspect ratio with
+// Letterbox=1), keep the viewport covering it, issue the Reset the window
+// manager asks for, and cap, throttle and time the frames in Present.
+//
+// The hooks only reach Direct3D through the interfaces they are handed, so
+// the Linux tests drive them with mock devices (tests/mock).
+
+// PeggleResolution.ini, next to the game executable
+void GetConfigPath(char (&path)[MAX_PATH]);
+
+struct ClientSize {
+    DWORD width;
+    DWORD height;
+};
+
+// Width x Height from the ini, read once: the client area the game is
+// shown in
+const ClientSize& DesiredClientSize();
+
+// Queue the hook of d3d's CreateDevice for the next HookCommit. The device
+// it creates gets its Reset and Present hooked in turn. Returns false if it
+// was already requested.
+bool RequestCreateDeviceHook(IDirect3D9* d3d);
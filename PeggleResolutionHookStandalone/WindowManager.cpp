@@ -0,0 +1,322 @@
+#include "pch.h"
+#include "WindowManager.h"
+#include "../Common/Log.h"
+#include <atomic>
+
+// Posted to ourselves so a burst of change messages is handled once
+constexpr UINT WM_PEGGLE_ENFORCE_GEOMETRY = WM_APP + 0x50;
+constexpr ULONGLONG RESET_REPORT_INTERVAL_MS = 60000;
+
+// Attach and detach run on the init thread and the render thread, and are
+// serialised by g_attachLock. The window procedure only reads the two
+// pointers, which are published before the subclass is installed.
+static SRWLOCK g_attachLock = SRWLOCK_INIT;
+static std::atomic<HWND> g_hwnd{ nullptr };
+static std::atomic<WNDPROC> g_originalWndProc{ nullptr };
+static DWORD g_clientWidth = 0;
+static DWORD g_clientHeight = 0;
+
+static std::atomic<bool> g_enforcePending{ false };
+static std::atomic<bool> g_resetPending{ false };
+static std::atomic<bool> g_inSetWindowPos{ false };
+
+// Activity, written by the window procedure and read by the render thread.
+// The event is signaled when the window becomes active or is restored; it is
+// kept for the life of the process since a waiter may hold it at any time.
+static std::atomic<bool> g_foreground{ true };
+static std::atomic<bool> g_minimized{ false };
+static HANDLE g_activityEvent = nullptr;
+
+// Where the frame is presented; the rest of the client area is the bars.
+// Written by the render thread, read by the window procedure.
+static SRWLOCK g_imageLock = SRWLOCK_INIT;
+static RECT g_imageRect = {};
+
+// Reset statistics
+static std::atomic<LONG> g_resetsThisInterval{ 0 };
+static LONG g_resetsTotal = 0;
+static ULONGLONG g_intervalStart = 0;
+
+// Compute the centered window rect that gives the desired client area
+static RECT ComputeDesiredWindowRect(HWND hwnd) {
+    LONG style = GetWindowLongW(hwnd, GWL_STYLE);
+    LONG exStyle = GetWindowLongW(hwnd, GWL_EXSTYLE);
+
+    RECT rc = { 0, 0, (LONG)g_clientWidth, (LONG)g_clientHeight };
+    AdjustWindowRectEx(&rc, style, FALSE, exStyle);
+
+    int width = rc.right - rc.left;
+    int height = rc.bottom - rc.top;
+
+    int screenWidth = GetSystemMetrics(SM_CXSCREEN);
+    int screenHeight = GetSystemMetrics(SM_CYSCREEN);
+
+    int x = (screenWidth - width) / 2;
+    int y = (screenHeight - height) / 2;
+
+    return { x, y, x + width, y + height };
+}
+
+// Bring the window to the desired geometry. Only touches the window, and only
+// requests a Reset, when the geometry actually differs.
+static void EnforceGeometry() {
+    g_enforcePending = false;
+    HWND hwnd = g_hwnd;
+    if (!hwnd || IsIconic(hwnd)) return;
+
+    RECT client;
+    GetClientRect(hwnd, &client);
+    bool clientMatches = (DWORD)(client.right - client.left) == g_clientWidth &&
+        (DWORD)(client.bottom - client.top) == g_clientHeight;
+
+    RECT current;
+    GetWindowRect(hwnd, &current);
+    RECT desired = ComputeDesiredWindowRect(hwnd);
+
+    if (clientMatches && EqualRect(&current, &desired)) return;
+
+    LogDebug("Adjusting window: client %dx%d -> %dx%d at (%d,%d)",
+        client.right - client.left, client.bottom - client.top,
+        g_clientWidth, g_clientHeight, desired.left, desired.top);
+
+    g_inSetWindowPos = true;
+    SetWindowPos(hwnd, NULL, desired.left, desired.top,
+        desired.right - desired.left, desired.bottom - desired.top,
+        SWP_NOZORDER | SWP_NOACTIVATE | SWP_FRAMECHANGED);
+    g_inSetWindowPos = false;
+
+    // The backbuffer only needs rebuilding when the client area changed
+    if (!clientMatches) {
+        g_resetPending = true;
+    }
+}
+
+// The client area outside the image, or nullptr if there is none
+static HRGN CreateBarsRegion(HWND hwnd) {
+    RECT image;
+    AcquireSRWLockShared(&g_imageLock);
+    image = g_imageRect;
+    ReleaseSRWLockShared(&g_imageLock);
+
+    RECT client;
+    if (IsRectEmpty(&image) || !GetClientRect(hwnd, &client)) return nullptr;
+
+    HRGN bars = CreateRectRgnIndirect(&client);
+    HRGN inside = CreateRectRgnIndirect(&image);
+    int kind = CombineRgn(bars, bars, inside, RGN_DIFF);
+    DeleteObject(inside);
+    if (kind == NULLREGION || kind == ERROR) {
+        DeleteObject(bars);
+        return nullptr;
+    }
+    return bars;
+}
+
+static void PaintBars(HWND hwnd) {
+    HRGN bars = CreateBarsRegion(hwnd);
+    if (!bars) return;
+
+    HDC dc = GetDC(hwnd);
+    if (dc) {
+        FillRgn(dc, bars, (HBRUSH)GetStockObject(BLACK_BRUSH));
+        ReleaseDC(hwnd, dc);
+    }
+    DeleteObject(bars);
+}
+
+static void InvalidateBars(HWND hwnd) {
+    HRGN bars = CreateBarsRegion(hwnd);
+    if (!bars) return;
+
+    InvalidateRgn(hwnd, bars, FALSE);
+    DeleteObject(bars);
+}
+
+static void ScheduleEnforce() {
+    if (g_inSetWindowPos) return;
+    if (!g_enforcePending.exchange(true)) {
+        PostMessageW(g_hwnd, WM_PEGGLE_ENFORCE_GEOMETRY, 0, 0);
+    }
+}
+
+static LRESULT CALLBACK SubclassWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    switch (msg) {
+    case WM_PEGGLE_ENFORCE_GEOMETRY:
+        EnforceGeometry();
+        return 0;
+
+    case WM_WINDOWPOSCHANGED: {
+        const WINDOWPOS* wp = reinterpret_cast<const WINDOWPOS*>(lParam);
+        if ((wp->flags & (SWP_NOSIZE | SWP_NOMOVE)) != (SWP_NOSIZE | SWP_NOMOVE) ||
+            (wp->flags & SWP_FRAMECHANGED)) {
+            ScheduleEnforce();
+        }
+        break;
+    }
+
+    case WM_ACTIVATEAPP:
+        g_foreground = wParam != FALSE;
+        if (wParam) SetEvent(g_activityEvent);
+        break;
+
+    case WM_SIZE:
+        g_minimized = wParam == SIZE_MINIMIZED;
+        if (wParam != SIZE_MINIMIZED) SetEvent(g_activityEvent);
+        break;
+
+    case WM_STYLECHANGED:
+    case WM_DISPLAYCHANGE:
+        ScheduleEnforce();
+        break;
+
+    case WM_PAINT: {
+        // Whatever the game paints, the bars end up black
+        LRESULT result = CallWindowProcW(g_originalWndProc, hwnd, msg, wParam, lParam);
+        PaintBars(hwnd);
+        return result;
+    }
+
+    case WM_NCDESTROY: {
+        // No lock here: an attach on another thread may be waiting on this
+        // thread inside SetWindowPos
+        WNDPROC original = g_originalWndProc.exchange(nullptr);
+        SetWindowLongPtrW(hwnd, GWLP_WNDPROC, (LONG_PTR)original);
+        g_hwnd = nullptr;
+        return CallWindowProcW(original, hwnd, msg, wParam, lParam);
+    }
+    }
+
+    return CallWindowProcW(g_originalWndProc, hwnd, msg, wParam, lParam);
+}
+
+// Restore the original window procedure. Called with g_attachLock held.
+static void DetachLocked() {
+    HWND hwnd = g_hwnd;
+    if (!hwnd) return;
+
+    if (GetWindowLongPtrW(hwnd, GWLP_WNDPROC) == (LONG_PTR)SubclassWndProc) {
+        SetWindowLongPtrW(hwnd, GWLP_WNDPROC, (LONG_PTR)g_originalWndProc.load());
+    }
+    g_hwnd = nullptr;
+    g_originalWndProc = nullptr;
+}
+
+bool WindowManagerAttach(HWND hwnd, DWORD clientWidth, DWORD clientHeight) {
+    if (!hwnd) return false;
+
+    AcquireSRWLockExclusive(&g_attachLock);
+    g_clientWidth = clientWidth;
+    g_clientHeight = clientHeight;
+
+    if (g_hwnd == hwnd) {
+        ReleaseSRWLockExclusive(&g_attachLock);
+        return true;
+    }
+    DetachLocked();
+
+    // The original procedure has to be in place before the subclass can
+    // receive its first message
+    WNDPROC original = (WNDPROC)GetWindowLongPtrW(hwnd, GWLP_WNDPROC);
+    if (!original || original == SubclassWndProc) {
+        ReleaseSRWLockExclusive(&g_attachLock);
+        LogError("Failed to subclass game window: %d", GetLastError());
+        return false;
+    }
+    g_originalWndProc = original;
+
+    WNDPROC replaced = (WNDPROC)SetWindowLongPtrW(hwnd, GWLP_WNDPROC, (LONG_PTR)SubclassWndProc);
+    if (!replaced) {
+        g_originalWndProc = nullptr;
+        ReleaseSRWLockExclusive(&g_attachLock);
+        LogError("Failed to subclass game window: %d", GetLastError());
+        return false;
+    }
+    // Someone else subclassed the window in between; chain to them instead
+    if (replaced != original) {
+        g_originalWndProc = replaced;
+    }
+
+    if (!g_activityEvent) {
+        g_activityEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    }
+    g_foreground = GetForegroundWindow() == hwnd;
+    g_minimized = IsIconic(hwnd) != FALSE;
+
+    g_hwnd = hwnd;
+    g_intervalStart = GetTickCount64();
+    ReleaseSRWLockExclusive(&g_attachLock);
+    LogInfo("Game window subclassed");
+
+    // The device is created (or was already reset) at the desired size, so the
+    // initial adjustment never needs a Reset of its own
+    EnforceGeometry();
+    g_resetPending = false;
+    InvalidateBars(hwnd);
+    return true;
+}
+
+void WindowManagerDetach() {
+    AcquireSRWLockExclusive(&g_attachLock);
+    DetachLocked();
+    ReleaseSRWLockExclusive(&g_attachLock);
+}
+
+HWND WindowManagerGetWindow() {
+    return g_hwnd;
+}
+
+void WindowManagerSetImageRect(const RECT& image) {
+    AcquireSRWLockExclusive(&g_imageLock);
+    g_imageRect = image;
+    ReleaseSRWLockExclusive(&g_imageLock);
+
+    // Only the bars are repainted; Present covers the image
+    HWND hwnd = g_hwnd;
+    if (hwnd) InvalidateBars(hwnd);
+}
+
+bool WindowManagerTakeResetRequest() {
+    ULONGLONG now = GetTickCount64();
+    if (g_intervalStart && now - g_intervalStart >= RESET_REPORT_INTERVAL_MS) {
+        LONG resets = g_resetsThisInterval.exchange(0);
+        LogInfo("Device resets issued in the last minute: %d (total %d)", resets, g_resetsTotal);
+        g_intervalStart = now;
+    }
+
+    if (!g_resetPending.load(std::memory_order_relaxed)) return false;
+    return g_resetPending.exchange(false);
+}
+
+void WindowManagerRecordReset() {
+    g_resetsThisInterval++;
+    g_resetsTotal++;
+}
+
+WindowActivity WindowManagerGetActivity() {
+    if (!g_hwnd) return WINDOW_ACTIVE;
+    if (g_minimized.load(std::memory_order_relaxed)) return WINDOW_MINIMIZED;
+    return g_foreground.load(std::memory_order_relaxed) ? WINDOW_ACTIVE : WINDOW_INACTIVE;
+}
+
+bool WindowManagerWaitForActivity(DWORD timeoutMs) {
+    ULONGLONG deadline = GetTickCount64() + timeoutMs;
+
+    for (;;) {
+        if (WindowManagerGetActivity() == WINDOW_ACTIVE) return true;
+
+        ULONGLONG now = GetTickCount64();
+        if (now >= deadline) return false;
+
+        // Activation reaches a window on the calling thread as a sent message,
+        // which has to be dispatched before the state above changes
+        DWORD result = MsgWaitForMultipleObjects(g_activityEvent ? 1 : 0, &g_activityEvent, FALSE,
+            (DWORD)(deadline - now), QS_SENDMESSAGE);
+        if (result == WAIT_FAILED) {
+            Sleep((DWORD)(deadline - now));
+        }
+        else if (result == WAIT_OBJECT_0 + (g_activityEvent ? 1 : 0)) {
+            MSG msg;
+            PeekMessageW(&msg, nullptr, 0, 0, PM_NOREMOVE | PM_QS_SENDMESSAGE);
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <Windows.h>
+
+// Event-driven window management for the game window.
+//
+// The game window is subclassed once and only real size/position/style changes
+// are acted on. Bursts of change messages are coalesced into a single posted
+// message, and at most one device Reset is requested per actual geometry change.
+// The subclass also follows activation and minimizing, for background throttling,
+// and paints the letterbox bars around the presented frame.
+
+enum WindowActivity {
+    WINDOW_ACTIVE,
+    WINDOW_INACTIVE,   // another application has the focus
+    WINDOW_MINIMIZED,
+};
+
+// Subclass the game window and bring it to the desired client size.
+bool WindowManagerAttach(HWND hwnd, DWORD clientWidth, DWORD clientHeight);
+
+// Restore the original window procedure if it is still ours.
+void WindowManagerDetach();
+
+HWND WindowManagerGetWindow();
+
+// Part of the client area Present draws the frame into. The rest is painted
+// black by the window procedure: now, and whenever the window is repainted,
+// never per frame. The whole client area (the default) paints nothing.
+void WindowManagerSetImageRect(const RECT& image);
+
+// Called from the render thread before each Present. Returns true once per
+// geometry change; the caller is expected to Reset the device and then call
+// WindowManagerRecordReset().
+bool WindowManagerTakeResetRequest();
+
+// Count a device Reset issued by the hook. The rate is logged once a minute so
+// steady state can be verified to be zero.
+void WindowManagerRecordReset();
+
+// WINDOW_ACTIVE until a window is attached.
+WindowActivity WindowManagerGetActivity();
+
+// Block for up to timeoutMs, returning early once the window is activated or
+// restored. Messages sent to the calling thread meanwhile are dispatched, so
+// this also works on the thread that owns the window. Returns true if the
+// window is active.
+bool WindowManagerWaitForActivity(DWORD timeoutMs);
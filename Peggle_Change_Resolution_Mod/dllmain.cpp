@@ -2,9 +2,10 @@
 #include <Windows.h>
 #include <ddraw.h>
 #include <shlwapi.h>
-#include <detours.h>
-#include <fstream>
 #include <ctime>
+#include "../Common/ComHook.h"
+#include "../Common/HookRegistry.h"
+#include "../Common/Log.h"
 
 const GUID IID_IDirectDraw7 = {
     0x15e65ec0, 0x3b9c, 0x11d2,
@@ -19,7 +20,6 @@ UINT g_TargetWidth = 1280;
 UINT g_TargetHeight = 720;
 bool g_Enabled = true;
 
-std::ofstream g_LogFile;
 bool g_LogInitialized = false;
 
 void InitializeLog() {
@@ -30,38 +30,30 @@ void InitializeLog() {
     PathRemoveFileSpecA(logPath);
     PathCombineA(logPath, logPath, "PeggleResolution.log");
 
-    g_LogFile.open(logPath, std::ios::out | std::ios::trunc);
-    if (g_LogFile.is_open()) {
+    // Binary logging defers all formatting to PeggleLogDecoder
+    char iniPath[MAX_PATH];
+    GetModuleFileNameA(nullptr, iniPath, MAX_PATH);
+    PathRemoveFileSpecA(iniPath);
+    PathCombineA(iniPath, iniPath, "PeggleResolution.ini");
+
+    unsigned flags = LOG_DEBUG_OUTPUT;
+    if (GetPrivateProfileIntA("Settings", "BinaryLog", 0, iniPath)) {
+        flags |= LOG_BINARY;
+    }
+
+    if (LogOpen(logPath, flags)) {
         time_t now = time(nullptr);
         char timeStr[26];
         ctime_s(timeStr, sizeof(timeStr), &now);
-        g_LogFile << "===== Log Started: " << timeStr;
-        g_LogFile.flush();
-        g_LogInitialized = true;
+        timeStr[24] = '\0';
+        LogInfo("===== Log Started: %s", timeStr);
     }
-}
-
-void Log(const char* format, ...) {
-    if (!g_LogInitialized) InitializeLog();
-    if (!g_LogFile.is_open()) return;
-
-    char buffer[512];
-    va_list args;
-    va_start(args, format);
-    vsprintf_s(buffer, sizeof(buffer), format, args);
-    va_end(args);
-
-    g_LogFile << buffer << std::endl;
-    g_LogFile.flush();
-    OutputDebugStringA(buffer);
-    OutputDebugStringA("\n");
+    g_LogInitialized = true;
 }
 
 typedef HRESULT(WINAPI* DirectDrawCreate_t)(GUID*, LPDIRECTDRAW*, IUnknown*);
-typedef HRESULT(STDMETHODCALLTYPE* SetDisplayMode_t)(LPDIRECTDRAW7, DWORD, DWORD, DWORD);
 
 DirectDrawCreate_t Original_DirectDrawCreate = nullptr;
-SetDisplayMode_t Original_SetDisplayMode = nullptr;
 
 void LoadConfig() {
     char path[MAX_PATH];
@@ -73,67 +65,73 @@ void LoadConfig() {
     g_TargetHeight = GetPrivateProfileIntA("Settings", "Height", 720, path);
     g_Enabled = GetPrivateProfileIntA("Settings", "Enabled", 1, path) != 0;
 
-    Log("Config loaded: %dx%d, Enabled=%d", g_TargetWidth, g_TargetHeight, g_Enabled);
+    LogInfo("Config loaded: %dx%d, Enabled=%d", g_TargetWidth, g_TargetHeight, g_Enabled);
 }
 
-HRESULT STDMETHODCALLTYPE Hooked_SetDisplayMode(
-    LPDIRECTDRAW7 pDD,
-    DWORD width,
-    DWORD height,
-    DWORD bpp
-) {
-    Log("SetDisplayMode called: %dx%d", width, height);
+// Replace the mode the game asks for with the configured one
+void OverrideDisplayMode(DWORD& width, DWORD& height) {
+    LogDebug("SetDisplayMode called: %dx%d", width, height);
+    if (!g_Enabled) return;
 
-    if (g_Enabled) {
-        Log("Overriding resolution to %dx%d", g_TargetWidth, g_TargetHeight);
+    LogDebug("Overriding resolution to %dx%d", g_TargetWidth, g_TargetHeight);
+    width = g_TargetWidth;
+    height = g_TargetHeight;
+}
 
-        HRESULT hr = Original_SetDisplayMode(pDD, g_TargetWidth, g_TargetHeight, bpp);
+void ResizeGameWindow() {
+    HWND hwnd = GetForegroundWindow();
+    if (hwnd) {
+        SetWindowPos(hwnd, NULL, 0, 0, g_TargetWidth, g_TargetHeight,
+            SWP_NOZORDER | SWP_NOACTIVATE);
+        LogDebug("Window resized manually");
+    }
+}
 
-        HWND hwnd = GetForegroundWindow();
-        if (hwnd) {
-            SetWindowPos(hwnd, NULL, 0, 0, g_TargetWidth, g_TargetHeight,
-                SWP_NOZORDER | SWP_NOACTIVATE);
-            Log("Window resized manually");
-        }
+// IDirectDraw::SetDisplayMode(width, height, bpp) and
+// IDirectDraw7::SetDisplayMode(width, height, bpp, refreshRate, flags)
+struct SetDisplayModeHandler : ComHookHandler {
+    template <typename DirectDraw, typename... Rest>
+    static void Pre(DirectDraw*, DWORD& width, DWORD& height, Rest&...) {
+        OverrideDisplayMode(width, height);
+    }
 
-        return hr;
+    template <typename DirectDraw, typename... Rest>
+    static void Post(HRESULT&, DirectDraw*, Rest&...) {
+        if (g_Enabled) ResizeGameWindow();
     }
+};
 
-    return Original_SetDisplayMode(pDD, width, height, bpp);
-}
+typedef ComHook<COM_METHOD(IDirectDraw, SetDisplayMode), SetDisplayModeHandler> SetDisplayModeHook;
+typedef ComHook<COM_METHOD(IDirectDraw7, SetDisplayMode), SetDisplayModeHandler> SetDisplayMode7Hook;
 
 HRESULT WINAPI Hooked_DirectDrawCreate(
     GUID* lpGUID,
     LPDIRECTDRAW* lplpDD,
     IUnknown* pUnkOuter
 ) {
-    Log("DirectDrawCreate called");
+    LogDebug("DirectDrawCreate called");
 
     HRESULT hr = Original_DirectDrawCreate(lpGUID, lplpDD, pUnkOuter);
     if (FAILED(hr)) {
-        Log("DirectDrawCreate failed: 0x%X", hr);
+        LogError("DirectDrawCreate failed: 0x%X", hr);
         return hr;
     }
 
+    // Games using the original interface call IDirectDraw::SetDisplayMode
+    if (SetDisplayModeHook::PatchVtable("IDirectDraw::SetDisplayMode", *lplpDD)) {
+        LogInfo("Hooked IDirectDraw::SetDisplayMode");
+    }
+
+    // ... and those that upgrade to DirectDraw 7 call its own vtable
     LPDIRECTDRAW7 pDD7 = nullptr;
-    hr = (*lplpDD)->QueryInterface(IID_IDirectDraw7, (LPVOID*)&pDD7);
-    if (FAILED(hr)) {
-        Log("QueryInterface failed: 0x%X", hr);
+    if (FAILED((*lplpDD)->QueryInterface(IID_IDirectDraw7, (LPVOID*)&pDD7))) {
+        LogWarn("IDirectDraw7 not available");
         return hr;
     }
 
-    Log("Obtained IDirectDraw7 interface");
-
-    void** vTable = *(void***)pDD7;
-
-    Original_SetDisplayMode = (SetDisplayMode_t)vTable[13];
-
-    DWORD oldProtect;
-    VirtualProtect(&vTable[13], sizeof(void*), PAGE_READWRITE, &oldProtect);
-    vTable[13] = &Hooked_SetDisplayMode;
-    VirtualProtect(&vTable[13], sizeof(void*), oldProtect, &oldProtect);
-
-    Log("Hooked SetDisplayMode");
+    if (SetDisplayMode7Hook::PatchVtable("IDirectDraw7::SetDisplayMode", pDD7)) {
+        LogInfo("Hooked IDirectDraw7::SetDisplayMode");
+    }
 
     pDD7->Release();
 
@@ -146,64 +144,51 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD reason, LPVOID lpReserved) {
         DisableThreadLibraryCalls(hModule);
 
         InitializeLog();
-        Log("DLL attached to process");
+        LogInfo("DLL attached to process");
         LoadConfig();
 
+        // The vtable patches stay until the process exits, so the region is
+        // never closed
+        if (!HookStatsOpen()) {
+            LogWarn("Hook statistics not published");
+        }
+
         if (g_Enabled) {
-            Log("Initializing DirectDraw hooks...");
+            LogInfo("Initializing DirectDraw hooks...");
 
             // Load ddraw.dll
             HMODULE ddraw = LoadLibraryA("ddraw.dll");
             if (!ddraw) {
-                Log("Failed to load ddraw.dll");
+                LogError("Failed to load ddraw.dll");
                 break;
             }
 
-            Log("ddraw.dll loaded at 0x%p", ddraw);
+            LogInfo("ddraw.dll loaded at 0x%p", ddraw);
 
             // Get DirectDrawCreate address
-            Original_DirectDrawCreate = (DirectDrawCreate_t)GetProcAddress(ddraw, "DirectDrawCreate");
-            if (!Original_DirectDrawCreate) {
-                Log("GetProcAddress failed");
+            DirectDrawCreate_t directDrawCreate = (DirectDrawCreate_t)GetProcAddress(ddraw, "DirectDrawCreate");
+            if (!directDrawCreate) {
+                LogError("GetProcAddress failed");
                 break;
             }
 
-            Log("Hooking DirectDrawCreate...");
-
-            // Start hook transaction
-            DetourTransactionBegin();
-            DetourUpdateThread(GetCurrentThread());
-
-            // Attach hook
-            if (DetourAttach(&(PVOID&)Original_DirectDrawCreate, Hooked_DirectDrawCreate) != NO_ERROR) {
-                Log("DetourAttach failed");
-                DetourTransactionAbort();
-                break;
-            }
+            LogInfo("Hooking DirectDrawCreate...");
 
-            // Commit transaction
-            if (DetourTransactionCommit() != NO_ERROR) {
-                Log("DetourTransactionCommit failed");
+            HookRequest("DirectDrawCreate", &Original_DirectDrawCreate, directDrawCreate, Hooked_DirectDrawCreate);
+            if (!HookCommit()) {
                 break;
             }
 
-            Log("DirectDraw hook installed successfully");
+            LogInfo("DirectDraw hook installed successfully");
         }
         break;
 
     case DLL_PROCESS_DETACH:
-        Log("DLL detached from process");
+        LogInfo("DLL detached from process");
 
-        if (Original_DirectDrawCreate) {
-            DetourTransactionBegin();
-            DetourUpdateThread(GetCurrentThread());
-            DetourDetach(&(PVOID&)Original_DirectDrawCreate, Hooked_DirectDrawCreate);
-            DetourTransactionCommit();
-        }
+        HookDetachAll();
 
-        if (g_LogFile.is_open()) {
-            g_LogFile.close();
-        }
+        LogClose(lpReserved == nullptr);
         break;
     }
     return TRUE;
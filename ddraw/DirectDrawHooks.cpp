@@ -0,0 +1,153 @@
+#include "pch.h"
+#include "DirectDrawHooks.h"
+#include "ScaledPresent.h"
+#include "../Common/ComHook.h"
+#include "../Common/Log.h"
+
+// Define IID_IDirectDraw7
+const GUID IID_IDirectDraw7 = {
+    0x15e65ec0, 0x3b9c, 0x11d2,
+    {0xb9, 0x2f, 0x00, 0x60, 0x97, 0x97, 0xea, 0x5b}
+};
+
+UINT g_TargetWidth = 1280;
+UINT g_TargetHeight = 720;
+bool g_Enabled = true;
+bool g_Scaling = true;
+ImageScaleFilter g_ScaleFilter = IMAGE_FILTER_BILINEAR;
+UINT g_ScaleThreads = 0;
+bool g_ConvertDepth = true;
+
+static bool g_Surface7Hooked = false;  // IDirectDraw7::CreateSurface goes through CreateSurfaceHandler
+
+// Replace the mode the game asks for with the configured one. Only a game
+// whose surfaces come from the hooked IDirectDraw7::CreateSurface can have
+// its depth converted.
+void OverrideDisplayMode(DWORD& width, DWORD& height, DWORD& bpp, bool surfacesHooked) {
+    LogDebug("SetDisplayMode called: %dx%dx%d", width, height, bpp);
+    if (!g_Enabled) return;
+
+    // The game keeps drawing at the size (and depth) it asked for
+    ScaledPresentSetNativeMode(width, height, bpp, surfacesHooked);
+
+    LogDebug("Overriding resolution to %dx%d", g_TargetWidth, g_TargetHeight);
+    width = g_TargetWidth;
+    height = g_TargetHeight;
+}
+
+void ResizeGameWindow() {
+    HWND hwnd = GetForegroundWindow();
+    if (hwnd) {
+        SetWindowPos(hwnd, NULL, 0, 0, g_TargetWidth, g_TargetHeight,
+            SWP_NOZORDER | SWP_NOACTIVATE);
+        LogDebug("Window resized manually");
+    }
+}
+
+// IDirectDraw::SetDisplayMode(width, height, bpp) and
+// IDirectDraw7::SetDisplayMode(width, height, bpp, refreshRate, flags)
+struct SetDisplayModeHandler : ComHookHandler {
+    static void Pre(IDirectDraw*, DWORD& width, DWORD& height, DWORD& bpp) {
+        OverrideDisplayMode(width, height, bpp, false);
+    }
+
+    static void Pre(IDirectDraw7*, DWORD& width, DWORD& height, DWORD& bpp, DWORD&, DWORD&) {
+        OverrideDisplayMode(width, height, bpp, g_Surface7Hooked);
+    }
+
+    template <typename DirectDraw, typename... Rest>
+    static void Post(HRESULT&, DirectDraw*, Rest&...) {
+        if (g_Enabled) ResizeGameWindow();
+    }
+};
+
+typedef ComHook<COM_METHOD(IDirectDraw, SetDisplayMode), SetDisplayModeHandler> SetDisplayModeHook;
+typedef ComHook<COM_METHOD(IDirectDraw7, SetDisplayMode), SetDisplayModeHandler> SetDisplayMode7Hook;
+
+// Presentation: frames reach the screen through Blt or Flip on the primary
+// surface, where ScaledPresent upscales them
+struct BltHandler : ComHookHandler {
+    static bool Skip(HRESULT& result, IDirectDrawSurface7* surface, LPRECT& destRect, LPDIRECTDRAWSURFACE7& source,
+        LPRECT& sourceRect, DWORD&, LPDDBLTFX&) {
+        if (ScaledPresentBlt(surface, destRect, source, sourceRect) != SCALED_BLT_DROP) return false;
+        result = DD_OK;
+        return true;
+    }
+};
+
+struct FlipHandler : ComHookHandler {
+    static void Pre(IDirectDrawSurface7* surface, LPDIRECTDRAWSURFACE7& targetOverride, DWORD&) {
+        ScaledPresentFlip(surface, targetOverride);
+    }
+};
+
+// The palette of an 8-bit game whose frames are converted stays with us
+struct SetPaletteHandler : ComHookHandler {
+    static bool Skip(HRESULT& result, IDirectDrawSurface7* surface, LPDIRECTDRAWPALETTE& palette) {
+        if (!ScaledPresentSetPalette(surface, palette)) return false;
+        result = DD_OK;
+        return true;
+    }
+};
+
+typedef ComHook<COM_METHOD(IDirectDrawSurface7, Blt), BltHandler> BltHook;
+typedef ComHook<COM_METHOD(IDirectDrawSurface7, Flip), FlipHandler> FlipHook;
+typedef ComHook<COM_METHOD(IDirectDrawSurface7, SetPalette), SetPaletteHandler> SetPaletteHook;
+
+void HookPrimarySurface(IDirectDrawSurface7* surface);
+
+// IDirectDraw7::CreateSurface, to find the primary surface (and to give the
+// game's surfaces its own depth when converting it)
+struct CreateSurfaceHandler : ComHookHandler {
+    static void Pre(IDirectDraw7* dd, LPDDSURFACEDESC2& desc, LPDIRECTDRAWSURFACE7*&, IUnknown*&) {
+        if (desc) ScaledPresentCreatingSurface(dd, *desc);
+    }
+
+    static void Post(HRESULT& hr, IDirectDraw7*, LPDDSURFACEDESC2&, LPDIRECTDRAWSURFACE7*& surface, IUnknown*&) {
+        if (SUCCEEDED(hr) && surface && *surface) {
+            ScaledPresentSurfaceCreated(*surface);
+            HookPrimarySurface(*surface);
+        }
+    }
+};
+
+typedef ComHook<COM_METHOD(IDirectDraw7, CreateSurface), CreateSurfaceHandler> CreateSurface7Hook;
+
+// Every IDirectDrawSurface7 shares one vtable; patching it again is a no-op
+void HookPrimarySurface(IDirectDrawSurface7* surface) {
+    DDSCAPS2 caps = {};
+    if (FAILED(surface->GetCaps(&caps)) || !(caps.dwCaps & DDSCAPS_PRIMARYSURFACE)) return;
+
+    if (BltHook::PatchVtable("IDirectDrawSurface7::Blt", surface) &&
+        FlipHook::PatchVtable("IDirectDrawSurface7::Flip", surface) &&
+        SetPaletteHook::PatchVtable("IDirectDrawSurface7::SetPalette", surface)) {
+        LogDebug("Hooked primary surface Blt/Flip/SetPalette");
+    }
+}
+
+void HookDirectDraw7(IDirectDraw7* dd) {
+    if (SetDisplayMode7Hook::PatchVtable("IDirectDraw7::SetDisplayMode", dd)) {
+        LogInfo("Hooked IDirectDraw7::SetDisplayMode");
+    }
+    if (g_Scaling && CreateSurface7Hook::PatchVtable("IDirectDraw7::CreateSurface", dd)) {
+        g_Surface7Hooked = true;
+        LogInfo("Hooked IDirectDraw7::CreateSurface");
+    }
+}
+
+void HookDirectDraw(IDirectDraw* dd) {
+    // Games using the original interface call IDirectDraw::SetDisplayMode
+    if (SetDisplayModeHook::PatchVtable("IDirectDraw::SetDisplayMode", dd)) {
+        LogInfo("Hooked IDirectDraw::SetDisplayMode");
+    }
+
+    // ... and those that upgrade to DirectDraw 7 call its own vtable
+    LPDIRECTDRAW7 pDD7 = nullptr;
+    if (FAILED(dd->QueryInterface(IID_IDirectDraw7, (LPVOID*)&pDD7))) {
+        LogWarn("IDirectDraw7 not available");
+        return;
+    }
+
+    HookDirectDraw7(pDD7);
+    pDD7->Release();
+}
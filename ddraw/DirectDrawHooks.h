@@ -0,0 +1,31 @@
+#pragma once
+#include <Windows.h>
+#include <ddraw.h>
+#include "../Common/ImageScaler.h"
+
+// DirectDraw hooks of the ddraw.dll proxy.
+//
+// SetDisplayMode of IDirectDraw and IDirectDraw7 is patched to set the
+// configured mode instead of the game's, and IDirectDraw7::CreateSurface to
+// find the primary surface, whose Blt, Flip and SetPalette then go through
+// ScaledPresent. All of them are ComHook handlers patched into the vtables
+// (see ComHook.h), so the Linux tests drive them with mock objects
+// (tests/mock).
+
+// Settings from PeggleResolution.ini, loaded by the proxy before the game
+// creates any DirectDraw object
+extern UINT g_TargetWidth;
+extern UINT g_TargetHeight;
+extern bool g_Enabled;
+extern bool g_Scaling;
+extern ImageScaleFilter g_ScaleFilter;
+extern UINT g_ScaleThreads;
+extern bool g_ConvertDepth;
+
+// Object from DirectDrawCreate: hooks its SetDisplayMode, and the
+// IDirectDraw7 interface behind it if there is one
+void HookDirectDraw(IDirectDraw* dd);
+
+// Object from DirectDrawCreateEx, or the IDirectDraw7 of one from
+// DirectDrawCreate
+void HookDirectDraw7(IDirectDraw7* dd);
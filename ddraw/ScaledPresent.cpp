@@ -0,0 +1,487 @@
+#include "pch.h"
+#include "ScaledPresent.h"
+#include <cstring>
+#include <vector>
+#include "../Common/FrameChanges.h"
+#include "../Common/HookStats.h"
+#include "../Common/Log.h"
+#include "../Common/PixelConvert.h"
+#include "../Common/WorkerPool.h"
+
+constexpr unsigned MAX_AUTO_THREADS = 4;  // leaves the other cores to the game and the system
+constexpr ULONGLONG TILE_REPORT_INTERVAL_MS = 60000;
+
+static bool g_enabled = false;
+static ImageScaleFilter g_filter = IMAGE_FILTER_BILINEAR;
+static DWORD g_nativeWidth = 0;
+static DWORD g_nativeHeight = 0;
+static IDirectDrawSurface7* g_primary = nullptr;  // not referenced; compared only
+
+// Depth conversion: the display runs at 32 bits while the game's surfaces
+// keep g_gameDepth (8 or 16; 0 when not converting). The palette the game
+// set on the primary is kept here instead, since a 32-bit surface takes none.
+static bool g_convertDepth = false;
+static DWORD g_gameDepth = 0;
+static IDirectDrawPalette* g_primaryPalette = nullptr;
+static uint32_t g_palette[256];
+
+static ImageScaler g_scaler;
+static unsigned g_threads = 0;
+static uint32_t g_stats = HOOK_STATS_NONE;
+static bool g_formatWarned = false;
+static bool g_dropWarned = false;
+
+// System memory surface the Blt path scales into
+static IDirectDrawSurface7* g_scaled = nullptr;
+static DWORD g_scaledWidth = 0;
+static DWORD g_scaledHeight = 0;
+
+// Tiles of the Blt source that changed since the frame in g_scaled, and the
+// tiles skipped since the last report
+static FrameChanges g_changes;
+static ULONGLONG g_tileIntervalStart = 0;
+static uint64_t g_tilesSkipped = 0;
+static uint64_t g_tileFrames = 0;
+
+// Destination of the substituted blit and the part of g_scaled it copies;
+// must outlive the hook's Pre
+static RECT g_presentRect;
+static RECT g_scaledRect;
+
+// Copy of the native-size corner of the back buffer for the Flip path
+static std::vector<uint8_t> g_staging;
+
+// The ImageFormat of a surface, if the scaler reads it
+static bool GetImageFormat(const DDPIXELFORMAT& format, ImageFormat& result) {
+    if (format.dwFlags & DDPF_PALETTEINDEXED8) {
+        result = IMAGE_FORMAT_PALETTE8;
+        return true;
+    }
+    if (format.dwFlags & DDPF_RGB) {
+        if (format.dwRGBBitCount == 32 && format.dwRBitMask == 0xFF0000 && format.dwGBitMask == 0x00FF00 &&
+            format.dwBBitMask == 0x0000FF) {
+            result = IMAGE_FORMAT_BGRX8888;
+            return true;
+        }
+        if (format.dwRGBBitCount == 16 && format.dwBBitMask == 0x001F) {
+            if (format.dwRBitMask == 0xF800 && format.dwGBitMask == 0x07E0) {
+                result = IMAGE_FORMAT_RGB565;
+                return true;
+            }
+            if (format.dwRBitMask == 0x7C00 && format.dwGBitMask == 0x03E0) {
+                result = IMAGE_FORMAT_RGB555;
+                return true;
+            }
+        }
+    }
+
+    if (!g_formatWarned) {
+        LogWarn("Scaled present cannot read %u-bit surfaces (flags 0x%X, masks %X %X %X); presenting unscaled",
+            format.dwRGBBitCount, format.dwFlags, format.dwRBitMask, format.dwGBitMask, format.dwBBitMask);
+        g_formatWarned = true;
+    }
+    return false;
+}
+
+static bool IsScalable(const DDPIXELFORMAT& format) {
+    ImageFormat result;
+    if (!GetImageFormat(format, result)) return false;
+    if (result == IMAGE_FORMAT_BGRX8888) return true;
+
+    if (!g_formatWarned) {
+        LogWarn("Scaled present needs a 32-bit surface here (got %u bits); presenting unscaled",
+            format.dwRGBBitCount);
+        g_formatWarned = true;
+    }
+    return false;
+}
+
+// The game's surface format at g_gameDepth
+static DDPIXELFORMAT GameFormat() {
+    DDPIXELFORMAT format = {};
+    format.dwSize = sizeof(format);
+    format.dwRGBBitCount = g_gameDepth;
+    if (g_gameDepth == 8) {
+        format.dwFlags = DDPF_RGB | DDPF_PALETTEINDEXED8;
+    }
+    else {
+        format.dwFlags = DDPF_RGB;
+        format.dwRBitMask = 0xF800;
+        format.dwGBitMask = 0x07E0;
+        format.dwBBitMask = 0x001F;
+    }
+    return format;
+}
+
+// Load g_palette from the source's own palette, or the one set on the primary
+static bool LoadPalette(IDirectDrawSurface7* source) {
+    IDirectDrawPalette* palette = nullptr;
+    if (FAILED(source->GetPalette(&palette))) {
+        palette = g_primaryPalette;
+        if (!palette) return false;
+        palette->AddRef();
+    }
+
+    PALETTEENTRY entries[256];
+    HRESULT hr = palette->GetEntries(0, 0, 256, entries);
+    palette->Release();
+    if (FAILED(hr)) return false;
+
+    for (int i = 0; i < 256; i++) {
+        uint32_t entry;
+        memcpy(&entry, &entries[i], sizeof(entry));
+        g_palette[i] = PaletteEntryToBgrx(entry);
+    }
+    return true;
+}
+
+static ImageView ViewOf(const DDSURFACEDESC2& desc, DWORD width, DWORD height) {
+    ImageView view;
+    view.pixels = (uint8_t*)desc.lpSurface;
+    view.width = width;
+    view.height = height;
+    view.pitch = desc.lPitch;
+    return view;
+}
+
+// Threads are not started from DllMain: the pool is created on the render
+// thread by the first scaled frame and lives until the process exits, like
+// the hooks that use it
+static WorkerPool* StartWorkers() {
+    unsigned threads = WorkerPoolThreadCount(g_threads, MAX_AUTO_THREADS);
+    if (threads <= 1) return nullptr;
+
+    WorkerPool* pool = new WorkerPool(threads - 1);
+    LogInfo("Scaling on %u threads", threads);
+    return pool;
+}
+
+static void Scale(const ImageView& source, const ImageView& target, const FrameChanges* changes = nullptr) {
+    static WorkerPool* pool = StartWorkers();
+    g_scaler.SetWorkerPool(pool);
+
+    uint64_t start = HookStatsNow();
+    if (!g_scaler.Scale(source, target, g_filter, changes)) {
+        g_scaler.Scale(source, target, IMAGE_FILTER_BILINEAR, changes);
+    }
+    HookStatsRecord(g_stats, HookStatsNow() - start);
+}
+
+static void RecordSkippedTiles() {
+    g_tilesSkipped += g_changes.TileCount() - g_changes.ChangedCount();
+    g_tileFrames++;
+
+    ULONGLONG now = GetTickCount64();
+    if (!g_tileIntervalStart) {
+        g_tileIntervalStart = now;
+    }
+    else if (now - g_tileIntervalStart >= TILE_REPORT_INTERVAL_MS) {
+        LogInfo("Unchanged tiles skipped per frame in the last minute: %u of %u",
+            (unsigned)(g_tilesSkipped / g_tileFrames), g_changes.TileCount());
+        g_tileIntervalStart = now;
+        g_tilesSkipped = 0;
+        g_tileFrames = 0;
+    }
+}
+
+// (Re)create the scaled surface at the given size, in the primary's format
+static bool PrepareScaledSurface(IDirectDrawSurface7* primary, const DDPIXELFORMAT& format,
+    DWORD width, DWORD height) {
+    if (g_scaled && g_scaledWidth == width && g_scaledHeight == height) {
+        if (g_scaled->IsLost() == DDERR_SURFACELOST) {
+            g_scaled->Restore();
+            g_changes.Invalidate();
+        }
+        return true;
+    }
+    if (g_scaled) {
+        g_scaled->Release();
+        g_scaled = nullptr;
+    }
+
+    IDirectDraw7* dd = nullptr;
+    if (FAILED(primary->GetDDInterface((LPVOID*)&dd))) return false;
+
+    DDSURFACEDESC2 desc = {};
+    desc.dwSize = sizeof(desc);
+    desc.dwFlags = DDSD_CAPS | DDSD_WIDTH | DDSD_HEIGHT | DDSD_PIXELFORMAT;
+    desc.ddsCaps.dwCaps = DDSCAPS_OFFSCREENPLAIN | DDSCAPS_SYSTEMMEMORY;
+    desc.dwWidth = width;
+    desc.dwHeight = height;
+    desc.ddpfPixelFormat = format;
+
+    HRESULT hr = dd->CreateSurface(&desc, &g_scaled, nullptr);
+    dd->Release();
+    if (FAILED(hr)) {
+        LogError("Failed to create %ux%u scaled surface: 0x%X", width, height, hr);
+        g_scaled = nullptr;
+        return false;
+    }
+
+    g_scaledWidth = width;
+    g_scaledHeight = height;
+    g_changes.Invalidate();
+    LogInfo("Scaled present surface created at %ux%u", width, height);
+    return true;
+}
+
+// Screen area the primary shows the game in: the clipper window's client
+// area, or the whole surface
+static bool GetPresentArea(IDirectDrawSurface7* primary, RECT& area) {
+    IDirectDrawClipper* clipper = nullptr;
+    if (SUCCEEDED(primary->GetClipper(&clipper))) {
+        HWND hwnd = nullptr;
+        clipper->GetHWnd(&hwnd);
+        clipper->Release();
+
+        if (hwnd) {
+            if (!GetClientRect(hwnd, &area)) return false;
+            MapWindowPoints(hwnd, HWND_DESKTOP, (LPPOINT)&area, 2);
+            return true;
+        }
+    }
+
+    DDSURFACEDESC2 desc = {};
+    desc.dwSize = sizeof(desc);
+    if (FAILED(primary->GetSurfaceDesc(&desc))) return false;
+    SetRect(&area, 0, 0, (int)desc.dwWidth, (int)desc.dwHeight);
+    return true;
+}
+
+// Where a blit to destRect (nullptr: the whole frame) lands once the frame
+// is scaled to area. The game places its frame at the top left of area, at
+// its native size; a blit to the whole frame or the whole of area covers
+// area. Returns false if the result is empty or outside area.
+static bool MapToPresentArea(const RECT* destRect, const RECT& area, RECT& result, bool& wholeFrame) {
+    wholeFrame = !destRect || EqualRect(destRect, &area);
+    RECT frame = { area.left, area.top, area.left + (LONG)g_nativeWidth, area.top + (LONG)g_nativeHeight };
+    if (!wholeFrame && g_nativeWidth && g_nativeHeight) {
+        wholeFrame = EqualRect(destRect, &frame) != FALSE;
+    }
+    if (wholeFrame) {
+        result = area;
+        return true;
+    }
+    if (!g_nativeWidth || !g_nativeHeight) return false;
+
+    // The part of area the whole frame is scaled into
+    RECT image = area;
+    LONG width = area.right - area.left;
+    LONG height = area.bottom - area.top;
+    if (g_filter == IMAGE_FILTER_INTEGER) {
+        uint32_t factor = IntegerScaleFactor(g_nativeWidth, g_nativeHeight, (uint32_t)width, (uint32_t)height);
+        if (factor) {
+            image.left += (LONG)(width - g_nativeWidth * factor) / 2;
+            image.top += (LONG)(height - g_nativeHeight * factor) / 2;
+            width = (LONG)(g_nativeWidth * factor);
+            height = (LONG)(g_nativeHeight * factor);
+        }
+    }
+
+    // Scaled edge by edge, so blits to adjacent rects stay adjacent
+    result.left = image.left + (LONG)((int64_t)(destRect->left - frame.left) * width / (LONG)g_nativeWidth);
+    result.right = image.left + (LONG)((int64_t)(destRect->right - frame.left) * width / (LONG)g_nativeWidth);
+    result.top = image.top + (LONG)((int64_t)(destRect->top - frame.top) * height / (LONG)g_nativeHeight);
+    result.bottom = image.top + (LONG)((int64_t)(destRect->bottom - frame.top) * height / (LONG)g_nativeHeight);
+
+    return result.left < result.right && result.top < result.bottom && result.left >= area.left &&
+        result.top >= area.top && result.right <= area.right && result.bottom <= area.bottom;
+}
+
+static const char* FilterName(ImageScaleFilter filter) {
+    switch (filter) {
+    case IMAGE_FILTER_INTEGER:
+        return "integer";
+    case IMAGE_FILTER_BICUBIC:
+        return "bicubic";
+    case IMAGE_FILTER_LANCZOS3:
+        return "Lanczos-3";
+    default:
+        return "bilinear";
+    }
+}
+
+void ScaledPresentEnable(bool enabled, ImageScaleFilter filter, unsigned threads, bool convertDepth) {
+    g_enabled = enabled;
+    g_filter = filter;
+    g_threads = threads;
+    g_convertDepth = enabled && convertDepth;
+    if (enabled && g_stats == HOOK_STATS_NONE) {
+        g_stats = HookStatsRegister("ScaledPresent");
+    }
+    LogInfo("Scaled present %s (%s)", enabled ? "enabled" : "disabled", FilterName(filter));
+}
+
+void ScaledPresentSetNativeMode(DWORD width, DWORD height, DWORD& depth, bool surfacesHooked) {
+    g_nativeWidth = width;
+    g_nativeHeight = height;
+
+    g_gameDepth = 0;
+    if (g_convertDepth && surfacesHooked && (depth == 8 || depth == 16)) {
+        LogInfo("Game asked for %u bits per pixel; converting its frames to 32", depth);
+        g_gameDepth = depth;
+        depth = 32;
+    }
+}
+
+void ScaledPresentCreatingSurface(IDirectDraw7* dd, DDSURFACEDESC2& desc) {
+    if (!g_gameDepth || (desc.dwFlags & DDSD_PIXELFORMAT)) return;
+
+    DWORD caps = (desc.dwFlags & DDSD_CAPS) ? desc.ddsCaps.dwCaps : 0;
+    if (caps & DDSCAPS_PRIMARYSURFACE) {
+        if (!(caps & DDSCAPS_FLIP)) return;
+
+        // The game draws into the back buffers of a flipping primary, which
+        // are in the display's format; give it the depth it asked for
+        DWORD depth = g_gameDepth;
+        LogWarn("Flipping primary at %u bits per pixel; not converting", depth);
+        g_convertDepth = false;
+        g_gameDepth = 0;
+        dd->SetDisplayMode(g_nativeWidth, g_nativeHeight, depth, 0, 0);
+        return;
+    }
+
+    // Plain surfaces the game draws its frame into take its depth
+    if (caps & (DDSCAPS_TEXTURE | DDSCAPS_ZBUFFER | DDSCAPS_OVERLAY | DDSCAPS_3DDEVICE)) return;
+    desc.dwFlags |= DDSD_PIXELFORMAT;
+    desc.ddpfPixelFormat = GameFormat();
+}
+
+bool ScaledPresentSetPalette(IDirectDrawSurface7* surface, IDirectDrawPalette* palette) {
+    if (g_gameDepth != 8 || surface != g_primary) return false;
+
+    if (palette) palette->AddRef();
+    if (g_primaryPalette) g_primaryPalette->Release();
+    g_primaryPalette = palette;
+    return true;
+}
+
+void ScaledPresentSurfaceCreated(IDirectDrawSurface7* surface) {
+    DDSCAPS2 caps = {};
+    if (SUCCEEDED(surface->GetCaps(&caps)) && (caps.dwCaps & DDSCAPS_PRIMARYSURFACE)) {
+        g_primary = surface;
+        LogDebug("Primary surface created");
+    }
+}
+
+ScaledBlt ScaledPresentBlt(IDirectDrawSurface7* target, LPRECT& destRect, LPDIRECTDRAWSURFACE7& source,
+    LPRECT& sourceRect) {
+    if (!g_enabled || target != g_primary || !source) return SCALED_BLT_PASS;
+
+    // While converting, a source in the game's depth cannot reach the 32-bit
+    // primary unconverted, so whatever goes wrong from here drops the blit
+    DDSURFACEDESC2 desc = {};
+    desc.dwSize = sizeof(desc);
+    ImageFormat format = IMAGE_FORMAT_BGRX8888;
+    bool known = SUCCEEDED(source->GetSurfaceDesc(&desc)) && GetImageFormat(desc.ddpfPixelFormat, format);
+    ScaledBlt failed = (g_gameDepth && (!known || format != IMAGE_FORMAT_BGRX8888)) ?
+        SCALED_BLT_DROP : SCALED_BLT_PASS;
+    if (failed == SCALED_BLT_DROP && !g_dropWarned) {
+        LogWarn("Frames in the game's depth that cannot be converted are dropped");
+        g_dropWarned = true;
+    }
+    if (!known) return failed;
+    if (format == IMAGE_FORMAT_PALETTE8 && !LoadPalette(source)) return failed;
+
+    RECT area;
+    if (!GetPresentArea(target, area)) return failed;
+
+    DDSURFACEDESC2 primaryDesc = {};
+    primaryDesc.dwSize = sizeof(primaryDesc);
+    if (FAILED(target->GetSurfaceDesc(&primaryDesc)) || !IsScalable(primaryDesc.ddpfPixelFormat)) return failed;
+
+    RECT present;
+    bool wholeFrame;
+    if (!MapToPresentArea(destRect, area, present, wholeFrame)) return failed;
+
+    DWORD sourceWidth = sourceRect ? (DWORD)(sourceRect->right - sourceRect->left) : desc.dwWidth;
+    DWORD sourceHeight = sourceRect ? (DWORD)(sourceRect->bottom - sourceRect->top) : desc.dwHeight;
+    DWORD width = (DWORD)(present.right - present.left);
+    DWORD height = (DWORD)(present.bottom - present.top);
+    if (!sourceWidth || !sourceHeight || !width || !height) return failed;
+    if (sourceWidth == width && sourceHeight == height && format == IMAGE_FORMAT_BGRX8888) return SCALED_BLT_PASS;
+
+    if (!PrepareScaledSurface(target, primaryDesc.ddpfPixelFormat, (DWORD)(area.right - area.left),
+        (DWORD)(area.bottom - area.top))) {
+        return failed;
+    }
+
+    DDSURFACEDESC2 from = {};
+    from.dwSize = sizeof(from);
+    if (FAILED(source->Lock(sourceRect, &from, DDLOCK_WAIT | DDLOCK_READONLY | DDLOCK_SURFACEMEMORYPTR, nullptr))) {
+        return failed;
+    }
+
+    DDSURFACEDESC2 to = {};
+    to.dwSize = sizeof(to);
+    if (FAILED(g_scaled->Lock(nullptr, &to, DDLOCK_WAIT | DDLOCK_WRITEONLY | DDLOCK_SURFACEMEMORYPTR, nullptr))) {
+        source->Unlock(sourceRect);
+        return failed;
+    }
+
+    ImageView frame = ViewOf(from, sourceWidth, sourceHeight);
+    frame.format = format;
+    frame.palette = g_palette;
+    SetRect(&g_scaledRect, present.left - area.left, present.top - area.top,
+        present.right - area.left, present.bottom - area.top);
+    if (wholeFrame) {
+        // g_scaled still holds the last frame, so only what changed is scaled again
+        g_changes.Update(frame);
+        Scale(frame, ViewOf(to, width, height), &g_changes);
+        RecordSkippedTiles();
+    }
+    else {
+        // A part of the frame is scaled into its own place, after which
+        // g_scaled no longer matches the last whole frame
+        ImageView part = ViewOf(to, width, height);
+        part.pixels += (ptrdiff_t)g_scaledRect.top * to.lPitch + 4 * (ptrdiff_t)g_scaledRect.left;
+        Scale(frame, part);
+        g_changes.Invalidate();
+    }
+
+    g_scaled->Unlock(nullptr);
+    source->Unlock(sourceRect);
+
+    g_presentRect = present;
+    destRect = &g_presentRect;
+    source = g_scaled;
+    sourceRect = &g_scaledRect;
+    return SCALED_BLT_REPLACED;
+}
+
+void ScaledPresentFlip(IDirectDrawSurface7* primary, IDirectDrawSurface7* targetOverride) {
+    if (!g_enabled || primary != g_primary || !g_nativeWidth || !g_nativeHeight) return;
+
+    IDirectDrawSurface7* back = targetOverride;
+    if (back) {
+        back->AddRef();
+    }
+    else {
+        DDSCAPS2 caps = {};
+        caps.dwCaps = DDSCAPS_BACKBUFFER;
+        if (FAILED(primary->GetAttachedSurface(&caps, &back))) return;
+    }
+
+    DDSURFACEDESC2 desc = {};
+    desc.dwSize = sizeof(desc);
+    if (SUCCEEDED(back->Lock(nullptr, &desc, DDLOCK_WAIT | DDLOCK_SURFACEMEMORYPTR, nullptr))) {
+        if (IsScalable(desc.ddpfPixelFormat) && g_nativeWidth <= desc.dwWidth && g_nativeHeight <= desc.dwHeight &&
+            (g_nativeWidth != desc.dwWidth || g_nativeHeight != desc.dwHeight)) {
+            // The frame is read from the buffer it is scaled into, so copy it out first
+            size_t rowBytes = 4 * (size_t)g_nativeWidth;
+            g_staging.resize(rowBytes * g_nativeHeight);
+            for (DWORD y = 0; y < g_nativeHeight; y++) {
+                memcpy(&g_staging[y * rowBytes], (uint8_t*)desc.lpSurface + (ptrdiff_t)y * desc.lPitch, rowBytes);
+            }
+
+            ImageView native;
+            native.pixels = g_staging.data();
+            native.width = g_nativeWidth;
+            native.height = g_nativeHeight;
+            native.pitch = (ptrdiff_t)rowBytes;
+            Scale(native, ViewOf(desc, desc.dwWidth, desc.dwHeight));
+        }
+        back->Unlock(nullptr);
+    }
+    back->Release();
+}
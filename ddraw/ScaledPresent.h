@@ -0,0 +1,80 @@
+#pragma once
+#include <Windows.h>
+#include <ddraw.h>
+#include "../Common/ImageScaler.h"
+
+// Scaled presentation for the DirectDraw proxy.
+//
+// The game keeps rendering at the resolution it asked for, and its frame is
+// upscaled with ImageScaler where it reaches the screen:
+//   - Blt to the primary surface: the source rect is scaled into a system
+//     memory surface the size of the present area (the clipper window's
+//     client area, or the whole primary without a clipper), which is then
+//     blitted 1:1 in its place. That surface keeps the previous scaled frame,
+//     so only the parts of it that read a changed 32x32 tile of the source
+//     are scaled again (see FrameChanges.h); the average number of tiles
+//     skipped per frame is logged once a minute. A blit to part of the frame
+//     is scaled into the matching part of the present area instead, taking
+//     the game's frame to sit at the top left of it at the native size.
+//   - Flip: the game drew its frame into the top-left corner of the larger
+//     back buffer; it is scaled up to the whole buffer before flipping. Back
+//     buffers take turns, so the whole frame is scaled every time.
+// With IMAGE_FILTER_INTEGER the frame is scaled by the largest whole factor
+// that fits and letterboxed; a destination smaller than the frame falls back
+// to bilinear. The bicubic and Lanczos-3 weight tables are rebuilt by the
+// first frame after SetDisplayMode or a window resize changes either size.
+//
+// When a DirectDraw 7 game asks for an 8- or 16-bit display mode, the
+// display is set to 32 bits instead.
+// The game's offscreen surfaces are created at its own depth (RGB565 for 16),
+// and the Blt path converts them to 32 bits as it scales.
+// For 8 bits it uses the palette the game set on the primary.
+// A game that flips a primary chain draws into the display's format, so for
+// it the mode is set back to the depth it asked for and left unconverted.
+// Games on the original IDirectDraw interface create surfaces the hook does
+// not see, so their mode is never changed.
+// Other formats and a primary that is not X8R8G8B8 are presented unchanged.
+// A frame in the game's depth that cannot be converted is dropped instead,
+// since the primary cannot show it.
+// The time spent scaling is recorded in the hook statistics under
+// "ScaledPresent".
+//
+// All of this runs on the game's render thread, which may share the scaling
+// with a pool of worker threads (see WorkerPool.h); the frame is complete
+// before the blit or flip is passed on.
+
+// threads is the number of threads scaling a frame, the render thread
+// included; 0 picks one per core, up to 4. convertDepth allows the 8- and
+// 16-bit conversion above.
+void ScaledPresentEnable(bool enabled, ImageScaleFilter filter, unsigned threads, bool convertDepth);
+
+// Mode the game asked for in SetDisplayMode, before any override; raises
+// depth to 32 if its frames will be converted. surfacesHooked says the
+// game's surfaces are created through the CreateSurface hook, without which
+// nothing is converted.
+void ScaledPresentSetNativeMode(DWORD width, DWORD height, DWORD& depth, bool surfacesHooked);
+
+// CreateSurface hook, before the call: gives the game's plain surfaces its
+// own depth while converting.
+void ScaledPresentCreatingSurface(IDirectDraw7* dd, DDSURFACEDESC2& desc);
+
+// SetPalette hook: keeps the palette set on the primary while converting 8
+// bits. Returns true if it did, and the call should not reach DirectDraw.
+bool ScaledPresentSetPalette(IDirectDrawSurface7* surface, IDirectDrawPalette* palette);
+
+// Called for every surface the game creates; remembers the primary.
+void ScaledPresentSurfaceCreated(IDirectDrawSurface7* surface);
+
+enum ScaledBlt {
+    SCALED_BLT_PASS,      // the blit goes ahead as the game made it
+    SCALED_BLT_REPLACED,  // destRect, source and sourceRect point at the scaled copy
+    SCALED_BLT_DROP,      // a frame in the game's depth that could not be converted
+};
+
+// Blt hook: when the blit presents a frame that should be scaled, points
+// destRect, source and sourceRect at the scaled copy.
+ScaledBlt ScaledPresentBlt(IDirectDrawSurface7* target, LPRECT& destRect, LPDIRECTDRAWSURFACE7& source,
+    LPRECT& sourceRect);
+
+// Flip hook: scales the native-size frame in the back buffer up to its full size.
+void ScaledPresentFlip(IDirectDrawSurface7* primary, IDirectDrawSurface7* targetOverride);
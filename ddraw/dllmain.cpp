@@ -2,44 +2,31 @@
 #include <Windows.h>
 #include <ddraw.h>
 #include <shlwapi.h>
-#include <fstream>
 #include <ctime>
-
-// Define IID_IDirectDraw7
-const GUID IID_IDirectDraw7 = {
-    0x15e65ec0, 0x3b9c, 0x11d2,
-    {0xb9, 0x2f, 0x00, 0x60, 0x97, 0x97, 0xea, 0x5b}
-};
+#include "DirectDrawHooks.h"
+#include "ScaledPresent.h"
+#include "../Common/HookStats.h"
+#include "../Common/Log.h"
 
 #pragma comment(lib, "shlwapi.lib")
 
-UINT g_TargetWidth = 1280;
-UINT g_TargetHeight = 720;
-bool g_Enabled = true;
-
-std::ofstream g_LogFile;
-
 void InitializeLog() {
     char logPath[MAX_PATH];
     GetModuleFileNameA(nullptr, logPath, MAX_PATH);
     PathRemoveFileSpecA(logPath);
     PathCombineA(logPath, logPath, "PeggleResolution.log");
-    g_LogFile.open(logPath, std::ios::out | std::ios::trunc);
-}
-
-void Log(const char* format, ...) {
-    if (!g_LogFile.is_open()) return;
 
-    char buffer[512];
-    va_list args;
-    va_start(args, format);
-    vsprintf_s(buffer, sizeof(buffer), format, args);
-    va_end(args);
+    // Binary logging defers all formatting to PeggleLogDecoder
+    char iniPath[MAX_PATH];
+    GetModuleFileNameA(nullptr, iniPath, MAX_PATH);
+    PathRemoveFileSpecA(iniPath);
+    PathCombineA(iniPath, iniPath, "PeggleResolution.ini");
 
-    g_LogFile << buffer << std::endl;
-    g_LogFile.flush();
-    OutputDebugStringA(buffer);
-    OutputDebugStringA("\n");
+    unsigned flags = LOG_DEBUG_OUTPUT;
+    if (GetPrivateProfileIntA("Settings", "BinaryLog", 0, iniPath)) {
+        flags |= LOG_BINARY;
+    }
+    LogOpen(logPath, flags);
 }
 
 // Load settings from INI file
@@ -52,46 +39,42 @@ void LoadConfig() {
     g_TargetWidth = GetPrivateProfileIntA("Settings", "Width", 1280, path);
     g_TargetHeight = GetPrivateProfileIntA("Settings", "Height", 720, path);
     g_Enabled = GetPrivateProfileIntA("Settings", "Enabled", 1, path) != 0;
+    g_Scaling = GetPrivateProfileIntA("Settings", "Scaling", 1, path) != 0;
+
+    // ScaleFilter=Integer keeps pixels sharp at the largest whole multiple of
+    // the game's size that fits Width x Height; Bicubic and Lanczos3 are
+    // sharper than Bilinear at a higher cost per frame
+    char filter[32];
+    GetPrivateProfileStringA("Settings", "ScaleFilter", "Bilinear", filter, sizeof(filter), path);
+    if (_stricmp(filter, "Integer") == 0) {
+        g_ScaleFilter = IMAGE_FILTER_INTEGER;
+    }
+    else if (_stricmp(filter, "Bicubic") == 0) {
+        g_ScaleFilter = IMAGE_FILTER_BICUBIC;
+    }
+    else if (_stricmp(filter, "Lanczos3") == 0) {
+        g_ScaleFilter = IMAGE_FILTER_LANCZOS3;
+    }
+    else if (_stricmp(filter, "Bilinear") != 0) {
+        LogWarn("Unknown ScaleFilter %s, using Bilinear", filter);
+    }
 
-    Log("Config loaded: %dx%d, Enabled=%d", g_TargetWidth, g_TargetHeight, g_Enabled);
+    // ScaleThreads=<n> scales each frame on n threads, the game's included;
+    // 0 (the default) uses one per core, up to 4
+    g_ScaleThreads = GetPrivateProfileIntA("Settings", "ScaleThreads", 0, path);
+
+    // ConvertDepth=0 passes 8- and 16-bit display modes through, unscaled,
+    // instead of converting the game's frames to 32 bits
+    g_ConvertDepth = GetPrivateProfileIntA("Settings", "ConvertDepth", 1, path) != 0;
+
+    LogInfo("Config loaded: %dx%d, Enabled=%d, Scaling=%d", g_TargetWidth, g_TargetHeight, g_Enabled, g_Scaling);
 }
 
 typedef HRESULT(WINAPI* DirectDrawCreate_t)(GUID*, LPDIRECTDRAW*, IUnknown*);
 typedef HRESULT(WINAPI* DirectDrawCreateEx_t)(GUID*, LPVOID*, REFIID, IUnknown*);
-typedef HRESULT(STDMETHODCALLTYPE* SetDisplayMode_t)(LPDIRECTDRAW7, DWORD, DWORD, DWORD);
 
 DirectDrawCreate_t Real_DirectDrawCreate = nullptr;
 DirectDrawCreateEx_t Real_DirectDrawCreateEx = nullptr;
-SetDisplayMode_t Original_SetDisplayMode = nullptr;
-
-// Hooked SetDisplayMode
-HRESULT STDMETHODCALLTYPE Hooked_SetDisplayMode(
-    LPDIRECTDRAW7 pDD,
-    DWORD width,
-    DWORD height,
-    DWORD bpp
-) {
-    Log("SetDisplayMode called: %dx%d", width, height);
-
-    if (g_Enabled) {
-        Log("Overriding resolution to %dx%d", g_TargetWidth, g_TargetHeight);
-
-        // Set the new resolution
-        HRESULT hr = Original_SetDisplayMode(pDD, g_TargetWidth, g_TargetHeight, bpp);
-
-        // Resize window
-        HWND hwnd = GetForegroundWindow();
-        if (hwnd) {
-            SetWindowPos(hwnd, NULL, 0, 0, g_TargetWidth, g_TargetHeight,
-                SWP_NOZORDER | SWP_NOACTIVATE);
-            Log("Window resized manually");
-        }
-
-        return hr;
-    }
-
-    return Original_SetDisplayMode(pDD, width, height, bpp);
-}
 
 // Hooked DirectDrawCreate
 HRESULT WINAPI DirectDrawCreate(
@@ -99,7 +82,7 @@ HRESULT WINAPI DirectDrawCreate(
     LPDIRECTDRAW* lplpDD,
     IUnknown* pUnkOuter
 ) {
-    Log("DirectDrawCreate called");
+    LogDebug("DirectDrawCreate called");
 
     if (!Real_DirectDrawCreate) {
         HMODULE realDDraw = LoadLibraryA("ddraw_real.dll");
@@ -109,39 +92,17 @@ HRESULT WINAPI DirectDrawCreate(
     }
 
     if (!Real_DirectDrawCreate) {
-        Log("Failed to load real DirectDrawCreate");
+        LogError("Failed to load real DirectDrawCreate");
         return DDERR_GENERIC;
     }
 
     HRESULT hr = Real_DirectDrawCreate(lpGUID, lplpDD, pUnkOuter);
     if (FAILED(hr)) {
-        Log("DirectDrawCreate failed: 0x%X", hr);
-        return hr;
-    }
-
-    // Query for DirectDraw7 interface
-    LPDIRECTDRAW7 pDD7 = nullptr;
-    hr = (*lplpDD)->QueryInterface(IID_IDirectDraw7, (LPVOID*)&pDD7);
-    if (FAILED(hr)) {
-        Log("QueryInterface failed: 0x%X", hr);
+        LogError("DirectDrawCreate failed: 0x%X", hr);
         return hr;
     }
 
-    Log("Obtained IDirectDraw7 interface");
-
-    void** vTable = *(void***)pDD7;
-
-    Original_SetDisplayMode = (SetDisplayMode_t)vTable[13];
-
-    DWORD oldProtect;
-    VirtualProtect(&vTable[13], sizeof(void*), PAGE_READWRITE, &oldProtect);
-    vTable[13] = &Hooked_SetDisplayMode;
-    VirtualProtect(&vTable[13], sizeof(void*), oldProtect, &oldProtect);
-
-    Log("Hooked SetDisplayMode");
-
-    pDD7->Release();
-
+    HookDirectDraw(*lplpDD);
     return hr;
 }
 
@@ -151,7 +112,7 @@ HRESULT WINAPI DirectDrawCreateEx(
     REFIID iid,
     IUnknown* pUnkOuter
 ) {
-    Log("DirectDrawCreateEx called");
+    LogDebug("DirectDrawCreateEx called");
 
     if (!Real_DirectDrawCreateEx) {
         HMODULE realDDraw = LoadLibraryA("ddraw_real.dll");
@@ -161,19 +122,37 @@ HRESULT WINAPI DirectDrawCreateEx(
     }
 
     if (!Real_DirectDrawCreateEx) {
-        Log("Failed to load real DirectDrawCreateEx");
+        LogError("Failed to load real DirectDrawCreateEx");
         return DDERR_GENERIC;
     }
 
-    return Real_DirectDrawCreateEx(lpGUID, lplpDD, iid, pUnkOuter);
+    HRESULT hr = Real_DirectDrawCreateEx(lpGUID, lplpDD, iid, pUnkOuter);
+    if (FAILED(hr)) {
+        LogError("DirectDrawCreateEx failed: 0x%X", hr);
+        return hr;
+    }
+
+    // DirectDrawCreateEx only creates IDirectDraw7 objects
+    HookDirectDraw7((LPDIRECTDRAW7)*lplpDD);
+    return hr;
 }
 
 BOOL APIENTRY DllMain(HMODULE hModule, DWORD reason, LPVOID lpReserved) {
     if (reason == DLL_PROCESS_ATTACH) {
         DisableThreadLibraryCalls(hModule);
         InitializeLog();
-        Log("ddraw.dll proxy loaded");
+        LogInfo("ddraw.dll proxy loaded");
         LoadConfig();
+
+        // The vtable patches stay until the process exits, so the region is
+        // never closed
+        if (!HookStatsOpen()) {
+            LogWarn("Hook statistics not published");
+        }
+        ScaledPresentEnable(g_Scaling, g_ScaleFilter, g_ScaleThreads, g_ConvertDepth);
+    }
+    else if (reason == DLL_PROCESS_DETACH) {
+        LogClose(lpReserved == nullptr);
     }
     return TRUE;
 }
\ No newline at end of file
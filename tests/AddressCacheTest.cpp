@@ -0,0 +1,200 @@
+// Checks of the resolved address cache (AddressCache.h): the fingerprint of a
+// synthetic executable, a cache saved and loaded back with its fingerprint,
+// scan time and addresses, and a cache rejected as a whole when it was
+// written for another executable or another cache version, or when it is
+// corrupt. Cut short at every byte, it is either rejected or loaded with a
+// leading part of its addresses, never with a wrong one.
+
+#include "../Common/AddressCache.h"
+#include "PeFixture.h"
+#include "TestUtil.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+
+static ImageFingerprint g_fingerprint;
+
+static std::string ReadFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+static void WriteFile(const std::string& path, const std::string& contents) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << contents;
+}
+
+// text with the first occurrence of from replaced by to
+static std::string Replace(std::string text, const char* from, const char* to) {
+    size_t at = text.find(from);
+    CHECK(at != std::string::npos);
+    return text.replace(at, strlen(from), to);
+}
+
+static AddressCache SampleCache() {
+    AddressCache cache;
+    cache.fingerprint = g_fingerprint;
+    cache.scanMicroseconds = 12345;
+    SetCachedAddress(cache, "WindowWidth", 0x1A2B3C);
+    SetCachedAddress(cache, "WindowHeight", 0x1A2B44);
+    SetCachedAddress(cache, "BackBufferWidth", 0xFFFFFFFF);
+    SetCachedAddress(cache, "BackBufferHeight", 0);
+    return cache;
+}
+
+static void TestFingerprint() {
+    PeFixture fixture;
+    CHECK(BuildPeFixture(0x3000, 0x1000, 0x800, 1, fixture));
+    CHECK(FingerprintImage(fixture.image, g_fingerprint));
+    CHECK_EQ(g_fingerprint.timeDateStamp, FIXTURE_TIMESTAMP);
+    CHECK_EQ(g_fingerprint.sizeOfImage, fixture.image.sizeOfImage);
+    CHECK_EQ(g_fingerprint.checkSum, fixture.image.checkSum);
+
+    // The section contents are not part of it; the section table is
+    PeFixture reseeded;
+    CHECK(BuildPeFixture(0x3000, 0x1000, 0x800, 2, reseeded));
+    ImageFingerprint same;
+    CHECK(FingerprintImage(reseeded.image, same));
+    CHECK(same.headerHash == g_fingerprint.headerHash);
+
+    PeFixture resized;
+    CHECK(BuildPeFixture(0x3000, 0x1200, 0x800, 1, resized));
+    ImageFingerprint other;
+    CHECK(FingerprintImage(resized.image, other));
+    CHECK(other.headerHash != g_fingerprint.headerHash);
+
+    // The headers must be inside the view
+    PeImage headerless = fixture.image;
+    headerless.size = headerless.sizeOfHeaders - 1;
+    CHECK(!FingerprintImage(headerless, other));
+}
+
+static void TestRoundTrip() {
+    std::string path = TestFilePath("AddressCacheTest.cache");
+    AddressCache saved = SampleCache();
+    CHECK(SaveAddressCache(path.c_str(), saved));
+
+    AddressCache loaded;
+    CHECK(LoadAddressCache(path.c_str(), g_fingerprint, loaded));
+    CHECK(loaded.fingerprint.headerHash == g_fingerprint.headerHash);
+    CHECK_EQ(loaded.fingerprint.timeDateStamp, g_fingerprint.timeDateStamp);
+    CHECK_EQ(loaded.scanMicroseconds, 12345);
+    CHECK_EQ(loaded.entries.size(), saved.entries.size());
+    for (const CachedAddress& entry : saved.entries) {
+        const CachedAddress* found = FindCachedAddress(loaded, entry.name.c_str());
+        CHECK(found);
+        CHECK_EQ(found->rva, entry.rva);
+    }
+    CHECK(!FindCachedAddress(loaded, "Missing"));
+
+    // Setting a name again replaces its address
+    SetCachedAddress(loaded, "WindowWidth", 7);
+    CHECK_EQ(loaded.entries.size(), saved.entries.size());
+    CHECK_EQ(FindCachedAddress(loaded, "WindowWidth")->rva, 7);
+
+    // Written by hand, with a Windows line ending and a comment
+    WriteFile(path, Replace(ReadFile(path), "ScanMicroseconds=12345\n", "# scan\r\nScanMicroseconds=12345\r\n"));
+    CHECK(LoadAddressCache(path.c_str(), g_fingerprint, loaded));
+    CHECK_EQ(loaded.scanMicroseconds, 12345);
+
+    remove(path.c_str());
+    CHECK(!LoadAddressCache(path.c_str(), g_fingerprint, loaded));
+    CHECK(loaded.entries.empty());
+}
+
+static void TestMismatch() {
+    std::string path = TestFilePath("AddressCacheTest.cache");
+    CHECK(SaveAddressCache(path.c_str(), SampleCache()));
+    std::string contents = ReadFile(path);
+
+    // Another build of the executable
+    AddressCache loaded;
+    ImageFingerprint other = g_fingerprint;
+    other.timeDateStamp++;
+    CHECK(!LoadAddressCache(path.c_str(), other, loaded));
+    CHECK(loaded.entries.empty());
+    other = g_fingerprint;
+    other.sizeOfImage += 0x1000;
+    CHECK(!LoadAddressCache(path.c_str(), other, loaded));
+    other = g_fingerprint;
+    other.checkSum ^= 1;
+    CHECK(!LoadAddressCache(path.c_str(), other, loaded));
+    other = g_fingerprint;
+    other.headerHash ^= 1ull << 63;
+    CHECK(!LoadAddressCache(path.c_str(), other, loaded));
+    CHECK(loaded.entries.empty());
+
+    // Another cache version, or none
+    WriteFile(path, Replace(contents, "Version=1\n", "Version=2\n"));
+    CHECK(!LoadAddressCache(path.c_str(), g_fingerprint, loaded));
+    CHECK(loaded.entries.empty());
+    WriteFile(path, Replace(contents, "Version=1\n", ""));
+    CHECK(!LoadAddressCache(path.c_str(), g_fingerprint, loaded));
+
+    WriteFile(path, contents);
+    CHECK(LoadAddressCache(path.c_str(), g_fingerprint, loaded));
+    remove(path.c_str());
+}
+
+static void TestCorrupt() {
+    std::string path = TestFilePath("AddressCacheTest.cache");
+    CHECK(SaveAddressCache(path.c_str(), SampleCache()));
+    std::string contents = ReadFile(path);
+
+    static const char* const CORRUPTIONS[][2] = {
+        { "Address.WindowHeight=0x001A2B44", "Address.WindowHeight=0x001A2Bzz" },
+        { "Address.WindowHeight=0x001A2B44", "Address.WindowHeight=" },
+        { "Address.WindowHeight=0x001A2B44", "Address.WindowHeight=-1" },
+        { "Address.WindowHeight=0x001A2B44", "Address.WindowHeight=0x1001A2B44" },
+        { "Address.WindowHeight=0x001A2B44", "Address.WindowHeight 0x001A2B44" },
+        { "ScanMicroseconds=12345", "ScanMicroseconds= 12345" },
+        { "CheckSum=", "CheckSum=\x01\xFF" },
+    };
+    AddressCache loaded;
+    for (const auto& corruption : CORRUPTIONS) {
+        WriteFile(path, Replace(contents, corruption[0], corruption[1]));
+        if (LoadAddressCache(path.c_str(), g_fingerprint, loaded)) {
+            fprintf(stderr, "Loaded a cache with %s in place of %s\n", corruption[1], corruption[0]);
+            exit(1);
+        }
+        CHECK(loaded.entries.empty());
+    }
+
+    // A line longer than any the cache writes
+    WriteFile(path, contents + "Address." + std::string(300, 'A') + "=0x10\n");
+    CHECK(!LoadAddressCache(path.c_str(), g_fingerprint, loaded));
+
+    // Cut short anywhere: rejected, or loaded with the addresses written
+    // before the cut, each with its own value
+    AddressCache saved = SampleCache();
+    size_t loadedCount = 0;
+    for (size_t length = 0; length <= contents.size(); length++) {
+        WriteFile(path, contents.substr(0, length));
+        if (!LoadAddressCache(path.c_str(), g_fingerprint, loaded)) {
+            CHECK(loaded.entries.empty());
+            continue;
+        }
+        CHECK(contents[length - 1] == '\n');
+        CHECK(loaded.entries.size() <= saved.entries.size());
+        for (size_t i = 0; i < loaded.entries.size(); i++) {
+            CHECK(loaded.entries[i].name == saved.entries[i].name);
+            CHECK_EQ(loaded.entries[i].rva, saved.entries[i].rva);
+        }
+        loadedCount++;
+    }
+    // Cut after the fingerprint, after ScanMicroseconds and after each
+    // address
+    CHECK_EQ(loadedCount, saved.entries.size() + 2);
+    remove(path.c_str());
+}
+
+int main() {
+    TestFingerprint();
+    TestRoundTrip();
+    TestMismatch();
+    TestCorrupt();
+    puts("AddressCacheTest passed");
+    return 0;
+}
@@ -0,0 +1,121 @@
+// Overhead of the generated COM hook thunks, in ns per call, on a fake
+// object with a hand-built vtable (FakeCom.h). Each call loads the entry
+// from the vtable and calls it, as the game's code does, so the baseline is
+// the unhooked method and the rest is what a hook adds:
+//   - a hand-written hook: a global original pointer and a detour function
+//   - the thunk with an empty handler
+//   - the thunk with a Pre handler that changes an argument
+//   - the same with the call timed into the hook statistics
+// for Present (four arguments) and DrawPrimitive (three).
+//
+// Usage: ComHookBench [scale]   (scale 1 = 50 million calls per row)
+
+#include "../Common/ComHook.h"
+#include "FakeCom.h"
+#include "TestUtil.h"
+
+// The thunks time the original call whenever the hook has a statistics
+// entry, so the untimed rows clear it after patching
+struct EmptyHandler : ComHookHandler {};
+
+struct PresentRectHandler : ComHookHandler {
+    static int rect[4];
+    static void Pre(IFakeDevice*, const void*&, const void*& destRect, void*&, const void*&) {
+        if (!destRect) destRect = rect;
+    }
+};
+int PresentRectHandler::rect[4];
+
+struct PrimitiveHandler : ComHookHandler {
+    static void Pre(IFakeDevice*, uint32_t&, uint32_t&, uint32_t& primitiveCount) {
+        if (!primitiveCount) primitiveCount = 1;
+    }
+};
+
+typedef ComHook<FakePresent, EmptyHandler> EmptyPresentHook;
+typedef ComHook<FakeDrawPrimitive, EmptyHandler> EmptyDrawPrimitiveHook;
+typedef ComHook<FakePresent, PresentRectHandler> PresentHook;
+typedef ComHook<FakeDrawPrimitive, PrimitiveHandler> DrawPrimitiveHook;
+
+// What every hook in the DLLs looked like before ComHook
+static FakePresent::Function g_originalPresent;
+static int32_t COM_CALL HandWrittenPresent(IFakeDevice* self, const void* sourceRect, const void* destRect,
+    void* window, const void* dirtyRegion) {
+    if (!destRect) destRect = PresentRectHandler::rect;
+    return g_originalPresent(self, sourceRect, destRect, window, dirtyRegion);
+}
+
+static FakeDrawPrimitive::Function g_originalDrawPrimitive;
+static int32_t COM_CALL HandWrittenDrawPrimitive(IFakeDevice* self, uint32_t type, uint32_t startVertex,
+    uint32_t primitiveCount) {
+    if (!primitiveCount) primitiveCount = 1;
+    return g_originalDrawPrimitive(self, type, startVertex, primitiveCount);
+}
+
+template <typename M>
+static void HookByHand(FakeDevice& device, typename M::Function detour, typename M::Function& original) {
+    original = ComVtableEntry<M>(device.Com());
+    device.table[M::slot] = reinterpret_cast<void*>(detour);
+}
+
+static uint64_t g_calls;
+
+static double TimePresent(FakeDevice& device) {
+    IFakeDevice* object = device.Com();
+    double start = NowSeconds();
+    for (uint64_t i = 0; i < g_calls; i++) {
+        CallThroughVtable<FakePresent>(object, nullptr, nullptr, nullptr, nullptr);
+    }
+    return (NowSeconds() - start) * 1e9 / g_calls;
+}
+
+static double TimeDrawPrimitive(FakeDevice& device) {
+    IFakeDevice* object = device.Com();
+    double start = NowSeconds();
+    for (uint64_t i = 0; i < g_calls; i++) {
+        CallThroughVtable<FakeDrawPrimitive>(object, 4u, (uint32_t)i, 2u);
+    }
+    return (NowSeconds() - start) * 1e9 / g_calls;
+}
+
+static void Report(const char* label, double presentNs, double drawNs, double basePresent, double baseDraw) {
+    printf("%-32s Present %6.2f ns (+%5.2f)   DrawPrimitive %6.2f ns (+%5.2f)\n", label,
+        presentNs, presentNs - basePresent, drawNs, drawNs - baseDraw);
+}
+
+int main(int argc, char** argv) {
+    g_calls = (uint64_t)(50e6 * BenchScale(argc, argv));
+    if (!g_calls) g_calls = 1;
+
+    FakeDevice plain;
+    double basePresent = TimePresent(plain);
+    double baseDraw = TimeDrawPrimitive(plain);
+    Report("unhooked", basePresent, baseDraw, basePresent, baseDraw);
+
+    FakeDevice byHand;
+    HookByHand<FakePresent>(byHand, &HandWrittenPresent, g_originalPresent);
+    HookByHand<FakeDrawPrimitive>(byHand, &HandWrittenDrawPrimitive, g_originalDrawPrimitive);
+    Report("hand-written detour", TimePresent(byHand), TimeDrawPrimitive(byHand), basePresent, baseDraw);
+
+    FakeDevice empty;
+    CHECK(EmptyPresentHook::PatchVtable("Bench::Present", empty.Com()));
+    CHECK(EmptyDrawPrimitiveHook::PatchVtable("Bench::DrawPrimitive", empty.Com()));
+    EmptyPresentHook::stats = HOOK_STATS_NONE;
+    EmptyDrawPrimitiveHook::stats = HOOK_STATS_NONE;
+    Report("ComHook, empty handler", TimePresent(empty), TimeDrawPrimitive(empty), basePresent, baseDraw);
+
+    FakeDevice withPre;
+    CHECK(PresentHook::PatchVtable("Bench::Present", withPre.Com()));
+    CHECK(DrawPrimitiveHook::PatchVtable("Bench::DrawPrimitive", withPre.Com()));
+    PresentHook::stats = HOOK_STATS_NONE;
+    DrawPrimitiveHook::stats = HOOK_STATS_NONE;
+    Report("ComHook, Pre handler", TimePresent(withPre), TimeDrawPrimitive(withPre), basePresent, baseDraw);
+    CHECK(withPre.lastDestRect == PresentRectHandler::rect);
+
+    PresentHook::stats = HookStatsRegister("Bench::Present");
+    DrawPrimitiveHook::stats = HookStatsRegister("Bench::DrawPrimitive");
+    Report("ComHook, Pre handler, timed", TimePresent(withPre), TimeDrawPrimitive(withPre), basePresent, baseDraw);
+
+    CHECK_EQ(withPre.presents, 2 * g_calls);
+    return 0;
+}
@@ -0,0 +1,117 @@
+// Checks of the generated COM hook thunks on a fake object with a
+// hand-built vtable: Pre sees and can change the arguments before the
+// original runs, Post sees the result, Skip drops the call, methods without
+// a result work, and patching a slot twice does not make the hook call
+// itself.
+
+#include "../Common/ComHook.h"
+#include "FakeCom.h"
+#include "TestUtil.h"
+#include <string>
+
+static std::string g_order;
+static uint32_t g_postPrimitives;
+
+struct DoublingHandler : ComHookHandler {
+    static void Pre(IFakeDevice*, uint32_t&, uint32_t&, uint32_t& primitiveCount) {
+        g_order += "pre ";
+        primitiveCount *= 2;
+    }
+
+    static void Post(int32_t& result, IFakeDevice*, uint32_t&, uint32_t&, uint32_t& primitiveCount) {
+        g_order += "post ";
+        g_postPrimitives = primitiveCount;
+        result = 7;
+    }
+};
+
+typedef ComHook<FakeDrawPrimitive, DoublingHandler> DrawPrimitiveHook;
+
+static int g_rect[4];
+static bool g_drop;
+
+struct PresentHandler : ComHookHandler {
+    template <typename... Rest>
+    static bool Skip(int32_t& result, IFakeDevice*, Rest&...) {
+        result = 99;
+        return g_drop;
+    }
+
+    static void Pre(IFakeDevice*, const void*&, const void*& destRect, void*&, const void*&) {
+        if (!destRect) destRect = g_rect;
+    }
+};
+
+typedef ComHook<FakePresent, PresentHandler> PresentHook;
+
+static uint64_t g_gammaPre;
+static uint64_t g_gammaPost;
+
+struct GammaHandler : ComHookHandler {
+    template <typename... Args>
+    static void Pre(Args&...) { g_gammaPre++; }
+
+    template <typename... Args>
+    static void Post(Args&...) { g_gammaPost++; }
+};
+
+typedef ComHook<FakeSetGammaRamp, GammaHandler> SetGammaRampHook;
+
+static void TestPreAndPost() {
+    FakeDevice device;
+    CHECK(DrawPrimitiveHook::PatchVtable("Test::DrawPrimitive", device.Com()));
+    CHECK(DrawPrimitiveHook::original == reinterpret_cast<FakeDrawPrimitive::Function>(&FakeComDetail::DrawPrimitive));
+    CHECK(device.table[FakeDrawPrimitive::slot] == reinterpret_cast<void*>(&DrawPrimitiveHook::Thunk));
+
+    int32_t result = CallThroughVtable<FakeDrawPrimitive>(device.Com(), 4u, 0u, 10u);
+    CHECK(g_order == "pre post ");
+    CHECK_EQ(device.primitives, 20);
+    CHECK_EQ(g_postPrimitives, 20);
+    CHECK_EQ(result, 7);
+
+    // Patching again leaves the original alone instead of pointing it at the thunk
+    CHECK(DrawPrimitiveHook::PatchVtable("Test::DrawPrimitive", device.Com()));
+    CHECK(DrawPrimitiveHook::original == reinterpret_cast<FakeDrawPrimitive::Function>(&FakeComDetail::DrawPrimitive));
+    CallThroughVtable<FakeDrawPrimitive>(device.Com(), 4u, 0u, 1u);
+    CHECK_EQ(device.primitives, 22);
+
+    // Other slots are untouched
+    CallThroughVtable<FakeSetGammaRamp>(device.Com(), 0u, 0u, nullptr);
+    CHECK_EQ(device.gammaRamps, 1);
+}
+
+static void TestSkip() {
+    FakeDevice device;
+    device.presentResult = 3;
+    CHECK(PresentHook::PatchVtable("Test::Present", device.Com()));
+
+    CHECK_EQ(CallThroughVtable<FakePresent>(device.Com(), nullptr, nullptr, nullptr, nullptr), 3);
+    CHECK_EQ(device.presents, 1);
+    CHECK(device.lastDestRect == g_rect);
+
+    int own[4];
+    CallThroughVtable<FakePresent>(device.Com(), nullptr, (const void*)own, nullptr, nullptr);
+    CHECK(device.lastDestRect == own);
+
+    g_drop = true;
+    CHECK_EQ(CallThroughVtable<FakePresent>(device.Com(), nullptr, nullptr, nullptr, nullptr), 99);
+    CHECK_EQ(device.presents, 2);
+    g_drop = false;
+}
+
+static void TestVoidMethod() {
+    FakeDevice device;
+    CHECK(SetGammaRampHook::PatchVtable("Test::SetGammaRamp", device.Com()));
+    CallThroughVtable<FakeSetGammaRamp>(device.Com(), 0u, 1u, nullptr);
+    CHECK_EQ(g_gammaPre, 1);
+    CHECK_EQ(g_gammaPost, 1);
+    CHECK_EQ(device.gammaRamps, 1);
+}
+
+int main() {
+    TestPreAndPost();
+    TestSkip();
+    TestVoidMethod();
+    puts("ComHookTest passed");
+    return 0;
+}
@@ -0,0 +1,247 @@
+// Checks of the standalone hook's Direct3D 9 hooks (DeviceHooks.cpp) on mock
+// devices: CreateDevice and Reset get the configured backbuffer, letterboxed
+// to the game's aspect ratio with Letterbox=1, the window is attached and the
+// viewport set once per device or Reset, Present issues the Reset the window
+// manager asks for, caps the frame rate and throttles in the background.
+//
+// The hooks read the ini once per process, so each scenario is a run of its
+// own: DeviceHooksTest default|letterbox|framecap|background.
+
+#include "../PeggleResolutionHookStandalone/DeviceHooks.h"
+#include "../Common/HookRegistry.h"
+#include "MockCom.h"
+#include "MockWin32.h"
+#include "TestUtil.h"
+#include <cstring>
+
+static HWND g_window;
+
+// The hooks installed on a fresh IDirect3D9, and a window for the device
+static MockDirect3D9* HookDirect3D() {
+    MockDirect3D9* d3d = new MockDirect3D9();
+    CHECK(RequestCreateDeviceHook(d3d));
+    CHECK_EQ(HookCommit(), 1);
+    g_window = MockCreateWindow(100, 50, 800, 600);
+    MockSetForegroundWindow(g_window);
+    return d3d;
+}
+
+// A windowed device of the size Peggle asks for
+static MockDevice9* CreateDevice(IDirect3D9* d3d, UINT width, UINT height) {
+    D3DPRESENT_PARAMETERS params = {};
+    params.BackBufferWidth = width;
+    params.BackBufferHeight = height;
+    params.BackBufferFormat = D3DFMT_X8R8G8B8;
+    params.hDeviceWindow = g_window;
+    params.Windowed = TRUE;
+
+    IDirect3DDevice9* device = nullptr;
+    CHECK_EQ(d3d->CreateDevice(0, D3DDEVTYPE_HAL, g_window, D3DCREATE_HARDWARE_VERTEXPROCESSING, &params, &device),
+        D3D_OK);
+    // The game sees the parameters the device was created with, as it does
+    // from Direct3D itself
+    CHECK_EQ(params.BackBufferWidth, static_cast<MockDevice9*>(device)->params.BackBufferWidth);
+    return static_cast<MockDevice9*>(device);
+}
+
+static void Present(IDirect3DDevice9* device) {
+    CHECK_EQ(device->Present(nullptr, nullptr, nullptr, nullptr), D3D_OK);
+}
+
+static void CheckRect(const RECT& rect, LONG left, LONG top, LONG right, LONG bottom) {
+    CHECK_EQ(rect.left, left);
+    CHECK_EQ(rect.top, top);
+    CHECK_EQ(rect.right, right);
+    CHECK_EQ(rect.bottom, bottom);
+}
+
+// No ini: the default client area, stretched
+static void TestDefault() {
+    MockDirect3D9* d3d = HookDirect3D();
+    MockDevice9* device = CreateDevice(d3d, 800, 600);
+    CHECK_EQ(d3d->Calls(ComSlot::IDirect3D9::CreateDevice), 1);
+    CHECK_EQ(device->params.BackBufferWidth, 1280);
+    CHECK_EQ(device->params.BackBufferHeight, 960);
+    CHECK(device->params.Windowed);
+
+    MockWindowManagerState& manager = MockWindowManager();
+    CHECK(manager.window == g_window);
+    CHECK_EQ(manager.attaches, 1);
+    CHECK_EQ(manager.clientWidth, 1280);
+    CHECK_EQ(manager.clientHeight, 960);
+    CheckRect(manager.imageRect, 0, 0, 1280, 960);
+
+    // The viewport covers the backbuffer, set by the first Present only
+    Present(device);
+    Present(device);
+    CHECK_EQ(device->Calls(ComSlot::IDirect3DDevice9::Present), 2);
+    CHECK_EQ(device->Calls(ComSlot::IDirect3DDevice9::SetViewport), 1);
+    CHECK_EQ(device->viewport.Width, 1280);
+    CHECK_EQ(device->viewport.Height, 960);
+    CHECK(!device->hasDestRect);
+
+    // A geometry change: Present resets with the game's parameters, forced
+    // again, and sets the viewport anew
+    manager.resetRequested = true;
+    Present(device);
+    CHECK_EQ(device->Calls(ComSlot::IDirect3DDevice9::Reset), 1);
+    CHECK_EQ(manager.resets, 1);
+    CHECK_EQ(device->params.BackBufferWidth, 1280);
+    Present(device);
+    CHECK_EQ(device->Calls(ComSlot::IDirect3DDevice9::Reset), 1);
+    CHECK_EQ(device->Calls(ComSlot::IDirect3DDevice9::SetViewport), 2);
+
+    // A Reset that fails is not counted
+    device->resetResult = D3DERR_DEVICELOST;
+    manager.resetRequested = true;
+    Present(device);
+    CHECK_EQ(device->Calls(ComSlot::IDirect3DDevice9::Reset), 2);
+    CHECK_EQ(manager.resets, 1);
+    device->resetResult = D3D_OK;
+
+    // The game's own Reset
+    D3DPRESENT_PARAMETERS params = device->params;
+    params.BackBufferWidth = 1024;
+    params.BackBufferHeight = 768;
+    CHECK_EQ(static_cast<IDirect3DDevice9*>(device)->Reset(&params), D3D_OK);
+    CHECK_EQ(device->params.BackBufferWidth, 1280);
+    CHECK_EQ(device->params.BackBufferHeight, 960);
+    CHECK_EQ(manager.imageRectUpdates, 1);
+    Present(device);
+    CHECK_EQ(device->Calls(ComSlot::IDirect3DDevice9::SetViewport), 3);
+    device->Release();
+
+    // A recreated device shares the vtable: nothing new to hook, and the
+    // hooks stay in place
+    device = CreateDevice(d3d, 800, 600);
+    CHECK_EQ(HookCommit(), 0);
+    CHECK_EQ(device->params.BackBufferWidth, 1280);
+    Present(device);
+    CHECK_EQ(device->Calls(ComSlot::IDirect3DDevice9::SetViewport), 1);
+    CHECK_EQ(manager.attaches, 2);
+    device->Release();
+    d3d->Release();
+}
+
+static void TestLetterbox() {
+    MockSetIni("Settings", "Width", "1600");
+    MockSetIni("Settings", "Height", "900");
+    MockSetIni("Settings", "Letterbox", "1");
+
+    // 4:3 in 16:9: pillarboxed in the middle
+    MockDirect3D9* d3d = HookDirect3D();
+    MockDevice9* device = CreateDevice(d3d, 800, 600);
+    CHECK_EQ(device->params.BackBufferWidth, 1200);
+    CHECK_EQ(device->params.BackBufferHeight, 900);
+    CheckRect(MockWindowManager().imageRect, 200, 0, 1400, 900);
+    CHECK_EQ(MockWindowManager().clientWidth, 1600);
+
+    Present(device);
+    CHECK(device->hasDestRect);
+    CheckRect(device->destRect, 200, 0, 1400, 900);
+    CHECK_EQ(device->viewport.Width, 1200);
+
+    // A destination of the game's own is left alone
+    RECT dest = { 0, 0, 10, 10 };
+    CHECK_EQ(device->Present(nullptr, &dest, nullptr, nullptr), D3D_OK);
+    CheckRect(device->destRect, 0, 0, 10, 10);
+
+    // A backbuffer the size of the window has no aspect ratio to keep
+    D3DPRESENT_PARAMETERS params = device->params;
+    params.BackBufferWidth = 0;
+    params.BackBufferHeight = 0;
+    CHECK_EQ(static_cast<IDirect3DDevice9*>(device)->Reset(&params), D3D_OK);
+    CHECK_EQ(device->params.BackBufferWidth, 1600);
+    CheckRect(MockWindowManager().imageRect, 0, 0, 1600, 900);
+    Present(device);
+    CHECK(!device->hasDestRect);
+    CHECK_EQ(device->viewport.Width, 1600);
+
+    device->Release();
+    d3d->Release();
+}
+
+static void TestFrameCap() {
+    MockSetIni("Settings", "FrameCap", "100");
+
+    MockDirect3D9* d3d = HookDirect3D();
+    MockDevice9* device = CreateDevice(d3d, 800, 600);
+    Present(device);
+    double start = NowSeconds();
+    for (int i = 0; i < 20; i++) Present(device);
+    double elapsed = NowSeconds() - start;
+    CHECK_EQ(device->Calls(ComSlot::IDirect3DDevice9::Present), 21);
+    CHECK(elapsed >= 0.19);
+    CHECK(elapsed < 1.0);
+
+    device->Release();
+    d3d->Release();
+}
+
+// BackgroundFps defaults to 10 and SkipMinimized to 1
+static void TestBackground() {
+    MockDirect3D9* d3d = HookDirect3D();
+    MockDevice9* device = CreateDevice(d3d, 800, 600);
+    MockWindowManagerState& manager = MockWindowManager();
+
+    // Active: nothing held
+    double start = NowSeconds();
+    for (int i = 0; i < 5; i++) Present(device);
+    CHECK(NowSeconds() - start < 0.05);
+    CHECK_EQ(manager.waits, 0);
+
+    // Inactive: presented at 10 fps, waiting on the window
+    manager.activity = WINDOW_INACTIVE;
+    start = NowSeconds();
+    for (int i = 0; i < 3; i++) Present(device);
+    CHECK(NowSeconds() - start >= 0.19);
+    CHECK_EQ(device->Calls(ComSlot::IDirect3DDevice9::Present), 8);
+    CHECK(manager.waits >= 2);
+
+    // Minimized: dropped before reaching the device
+    manager.activity = WINDOW_MINIMIZED;
+    Present(device);
+    Present(device);
+    CHECK_EQ(device->Calls(ComSlot::IDirect3DDevice9::Present), 8);
+
+    // Active but occluded, as Present reports it: held without a window to
+    // wait on, until a present succeeds again
+    manager.activity = WINDOW_ACTIVE;
+    device->presentResult = S_PRESENT_OCCLUDED;
+    CHECK_EQ(static_cast<IDirect3DDevice9*>(device)->Present(nullptr, nullptr, nullptr, nullptr), S_PRESENT_OCCLUDED);
+    unsigned waits = manager.waits;
+    start = NowSeconds();
+    device->presentResult = D3D_OK;
+    Present(device);
+    CHECK(NowSeconds() - start >= 0.09);
+    CHECK_EQ(manager.waits, waits);
+    start = NowSeconds();
+    Present(device);
+    CHECK(NowSeconds() - start < 0.05);
+    CHECK_EQ(device->Calls(ComSlot::IDirect3DDevice9::Present), 11);
+
+    device->Release();
+    d3d->Release();
+}
+
+int main(int argc, char** argv) {
+    const char* scenario = argc > 1 ? argv[1] : "default";
+    if (!strcmp(scenario, "default")) {
+        TestDefault();
+    }
+    else if (!strcmp(scenario, "letterbox")) {
+        TestLetterbox();
+    }
+    else if (!strcmp(scenario, "framecap")) {
+        TestFrameCap();
+    }
+    else if (!strcmp(scenario, "background")) {
+        TestBackground();
+    }
+    else {
+        fprintf(stderr, "Unknown scenario %s\n", scenario);
+        return 1;
+    }
+    printf("DeviceHooksTest %s passed\n", scenario);
+    return 0;
+}
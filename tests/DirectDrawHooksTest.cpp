@@ -0,0 +1,135 @@
+// Checks of the ddraw proxy's hooks (DirectDrawHooks.cpp) on mock DirectDraw
+// objects: SetDisplayMode of IDirectDraw and IDirectDraw7 sets the
+// configured mode and resizes the window, a DirectDraw 7 game asking for 16
+// bits gets a 32-bit display with RGB565 surfaces of its own, and its frame
+// blitted to the primary arrives scaled and converted through ScaledPresent.
+// With the proxy disabled every call passes through.
+
+#include "../ddraw/DirectDrawHooks.h"
+#include "../ddraw/ScaledPresent.h"
+#include "MockCom.h"
+#include "MockWin32.h"
+#include "TestUtil.h"
+
+constexpr DWORD GAME_WIDTH = 640;
+constexpr DWORD GAME_HEIGHT = 480;
+
+static HWND g_window;
+
+static void TestDisplayMode() {
+    MockDirectDraw* dd = new MockDirectDraw();
+    HookDirectDraw(dd);
+
+    // The original interface: the mode is overridden, the depth left alone
+    IDirectDraw* original = dd;
+    CHECK_EQ(original->SetDisplayMode(GAME_WIDTH, GAME_HEIGHT, 16), DD_OK);
+    CHECK_EQ(dd->width, 1280);
+    CHECK_EQ(dd->height, 720);
+    CHECK_EQ(dd->bpp, 16);
+    CHECK_EQ(MockLastWindowPos().calls, 1);
+    CHECK(MockLastWindowPos().hwnd == g_window);
+    CHECK_EQ(MockLastWindowPos().width, 1280);
+    CHECK_EQ(MockLastWindowPos().height, 720);
+
+    // DirectDraw 7 has its surfaces hooked, so 16 bits become 32
+    IDirectDraw7* dd7 = dd->directDraw7;
+    CHECK_EQ(dd7->SetDisplayMode(GAME_WIDTH, GAME_HEIGHT, 16, 0, 0), DD_OK);
+    CHECK_EQ(dd->directDraw7->width, 1280);
+    CHECK_EQ(dd->directDraw7->bpp, 32);
+    CHECK_EQ(MockLastWindowPos().calls, 2);
+    dd->Release();
+}
+
+static void TestScaledBlt() {
+    MockDirectDraw* dd = new MockDirectDraw();
+    HookDirectDraw(dd);
+    IDirectDraw7* dd7 = dd->directDraw7;
+    CHECK_EQ(dd7->SetDisplayMode(GAME_WIDTH, GAME_HEIGHT, 16, 0, 0), DD_OK);
+
+    DDSURFACEDESC2 desc = {};
+    desc.dwSize = sizeof(desc);
+    desc.dwFlags = DDSD_CAPS;
+    desc.ddsCaps.dwCaps = DDSCAPS_PRIMARYSURFACE;
+    IDirectDrawSurface7* primary = nullptr;
+    CHECK_EQ(dd7->CreateSurface(&desc, &primary, nullptr), DD_OK);
+    MockSurface7* primaryMock = static_cast<MockSurface7*>(primary);
+    CHECK_EQ(primaryMock->desc.dwWidth, 1280);
+    CHECK_EQ(primaryMock->desc.ddpfPixelFormat.dwRGBBitCount, 32);
+
+    // The game's back buffer takes the depth it asked for
+    desc = {};
+    desc.dwSize = sizeof(desc);
+    desc.dwFlags = DDSD_CAPS | DDSD_WIDTH | DDSD_HEIGHT;
+    desc.ddsCaps.dwCaps = DDSCAPS_OFFSCREENPLAIN;
+    desc.dwWidth = GAME_WIDTH;
+    desc.dwHeight = GAME_HEIGHT;
+    IDirectDrawSurface7* frame = nullptr;
+    CHECK_EQ(dd7->CreateSurface(&desc, &frame, nullptr), DD_OK);
+    MockSurface7* frameMock = static_cast<MockSurface7*>(frame);
+    CHECK_EQ(frameMock->desc.ddpfPixelFormat.dwRGBBitCount, 16);
+    CHECK_EQ(frameMock->desc.ddpfPixelFormat.dwRBitMask, 0xF800);
+    CHECK_EQ(frameMock->desc.ddpfPixelFormat.dwGBitMask, 0x07E0);
+
+    // A solid red frame
+    for (DWORD y = 0; y < GAME_HEIGHT; y++) {
+        uint16_t* row = reinterpret_cast<uint16_t*>(frameMock->Row(y));
+        for (DWORD x = 0; x < GAME_WIDTH; x++) row[x] = 0xF800;
+    }
+
+    // Blitted to the primary, it arrives from a 32-bit surface the size of
+    // the display, red all over
+    size_t created = dd->directDraw7->surfaces.size();
+    CHECK_EQ(primary->Blt(nullptr, frame, nullptr, DDBLT_WAIT, nullptr), DD_OK);
+    CHECK_EQ(dd->directDraw7->surfaces.size(), created + 1);
+    MockSurface7* scaled = dd->directDraw7->surfaces.back();
+    CHECK(primaryMock->bltSource == scaled);
+    CHECK_EQ(scaled->desc.dwWidth, 1280);
+    CHECK_EQ(scaled->desc.dwHeight, 720);
+    CHECK(primaryMock->bltCopied);
+    CHECK_EQ(primaryMock->Pixel32(0, 0) & 0xFFFFFF, 0xFF0000);
+    CHECK_EQ(primaryMock->Pixel32(640, 360) & 0xFFFFFF, 0xFF0000);
+    CHECK_EQ(primaryMock->Pixel32(1279, 719) & 0xFFFFFF, 0xFF0000);
+    CHECK_EQ(frameMock->locks, 0);
+    CHECK_EQ(scaled->locks, 0);
+
+    // The next frame reuses the scaled surface
+    CHECK_EQ(primary->Blt(nullptr, frame, nullptr, DDBLT_WAIT, nullptr), DD_OK);
+    CHECK_EQ(dd->directDraw7->surfaces.size(), created + 1);
+
+    // Blits between the game's own surfaces are left alone
+    CHECK_EQ(frame->Blt(nullptr, frame, nullptr, DDBLT_WAIT, nullptr), DD_OK);
+    CHECK(frameMock->bltSource == frame);
+
+    frame->Release();
+    primary->Release();
+    dd->Release();
+}
+
+static void TestDisabled() {
+    g_Enabled = false;
+    MockDirectDraw* dd = new MockDirectDraw();
+    HookDirectDraw(dd);
+    unsigned resizes = MockLastWindowPos().calls;
+
+    IDirectDraw* original = dd;
+    CHECK_EQ(original->SetDisplayMode(800, 600, 8), DD_OK);
+    CHECK_EQ(dd->width, 800);
+    CHECK_EQ(dd->height, 600);
+    CHECK_EQ(dd->bpp, 8);
+    CHECK_EQ(dd->directDraw7->SetDisplayMode(800, 600, 16, 0, 0), DD_OK);
+    CHECK_EQ(dd->directDraw7->bpp, 16);
+    CHECK_EQ(MockLastWindowPos().calls, resizes);
+    dd->Release();
+}
+
+int main() {
+    g_window = MockCreateWindow(0, 0, GAME_WIDTH, GAME_HEIGHT);
+    MockSetForegroundWindow(g_window);
+    ScaledPresentEnable(g_Scaling, g_ScaleFilter, 1, g_ConvertDepth);
+
+    TestDisplayMode();
+    TestScaledBlt();
+    TestDisabled();
+    puts("DirectDrawHooksTest passed");
+    return 0;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include "../Common/ComVtable.h"
+
+// A fake COM object with a hand-built vtable, laid out as the game sees a
+// Direct3D 9 device: the object starts with a pointer to an array of free
+// functions that take the object as their first argument. Only Present,
+// DrawPrimitive and SetGammaRamp are filled in, at their IDirect3DDevice9
+// slots; they count their calls and do nothing else, so a benchmark measures
+// the call path and not the method.
+//
+// Each FakeDevice has its own vtable, so one can be hooked while another
+// stays as it was.
+
+// Declares the methods for ComHook's type deduction; never instantiated
+struct IFakeDevice {
+    int32_t COM_CALL Present(const void* sourceRect, const void* destRect, void* window, const void* dirtyRegion);
+    int32_t COM_CALL DrawPrimitive(uint32_t type, uint32_t startVertex, uint32_t primitiveCount);
+    void COM_CALL SetGammaRamp(uint32_t swapChain, uint32_t flags, const void* ramp);
+};
+
+typedef ComMethod<decltype(&IFakeDevice::Present), ComSlot::IDirect3DDevice9::Present> FakePresent;
+typedef ComMethod<decltype(&IFakeDevice::DrawPrimitive), ComSlot::IDirect3DDevice9::DrawPrimitive> FakeDrawPrimitive;
+typedef ComMethod<decltype(&IFakeDevice::SetGammaRamp), ComSlot::IDirect3DDevice9::SetGammaRamp> FakeSetGammaRamp;
+
+struct FakeDevice {
+    void** vtable;
+    uint64_t presents = 0;
+    uint64_t primitives = 0;
+    uint64_t gammaRamps = 0;
+    int32_t presentResult = 0;
+    const void* lastDestRect = nullptr;
+    void* table[ComSlot::IDirect3DDevice9::Count] = {};
+
+    FakeDevice();
+    FakeDevice(const FakeDevice&) = delete;
+    FakeDevice& operator=(const FakeDevice&) = delete;
+
+    IFakeDevice* Com() { return reinterpret_cast<IFakeDevice*>(this); }
+};
+
+namespace FakeComDetail {
+
+inline FakeDevice* Self(IFakeDevice* self) {
+    return reinterpret_cast<FakeDevice*>(self);
+}
+
+__attribute__((noinline)) inline int32_t COM_CALL Present(IFakeDevice* self, const void*, const void* destRect,
+    void*, const void*) {
+    FakeDevice* device = Self(self);
+    device->presents++;
+    device->lastDestRect = destRect;
+    return device->presentResult;
+}
+
+__attribute__((noinline)) inline int32_t COM_CALL DrawPrimitive(IFakeDevice* self, uint32_t, uint32_t,
+    uint32_t primitiveCount) {
+    Self(self)->primitives += primitiveCount;
+    return 0;
+}
+
+__attribute__((noinline)) inline void COM_CALL SetGammaRamp(IFakeDevice* self, uint32_t, uint32_t, const void*) {
+    Self(self)->gammaRamps++;
+}
+
+} // namespace FakeComDetail
+
+inline FakeDevice::FakeDevice() : vtable(table) {
+    table[FakePresent::slot] = reinterpret_cast<void*>(&FakeComDetail::Present);
+    table[FakeDrawPrimitive::slot] = reinterpret_cast<void*>(&FakeComDetail::DrawPrimitive);
+    table[FakeSetGammaRamp::slot] = reinterpret_cast<void*>(&FakeComDetail::SetGammaRamp);
+}
+
+// Call a method the way compiled game code does: load the entry from the
+// object's vtable and call it with the object first.
+template <typename M, typename... Args>
+inline auto CallThroughVtable(IFakeDevice* object, Args... args)
+    -> decltype(ComVtableEntry<M>(object)(object, args...)) {
+    return ComVtableEntry<M>(object)(object, args...);
+}
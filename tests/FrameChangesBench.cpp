@@ -0,0 +1,78 @@
+// Rescaling only what changed against rescaling whole frames, replaying the
+// recorded Peggle frames (tests/traces/PeggleBoard.frames) from 800x600 to
+// 1920x1080 and 3840x2160, per filter on one thread: milliseconds per frame
+// for a full rescale, and for FrameChanges::Update plus a rescale of the
+// changes alone, with the mean number of tiles skipped per frame. The
+// frames are drawn up front, and rows are the fastest of up to five passes.
+//
+// Usage: FrameChangesBench [scale]   (scale 1 = 100 replays of the sequence
+// per row, in 5 passes)
+
+#include "../Common/FrameChanges.h"
+#include "../Common/ImageScaler.h"
+#include "FrameSequence.h"
+#include "ImageFixture.h"
+#include "TestUtil.h"
+#include <algorithm>
+
+static const uint32_t TARGETS[][2] = {
+    { 1920, 1080 },
+    { 3840, 2160 },
+};
+
+int main(int argc, char** argv) {
+    int replays = std::max(1, (int)(100 * BenchScale(argc, argv)));
+    int passes = std::min(BATCHES, replays);
+    int repeats = replays / passes;
+    FrameSequence sequence;
+    CHECK(LoadFrameSequence(PEGGLE_TRACE_DIR "/PeggleBoard.frames", sequence));
+
+    // Drawn up front so drawing is not timed
+    std::vector<TestImage> frames(sequence.frames.size());
+    for (size_t i = 0; i < frames.size(); i++) {
+        MakeImage(sequence.width, sequence.height, frames[i], 0);
+        if (i) {
+            frames[i].bytes = frames[i - 1].bytes;
+            frames[i].view.pixels = frames[i].bytes.data();
+        }
+        DrawFrame(sequence.frames[i], frames[i]);
+    }
+    size_t count = frames.size() * repeats;
+
+    for (const uint32_t* size : TARGETS) {
+        TestImage target;
+        MakeImage(size[0], size[1], target, 0);
+        for (ImageScaleFilter filter : BENCH_FILTERS) {
+            ImageScaler scaler;
+            double full = 1e9;
+            for (int pass = 0; pass < passes; pass++) {
+                double start = NowSeconds();
+                for (int repeat = 0; repeat < repeats; repeat++) {
+                    for (const TestImage& frame : frames) scaler.Scale(frame.view, target.view, filter);
+                }
+                full = std::min(full, (NowSeconds() - start) / count);
+            }
+
+            FrameChanges changes;
+            double partial = 1e9;
+            uint64_t skipped = 0;
+            for (int pass = 0; pass < passes; pass++) {
+                skipped = 0;
+                double start = NowSeconds();
+                for (int repeat = 0; repeat < repeats; repeat++) {
+                    for (const TestImage& frame : frames) {
+                        changes.Update(frame.view);
+                        scaler.Scale(frame.view, target.view, filter, &changes);
+                        skipped += changes.TileCount() - changes.ChangedCount();
+                    }
+                }
+                partial = std::min(partial, (NowSeconds() - start) / count);
+            }
+
+            printf("800x600 -> %4ux%-4u %-9s full %7.2f ms   changes %6.2f ms  %5.1fx   %3u of %u tiles skipped\n",
+                size[0], size[1], FilterName(filter), full * 1e3, partial * 1e3, full / partial,
+                (unsigned)(skipped / count), changes.TileCount());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,256 @@
+// Checks of dirty tile tracking (FrameChanges) and of rescaling only what
+// changed, on the recorded Peggle frames in tests/traces/PeggleBoard.frames:
+// the changed tiles of every frame against a tile by tile comparison with
+// the one before, and, for every filter, path and a pool of threads, a
+// target rescaled from the changes alone matching a full rescale frame after
+// frame. Also everything counting as changed after Invalidate and after a
+// change of size, format or palette, and a frame without changes leaving
+// the target alone.
+
+#include "../Common/FrameChanges.h"
+#include "../Common/ImageScaler.h"
+#include "../Common/WorkerPool.h"
+#include "FrameSequence.h"
+#include "ImageFixture.h"
+#include "TestUtil.h"
+#include <algorithm>
+#include <cstdint>
+
+static FrameSequence g_sequence;
+
+static bool TileDiffers(const TestImage& a, const TestImage& b, uint32_t column, uint32_t row) {
+    uint32_t left = column * FrameChanges::TILE_SIZE;
+    uint32_t top = row * FrameChanges::TILE_SIZE;
+    uint32_t right = std::min(left + FrameChanges::TILE_SIZE, a.view.width);
+    uint32_t bottom = std::min(top + FrameChanges::TILE_SIZE, a.view.height);
+    for (uint32_t y = top; y < bottom; y++) {
+        for (uint32_t x = left; x < right; x++) {
+            if (ImagePixel(a, x, y) != ImagePixel(b, x, y)) return true;
+        }
+    }
+    return false;
+}
+
+static void TestTileCounts() {
+    for (ImageScalePath path : SupportedScalePaths()) {
+        ImageScaleForcePath(path);
+        TestImage frame;
+        MakeImage(g_sequence.width, g_sequence.height, frame);
+        TestImage previous;
+        MakeImage(g_sequence.width, g_sequence.height, previous);
+
+        FrameChanges changes;
+        uint64_t skipped = 0;
+        for (size_t i = 0; i < g_sequence.frames.size(); i++) {
+            DrawFrame(g_sequence.frames[i], frame);
+            changes.Update(frame.view);
+            CHECK_EQ(changes.Width(), g_sequence.width);
+            CHECK_EQ(changes.Columns(), (g_sequence.width + FrameChanges::TILE_SIZE - 1) / FrameChanges::TILE_SIZE);
+            CHECK_EQ(changes.Rows(), (g_sequence.height + FrameChanges::TILE_SIZE - 1) / FrameChanges::TILE_SIZE);
+
+            if (i == 0) {
+                CHECK(changes.AllChanged());
+            }
+            else {
+                uint32_t changed = 0;
+                for (uint32_t row = 0; row < changes.Rows(); row++) {
+                    for (uint32_t column = 0; column < changes.Columns(); column++) {
+                        bool differs = TileDiffers(frame, previous, column, row);
+                        CHECK_EQ(changes.Changed(column, row), differs);
+                        changed += differs;
+                    }
+                }
+                CHECK_EQ(changes.ChangedCount(), changed);
+                if (g_sequence.frames[i].empty()) CHECK_EQ(changed, 0);
+            }
+            skipped += changes.TileCount() - changes.ChangedCount();
+            previous.bytes = frame.bytes;
+        }
+
+        // The flash changes everything; past the first frame, most frames
+        // change a few tiles
+        CHECK(skipped > (uint64_t)changes.TileCount() * (g_sequence.frames.size() - 3) * 9 / 10);
+    }
+    ImageScaleForcePath(ImageScaleDefaultPath());
+}
+
+// Replays the first frames of the sequence into a target rescaled from the
+// changes, checked against a full rescale of every frame
+static void ReplayPartial(ImageScaleFilter filter, uint32_t width, uint32_t height, WorkerPool* pool,
+    size_t frames = SIZE_MAX) {
+    TestImage frame;
+    MakeImage(g_sequence.width, g_sequence.height, frame);
+    TestImage partial;
+    MakeImage(width, height, partial);
+    TestImage full;
+    MakeImage(width, height, full);
+
+    ImageScaler partialScaler;
+    partialScaler.SetWorkerPool(pool);
+    ImageScaler fullScaler;
+    FrameChanges changes;
+    for (size_t i = 0; i < std::min(frames, g_sequence.frames.size()); i++) {
+        DrawFrame(g_sequence.frames[i], frame);
+        changes.Update(frame.view);
+        bool scaled = fullScaler.Scale(frame.view, full.view, filter);
+        CHECK_EQ(partialScaler.Scale(frame.view, partial.view, filter, &changes), scaled);
+        CHECK(PaddingIntact(partial));
+        if (scaled && !SamePixels(partial, full)) {
+            fprintf(stderr, "Filter %d, path %s, %u threads, %ux%u: frame %zu differs from a full rescale\n", filter,
+                ScalePathName(ImageScaleDefaultPath()), pool ? pool->Threads() + 1 : 1, width, height, i);
+            exit(1);
+        }
+    }
+}
+
+static void TestPartialMatchesFull() {
+    static const uint32_t TARGETS[][2] = {
+        { 1280, 960 },
+        { 800, 600 },
+        { 533, 400 },
+    };
+    static const ImageScaleFilter FILTERS[] = {
+        IMAGE_FILTER_BILINEAR,
+        IMAGE_FILTER_INTEGER,
+        IMAGE_FILTER_BICUBIC,
+        IMAGE_FILTER_LANCZOS3,
+    };
+
+    WorkerPool pool(2);
+    for (ImageScaleFilter filter : FILTERS) {
+        for (const uint32_t* size : TARGETS) ReplayPartial(filter, size[0], size[1], nullptr);
+        ReplayPartial(filter, 1920, 1080, &pool);
+
+        // The aiming and the start of the ball's fall, on every path
+        for (ImageScalePath path : SupportedScalePaths()) {
+            ImageScaleForcePath(path);
+            ReplayPartial(filter, 533, 400, nullptr, 30);
+        }
+        ImageScaleForcePath(ImageScaleDefaultPath());
+    }
+}
+
+static void TestInvalidate() {
+    TestImage frame;
+    MakeImage(g_sequence.width, g_sequence.height, frame);
+    DrawFrame(g_sequence.frames[0], frame);
+    TestImage target;
+    MakeImage(1280, 960, target);
+
+    ImageScaler scaler;
+    FrameChanges changes;
+    changes.Update(frame.view);
+    CHECK(scaler.Scale(frame.view, target.view, IMAGE_FILTER_BICUBIC, &changes));
+    TestImage expected = target;
+    expected.view.pixels = expected.bytes.data();
+
+    // Nothing changed: the target is left as it is
+    changes.Update(frame.view);
+    CHECK_EQ(changes.ChangedCount(), 0);
+    SetImagePixel(target, 5, 5, 0x12345678);
+    CHECK(scaler.Scale(frame.view, target.view, IMAGE_FILTER_BICUBIC, &changes));
+    CHECK_EQ(ImagePixel(target, 5, 5), 0x12345678);
+
+    // The target was lost, so whoever owns it invalidates the changes
+    FillRandom(target, 3);
+    changes.Invalidate();
+    changes.Update(frame.view);
+    CHECK(changes.AllChanged());
+    CHECK(scaler.Scale(frame.view, target.view, IMAGE_FILTER_BICUBIC, &changes));
+    CHECK(SamePixels(target, expected));
+
+    changes.Update(frame.view);
+    CHECK_EQ(changes.ChangedCount(), 0);
+}
+
+static void TestSizeAndFormat() {
+    TestImage frame;
+    MakeImage(g_sequence.width, g_sequence.height, frame);
+    DrawFrame(g_sequence.frames[0], frame);
+    FrameChanges changes;
+    changes.Update(frame.view);
+    changes.Update(frame.view);
+    CHECK_EQ(changes.ChangedCount(), 0);
+
+    // A window of the same pixels is a new size
+    ImageView smaller = frame.view;
+    smaller.width = 700;
+    smaller.height = 500;
+    changes.Update(smaller);
+    CHECK_EQ(changes.Columns(), 22);
+    CHECK_EQ(changes.Rows(), 16);
+    CHECK(changes.AllChanged());
+    changes.Update(smaller);
+    CHECK_EQ(changes.ChangedCount(), 0);
+
+    // The same bytes read as 16 bits per pixel
+    ImageView wide = frame.view;
+    wide.width = 2 * g_sequence.width;
+    wide.format = IMAGE_FORMAT_RGB565;
+    changes.Update(wide);
+    CHECK(changes.AllChanged());
+    CHECK_EQ(changes.Columns(), 50);
+    changes.Update(wide);
+    CHECK_EQ(changes.ChangedCount(), 0);
+    SetImagePixel(frame, 799, 599, 0);
+    changes.Update(wide);
+    CHECK_EQ(changes.ChangedCount(), 1);
+    CHECK(changes.Changed(49, 18));
+}
+
+static void TestPalette() {
+    TestImage frame;
+    MakeImage(256, 64, frame, 12, IMAGE_FORMAT_PALETTE8);
+    FillRandom(frame, 4);
+    uint32_t palette[256];
+    for (uint32_t i = 0; i < 256; i++) palette[i] = TexturePixel(i, 0, 9);
+    frame.view.palette = palette;
+
+    TestImage target;
+    MakeImage(640, 160, target);
+    TestImage full;
+    MakeImage(640, 160, full);
+    ImageScaler scaler;
+    ImageScaler fullScaler;
+    FrameChanges changes;
+    auto check = [&] {
+        CHECK(scaler.Scale(frame.view, target.view, IMAGE_FILTER_LANCZOS3, &changes));
+        CHECK(fullScaler.Scale(frame.view, full.view, IMAGE_FILTER_LANCZOS3));
+        CHECK(SamePixels(target, full));
+    };
+
+    changes.Update(frame.view);
+    CHECK(changes.AllChanged());
+    check();
+
+    // One index: one tile
+    ImageRow(frame, 40)[200] ^= 1;
+    changes.Update(frame.view);
+    CHECK_EQ(changes.ChangedCount(), 1);
+    CHECK(changes.Changed(6, 1));
+    check();
+
+    // One palette entry: every tile, though no index changed
+    palette[17] ^= 0xFF;
+    changes.Update(frame.view);
+    CHECK(changes.AllChanged());
+    check();
+    changes.Update(frame.view);
+    CHECK_EQ(changes.ChangedCount(), 0);
+    check();
+}
+
+int main() {
+    CHECK(LoadFrameSequence(PEGGLE_TRACE_DIR "/PeggleBoard.frames", g_sequence));
+    CHECK_EQ(g_sequence.width, 800);
+    CHECK_EQ(g_sequence.height, 600);
+    CHECK(g_sequence.frames.size() > 10);
+
+    TestTileCounts();
+    TestPartialMatchesFull();
+    TestInvalidate();
+    TestSizeAndFormat();
+    TestPalette();
+    puts("FrameChangesTest passed");
+    return 0;
+}
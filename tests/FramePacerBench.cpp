@@ -0,0 +1,112 @@
+// Jitter of the frame limiter: the interval between the frames it releases,
+// as mean, standard deviation and worst deviation from the target in us, and
+// the mean spin tail (the most each wait spends spinning). The game's work
+// per frame is random, from 10% to 60% of the interval.
+//   - simulated timers, so the numbers do not depend on the machine: the
+//     1 ms system timer (sleeps wake on the next tick, plus up to 100 us),
+//     and a high resolution waitable timer (wakes 50-500 us late)
+//   - the real clock of the tests (MockFrameClock.cpp, sleep_until)
+// at 60, 144 and 240 fps.
+//
+// Usage: FramePacerBench [scale]   (scale 1 = 20000 simulated frames and 600
+// real frames per row)
+
+#include "../Common/FrameClockWin32.h"
+#include "TestUtil.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Simulated timer: sleeps wake on the next multiple of tickNs after their
+// deadline (none for 0), then lateNs to lateNs + jitterNs later
+struct SimTimerClock : FrameClock {
+    int64_t now = 0;
+    int64_t tickNs;
+    int64_t lateNs;
+    int64_t jitterNs;
+    std::mt19937_64 random{ 1 };
+
+    SimTimerClock(int64_t tick, int64_t late, int64_t jitter) : tickNs(tick), lateNs(late), jitterNs(jitter) {}
+
+    int64_t Now() override { return now; }
+
+    void SleepUntil(int64_t deadline) override {
+        if (deadline > now) now = deadline;
+        if (tickNs) now = (now + tickNs - 1) / tickNs * tickNs;
+        now += lateNs + (int64_t)(random() % (uint64_t)(jitterNs + 1));
+    }
+
+    void Relax() override { now += 100; }
+};
+
+struct Jitter {
+    double mean;
+    double deviation;
+    double worst;
+    double tailUs;
+};
+
+// Work is spent on the clock: simulated, or busy-waited on the real one
+template <typename Clock, typename Spend>
+static Jitter Measure(Clock& clock, double fps, size_t frames, Spend spend) {
+    FramePacer pacer(clock);
+    pacer.SetFrameRate(fps);
+    std::mt19937 random(2);
+    std::uniform_int_distribution<int64_t> work(pacer.Interval() / 10, pacer.Interval() * 6 / 10);
+
+    std::vector<double> intervals;
+    intervals.reserve(frames);
+    double tail = 0.0;
+    pacer.Wait();
+    int64_t last = clock.Now();
+    for (size_t i = 0; i < frames; i++) {
+        spend(work(random));
+        pacer.Wait();
+        int64_t now = clock.Now();
+        intervals.push_back((now - last) / 1e3);
+        last = now;
+        tail += pacer.SpinTail() / 1e3;
+    }
+
+    Jitter result = {};
+    for (double interval : intervals) result.mean += interval;
+    result.mean /= frames;
+    double target = pacer.Interval() / 1e3;
+    for (double interval : intervals) {
+        result.deviation += (interval - result.mean) * (interval - result.mean);
+        result.worst = std::max(result.worst, std::fabs(interval - target));
+    }
+    result.deviation = std::sqrt(result.deviation / frames);
+    result.tailUs = tail / frames;
+    return result;
+}
+
+static void Report(const char* label, double fps, const Jitter& jitter) {
+    printf("%-26s %3.0f fps   mean %8.2f us   sd %7.2f us   worst %8.2f us   tail %6.1f us\n", label, fps,
+        jitter.mean, jitter.deviation, jitter.worst, jitter.tailUs);
+}
+
+int main(int argc, char** argv) {
+    double scale = BenchScale(argc, argv);
+    size_t simulated = std::max<size_t>((size_t)(20000 * scale), 10);
+    size_t real = std::max<size_t>((size_t)(600 * scale), 10);
+
+    static const double RATES[] = { 60.0, 144.0, 240.0 };
+    for (double fps : RATES) {
+        SimTimerClock tick(1000000, 0, 100000);
+        Report("1 ms system timer", fps, Measure(tick, fps, simulated, [&](int64_t ns) { tick.now += ns; }));
+
+        SimTimerClock highResolution(0, 50000, 450000);
+        Report("high resolution timer", fps,
+            Measure(highResolution, fps, simulated, [&](int64_t ns) { highResolution.now += ns; }));
+
+        Win32FrameClock clock;
+        Report("real clock", fps, Measure(clock, fps, real, [&](int64_t ns) {
+            int64_t end = clock.Now() + ns;
+            while (clock.Now() < end) {
+            }
+        }));
+    }
+    return 0;
+}
@@ -0,0 +1,170 @@
+// Checks of the frame limiter against a simulated clock: frames are released
+// on a fixed grid of deadlines whatever the work before them, the spin tail
+// grows at once to how late the sleeps wake and shrinks slowly back, a late
+// frame is not delayed and keeps the grid, and a hitch of more than a frame
+// restarts it.
+
+#include "../Common/FramePacer.h"
+#include "TestUtil.h"
+#include <random>
+
+constexpr int64_t MS = 1000000;
+constexpr int64_t US = 1000;
+constexpr int64_t RELAX_NS = 100;  // simulated time of one spin iteration
+
+// Time only moves when the pacer sleeps or spins, or the test says so.
+// Sleeps wake lateNs after their deadline.
+struct SimClock : FrameClock {
+    int64_t now = 0;
+    int64_t lateNs = 0;
+    unsigned sleeps = 0;
+    uint64_t relaxes = 0;
+
+    int64_t Now() override { return now; }
+
+    void SleepUntil(int64_t deadline) override {
+        sleeps++;
+        if (deadline > now) now = deadline;
+        now += lateNs;
+    }
+
+    void Relax() override {
+        relaxes++;
+        now += RELAX_NS;
+    }
+};
+
+static void TestOff() {
+    SimClock clock;
+    FramePacer pacer(clock);
+    pacer.Wait();
+    pacer.SetFrameRate(60.0);
+    pacer.SetFrameRate(0.0);
+    CHECK_EQ(pacer.Interval(), 0);
+    for (int i = 0; i < 10; i++) pacer.Wait();
+    CHECK_EQ(clock.now, 0);
+    CHECK_EQ(clock.sleeps, 0);
+}
+
+// Whatever the work, frame n is released at n intervals after the first
+static void TestGrid() {
+    SimClock clock;
+    FramePacer pacer(clock);
+    pacer.SetFrameRate(100.0);
+    CHECK_EQ(pacer.Interval(), 10 * MS);
+
+    clock.now = 5 * MS;
+    pacer.Wait();
+    CHECK_EQ(clock.now, 5 * MS);
+
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int64_t> work(0, 9 * MS);
+    for (int64_t frame = 1; frame <= 1000; frame++) {
+        clock.now += work(random);
+        pacer.Wait();
+        int64_t due = 5 * MS + frame * 10 * MS;
+        CHECK(clock.now >= due);
+        CHECK(clock.now < due + RELAX_NS);
+    }
+}
+
+static void TestSpinTail() {
+    SimClock clock;
+    FramePacer pacer(clock);
+    pacer.SetFrameRate(60.0);
+    pacer.Wait();
+    CHECK_EQ(pacer.SpinTail(), 1 * MS);
+
+    // Sleeps waking 300 us late are covered by the initial tail, and the
+    // deadline is met by spinning
+    clock.lateNs = 300 * US;
+    pacer.Wait();
+    CHECK_EQ(clock.sleeps, 1);
+    int64_t due = pacer.Interval();
+    CHECK(clock.now >= due && clock.now < due + RELAX_NS);
+
+    // 2 ms late misses the deadline once; the tail grows to cover it at once
+    clock.lateNs = 2 * MS;
+    clock.now += 1 * MS;
+    pacer.Wait();
+    CHECK(pacer.SpinTail() >= 2 * MS);
+    CHECK(clock.now - 2 * due < 2 * MS);
+
+    // Punctual sleeps: it shrinks by a sixteenth of the excess per frame...
+    clock.lateNs = 0;
+    int64_t before = pacer.SpinTail();
+    clock.now = 3 * due - 5 * MS;
+    pacer.Wait();
+    CHECK(pacer.SpinTail() < before);
+    CHECK(pacer.SpinTail() >= before - before / 16);
+
+    // ... down to its floor, so the spinning per frame ends up short
+    for (int i = 0; i < 200; i++) {
+        clock.now += 1 * MS;
+        pacer.Wait();
+    }
+    CHECK_EQ(pacer.SpinTail(), 50 * US);
+    uint64_t relaxes = clock.relaxes;
+    clock.now += 1 * MS;
+    pacer.Wait();
+    CHECK(clock.relaxes - relaxes <= (uint64_t)(50 * US / RELAX_NS) + 1);
+
+    // Never more than half an interval, however late the timer
+    pacer.SetFrameRate(1000.0);
+    pacer.Wait();
+    clock.lateNs = 5 * MS;
+    pacer.Wait();
+    CHECK_EQ(pacer.SpinTail(), 500 * US);
+}
+
+static void TestLateFrame() {
+    SimClock clock;
+    FramePacer pacer(clock);
+    pacer.SetFrameRate(100.0);
+    pacer.Wait();
+
+    // Half a frame late: released at once, and the next is due on the grid
+    clock.now = 15 * MS;
+    unsigned sleeps = clock.sleeps;
+    uint64_t relaxes = clock.relaxes;
+    pacer.Wait();
+    CHECK_EQ(clock.now, 15 * MS);
+    CHECK_EQ(clock.sleeps, sleeps);
+    CHECK_EQ(clock.relaxes, relaxes);
+    pacer.Wait();
+    CHECK(clock.now >= 20 * MS && clock.now < 20 * MS + RELAX_NS);
+}
+
+static void TestHitch() {
+    SimClock clock;
+    FramePacer pacer(clock);
+    pacer.SetFrameRate(100.0);
+    pacer.Wait();
+
+    // 100 ms stuck: the grid restarts instead of releasing ten frames at once
+    clock.now = 110 * MS;
+    pacer.Wait();
+    CHECK_EQ(clock.now, 110 * MS);
+    pacer.Wait();
+    CHECK(clock.now >= 120 * MS && clock.now < 120 * MS + RELAX_NS);
+    pacer.Wait();
+    CHECK(clock.now >= 130 * MS && clock.now < 130 * MS + RELAX_NS);
+
+    // A new rate restarts it as well
+    clock.now = 200 * MS;
+    pacer.SetFrameRate(50.0);
+    pacer.Wait();
+    CHECK_EQ(clock.now, 200 * MS);
+    pacer.Wait();
+    CHECK(clock.now >= 220 * MS && clock.now < 220 * MS + RELAX_NS);
+}
+
+int main() {
+    TestOff();
+    TestGrid();
+    TestSpinTail();
+    TestLateFrame();
+    TestHitch();
+    puts("FramePacerTest passed");
+    return 0;
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "ImageFixture.h"
+
+// Frame sequences for the dirty tile tests and benchmark, recorded as what
+// the game drew over the previous frame to make each one
+// (tests/traces/*.frames). The first line that is not blank or a # comment
+// gives the size, then each line is a frame:
+//
+//   size 800 600
+//   texture 0 0 800 600 1; rect 392 20 16 40 C0C0C0
+//   -
+//
+// with its draws separated by ';', or - for a frame that is drawn again
+// unchanged. texture x y w h seed fills a rectangle with noise that is the
+// same every time a pixel is drawn with the same seed, the way a background
+// is redrawn over a sprite that moved; rect x y w h color fills it with one
+// BGRX color in hex. Draws are clipped to the frame.
+
+struct FrameDraw {
+    bool texture;
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+    uint32_t value;  // seed or color
+};
+
+typedef std::vector<FrameDraw> FrameDraws;
+
+struct FrameSequence {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<FrameDraws> frames;
+};
+
+// Noise of a textured pixel (the MurmurHash3 finalizer of its position)
+inline uint32_t TexturePixel(uint32_t x, uint32_t y, uint32_t seed) {
+    uint32_t h = x * 0x9E3779B1u ^ y * 0x85EBCA77u ^ seed * 0xC2B2AE3Du;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// Prints the offending line and returns false on a draw it cannot read
+inline bool LoadFrameSequence(const char* path, FrameSequence& sequence) {
+    std::ifstream file(path);
+    if (!file) {
+        fprintf(stderr, "Cannot open frame sequence %s\n", path);
+        return false;
+    }
+
+    sequence = FrameSequence();
+    std::string line;
+    for (unsigned number = 1; std::getline(file, line); number++) {
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') continue;
+
+        if (!sequence.width) {
+            std::istringstream tokens(line);
+            std::string keyword;
+            if (!(tokens >> keyword >> sequence.width >> sequence.height) || keyword != "size" ||
+                !sequence.width || !sequence.height) {
+                fprintf(stderr, "%s:%u: expected the frame size\n", path, number);
+                return false;
+            }
+            continue;
+        }
+
+        FrameDraws frame;
+        std::istringstream draws(line);
+        std::string text;
+        while (std::getline(draws, text, ';')) {
+            std::istringstream tokens(text);
+            std::string kind;
+            if (!(tokens >> kind) || kind == "-") continue;
+
+            FrameDraw draw;
+            draw.texture = kind == "texture";
+            if ((!draw.texture && kind != "rect") ||
+                !(tokens >> draw.x >> draw.y >> draw.width >> draw.height >> std::hex >> draw.value)) {
+                fprintf(stderr, "%s:%u: cannot read draw %s\n", path, number, text.c_str());
+                return false;
+            }
+            frame.push_back(draw);
+        }
+        sequence.frames.push_back(frame);
+    }
+    return sequence.width != 0;
+}
+
+// Draw a frame over the previous one in a 32-bit image of the sequence's size
+inline void DrawFrame(const FrameDraws& draws, TestImage& image) {
+    for (const FrameDraw& draw : draws) {
+        uint32_t right = std::min(draw.x + draw.width, image.view.width);
+        uint32_t bottom = std::min(draw.y + draw.height, image.view.height);
+        for (uint32_t y = draw.y; y < bottom; y++) {
+            for (uint32_t x = draw.x; x < right; x++) {
+                SetImagePixel(image, x, y, draw.texture ? TexturePixel(x, y, draw.value) : draw.value);
+            }
+        }
+    }
+}
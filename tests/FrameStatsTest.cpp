@@ -0,0 +1,136 @@
+// Checks of the frame statistics recording (FrameStats.h): presents before
+// FrameStatsOpen are ignored; frames of a known length driven through
+// FrameStatsPresentBegin and FrameStatsPresentEnd come out, once
+// FrameStatsClose writes the partial window, as the CSV header and one row
+// with the frame count and ordered percentiles no shorter than the frames
+// were, and as a JSON file with the window and the session and every key;
+// and a reopened session starts over.
+
+#include "../Common/FrameStats.h"
+#include "TestUtil.h"
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr int FRAMES = 20;
+constexpr int PRESENT_MS = 2;  // inside the original Present
+constexpr int FRAME_MS = 5;    // from one present to the next, at least
+
+static const char* const CSV_HEADER =
+    "start_s,window_s,frames,fps,"
+    "interval_p50_ms,interval_p95_ms,interval_p99_ms,interval_p99.9_ms,interval_max_ms,"
+    "present_p50_ms,present_p95_ms,present_p99_ms,present_p99.9_ms,present_max_ms";
+
+static std::vector<std::string> ReadLines(const std::string& path) {
+    std::ifstream file(path);
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(file, line)) lines.push_back(line);
+    return lines;
+}
+
+static std::string ReadFile(const std::string& path) {
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+static std::vector<double> SplitCsv(const std::string& line) {
+    std::vector<double> fields;
+    std::istringstream tokens(line);
+    std::string field;
+    while (std::getline(tokens, field, ',')) fields.push_back(atof(field.c_str()));
+    return fields;
+}
+
+static void Present(int frames) {
+    for (int i = 0; i < frames; i++) {
+        FrameStatsPresentBegin();
+        std::this_thread::sleep_for(std::chrono::milliseconds(PRESENT_MS));
+        FrameStatsPresentEnd();
+        std::this_thread::sleep_for(std::chrono::milliseconds(FRAME_MS - PRESENT_MS));
+    }
+}
+
+// The number after "key": in the object named section
+static double JsonNumber(const std::string& json, const char* section, const char* key) {
+    size_t at = json.find(std::string("\"") + section + "\"");
+    CHECK(at != std::string::npos);
+    at = json.find(std::string("\"") + key + "\":", at);
+    CHECK(at != std::string::npos);
+    return atof(json.c_str() + json.find(':', at) + 1);
+}
+
+// p50 <= p95 <= p99 <= p99.9 <= max, the first no less than least
+static void CheckOrdered(const std::vector<double>& values, double least) {
+    CHECK(values[0] >= least);
+    for (size_t i = 1; i < values.size(); i++) CHECK(values[i] >= values[i - 1]);
+}
+
+static void TestSession() {
+    std::string csv = TestFilePath("FrameStatsTest.csv");
+    std::string json = TestFilePath("FrameStatsTest.json");
+
+    // Not open yet: nothing is recorded
+    Present(3);
+
+    CHECK(FrameStatsOpen(csv.c_str(), json.c_str(), 60));
+    CHECK(FrameStatsOpen(csv.c_str(), json.c_str(), 60));
+    Present(FRAMES);
+    FrameStatsClose();
+    Present(2);
+
+    std::vector<std::string> lines = ReadLines(csv);
+    CHECK_EQ(lines.size(), 2);
+    CHECK(lines[0] == CSV_HEADER);
+    std::vector<double> row = SplitCsv(lines[1]);
+    CHECK_EQ(row.size(), 14);
+    CHECK(row[0] == 0.0);
+    CHECK(row[1] >= FRAMES * FRAME_MS / 1000.0 * 0.9);
+    CHECK_EQ(row[2], FRAMES - 1);
+    CHECK(row[3] > 0.0 && row[3] <= 1000.0 / FRAME_MS);
+    CheckOrdered(std::vector<double>(row.begin() + 4, row.begin() + 9), FRAME_MS * 0.99);
+    CheckOrdered(std::vector<double>(row.begin() + 9, row.end()), PRESENT_MS * 0.99);
+
+    std::string text = ReadFile(json);
+    static const char* const KEYS[] = {
+        "\"window\":", "\"total\":", "\"start_s\":", "\"seconds\":", "\"frames\":", "\"fps\":",
+        "\"interval_ms\":", "\"present_ms\":", "\"mean\":", "\"p50\":", "\"p95\":", "\"p99\":",
+        "\"p99.9\":", "\"max\":",
+    };
+    for (const char* key : KEYS) {
+        if (text.find(key) == std::string::npos) {
+            fprintf(stderr, "%s is missing from %s\n", key, text.c_str());
+            exit(1);
+        }
+    }
+    CHECK(text.front() == '{');
+    CHECK(text.find_last_not_of("\n") == text.rfind('}'));
+    CHECK_EQ(JsonNumber(text, "window", "frames"), FRAMES - 1);
+    CHECK_EQ(JsonNumber(text, "total", "frames"), FRAMES - 1);
+    CHECK(JsonNumber(text, "window", "p50") >= FRAME_MS * 0.99);
+    CHECK(JsonNumber(text, "total", "max") >= JsonNumber(text, "total", "p99.9"));
+    CHECK(JsonNumber(text, "present_ms", "mean") >= PRESENT_MS * 0.99);
+
+    // A new session starts a new file and a new total
+    CHECK(FrameStatsOpen(csv.c_str(), json.c_str(), 60));
+    Present(5);
+    FrameStatsClose();
+    lines = ReadLines(csv);
+    CHECK_EQ(lines.size(), 2);
+    CHECK_EQ(SplitCsv(lines[1])[2], 4);
+    CHECK_EQ(JsonNumber(ReadFile(json), "total", "frames"), 4);
+
+    remove(csv.c_str());
+    remove(json.c_str());
+}
+
+int main() {
+    TestSession();
+    puts("FrameStatsTest passed");
+    return 0;
+}
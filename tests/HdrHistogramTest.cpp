@@ -0,0 +1,175 @@
+// Checks of the HDR histogram (HdrHistogram.h): values counted exactly below
+// the linear limit, buckets that tile the range without gaps or overlaps
+// across the linear/logarithmic boundary and every power of two above it,
+// each no wider than the stated precision; p50, p95, p99 and p99.9 of known
+// distributions within 2^-precisionBits of the exact order statistic; and
+// Add, Swap and Reset, and values above the maximum clamped to it.
+
+#include "../Common/HdrHistogram.h"
+#include "TestUtil.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+static const double PERCENTILES[] = { 50.0, 95.0, 99.0, 99.9 };
+
+// Upper end of the sub-bucket holding value: the median of value and the
+// (larger) maximum of the histogram
+static uint64_t UpperBound(HdrHistogram& histogram, uint64_t value, uint64_t maxValue) {
+    histogram.Reset();
+    histogram.Record(value);
+    histogram.Record(maxValue);
+    return histogram.Percentile(50.0);
+}
+
+static void TestBucketBoundaries() {
+    for (unsigned bits : { 1u, 3u, 7u }) {
+        uint64_t linear = 2ull << bits;
+        uint64_t limit = linear << 8;
+        uint64_t maxValue = limit * 4;
+        HdrHistogram histogram(maxValue, bits);
+
+        uint64_t previous = 0;
+        for (uint64_t value = 0; value < limit; value++) {
+            uint64_t upper = UpperBound(histogram, value, maxValue);
+            if (value < linear) CHECK_EQ(upper, value);
+            CHECK(upper >= value);
+            CHECK(upper >= previous);
+            // A new bucket starts right after the previous one ends
+            if (value && upper != previous) CHECK_EQ(value, previous + 1);
+            // and is no wider than value * 2^-bits
+            CHECK((upper - value) << bits <= value);
+            previous = upper;
+        }
+
+        // The first logarithmic buckets are two wide, and the width doubles
+        // at each power of two
+        CHECK_EQ(UpperBound(histogram, linear - 1, maxValue), linear - 1);
+        CHECK_EQ(UpperBound(histogram, linear, maxValue), linear + 1);
+        CHECK_EQ(UpperBound(histogram, linear + 1, maxValue), linear + 1);
+        CHECK_EQ(UpperBound(histogram, linear + 2, maxValue), linear + 3);
+        CHECK_EQ(UpperBound(histogram, 2 * linear, maxValue), 2 * linear + 3);
+    }
+}
+
+// Checks the histogram's percentiles against the sorted values: no lower
+// than the exact order statistic, and above it by at most its bucket width
+static void CheckPercentiles(const HdrHistogram& histogram, std::vector<uint64_t> values, unsigned bits) {
+    std::sort(values.begin(), values.end());
+    CHECK_EQ(histogram.Count(), values.size());
+    CHECK_EQ(histogram.Min(), values.front());
+    CHECK_EQ(histogram.Max(), values.back());
+
+    for (double percent : PERCENTILES) {
+        size_t rank = (size_t)(percent / 100.0 * values.size() + 0.5);
+        uint64_t exact = values[std::max<size_t>(rank, 1) - 1];
+        uint64_t reported = histogram.Percentile(percent);
+        if (reported < exact || (reported - exact) << bits > exact) {
+            fprintf(stderr, "p%g of %zu values: %llu, exact %llu\n", percent, values.size(),
+                (unsigned long long)reported, (unsigned long long)exact);
+            exit(1);
+        }
+    }
+    CHECK_EQ(histogram.Percentile(100.0), values.back());
+    uint64_t lowest = histogram.Percentile(0.0);
+    CHECK(lowest >= values.front() && (lowest - values.front()) << bits <= values.front());
+}
+
+static void TestKnownDistributions() {
+    for (unsigned bits : { 3u, 7u }) {
+        // Uniform: the n-th percentile of 1..100000 is n * 1000
+        HdrHistogram uniform(1000000, bits);
+        std::vector<uint64_t> values;
+        for (uint64_t value = 1; value <= 100000; value++) {
+            uniform.Record(value);
+            values.push_back(value);
+        }
+        CheckPercentiles(uniform, values, bits);
+        CHECK(uniform.Mean() == 50000.5);
+
+        // Frame times: most around 16.7 ms, a long tail of stutters, in us
+        std::mt19937 random(bits);
+        std::normal_distribution<double> frame(16667.0, 800.0);
+        std::exponential_distribution<double> stutter(1.0 / 40000.0);
+        HdrHistogram frames(60000000, bits);
+        values.clear();
+        for (int i = 0; i < 200000; i++) {
+            double time = i % 50 ? frame(random) : 16667.0 + stutter(random);
+            uint64_t value = (uint64_t)std::max(1.0, time);
+            frames.Record(value);
+            values.push_back(value);
+        }
+        CheckPercentiles(frames, values, bits);
+
+        // One value repeated: every percentile is that value
+        HdrHistogram constant(60000000, bits);
+        for (int i = 0; i < 1000; i++) constant.Record(16667);
+        for (double percent : PERCENTILES) CHECK_EQ(constant.Percentile(percent), 16667);
+    }
+}
+
+static void TestAddSwapReset() {
+    HdrHistogram all(1000000);
+    HdrHistogram even(1000000);
+    HdrHistogram odd(1000000);
+    std::mt19937 random(3);
+    for (int i = 0; i < 10000; i++) {
+        uint64_t value = random() % 500000;
+        all.Record(value);
+        (i % 2 ? odd : even).Record(value);
+    }
+
+    HdrHistogram sum(1000000);
+    sum.Add(even);
+    sum.Add(odd);
+    CHECK_EQ(sum.Count(), all.Count());
+    CHECK_EQ(sum.Min(), all.Min());
+    CHECK_EQ(sum.Max(), all.Max());
+    CHECK(sum.Mean() == all.Mean());
+    for (double percent : PERCENTILES) CHECK_EQ(sum.Percentile(percent), all.Percentile(percent));
+
+    // An empty histogram adds nothing, and leaves the minimum alone
+    HdrHistogram empty(1000000);
+    sum.Add(empty);
+    CHECK_EQ(sum.Count(), all.Count());
+    CHECK_EQ(sum.Min(), all.Min());
+    empty.Add(sum);
+    CHECK_EQ(empty.Min(), all.Min());
+    CHECK_EQ(empty.Percentile(99.0), all.Percentile(99.0));
+
+    // Swap exchanges everything, range included
+    HdrHistogram small(100, 3);
+    small.Record(7);
+    uint64_t p99 = all.Percentile(99.0);
+    all.Swap(small);
+    CHECK_EQ(all.Count(), 1);
+    CHECK_EQ(all.Min(), 7);
+    CHECK_EQ(all.Percentile(50.0), 7);
+    CHECK_EQ(small.Count(), 10000);
+    CHECK_EQ(small.Percentile(99.0), p99);
+    all.Record(1000);
+    CHECK_EQ(all.Max(), 100);
+    small.Record(999999);
+    CHECK_EQ(small.Max(), 999999);
+
+    // Reset empties it and keeps the range
+    small.Reset();
+    CHECK_EQ(small.Count(), 0);
+    CHECK_EQ(small.Min(), 0);
+    CHECK_EQ(small.Max(), 0);
+    CHECK(small.Mean() == 0.0);
+    CHECK_EQ(small.Percentile(50.0), 0);
+    small.Record(5);
+    small.Record(2000000);
+    CHECK_EQ(small.Min(), 5);
+    CHECK_EQ(small.Max(), 1000000);
+    CHECK_EQ(small.Percentile(50.0), 5);
+}
+
+int main() {
+    TestBucketBoundaries();
+    TestKnownDistributions();
+    TestAddSwapReset();
+    puts("HdrHistogramTest passed");
+    return 0;
+}
@@ -0,0 +1,196 @@
+// Checks of the shared hook statistics (HookStats.h) on a region backed by a
+// file, as on Linux: hooks registered and calls recorded before and after the
+// region is opened, from one thread and from more threads than there are
+// shards, read back through a second, read-only mapping with the reader API
+// with exact counts, totals, maximums and percentiles; the region named after
+// the process; and a region another module publishes left alone.
+//
+// HookStatsTest.shm is left behind for the PeggleHookStats viewer test.
+
+#include "../Common/HookStats.h"
+#include "TestUtil.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static const HookStatsSummary* Find(const std::vector<HookStatsSummary>& hooks, const char* name) {
+    for (const HookStatsSummary& hook : hooks) {
+        if (hook.name == name) return &hook;
+    }
+    return nullptr;
+}
+
+// The region as a viewer in another process sees it
+static std::vector<HookStatsSummary> ReadRegion(const char* name) {
+    HookStatsView view;
+    CHECK(HookStatsMap(name, view));
+    std::vector<HookStatsSummary> hooks;
+    uint64_t ticksPerSecond = 0;
+    CHECK(HookStatsRead(view.data, view.size, hooks, ticksPerSecond));
+    CHECK(ticksPerSecond > 0);
+    HookStatsUnmap(view);
+    CHECK(!view.data);
+    return hooks;
+}
+
+static void TestBuckets() {
+    using HookStatsDetail::BucketOf;
+    CHECK_EQ(BucketOf(0), 0);
+    CHECK_EQ(BucketOf(1), 1);
+    CHECK_EQ(BucketOf(2), 2);
+    CHECK_EQ(BucketOf(3), 2);
+    CHECK_EQ(BucketOf(4), 3);
+    CHECK_EQ(BucketOf(0xFFFFFFFFull), 32);
+    CHECK_EQ(BucketOf(0x100000000ull), 33);
+    CHECK_EQ(BucketOf(~0ull), HOOK_STATS_BUCKETS - 1);
+}
+
+static void TestSharedRegion() {
+    std::string path = TestFilePath("HookStatsTest.shm");
+    remove(path.c_str());
+
+    // Counted in the private region, then carried over
+    uint32_t early = HookStatsRegister("IDirect3D9::CreateDevice");
+    CHECK(early != HOOK_STATS_NONE);
+    for (int i = 0; i < 5; i++) HookStatsRecord(early, 3000);
+
+    CHECK(HookStatsOpen(path.c_str()));
+    CHECK(HookStatsOpen(path.c_str()));
+    CHECK_EQ(HookStatsRegister("IDirect3D9::CreateDevice"), early);
+
+    // 900 calls of 100 ticks, 90 of 1000 and 10 of 100000: log2 buckets
+    // [64, 128), [512, 1024) and [65536, 131072)
+    uint32_t present = HookStatsRegister("IDirect3DDevice9::Present");
+    CHECK_EQ(present, early + 1);
+    for (int i = 0; i < 900; i++) HookStatsRecord(present, 100);
+    for (int i = 0; i < 90; i++) HookStatsRecord(present, 1000);
+    for (int i = 0; i < 10; i++) HookStatsRecord(present, 100000);
+
+    // More threads than shards, the last ones sharing the final shard
+    uint32_t reset = HookStatsRegister("IDirect3DDevice9::Reset");
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < HOOK_STATS_SHARDS + 2; t++) {
+        threads.emplace_back([reset, t] {
+            for (int i = 0; i < 20000; i++) HookStatsRecord(reset, t + 1);
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+
+    std::vector<HookStatsSummary> hooks = ReadRegion(path.c_str());
+    CHECK_EQ(hooks.size(), 3);
+
+    const HookStatsSummary* createDevice = Find(hooks, "IDirect3D9::CreateDevice");
+    CHECK(createDevice);
+    CHECK_EQ(createDevice->calls, 5);
+    CHECK_EQ(createDevice->ticks, 15000);
+    CHECK_EQ(createDevice->maxTicks, 3000);
+
+    const HookStatsSummary* presents = Find(hooks, "IDirect3DDevice9::Present");
+    CHECK(presents);
+    CHECK_EQ(presents->calls, 1000);
+    CHECK_EQ(presents->ticks, 900 * 100 + 90 * 1000 + 10 * 100000);
+    CHECK_EQ(presents->maxTicks, 100000);
+    CHECK_EQ(presents->buckets[7], 900);
+    CHECK_EQ(presents->buckets[10], 90);
+    CHECK_EQ(presents->buckets[17], 10);
+    CHECK_EQ(HookStatsPercentile(*presents, 0.0), 128);
+    CHECK_EQ(HookStatsPercentile(*presents, 0.50), 128);
+    CHECK_EQ(HookStatsPercentile(*presents, 0.95), 1024);
+    CHECK_EQ(HookStatsPercentile(*presents, 0.99), 131072);
+    CHECK_EQ(HookStatsPercentile(*presents, 0.999), 131072);
+    CHECK_EQ(HookStatsPercentile(*presents, 1.0), 131072);
+
+    const HookStatsSummary* resets = Find(hooks, "IDirect3DDevice9::Reset");
+    CHECK(resets);
+    uint32_t threadCount = HOOK_STATS_SHARDS + 2;
+    CHECK_EQ(resets->calls, 20000ull * threadCount);
+    CHECK_EQ(resets->ticks, 20000ull * threadCount * (threadCount + 1) / 2);
+    CHECK_EQ(resets->maxTicks, threadCount);
+    CHECK_EQ(resets->buckets[0], 0);
+    CHECK_EQ(resets->buckets[1], 20000);
+    CHECK_EQ(HookStatsPercentile(*resets, 0.5), 8);
+
+    // Calls made while the viewer is attached show up on its next read
+    HookStatsView view;
+    CHECK(HookStatsMap(path.c_str(), view));
+    HookStatsRecord(present, 100);
+    uint64_t ticksPerSecond;
+    CHECK(HookStatsRead(view.data, view.size, hooks, ticksPerSecond));
+    CHECK_EQ(Find(hooks, "IDirect3DDevice9::Present")->calls, 1001);
+
+    // A region with another layout, or not published yet, is not read
+    std::vector<uint8_t> copy(view.data, view.data + view.size);
+    CHECK(!HookStatsRead(copy.data(), copy.size() - 1, hooks, ticksPerSecond));
+    copy[offsetof(HookStatsHeader, version)]++;
+    CHECK(!HookStatsRead(copy.data(), copy.size(), hooks, ticksPerSecond));
+    CHECK(hooks.empty());
+    copy[offsetof(HookStatsHeader, version)]--;
+    CHECK(HookStatsRead(copy.data(), copy.size(), hooks, ticksPerSecond));
+    memset(copy.data() + offsetof(HookStatsHeader, magic), 0, sizeof(uint32_t));
+    CHECK(!HookStatsRead(copy.data(), copy.size(), hooks, ticksPerSecond));
+    HookStatsUnmap(view);
+
+    // Closed, the region keeps what was counted for the viewer; counting
+    // goes on in private, where the hooks keep their ids
+    HookStatsClose();
+    HookStatsRecord(present, 100);
+    hooks = ReadRegion(path.c_str());
+    CHECK_EQ(Find(hooks, "IDirect3DDevice9::Present")->calls, 1001);
+}
+
+static void TestRegionName() {
+    std::string name = HookStatsRegionName(4242);
+    CHECK(name.find("PeggleHookStats") != std::string::npos);
+    CHECK(name.find("4242") != std::string::npos);
+    CHECK(HookStatsRegionName(4243) != name);
+
+    // Without a name, the region of this process, carrying over every hook
+    std::string path = HookStatsRegionName((uint64_t)getpid());
+    CHECK(HookStatsOpen());
+    uint32_t present = HookStatsRegister("IDirect3DDevice9::Present");
+    HookStatsRecord(present, 100);
+    std::vector<HookStatsSummary> hooks = ReadRegion(path.c_str());
+    CHECK_EQ(hooks.size(), 3);
+    CHECK_EQ(Find(hooks, "IDirect3DDevice9::Present")->calls, 1003);
+    HookStatsClose();
+    remove(path.c_str());
+}
+
+static void TestRegionTaken() {
+    // Published by another module: the file is locked while it is
+    std::string path = TestFilePath("HookStatsTaken.shm");
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    CHECK(fd >= 0);
+    CHECK_EQ(flock(fd, LOCK_EX | LOCK_NB), 0);
+    const char contents[] = "someone else's counters";
+    CHECK_EQ(write(fd, contents, sizeof(contents)), sizeof(contents));
+
+    uint32_t present = HookStatsRegister("IDirect3DDevice9::Present");
+    CHECK(!HookStatsOpen(path.c_str()));
+    HookStatsRecord(present, 100);
+    char read[sizeof(contents)] = {};
+    CHECK_EQ(pread(fd, read, sizeof(read), 0), sizeof(read));
+    CHECK(memcmp(read, contents, sizeof(contents)) == 0);
+    CHECK_EQ(lseek(fd, 0, SEEK_END), sizeof(contents));
+
+    // Left behind by a process that ended: cleared and reused
+    close(fd);
+    CHECK(HookStatsOpen(path.c_str()));
+    std::vector<HookStatsSummary> hooks = ReadRegion(path.c_str());
+    CHECK_EQ(hooks.size(), 3);
+    CHECK_EQ(Find(hooks, "IDirect3DDevice9::Present")->calls, 1004);
+    HookStatsClose();
+    remove(path.c_str());
+}
+
+int main() {
+    TestBuckets();
+    TestSharedRegion();
+    TestRegionName();
+    TestRegionTaken();
+    puts("HookStatsTest passed");
+    return 0;
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "../Common/CpuFeatures.h"
+#include "../Common/ImageScaler.h"
+
+// Images in memory for the scaler tests and benchmarks: rows padded past
+// their pixels, so writes outside an image show up, with the padding filled
+// with PADDING_BYTE and the pixels with seeded random bytes (mt19937 output
+// is the same on every platform, so golden hashes of results are too).
+
+constexpr uint8_t PADDING_BYTE = 0xAB;
+
+struct TestImage {
+    std::vector<uint8_t> bytes;
+    ImageView view;
+};
+
+inline void MakeImage(uint32_t width, uint32_t height, TestImage& image, uint32_t padding = 12,
+    ImageFormat format = IMAGE_FORMAT_BGRX8888) {
+    ptrdiff_t pitch = (ptrdiff_t)width * ImageFormatBytes(format) + padding;
+    image.bytes = std::vector<uint8_t>((size_t)pitch * height, PADDING_BYTE);
+    image.view = ImageView();
+    image.view.pixels = image.bytes.data();
+    image.view.width = width;
+    image.view.height = height;
+    image.view.pitch = pitch;
+    image.view.format = format;
+}
+
+inline uint8_t* ImageRow(const TestImage& image, uint32_t y) {
+    return image.view.pixels + (ptrdiff_t)y * image.view.pitch;
+}
+
+inline uint32_t ImagePixel(const TestImage& image, uint32_t x, uint32_t y) {
+    uint32_t pixel;
+    memcpy(&pixel, ImageRow(image, y) + 4 * (size_t)x, sizeof(pixel));
+    return pixel;
+}
+
+inline void SetImagePixel(TestImage& image, uint32_t x, uint32_t y, uint32_t pixel) {
+    memcpy(ImageRow(image, y) + 4 * (size_t)x, &pixel, sizeof(pixel));
+}
+
+// Random pixel bytes; the padding is left alone
+inline void FillRandom(TestImage& image, uint32_t seed) {
+    std::mt19937 random(seed);
+    size_t rowBytes = (size_t)image.view.width * ImageFormatBytes(image.view.format);
+    for (uint32_t y = 0; y < image.view.height; y++) {
+        uint8_t* row = ImageRow(image, y);
+        for (size_t i = 0; i < rowBytes; i++) row[i] = (uint8_t)random();
+    }
+}
+
+inline bool SamePixels(const TestImage& a, const TestImage& b) {
+    if (a.view.width != b.view.width || a.view.height != b.view.height) return false;
+    size_t rowBytes = (size_t)a.view.width * ImageFormatBytes(a.view.format);
+    for (uint32_t y = 0; y < a.view.height; y++) {
+        if (memcmp(ImageRow(a, y), ImageRow(b, y), rowBytes) != 0) return false;
+    }
+    return true;
+}
+
+inline bool PaddingIntact(const TestImage& image) {
+    size_t rowBytes = (size_t)image.view.width * ImageFormatBytes(image.view.format);
+    for (uint32_t y = 0; y < image.view.height; y++) {
+        const uint8_t* row = ImageRow(image, y);
+        for (size_t i = rowBytes; i < (size_t)image.view.pitch; i++) {
+            if (row[i] != PADDING_BYTE) return false;
+        }
+    }
+    return true;
+}
+
+// FNV-1a over the pixels, row by row
+inline uint64_t ImageHash(const TestImage& image) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    size_t rowBytes = (size_t)image.view.width * ImageFormatBytes(image.view.format);
+    for (uint32_t y = 0; y < image.view.height; y++) {
+        const uint8_t* row = ImageRow(image, y);
+        for (size_t i = 0; i < rowBytes; i++) hash = (hash ^ row[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+inline std::vector<ImageScalePath> SupportedScalePaths() {
+    std::vector<ImageScalePath> paths = { IMAGE_SCALE_SCALAR };
+#ifdef PEGGLE_X86
+    if (CpuHasSse2()) paths.push_back(IMAGE_SCALE_SSE2);
+    if (CpuHasAvx2()) paths.push_back(IMAGE_SCALE_AVX2);
+#endif
+    return paths;
+}
+
+inline const char* ScalePathName(ImageScalePath path) {
+    static const char* const NAMES[] = { "scalar", "SSE2", "AVX2" };
+    return NAMES[path];
+}
+
+inline const char* FilterName(ImageScaleFilter filter) {
+    static const char* const NAMES[] = { "bilinear", "integer", "bicubic", "lanczos3" };
+    return NAMES[filter];
+}
+
+// The benchmarks' rows: every filter, each the fastest of BATCHES batches
+static const ImageScaleFilter BENCH_FILTERS[] = {
+    IMAGE_FILTER_BILINEAR,
+    IMAGE_FILTER_INTEGER,
+    IMAGE_FILTER_BICUBIC,
+    IMAGE_FILTER_LANCZOS3,
+};
+
+constexpr int BATCHES = 5;
@@ -0,0 +1,53 @@
+// Throughput of the image scaler on one thread, per filter and path, scaling
+// Peggle's 800x600 frame to common window sizes: milliseconds per frame,
+// megapixels of output per second and the frame rate one core sustains
+// (bicubic and Lanczos-3 are meant to hold 60 fps at 3840x2160). Each row
+// is the fastest of BATCHES batches, so other load on the machine does not
+// count against the scaler. Integer scaling fills the bars too, so its rows
+// count the whole target like the others.
+//
+// Usage: ImageScalerBench [scale]   (scale 1 = 5 batches of 20 frames per row)
+
+#include "../Common/ImageScaler.h"
+#include "ImageFixture.h"
+#include "TestUtil.h"
+#include <algorithm>
+
+static const uint32_t TARGETS[][2] = {
+    { 1280, 960 },
+    { 1920, 1080 },
+    { 2560, 1440 },
+    { 3840, 2160 },
+};
+
+int main(int argc, char** argv) {
+    int frames = std::max(1, (int)(100 * BenchScale(argc, argv) / BATCHES));
+
+    TestImage source;
+    MakeImage(800, 600, source, 0);
+    FillRandom(source, 1);
+
+    for (const uint32_t* size : TARGETS) {
+        TestImage target;
+        MakeImage(size[0], size[1], target, 0);
+        for (ImageScaleFilter filter : BENCH_FILTERS) {
+            for (ImageScalePath path : SupportedScalePaths()) {
+                ImageScaleForcePath(path);
+                ImageScaler scaler;
+                CHECK(scaler.Scale(source.view, target.view, filter));
+
+                double seconds = 1e9;
+                for (int batch = 0; batch < BATCHES; batch++) {
+                    double start = NowSeconds();
+                    for (int i = 0; i < frames; i++) scaler.Scale(source.view, target.view, filter);
+                    seconds = std::min(seconds, (NowSeconds() - start) / frames);
+                }
+                printf("800x600 -> %4ux%-4u %-9s %-6s %7.2f ms  %6.0f MP/s  %6.0f fps\n", size[0], size[1],
+                    FilterName(filter), ScalePathName(path), seconds * 1e3, (double)size[0] * size[1] / seconds / 1e6,
+                    1.0 / seconds);
+            }
+        }
+    }
+    ImageScaleForcePath(ImageScaleDefaultPath());
+    return 0;
+}
@@ -0,0 +1,410 @@
+// Checks of the image scaler: a bilinear result worked out by hand, every
+// path against a floating-point reference and against each other byte for
+// byte, scaling to the same size as an exact copy, integer scaling as exact
+// replication inside black bars, the bicubic and Lanczos-3 convolutions
+// against floating-point ones and with their tables rebuilt for new sizes,
+// no writes past a row, and golden hashes of fixed inputs so a change to
+// the arithmetic shows up.
+
+#include "../Common/ImageScaler.h"
+#include "ImageFixture.h"
+#include "TestUtil.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+struct ScaleSize {
+    uint32_t sourceWidth;
+    uint32_t sourceHeight;
+    uint32_t targetWidth;
+    uint32_t targetHeight;
+};
+
+static const ScaleSize SIZES[] = {
+    { 800, 600, 1280, 960 },
+    { 800, 600, 1920, 1080 },
+    { 7, 5, 13, 11 },
+    { 13, 11, 7, 5 },
+    { 1, 1, 5, 3 },
+    { 33, 17, 33, 49 },
+    { 640, 480, 640, 480 },
+};
+
+// Scale source into a fresh target on every supported path; the scalar
+// result is returned, the others must match it byte for byte
+static void ScaleOnEveryPath(const TestImage& source, uint32_t width, uint32_t height, ImageScaleFilter filter,
+    TestImage& result) {
+    MakeImage(width, height, result);
+    for (ImageScalePath path : SupportedScalePaths()) {
+        ImageScaleForcePath(path);
+        TestImage target;
+        MakeImage(width, height, target);
+        ImageScaler scaler;
+        CHECK(scaler.Scale(source.view, target.view, filter));
+        CHECK(PaddingIntact(target));
+        if (path == IMAGE_SCALE_SCALAR) {
+            result = target;
+            result.view.pixels = result.bytes.data();
+        }
+        else if (!SamePixels(target, result)) {
+            fprintf(stderr, "%s differs from scalar at %ux%u -> %ux%u\n", ScalePathName(path),
+                source.view.width, source.view.height, width, height);
+            exit(1);
+        }
+    }
+    ImageScaleForcePath(ImageScaleDefaultPath());
+}
+
+// 2x2 to 4x4: pixel centres land on quarters of the source, whose weights
+// are exact in 7 bits. Blue follows x and green y; red and X are constant.
+static void TestBilinearByHand() {
+    TestImage source;
+    MakeImage(2, 2, source);
+    for (uint32_t y = 0; y < 2; y++) {
+        for (uint32_t x = 0; x < 2; x++) SetImagePixel(source, x, y, 0xFF400000 | (y * 128) << 8 | x * 128);
+    }
+
+    TestImage target;
+    ScaleOnEveryPath(source, 4, 4, IMAGE_FILTER_BILINEAR, target);
+    static const uint32_t STEPS[4] = { 0, 32, 96, 128 };
+    for (uint32_t y = 0; y < 4; y++) {
+        for (uint32_t x = 0; x < 4; x++) CHECK_EQ(ImagePixel(target, x, y), 0xFF400000 | STEPS[y] << 8 | STEPS[x]);
+    }
+}
+
+// Bilinear in floating point, with the same pixel-centre alignment and the
+// edges clamped
+static double BilinearReference(const TestImage& source, double x, double y, int channel) {
+    int width = (int)source.view.width;
+    int height = (int)source.view.height;
+    x = std::min(std::max(x, 0.0), (double)width - 1);
+    y = std::min(std::max(y, 0.0), (double)height - 1);
+    int x0 = (int)x;
+    int y0 = (int)y;
+    int x1 = std::min(x0 + 1, width - 1);
+    int y1 = std::min(y0 + 1, height - 1);
+    double ax = x - x0;
+    double ay = y - y0;
+    auto at = [&](int px, int py) { return (double)ImageRow(source, (uint32_t)py)[4 * px + channel]; };
+    return (at(x0, y0) * (1 - ax) + at(x1, y0) * ax) * (1 - ay) + (at(x0, y1) * (1 - ax) + at(x1, y1) * ax) * ay;
+}
+
+static void TestBilinearAgainstReference() {
+    for (const ScaleSize& size : SIZES) {
+        TestImage source;
+        MakeImage(size.sourceWidth, size.sourceHeight, source);
+        FillRandom(source, size.sourceWidth * 31 + size.targetWidth);
+
+        TestImage target;
+        ScaleOnEveryPath(source, size.targetWidth, size.targetHeight, IMAGE_FILTER_BILINEAR, target);
+
+        // Each 7-bit weight is within half a step (1/256) of the exact one,
+        // which is up to one level per axis, plus the rounding of the two
+        // passes; on average the result is unbiased
+        double worst = 0.0;
+        double total = 0.0;
+        double scaleX = (double)size.sourceWidth / size.targetWidth;
+        double scaleY = (double)size.sourceHeight / size.targetHeight;
+        for (uint32_t y = 0; y < size.targetHeight; y++) {
+            for (uint32_t x = 0; x < size.targetWidth; x++) {
+                for (int channel = 0; channel < 4; channel++) {
+                    double expected = BilinearReference(source, (x + 0.5) * scaleX - 0.5, (y + 0.5) * scaleY - 0.5,
+                        channel);
+                    double error = std::fabs(expected - ImageRow(target, y)[4 * x + channel]);
+                    worst = std::max(worst, error);
+                    total += error;
+                }
+            }
+        }
+        CHECK(worst <= 3.0);
+        CHECK(total / (4.0 * size.targetWidth * size.targetHeight) < 0.5);
+
+        if (size.sourceWidth == size.targetWidth && size.sourceHeight == size.targetHeight) {
+            CHECK(SamePixels(source, target));
+        }
+    }
+}
+
+static void TestIntegerFactor() {
+    CHECK_EQ(IntegerScaleFactor(800, 600, 800, 600), 1);
+    CHECK_EQ(IntegerScaleFactor(800, 600, 1920, 1080), 1);
+    CHECK_EQ(IntegerScaleFactor(800, 600, 1600, 1200), 2);
+    CHECK_EQ(IntegerScaleFactor(800, 600, 3840, 2160), 3);
+    CHECK_EQ(IntegerScaleFactor(320, 240, 1920, 1080), 4);
+    CHECK_EQ(IntegerScaleFactor(1, 1, 5, 3), 3);
+    CHECK_EQ(IntegerScaleFactor(800, 600, 799, 600), 0);
+    CHECK_EQ(IntegerScaleFactor(800, 600, 1280, 599), 0);
+}
+
+// Every source pixel becomes a factor x factor square, centred, and the
+// bars around it are black
+static void TestIntegerAgainstReference() {
+    static const ScaleSize INTEGER_SIZES[] = {
+        { 800, 600, 1920, 1080 },
+        { 800, 600, 3840, 2160 },
+        { 800, 600, 1600, 1200 },
+        { 7, 5, 40, 33 },
+        { 5, 3, 100, 9 },
+        { 3, 3, 3, 3 },
+        { 10, 10, 10, 30 },
+    };
+
+    for (const ScaleSize& size : INTEGER_SIZES) {
+        TestImage source;
+        MakeImage(size.sourceWidth, size.sourceHeight, source);
+        FillRandom(source, size.targetWidth * 7 + size.targetHeight);
+
+        TestImage target;
+        ScaleOnEveryPath(source, size.targetWidth, size.targetHeight, IMAGE_FILTER_INTEGER, target);
+
+        uint32_t factor = IntegerScaleFactor(size.sourceWidth, size.sourceHeight, size.targetWidth,
+            size.targetHeight);
+        uint32_t left = (size.targetWidth - size.sourceWidth * factor) / 2;
+        uint32_t top = (size.targetHeight - size.sourceHeight * factor) / 2;
+        for (uint32_t y = 0; y < size.targetHeight; y++) {
+            for (uint32_t x = 0; x < size.targetWidth; x++) {
+                bool inside = x >= left && x < left + size.sourceWidth * factor && y >= top &&
+                    y < top + size.sourceHeight * factor;
+                uint32_t expected = inside ? ImagePixel(source, (x - left) / factor, (y - top) / factor) : 0;
+                CHECK_EQ(ImagePixel(target, x, y), expected);
+            }
+        }
+    }
+
+    // A source larger than the target has no whole factor
+    TestImage source;
+    MakeImage(800, 600, source);
+    TestImage target;
+    MakeImage(640, 480, target);
+    ImageScaler scaler;
+    CHECK(!scaler.Scale(source.view, target.view, IMAGE_FILTER_INTEGER));
+    CHECK(PaddingIntact(target));
+    for (uint32_t y = 0; y < 480; y++) CHECK_EQ(ImageRow(target, y)[0], PADDING_BYTE);
+}
+
+static double KernelReference(ImageScaleFilter filter, double x) {
+    const double pi = 3.14159265358979323846;
+    x = std::fabs(x);
+    if (filter == IMAGE_FILTER_LANCZOS3) {
+        if (x == 0.0) return 1.0;
+        return x < 3.0 ? 3.0 * sin(pi * x) * sin(pi * x / 3.0) / (pi * pi * x * x) : 0.0;
+    }
+    if (x < 1.0) return 1.5 * x * x * x - 2.5 * x * x + 1.0;
+    if (x < 2.0) return -0.5 * x * x * x + 2.5 * x * x - 4.0 * x + 2.0;
+    return 0.0;
+}
+
+// Normalized weights of the source pixels target pixel i reads, edges
+// repeated; the kernel widens by the shrink factor
+static void ConvolutionTaps(ImageScaleFilter filter, uint32_t sourceSize, uint32_t targetSize, uint32_t i,
+    std::vector<std::pair<uint32_t, double>>& taps) {
+    double scale = (double)sourceSize / targetSize;
+    double stretch = std::max(scale, 1.0);
+    double support = (filter == IMAGE_FILTER_LANCZOS3 ? 3.0 : 2.0) * stretch;
+    double center = (i + 0.5) * scale - 0.5;
+
+    taps.clear();
+    double sum = 0.0;
+    for (int64_t j = (int64_t)floor(center - support); j <= (int64_t)ceil(center + support); j++) {
+        double weight = KernelReference(filter, (j - center) / stretch);
+        if (weight == 0.0) continue;
+        int64_t clamped = std::min(std::max(j, (int64_t)0), (int64_t)sourceSize - 1);
+        taps.push_back(std::make_pair((uint32_t)clamped, weight));
+        sum += weight;
+    }
+    for (auto& tap : taps) tap.second /= sum;
+}
+
+// Horizontal then vertical, in floating point, clamped to 0..255 at the end
+static void ConvolutionReference(const TestImage& source, ImageScaleFilter filter, uint32_t width,
+    uint32_t height, std::vector<double>& result) {
+    uint32_t sourceWidth = source.view.width;
+    uint32_t sourceHeight = source.view.height;
+    std::vector<double> rows((size_t)sourceHeight * width * 4);
+    std::vector<std::pair<uint32_t, double>> taps;
+    for (uint32_t x = 0; x < width; x++) {
+        ConvolutionTaps(filter, sourceWidth, width, x, taps);
+        for (uint32_t y = 0; y < sourceHeight; y++) {
+            for (int c = 0; c < 4; c++) {
+                double value = 0.0;
+                for (const auto& tap : taps) value += tap.second * ImageRow(source, y)[4 * tap.first + c];
+                rows[((size_t)y * width + x) * 4 + c] = value;
+            }
+        }
+    }
+
+    result.assign((size_t)height * width * 4, 0.0);
+    for (uint32_t y = 0; y < height; y++) {
+        ConvolutionTaps(filter, sourceHeight, height, y, taps);
+        for (size_t i = 0; i < (size_t)width * 4; i++) {
+            double value = 0.0;
+            for (const auto& tap : taps) value += tap.second * rows[(size_t)tap.first * width * 4 + i];
+            result[(size_t)y * width * 4 + i] = std::min(std::max(value, 0.0), 255.0);
+        }
+    }
+}
+
+static void TestConvolutionAgainstReference() {
+    static const ScaleSize CONVOLUTION_SIZES[] = {
+        { 800, 600, 1280, 960 },
+        { 7, 5, 13, 11 },
+        { 13, 11, 7, 5 },
+        { 33, 17, 33, 49 },
+        { 1, 1, 5, 3 },
+        { 96, 64, 40, 30 },
+    };
+    static const ImageScaleFilter FILTERS[] = { IMAGE_FILTER_BICUBIC, IMAGE_FILTER_LANCZOS3 };
+
+    for (ImageScaleFilter filter : FILTERS) {
+        for (const ScaleSize& size : CONVOLUTION_SIZES) {
+            TestImage source;
+            MakeImage(size.sourceWidth, size.sourceHeight, source);
+            FillRandom(source, size.sourceWidth * 13 + size.targetHeight);
+
+            TestImage target;
+            ScaleOnEveryPath(source, size.targetWidth, size.targetHeight, filter, target);
+
+            // 14-bit weights and 6 fractional bits in between keep every
+            // channel within a level of the exact convolution
+            std::vector<double> expected;
+            ConvolutionReference(source, filter, size.targetWidth, size.targetHeight, expected);
+            double worst = 0.0;
+            for (uint32_t y = 0; y < size.targetHeight; y++) {
+                for (uint32_t i = 0; i < size.targetWidth * 4; i++) {
+                    double error = std::fabs(expected[(size_t)y * size.targetWidth * 4 + i] - ImageRow(target, y)[i]);
+                    worst = std::max(worst, error);
+                }
+            }
+            CHECK(worst <= 1.0);
+        }
+
+        // Both kernels are 1 at 0 and 0 at the other whole numbers, so the
+        // same size is an exact copy, and the weights sum to exactly one, so
+        // a flat image stays flat
+        TestImage source;
+        MakeImage(64, 48, source);
+        FillRandom(source, 9);
+        TestImage target;
+        ScaleOnEveryPath(source, 64, 48, filter, target);
+        CHECK(SamePixels(source, target));
+
+        for (uint32_t y = 0; y < 48; y++) {
+            for (uint32_t x = 0; x < 64; x++) SetImagePixel(source, x, y, 0x80FF3A07);
+        }
+        ScaleOnEveryPath(source, 150, 100, filter, target);
+        for (uint32_t y = 0; y < 100; y++) {
+            for (uint32_t x = 0; x < 150; x++) CHECK_EQ(ImagePixel(target, x, y), 0x80FF3A07);
+        }
+        ScaleOnEveryPath(source, 40, 30, filter, target);
+        CHECK_EQ(ImagePixel(target, 39, 29), 0x80FF3A07);
+    }
+}
+
+// One scaler through a change of size and of filter gives what fresh ones do
+static void TestConvolutionTablesFollowSizes() {
+    TestImage source;
+    MakeImage(800, 600, source);
+    FillRandom(source, 21);
+
+    struct Step {
+        ImageScaleFilter filter;
+        uint32_t width;
+        uint32_t height;
+    };
+    static const Step STEPS[] = {
+        { IMAGE_FILTER_LANCZOS3, 1280, 960 },
+        { IMAGE_FILTER_LANCZOS3, 1920, 1080 },
+        { IMAGE_FILTER_BICUBIC, 1920, 1080 },
+        { IMAGE_FILTER_BILINEAR, 1920, 1080 },
+        { IMAGE_FILTER_BICUBIC, 1920, 1080 },
+        { IMAGE_FILTER_BICUBIC, 1280, 960 },
+    };
+
+    ImageScaler reused;
+    for (const Step& step : STEPS) {
+        TestImage target;
+        MakeImage(step.width, step.height, target);
+        CHECK(reused.Scale(source.view, target.view, step.filter));
+
+        TestImage fresh;
+        MakeImage(step.width, step.height, fresh);
+        ImageScaler scaler;
+        CHECK(scaler.Scale(source.view, fresh.view, step.filter));
+        CHECK(SamePixels(target, fresh));
+    }
+}
+
+static void TestRejected() {
+    TestImage source;
+    MakeImage(8, 8, source);
+    TestImage target;
+    MakeImage(16, 16, target);
+    ImageScaler scaler;
+
+    ImageView empty = source.view;
+    empty.width = 0;
+    CHECK(!scaler.Scale(empty, target.view));
+    empty = target.view;
+    empty.pixels = nullptr;
+    CHECK(!scaler.Scale(source.view, empty));
+
+    ImageView palettized = source.view;
+    palettized.format = IMAGE_FORMAT_PALETTE8;
+    CHECK(!scaler.Scale(palettized, target.view));
+}
+
+// Hashes of the scalar result, which every path matches; update them only
+// for a deliberate change to the arithmetic
+struct GoldenScale {
+    ImageScaleFilter filter;
+    ScaleSize size;
+    uint64_t hash;
+};
+
+static const GoldenScale GOLDEN[] = {
+    { IMAGE_FILTER_BILINEAR, { 64, 48, 100, 75 }, 0xF79F693D52319ACull },
+    { IMAGE_FILTER_BILINEAR, { 800, 600, 1280, 960 }, 0x7A4C594F9651E247ull },
+    { IMAGE_FILTER_BILINEAR, { 100, 75, 64, 48 }, 0xCA6B2F18AABD7623ull },
+    { IMAGE_FILTER_INTEGER, { 64, 48, 200, 150 }, 0xDC0F4A3E36C46ADAull },
+    { IMAGE_FILTER_INTEGER, { 800, 600, 1920, 1080 }, 0x075B334A5C69A2A9ull },
+    { IMAGE_FILTER_BICUBIC, { 64, 48, 100, 75 }, 0xC7256FE098D27C0Aull },
+    { IMAGE_FILTER_BICUBIC, { 800, 600, 2560, 1440 }, 0x63E8B802C466F233ull },
+    { IMAGE_FILTER_BICUBIC, { 100, 75, 64, 48 }, 0xC31A44DF2792C624ull },
+    { IMAGE_FILTER_LANCZOS3, { 64, 48, 100, 75 }, 0xDFF3F5DADF250B0Full },
+    { IMAGE_FILTER_LANCZOS3, { 800, 600, 2560, 1440 }, 0x8CBDDEAA18A17FC4ull },
+    { IMAGE_FILTER_LANCZOS3, { 100, 75, 64, 48 }, 0x248C84CFFCD05A72ull },
+};
+
+static void TestGolden() {
+    bool failed = false;
+    for (const GoldenScale& golden : GOLDEN) {
+        const ScaleSize& size = golden.size;
+        TestImage source;
+        MakeImage(size.sourceWidth, size.sourceHeight, source);
+        FillRandom(source, 2024);
+
+        TestImage target;
+        ScaleOnEveryPath(source, size.targetWidth, size.targetHeight, golden.filter, target);
+        uint64_t hash = ImageHash(target);
+        if (hash != golden.hash) {
+            fprintf(stderr, "Golden hash of filter %d, %ux%u -> %ux%u: 0x%llXull, expected 0x%llXull\n",
+                golden.filter, size.sourceWidth, size.sourceHeight, size.targetWidth, size.targetHeight,
+                (unsigned long long)hash, (unsigned long long)golden.hash);
+            failed = true;
+        }
+    }
+    CHECK(!failed);
+}
+
+int main() {
+    TestBilinearByHand();
+    TestBilinearAgainstReference();
+    TestIntegerFactor();
+    TestIntegerAgainstReference();
+    TestConvolutionAgainstReference();
+    TestConvolutionTablesFollowSizes();
+    TestRejected();
+    TestGolden();
+    puts("ImageScalerTest passed");
+    return 0;
+}
@@ -0,0 +1,51 @@
+// Cost of a log call seen by the calling hook, with 1 to N producer threads,
+// in text and binary mode. Reports ns per call, total messages per second and
+// how many were dropped because the ring was full.
+//
+// Usage: LogBench [scale]
+
+#include "../Common/Log.h"
+#include "TestUtil.h"
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void Run(unsigned flags, int threadCount, int messagesPerThread) {
+    std::string path = TestFilePath("LogBench.log");
+    LogOpen(path.c_str(), flags);
+    uint64_t droppedBefore = LogDroppedCount();
+
+    std::vector<double> perCall(threadCount);
+    std::vector<std::thread> threads;
+    double start = NowSeconds();
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&perCall, t, messagesPerThread] {
+            double begin = NowSeconds();
+            for (int i = 0; i < messagesPerThread; i++) {
+                Log("Present: frame %d on thread %d took %.3f ms", i, t, 16.6);
+            }
+            perCall[t] = (NowSeconds() - begin) * 1e9 / messagesPerThread;
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    double elapsed = NowSeconds() - start;
+    LogClose();
+
+    uint64_t total = (uint64_t)threadCount * messagesPerThread;
+    uint64_t dropped = LogDroppedCount() - droppedBefore;
+    double worst = *std::max_element(perCall.begin(), perCall.end());
+    printf("%-6s %2d thread(s): %7.1f ns/call (slowest thread), %6.2f M calls/s, %5.1f%% dropped\n",
+        (flags & LOG_BINARY) ? "binary" : "text", threadCount, worst, total / elapsed / 1e6,
+        100.0 * dropped / total);
+    remove(path.c_str());
+}
+
+int main(int argc, char** argv) {
+    int messages = (int)(200000 * BenchScale(argc, argv));
+    int maxThreads = (int)std::max(4u, std::thread::hardware_concurrency());
+    for (unsigned flags : { 0u, (unsigned)LOG_BINARY }) {
+        for (int threads = 1; threads <= maxThreads; threads *= 2) Run(flags, threads, messages);
+    }
+    return 0;
+}
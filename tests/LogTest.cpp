@@ -0,0 +1,162 @@
+// Checks of the asynchronous logger: every message is either written or
+// counted as dropped, each thread's messages keep their order, the logger
+// can be closed and reopened, and binary logs carry the file header and
+// define every format they use, even when an earlier file already did.
+// LogBinaryFile and LogReopenedFile are also decoded with PeggleLogDecoder
+// by the LogDecode tests.
+
+#define PEGGLE_LOG_LEVEL 2
+#include "../Common/Log.h"
+#include "../Common/LogFormat.h"
+#include "TestUtil.h"
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr int THREADS = 4;
+constexpr int MESSAGES_PER_THREAD = 5000;
+
+static std::vector<std::string> ReadLines(const std::string& path) {
+    std::vector<std::string> lines;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) lines.push_back(line);
+    return lines;
+}
+
+static void TestConcurrentProducers() {
+    std::string path = TestFilePath("LogConcurrent.log");
+    CHECK(LogOpen(path.c_str(), 0));
+    uint64_t droppedBefore = LogDroppedCount();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([t] {
+            for (int i = 0; i < MESSAGES_PER_THREAD; i++) LogInfo("thread %d message %d", t, i);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    LogClose();
+
+    uint64_t dropped = LogDroppedCount() - droppedBefore;
+    std::vector<std::string> lines = ReadLines(path);
+    CHECK_EQ(lines.size() + dropped, THREADS * MESSAGES_PER_THREAD);
+
+    int last[THREADS];
+    for (int& value : last) value = -1;
+    for (const std::string& line : lines) {
+        int thread, message;
+        CHECK(sscanf(line.c_str(), "thread %d message %d", &thread, &message) == 2);
+        CHECK(thread >= 0 && thread < THREADS);
+        CHECK(message > last[thread]);
+        last[thread] = message;
+    }
+    remove(path.c_str());
+}
+
+static void TestLevelsAndReopen() {
+    std::string first = TestFilePath("LogFirst.log");
+    std::string second = TestFilePath("LogSecond.log");
+
+    for (int round = 0; round < 20; round++) {
+        CHECK(LogOpen(first.c_str(), 0));
+        LogDebug("compiled out %d", round);
+        LogInfo("first %d", round);
+        LogClose(true);
+
+        CHECK(LogOpen(second.c_str(), 0));
+        LogWarn("second %d", round);
+        LogClose(round % 2 == 0);
+
+        std::vector<std::string> lines = ReadLines(first);
+        CHECK_EQ(lines.size(), 1);
+        CHECK(lines[0] == "first " + std::to_string(round));
+        lines = ReadLines(second);
+        CHECK_EQ(lines.size(), 1);
+        CHECK(lines[0] == "second " + std::to_string(round));
+    }
+    remove(first.c_str());
+    remove(second.c_str());
+}
+
+static void TestLongMessageIsTruncated() {
+    std::string path = TestFilePath("LogLong.log");
+    std::string text(1000, 'x');
+    CHECK(LogOpen(path.c_str(), 0));
+    LogInfo("%s", text.c_str());
+    LogClose();
+
+    std::vector<std::string> lines = ReadLines(path);
+    CHECK_EQ(lines.size(), 1);
+    CHECK(lines[0].size() > 0 && lines[0].size() < text.size());
+    CHECK(lines[0].find_first_not_of('x') == std::string::npos);
+    remove(path.c_str());
+}
+
+static void TestBinaryHeader() {
+    std::string path = TestFilePath("LogBinaryFile.bin");
+    CHECK(LogOpen(path.c_str(), LOG_BINARY));
+    LogInfo("binary %d %s %.2f", 41, "hello", 2.5);
+    LogInfo("wide %ls", L"text");
+    LogClose();
+
+    std::ifstream in(path, std::ios::binary);
+    LogFileHeader header;
+    CHECK(in.read((char*)&header, sizeof(header)));
+    CHECK(memcmp(header.magic, LOG_BINARY_MAGIC, sizeof(header.magic)) == 0);
+    CHECK_EQ(header.version, LOG_BINARY_VERSION);
+    CHECK_EQ(header.pointerSize, sizeof(void*));
+    CHECK(header.ticksPerSecond != 0);
+}
+
+// One call site, so both files use the same format string
+static void LogReopened(int file) {
+    LogInfo("reopened %d", file);
+}
+
+static void TestBinaryReopen() {
+    std::string first = TestFilePath("LogFirstFile.bin");
+    std::string second = TestFilePath("LogReopenedFile.bin");
+    CHECK(LogOpen(first.c_str(), LOG_BINARY));
+    LogReopened(1);
+    LogClose();
+    CHECK(LogOpen(second.c_str(), LOG_BINARY));
+    LogReopened(2);
+    LogClose();
+    remove(first.c_str());
+
+    // The second file defines the format again before its message
+    std::ifstream in(second, std::ios::binary);
+    LogFileHeader header;
+    CHECK(in.read((char*)&header, sizeof(header)));
+    int formats = 0;
+    int messages = 0;
+    LogRecordHeader record;
+    while (in.read((char*)&record, sizeof(record))) {
+        CHECK(record.size >= sizeof(record));
+        std::string payload(record.size - sizeof(record), '\0');
+        CHECK(in.read(&payload[0], payload.size()));
+        if (record.kind == LOG_RECORD_FORMAT) {
+            CHECK(payload.substr(sizeof(uint32_t)) == "reopened %d");
+            formats++;
+        }
+        else if (record.kind == LOG_RECORD_MESSAGE) {
+            CHECK_EQ(formats, 1);
+            messages++;
+        }
+    }
+    CHECK_EQ(formats, 1);
+    CHECK_EQ(messages, 1);
+}
+
+int main() {
+    TestConcurrentProducers();
+    TestLevelsAndReopen();
+    TestLongMessageIsTruncated();
+    TestBinaryHeader();
+    TestBinaryReopen();
+    puts("LogTest passed");
+    return 0;
+}
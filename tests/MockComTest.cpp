@@ -0,0 +1,287 @@
+// Checks of the mock Direct3D 9 and DirectDraw library: its interfaces have
+// the slots of ComVtable.h, the objects count calls and simulate latency, the
+// mock hook registry redirects and restores the shared vtables as Detours
+// would, the surfaces lock, blit and flip, and traces load and replay.
+
+#include "../Common/ComHook.h"
+#include "MockCom.h"
+#include "MockTrace.h"
+#include "TestUtil.h"
+#include <cstdio>
+#include <cstring>
+
+// Vtable slot of a virtual member function, from its Itanium C++ ABI
+// representation: the byte offset in the vtable, plus one on x86 (ARM flags
+// virtual functions in the adjustment instead)
+template <typename Method>
+static size_t VirtualSlot(Method method) {
+    struct {
+        uintptr_t ptr;
+        ptrdiff_t adj;
+    } representation;
+    static_assert(sizeof(method) == sizeof(representation), "Itanium member function pointer");
+    memcpy(&representation, &method, sizeof(representation));
+#if defined(__arm__) || defined(__aarch64__)
+    return representation.ptr / sizeof(void*);
+#else
+    return (representation.ptr - 1) / sizeof(void*);
+#endif
+}
+
+#define CHECK_SLOT(Interface, name) CHECK_EQ(VirtualSlot(&Interface::name), ComSlot::Interface::name);
+#define CHECK_D3D9_SLOT(name) CHECK_SLOT(IDirect3D9, name)
+#define CHECK_DEVICE9_SLOT(name) CHECK_SLOT(IDirect3DDevice9, name)
+#define CHECK_DIRECTDRAW_SLOT(name) CHECK_SLOT(IDirectDraw, name)
+#define CHECK_DIRECTDRAW7_SLOT(name) CHECK_SLOT(IDirectDraw7, name)
+#define CHECK_SURFACE7_SLOT(name) CHECK_SLOT(IDirectDrawSurface7, name)
+
+static void TestSlotLayout() {
+    COM_IDIRECT3D9_METHODS(CHECK_D3D9_SLOT)
+    COM_IDIRECT3DDEVICE9_METHODS(CHECK_DEVICE9_SLOT)
+    COM_IDIRECTDRAW_METHODS(CHECK_DIRECTDRAW_SLOT)
+    COM_IDIRECTDRAW7_METHODS(CHECK_DIRECTDRAW7_SLOT)
+    COM_IDIRECTDRAWSURFACE7_METHODS(CHECK_SURFACE7_SLOT)
+
+    // The last slot of each is the last one of the mock's vtable that belongs
+    // to the interface
+    CHECK_EQ(VirtualSlot(&IDirect3DDevice9::CreateQuery) + 1, ComSlot::IDirect3DDevice9::Count);
+    CHECK_EQ(VirtualSlot(&IDirectDraw7::EvaluateMode) + 1, ComSlot::IDirectDraw7::Count);
+    CHECK_EQ(VirtualSlot(&IDirectDrawSurface7::GetLOD) + 1, ComSlot::IDirectDrawSurface7::Count);
+}
+
+static D3DPRESENT_PARAMETERS GameParams() {
+    D3DPRESENT_PARAMETERS params = {};
+    params.BackBufferWidth = 800;
+    params.BackBufferHeight = 600;
+    params.BackBufferFormat = D3DFMT_X8R8G8B8;
+    params.Windowed = TRUE;
+    return params;
+}
+
+static void TestCallsAndLatency() {
+    MockDevice9* mock = new MockDevice9(GameParams());
+    IDirect3DDevice9* device = mock;
+
+    RECT dest = { 10, 20, 30, 40 };
+    device->Present(nullptr, &dest, nullptr, nullptr);
+    CHECK(mock->hasDestRect && EqualRect(&mock->destRect, &dest));
+    device->Present(nullptr, nullptr, nullptr, nullptr);
+    CHECK(!mock->hasDestRect);
+    CHECK_EQ(mock->Calls(ComSlot::IDirect3DDevice9::Present), 2);
+    CHECK_EQ(mock->Calls(ComSlot::IDirect3DDevice9::Reset), 0);
+
+    D3DVIEWPORT9 viewport = { 0, 0, 640, 480, 0.0f, 1.0f };
+    D3DVIEWPORT9 read = {};
+    device->SetViewport(&viewport);
+    device->GetViewport(&read);
+    CHECK_EQ(read.Width, 640);
+
+    // Methods the mock does not implement answer as the placeholder
+    CHECK_EQ(device->TestCooperativeLevel(), E_NOTIMPL);
+
+    mock->SetLatency(ComSlot::IDirect3DDevice9::Present, 2000000);
+    double start = NowSeconds();
+    device->Present(nullptr, nullptr, nullptr, nullptr);
+    CHECK(NowSeconds() - start >= 0.002);
+
+    device->AddRef();
+    CHECK_EQ(mock->RefCount(), 2);
+    CHECK_EQ(device->Release(), 1);
+    CHECK_EQ(device->Release(), 0);
+}
+
+// Counts presents and replaces the destination rect
+struct CountingPresent : ComHookHandler {
+    static unsigned calls;
+    static RECT rect;
+
+    static void Pre(IDirect3DDevice9*, const RECT*&, const RECT*& destRect, HWND&, const RGNDATA*&) {
+        calls++;
+        destRect = &rect;
+    }
+};
+
+unsigned CountingPresent::calls = 0;
+RECT CountingPresent::rect = { 1, 2, 3, 4 };
+
+typedef ComHook<COM_METHOD(IDirect3DDevice9, Present), CountingPresent> CountingPresentHook;
+
+static HRESULT Unreachable(IDirect3DDevice9*) {
+    return S_OK;
+}
+
+static void TestHookRegistry() {
+    MockDirect3D9* d3d = new MockDirect3D9();
+    IDirect3DDevice9* first = nullptr;
+    D3DPRESENT_PARAMETERS params = GameParams();
+    CHECK_EQ(d3d->CreateDevice(0, D3DDEVTYPE_HAL, nullptr, 0, &params, &first), D3D_OK);
+
+    auto target = ComVtableEntry<COM_METHOD(IDirect3DDevice9, Present)>(first);
+    CHECK(CountingPresentHook::Request("IDirect3DDevice9::Present", first));
+    CHECK(!CountingPresentHook::Request("IDirect3DDevice9::Present", first));
+    CHECK_EQ(HookGetState(&CountingPresentHook::original), HOOK_PENDING);
+    CHECK_EQ(HookCommit(), 1);
+    CHECK_EQ(HookGetState(&CountingPresentHook::original), HOOK_ATTACHED);
+    CHECK(CountingPresentHook::original == target);
+
+    // The vtable is shared: a device created later is hooked as well
+    IDirect3DDevice9* second = nullptr;
+    CHECK_EQ(d3d->CreateDevice(0, D3DDEVTYPE_HAL, nullptr, 0, &params, &second), D3D_OK);
+    first->Present(nullptr, nullptr, nullptr, nullptr);
+    second->Present(nullptr, nullptr, nullptr, nullptr);
+    CHECK_EQ(CountingPresent::calls, 2);
+    MockDevice9* mock = static_cast<MockDevice9*>(second);
+    CHECK(mock->hasDestRect && EqualRect(&mock->destRect, &CountingPresent::rect));
+    CHECK_EQ(mock->Calls(ComSlot::IDirect3DDevice9::Present), 1);
+
+    CHECK_EQ(HookDetachAll(), 1);
+    CHECK_EQ(HookGetState(&CountingPresentHook::original), HOOK_DETACHED);
+    CHECK(ComVtableEntry<COM_METHOD(IDirect3DDevice9, Present)>(first) == target);
+    first->Present(nullptr, nullptr, nullptr, nullptr);
+    CHECK_EQ(CountingPresent::calls, 2);
+
+    // A detached hook can be requested again
+    CHECK(CountingPresentHook::Request("IDirect3DDevice9::Present", first));
+    CHECK_EQ(HookCommit(), 1);
+    first->Present(nullptr, nullptr, nullptr, nullptr);
+    CHECK_EQ(CountingPresent::calls, 3);
+    CHECK_EQ(HookDetachAll(), 1);
+
+    // A target no vtable points at fails, as Detours would on bad code
+    static void* unreachable = nullptr;
+    CHECK(HookRequest("Unreachable", &unreachable, (void*)&Unreachable, (void*)&Unreachable));
+    CHECK_EQ(HookCommit(), 0);
+    CHECK_EQ(HookGetState(&unreachable), HOOK_FAILED);
+
+    first->Release();
+    second->Release();
+    d3d->Release();
+}
+
+static void TestSurfaces() {
+    MockDirectDraw* dd = new MockDirectDraw();
+    IDirectDraw7* dd7 = nullptr;
+    CHECK_EQ(dd->QueryInterface(IID_IDirectDraw7, (void**)&dd7), S_OK);
+    CHECK(dd7 == static_cast<IDirectDraw7*>(dd->directDraw7));
+    CHECK_EQ(dd7->SetDisplayMode(320, 240, 32, 0, 0), DD_OK);
+
+    DDSURFACEDESC2 desc = {};
+    desc.dwSize = sizeof(desc);
+    desc.dwFlags = DDSD_CAPS | DDSD_BACKBUFFERCOUNT;
+    desc.ddsCaps.dwCaps = DDSCAPS_PRIMARYSURFACE | DDSCAPS_FLIP | DDSCAPS_COMPLEX;
+    desc.dwBackBufferCount = 1;
+    IDirectDrawSurface7* primary = nullptr;
+    CHECK_EQ(dd7->CreateSurface(&desc, &primary, nullptr), DD_OK);
+
+    DDSURFACEDESC2 read = {};
+    CHECK_EQ(primary->GetSurfaceDesc(&read), DD_OK);
+    CHECK_EQ(read.dwWidth, 320);
+    CHECK_EQ(read.dwHeight, 240);
+    CHECK_EQ(read.ddpfPixelFormat.dwRGBBitCount, 32);
+    CHECK_EQ(read.lPitch, 1280);
+
+    // A plain surface in the game's own depth
+    DDSURFACEDESC2 plainDesc = {};
+    plainDesc.dwSize = sizeof(plainDesc);
+    plainDesc.dwFlags = DDSD_CAPS | DDSD_WIDTH | DDSD_HEIGHT | DDSD_PIXELFORMAT;
+    plainDesc.ddsCaps.dwCaps = DDSCAPS_OFFSCREENPLAIN;
+    plainDesc.dwWidth = 16;
+    plainDesc.dwHeight = 8;
+    plainDesc.ddpfPixelFormat = MockPixelFormat(16);
+    IDirectDrawSurface7* plain = nullptr;
+    CHECK_EQ(dd7->CreateSurface(&plainDesc, &plain, nullptr), DD_OK);
+    CHECK_EQ(static_cast<MockSurface7*>(plain)->desc.lPitch, 32);
+
+    // Lock hands out the surface memory, offset to the rect
+    DDSURFACEDESC2 locked = {};
+    RECT part = { 2, 3, 6, 5 };
+    CHECK_EQ(primary->Lock(&part, &locked, DDLOCK_WAIT, nullptr), DD_OK);
+    ((uint32_t*)locked.lpSurface)[0] = 0x123456;
+    CHECK_EQ(primary->Unlock(&part), DD_OK);
+    CHECK_EQ(primary->Unlock(&part), DDERR_INVALIDPARAMS);
+    MockSurface7* mock = static_cast<MockSurface7*>(primary);
+    CHECK_EQ(mock->Pixel32(2, 3), 0x123456);
+
+    // The back buffer, filled and flipped to the front
+    DDSCAPS2 caps = {};
+    caps.dwCaps = DDSCAPS_BACKBUFFER;
+    IDirectDrawSurface7* back = nullptr;
+    CHECK_EQ(primary->GetAttachedSurface(&caps, &back), DD_OK);
+    CHECK_EQ(back->Blt(nullptr, primary, nullptr, DDBLT_WAIT, nullptr), DD_OK);
+    CHECK(static_cast<MockSurface7*>(back)->bltCopied);
+    CHECK_EQ(static_cast<MockSurface7*>(back)->Pixel32(2, 3), 0x123456);
+    RECT corner = { 0, 0, 4, 4 };
+    CHECK_EQ(back->Blt(&corner, plain, &corner, DDBLT_WAIT, nullptr), DD_OK);
+    CHECK(!static_cast<MockSurface7*>(back)->bltCopied);
+    memset(mock->pixels.data(), 0, mock->pixels.size());
+    CHECK_EQ(primary->Flip(nullptr, DDFLIP_WAIT), DD_OK);
+    CHECK_EQ(mock->Pixel32(2, 3), 0x123456);
+    back->Release();
+
+    IDirectDraw7* owner = nullptr;
+    CHECK_EQ(primary->GetDDInterface((LPVOID*)&owner), DD_OK);
+    CHECK(owner == dd7);
+    CHECK_EQ(dd->directDraw7->RefCount(), 3);
+    owner->Release();
+
+    // No clipper or palette until one is set
+    IDirectDrawClipper* clipper = nullptr;
+    CHECK_EQ(primary->GetClipper(&clipper), DDERR_NOCLIPPERATTACHED);
+    IDirectDrawPalette* palette = nullptr;
+    CHECK_EQ(primary->GetPalette(&palette), DDERR_NOPALETTEATTACHED);
+
+    plain->Release();
+    primary->Release();
+    dd7->Release();
+    dd->Release();
+
+    // DirectDraw without the version 7 interface
+    MockDirectDraw* old = new MockDirectDraw(false);
+    CHECK_EQ(old->QueryInterface(IID_IDirectDraw7, (void**)&dd7), E_NOINTERFACE);
+    CHECK(!dd7);
+    old->Release();
+}
+
+static void TestTrace() {
+    std::string path = TestFilePath("MockComTest.trace");
+    FILE* file = fopen(path.c_str(), "w");
+    CHECK(file);
+    fputs("# two frames\n\nBeginScene Clear SetTexture*3 DrawPrimitiveUP*5 EndScene Present\n"
+        "  BeginScene DrawPrimitive*2 EndScene Present\n", file);
+    fclose(file);
+
+    std::vector<MockTraceFrame> frames;
+    CHECK(MockLoadTrace(path.c_str(), frames));
+    CHECK_EQ(frames.size(), 2);
+    CHECK_EQ(frames[0].size(), 6);
+    CHECK_EQ(frames[0][2].slot, ComSlot::IDirect3DDevice9::SetTexture);
+    CHECK_EQ(frames[0][2].repeat, 3);
+
+    MockDevice9* mock = new MockDevice9(GameParams());
+    MockReplayFrame(mock, frames[0]);
+    MockReplayFrame(mock, frames[1]);
+    CHECK_EQ(mock->Calls(ComSlot::IDirect3DDevice9::BeginScene), 2);
+    CHECK_EQ(mock->Calls(ComSlot::IDirect3DDevice9::SetTexture), 3);
+    CHECK_EQ(mock->Calls(ComSlot::IDirect3DDevice9::DrawPrimitiveUP), 5);
+    CHECK_EQ(mock->Calls(ComSlot::IDirect3DDevice9::Present), 2);
+    CHECK_EQ(mock->primitives, 5 * 2 + 2 * 2);
+    mock->Release();
+
+    file = fopen(path.c_str(), "w");
+    CHECK(file);
+    fputs("BeginScene DrawSomething EndScene\n", file);
+    fclose(file);
+    frames.clear();
+    CHECK(!MockLoadTrace(path.c_str(), frames));
+    remove(path.c_str());
+}
+
+int main() {
+    TestSlotLayout();
+    TestCallsAndLatency();
+    TestHookRegistry();
+    TestSurfaces();
+    TestTrace();
+    puts("MockComTest passed");
+    return 0;
+}
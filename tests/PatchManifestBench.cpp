@@ -0,0 +1,122 @@
+// Cost of loading the patch manifest at startup, on a generated manifest of
+// 500 sites over five builds (pinned and generic, every kind of locator and
+// expressions of one to a dozen operations): microseconds and MB/s to parse
+// it, ns per site to evaluate every site's value, and ns to select a build.
+// Rows are the fastest of five batches.
+//
+// Usage: PatchManifestBench [scale]   (scale 1 = 5 batches of 200 parses and
+// of 2000 evaluations of every site)
+
+#include "../Common/PatchManifest.h"
+#include "TestUtil.h"
+#include <algorithm>
+#include <string>
+
+constexpr int BATCHES = 5;
+constexpr int BUILDS = 5;
+constexpr int SITES_PER_BUILD = 100;
+
+static const char* const VARIABLES[] = { "Width", "Height" };
+static const double VALUES[] = { 1920, 1080 };
+
+static const char* const EXPRESSIONS[] = {
+    "u32 Width",
+    "u16 Height",
+    "i32 -Width / 2 + 400",
+    "u32 (Width - 800) / 2",
+    "f32 Width / Height",
+    "f64 (Width * 0.75 - Height) / (Height - 600) * 2",
+    "u32 Width * 3 / 4 + (Height - 600) / 2 - ((Width - 800) * (Height - 600)) / (Width + Height)",
+    "f32 -(Width / 800.0) * (600.0 / Height) + 1.5",
+};
+
+// Seconds per call of work, fastest of BATCHES batches of count calls
+template <typename Work>
+static double BestOf(int count, Work work) {
+    double best = 1e9;
+    for (int batch = 0; batch < BATCHES; batch++) {
+        double start = NowSeconds();
+        for (int i = 0; i < count; i++) work();
+        best = std::min(best, (NowSeconds() - start) / count);
+    }
+    return best;
+}
+
+static std::string GenerateManifest() {
+    std::string text = "# Generated for PatchManifestBench\n";
+    char line[256];
+    for (int build = 0; build < BUILDS; build++) {
+        snprintf(line, sizeof(line), "\n[Peggle build %d]\nModule = Peggle.exe\n", build);
+        text += line;
+        if (build) {
+            snprintf(line, sizeof(line), "TimeDateStamp = 0x%08X\nSizeOfImage = 0x%X\n", 0x4A000000 + build,
+                0x1A0000 + build * 0x1000);
+            text += line;
+        }
+        for (int site = 0; site < SITES_PER_BUILD; site++) {
+            const char* expression = EXPRESSIONS[site % 8];
+            switch (site % 4) {
+            case 0:
+                snprintf(line, sizeof(line), "Site S%d = rva 0x%06X %s\n", site, 0x150000 + site * 8, expression);
+                break;
+            case 1:
+                snprintf(line, sizeof(line), "Site S%d = sig \"20 03 00 00 58 02 %02X %02X\" rva 0x%06X %s\n", site,
+                    site & 0xFF, build, 0x150000 + site * 8, expression);
+                break;
+            case 2:
+                snprintf(line, sizeof(line), "Site S%d = codesig \"C7 05 ?? ?? ?? ?? 20 03 00 00 %02X\" +6 %s"
+                    "  # width immediate\n", site, site & 0xFF, expression);
+                break;
+            default:
+                snprintf(line, sizeof(line), "Site S%d = sig \"58 02 00 00 ?? %02X\" -4 %s\n", site, site & 0xFF,
+                    expression);
+                break;
+            }
+            text += line;
+        }
+    }
+    return text;
+}
+
+int main(int argc, char** argv) {
+    double scale = BenchScale(argc, argv);
+    int parses = std::max(1, (int)(1000 * scale / BATCHES));
+    int evaluations = std::max(1, (int)(10000 * scale / BATCHES));
+
+    std::string text = GenerateManifest();
+    PatchManifest manifest;
+    std::string error;
+    double parse = BestOf(parses, [&] {
+        CHECK(ParsePatchManifest(text.data(), text.size(), VARIABLES, 2, manifest, error));
+    });
+    CHECK_EQ(manifest.builds.size(), BUILDS);
+
+    size_t sites = 0;
+    for (const ManifestBuild& build : manifest.builds) sites += build.sites.size();
+    uint64_t checksum = 0;
+    double evaluate = BestOf(evaluations, [&] {
+        for (const ManifestBuild& build : manifest.builds) {
+            for (const ManifestSite& site : build.sites) {
+                uint8_t value[8] = {};
+                CHECK(EvaluateManifestSite(site, VALUES, value));
+                checksum += value[0];
+            }
+        }
+    });
+
+    // The last build, past the generic one and the other pinned ones
+    const ManifestBuild* selected = nullptr;
+    uint32_t timeDateStamp = 0x4A000000 + BUILDS - 1;
+    uint32_t sizeOfImage = 0x1A0000 + (BUILDS - 1) * 0x1000;
+    double select = BestOf(evaluations, [&] {
+        selected = SelectManifestBuild(manifest, "peggle.exe", timeDateStamp, sizeOfImage);
+    });
+    CHECK(selected == &manifest.builds.back());
+
+    printf("parse %zu sites, %zu KB   %8.1f us  %6.1f MB/s\n", sites, text.size() / 1024, parse * 1e6,
+        text.size() / parse / 1e6);
+    printf("evaluate every site         %8.1f ns per site (checksum %llu)\n", evaluate * 1e9 / sites,
+        (unsigned long long)checksum);
+    printf("select a pinned build       %8.1f ns\n", select * 1e9);
+    return 0;
+}
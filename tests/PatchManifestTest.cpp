@@ -0,0 +1,300 @@
+// Checks of the patch manifest (PatchManifest.h): a manifest with every kind
+// of locator parsed into its builds and sites; expressions evaluated with C
+// precedence, left associativity, unary minus and integer or floating point
+// arithmetic by value type, and rejected on division by zero or a value out
+// of the type's range; every parse error reported with the line it is on;
+// and SelectManifestBuild preferring builds that pin the executable over
+// generic ones.
+
+#include "../Common/PatchManifest.h"
+#include "TestUtil.h"
+#include <cstring>
+#include <string>
+
+static const char* const VARIABLES[] = { "Width", "Height" };
+static const double VALUES[] = { 1280, 720 };
+
+static bool Parse(const std::string& text, PatchManifest& manifest, std::string& error) {
+    return ParsePatchManifest(text.data(), text.size(), VARIABLES, 2, manifest, error);
+}
+
+// The site of a one-site manifest
+static ManifestSite ParseSite(const char* line) {
+    PatchManifest manifest;
+    std::string error;
+    std::string text = std::string("[Build]\nModule = Peggle.exe\nSite A = rva 0x10 ") + line + "\n";
+    if (!Parse(text, manifest, error)) {
+        fprintf(stderr, "%s: %s\n", line, error.c_str());
+        exit(1);
+    }
+    return manifest.builds[0].sites[0];
+}
+
+static bool Evaluate(const char* line, uint8_t* out) {
+    return EvaluateManifestSite(ParseSite(line), VALUES, out);
+}
+
+static long long EvaluateInteger(const char* line) {
+    uint8_t out[8] = {};
+    ManifestSite site = ParseSite(line);
+    CHECK(EvaluateManifestSite(site, VALUES, out));
+    switch (site.type) {
+    case PATCH_VALUE_U8: return out[0];
+    case PATCH_VALUE_U16: { uint16_t v; memcpy(&v, out, sizeof(v)); return v; }
+    case PATCH_VALUE_U32: { uint32_t v; memcpy(&v, out, sizeof(v)); return v; }
+    default: { int32_t v; memcpy(&v, out, sizeof(v)); return v; }
+    }
+}
+
+static double EvaluateReal(const char* line) {
+    uint8_t out[8] = {};
+    ManifestSite site = ParseSite(line);
+    CHECK(EvaluateManifestSite(site, VALUES, out));
+    if (site.type == PATCH_VALUE_F64) {
+        double v;
+        memcpy(&v, out, sizeof(v));
+        return v;
+    }
+    float v;
+    memcpy(&v, out, sizeof(v));
+    return v;
+}
+
+static void TestParse() {
+    const char* text =
+        "\xEF\xBB\xBF# Peggle builds\n"
+        "\n"
+        "[Peggle Deluxe 1.01]\n"
+        "Module = Peggle.exe   ; the game\n"
+        "TimeDateStamp = 0x4A0F1C2D\n"
+        "SizeOfImage = 1724416\n"
+        "Site Width  = sig \"20 03 00 00 58 02 00 00\" rva 0x15E034 u32 Width\n"
+        "Site Height = sig \"20 03 00 00 58 02 00 00\" +4 u16 Height  # second half\n"
+        "Site Code   = codesig \"C7 05 ?? ?? ?? ?? 20 03\" -0x10 i32 -Width\n"
+        "Site Aspect = rva 0x15E0A0 f32 Width/Height\n"
+        "\n"
+        "[Generic]\n"
+        "Module = Peggle Nights.exe\n";
+    PatchManifest manifest;
+    std::string error;
+    CHECK(ParsePatchManifest(text, strlen(text), VARIABLES, 2, manifest, error));
+    CHECK(error.empty());
+    CHECK_EQ(manifest.builds.size(), 2);
+
+    const ManifestBuild& build = manifest.builds[0];
+    CHECK(build.name == "Peggle Deluxe 1.01");
+    CHECK(build.module == "Peggle.exe");
+    CHECK(build.hasTimeDateStamp);
+    CHECK_EQ(build.timeDateStamp, 0x4A0F1C2D);
+    CHECK(build.hasSizeOfImage);
+    CHECK_EQ(build.sizeOfImage, 1724416);
+    CHECK_EQ(build.sites.size(), 4);
+
+    const ManifestSite& width = build.sites[0];
+    CHECK(width.name == "Width");
+    CHECK_EQ(width.scope, SIGNATURE_DATA);
+    CHECK_EQ(width.pattern.bytes.size(), 8);
+    CHECK_EQ(width.pattern.bytes[4], 0x58);
+    CHECK(width.hasRva);
+    CHECK_EQ(width.rva, 0x15E034);
+    CHECK_EQ(width.offset, 0);
+    CHECK_EQ(width.type, PATCH_VALUE_U32);
+
+    const ManifestSite& height = build.sites[1];
+    CHECK(!height.hasRva);
+    CHECK_EQ(height.offset, 4);
+    CHECK_EQ(height.type, PATCH_VALUE_U16);
+
+    const ManifestSite& code = build.sites[2];
+    CHECK_EQ(code.scope, SIGNATURE_CODE);
+    CHECK_EQ(code.pattern.mask[2], 0x00);
+    CHECK_EQ(code.offset, -16);
+    CHECK_EQ(code.type, PATCH_VALUE_I32);
+
+    const ManifestSite& aspect = build.sites[3];
+    CHECK_EQ(aspect.scope, SIGNATURE_NONE);
+    CHECK_EQ(aspect.type, PATCH_VALUE_F32);
+    CHECK_EQ(aspect.expression.size(), 3);
+    CHECK_EQ(aspect.expression[2].kind, EXPR_DIV);
+
+    CHECK(manifest.builds[1].module == "Peggle Nights.exe");
+    CHECK(!manifest.builds[1].hasTimeDateStamp);
+    CHECK(manifest.builds[1].sites.empty());
+
+    uint8_t value[8];
+    CHECK(EvaluateManifestSite(code, VALUES, value));
+    int32_t negative;
+    memcpy(&negative, value, sizeof(negative));
+    CHECK_EQ(negative, -1280);
+}
+
+static void TestPrecedence() {
+    CHECK_EQ(EvaluateInteger("u32 2 + 3 * 4"), 14);
+    CHECK_EQ(EvaluateInteger("u32 (2 + 3) * 4"), 20);
+    CHECK_EQ(EvaluateInteger("u32 2 * 3 + 4 * 5"), 26);
+    CHECK_EQ(EvaluateInteger("u32 20 - 4 - 3"), 13);
+    CHECK_EQ(EvaluateInteger("u32 64 / 4 / 2"), 8);
+    CHECK_EQ(EvaluateInteger("u32 64 / (4 / 2)"), 32);
+    CHECK_EQ(EvaluateInteger("u32 100 / 3 * 3"), 99);
+    CHECK_EQ(EvaluateInteger("u32 ((Width))"), 1280);
+    CHECK_EQ(EvaluateInteger("u32 Width * 3 / 4 - Height"), 240);
+    CHECK_EQ(EvaluateInteger("u16 0x20 * 0X10"), 512);
+
+    // Unary minus binds tighter than any operator, and nests
+    CHECK_EQ(EvaluateInteger("i32 -Width + 2000"), 720);
+    CHECK_EQ(EvaluateInteger("i32 -(2 + 3) * 4"), -20);
+    CHECK_EQ(EvaluateInteger("i32 2 * -3"), -6);
+    CHECK_EQ(EvaluateInteger("i32 10 - -3"), 13);
+    CHECK_EQ(EvaluateInteger("i32 --5"), 5);
+    CHECK_EQ(EvaluateInteger("i32 -Width / 3"), -426);
+
+    // Integer types divide like C; floating point ones do not
+    CHECK_EQ(EvaluateInteger("u32 Width / Height"), 1);
+    CHECK_EQ(EvaluateInteger("i32 7 / -2"), -3);
+    CHECK(EvaluateReal("f32 Width / Height") == (float)(1280.0 / 720.0));
+    CHECK(EvaluateReal("f64 Width / Height") == 1280.0 / 720.0);
+    CHECK(EvaluateReal("f64 0.5 * (Height - 0.25)") == 359.875);
+    CHECK(EvaluateReal("f32 -1.5") == -1.5);
+}
+
+static void TestRange() {
+    uint8_t out[8];
+    CHECK(!Evaluate("u32 Width / (Height - 720)", out));
+    CHECK(!Evaluate("f32 Width / (Height - 720)", out));
+
+    // At the ends of each type, and one past them
+    CHECK_EQ(EvaluateInteger("u8 255"), 255);
+    CHECK_EQ(EvaluateInteger("u8 0"), 0);
+    CHECK(!Evaluate("u8 Width", out));
+    CHECK(!Evaluate("u8 256", out));
+    CHECK(!Evaluate("u8 -1", out));
+    CHECK_EQ(EvaluateInteger("u16 65535"), 65535);
+    CHECK(!Evaluate("u16 65536", out));
+    CHECK(!Evaluate("u16 Height - 721", out));
+    CHECK_EQ(EvaluateInteger("u32 0xFFFFFFFF"), 0xFFFFFFFFll);
+    CHECK(!Evaluate("u32 0xFFFFFFFF + 1", out));
+    CHECK(!Evaluate("u32 2 - 3", out));
+    CHECK_EQ(EvaluateInteger("i32 -2147483647 - 1"), -2147483647ll - 1);
+    CHECK_EQ(EvaluateInteger("i32 2147483647"), 2147483647);
+    CHECK(!Evaluate("i32 2147483648", out));
+    CHECK(!Evaluate("i32 -2147483647 - 2", out));
+    CHECK(EvaluateReal("f32 1000000 * 1000000") == 1e12f);
+    CHECK(!Evaluate("f32 1000000000 * 1000000000 * 1000000000 * 1000000000 * 1000", out));
+    CHECK(!Evaluate("f32 -1000000000 * 1000000000 * 1000000000 * 1000000000 * 1000", out));
+    CHECK(EvaluateReal("f64 1000000000 * 1000000000 * 1000000000 * 1000000000 * 1000") > 9.99e38);
+}
+
+// A manifest whose line 4 is line fails with problem on that line
+static void CheckError(const char* line, const char* problem) {
+    std::string text = std::string("# builds\n[Build]\nModule = Peggle.exe\n") + line + "\nSite B = rva 4 u32 1\n";
+    PatchManifest manifest;
+    std::string error;
+    std::string expected = std::string("line 4: ") + problem;
+    if (Parse(text, manifest, error) || error != expected) {
+        fprintf(stderr, "%s: got \"%s\", not \"%s\"\n", line, error.c_str(), expected.c_str());
+        exit(1);
+    }
+}
+
+static void TestErrors() {
+    CheckError("[Build", "unterminated section");
+    CheckError("[Build] x", "unexpected text at end of line");
+    CheckError("= 5", "key expected");
+    CheckError("Module Peggle.exe", "'=' expected");
+    CheckError("Module =   # none", "module name expected");
+    CheckError("TimeDateStamp = 0x100000000", "bad TimeDateStamp");
+    CheckError("TimeDateStamp = 1.5", "bad TimeDateStamp");
+    CheckError("SizeOfImage = big", "bad SizeOfImage");
+    CheckError("Flavor = 1", "unknown key");
+
+    CheckError("Site = rva 1 u32 1", "site name expected");
+    CheckError("Site A rva 1 u32 1", "'=' expected");
+    CheckError("Site A = +x u32 1", "bad offset");
+    CheckError("Site A = -0x80000000 u32 1", "bad offset");
+    CheckError("Site A = rva 1", "locator or value type expected");
+    CheckError("Site A = rva -1 u32 1", "bad rva");
+    CheckError("Site A = sig 20 03", "quoted signature expected");
+    CheckError("Site A = sig \"20 03", "unterminated signature");
+    CheckError("Site A = sig \"20 0\" u32 1", "bad signature");
+    CheckError("Site A = near 1 u32 1", "unknown locator");
+    CheckError("Site A = u32 1", "site needs an rva or a signature");
+
+    CheckError("Site A = rva 1 u32", "expression expected");
+    CheckError("Site A = rva 1 u32 1 +", "expression expected");
+    CheckError("Site A = rva 1 u32 * 2", "operand expected");
+    CheckError("Site A = rva 1 u32 1 2", "operator expected");
+    CheckError("Site A = rva 1 u32 Depth", "unknown variable");
+    CheckError("Site A = rva 1 u32 1.5", "fractional constant in an integer expression");
+    CheckError("Site A = rva 1 u32 (1 + 2", "unbalanced '('");
+    CheckError("Site A = rva 1 u32 1 + 2)", "unbalanced ')'");
+    CheckError("Site A = rva 1 u32 1 + 2 % 3", "operator expected");
+    CheckError(("Site A = rva 1 u32 " + std::string(33, '(') + "1" + std::string(33, ')')).c_str(),
+        "expression too deep");
+
+    // Before any section, and a section without a module
+    PatchManifest manifest;
+    std::string error;
+    CHECK(!Parse("\nModule = Peggle.exe\n", manifest, error));
+    CHECK(error == "line 2: entry outside of a [build] section");
+    CHECK(!Parse("[A]\nModule = Peggle.exe\n\n# B\n[B]\nSite A = rva 1 u8 1\n[C]\nModule = x\n", manifest, error));
+    CHECK(error == "line 5: build [B] has no Module");
+    CHECK(!Parse("[A]\n", manifest, error));
+    CHECK(error == "line 1: build [A] has no Module");
+
+    // Nothing is kept from a manifest that failed
+    CHECK(!Parse("[A]\nModule = Peggle.exe\nSite B = rva 4 u32 1\nbad\n", manifest, error));
+    CHECK(error == "line 4: '=' expected");
+    CHECK(Parse("", manifest, error));
+    CHECK(manifest.builds.empty());
+    CHECK(error.empty());
+}
+
+static void TestSelect() {
+    const char* text =
+        "[Generic]\n"
+        "Module = Peggle.exe\n"
+        "[Generic again]\n"
+        "Module = Peggle.exe\n"
+        "[Pinned]\n"
+        "Module = PEGGLE.EXE\n"
+        "TimeDateStamp = 0x100\n"
+        "[Sized]\n"
+        "Module = peggle.exe\n"
+        "SizeOfImage = 0x2000\n"
+        "[Both]\n"
+        "Module = Peggle.exe\n"
+        "TimeDateStamp = 0x300\n"
+        "SizeOfImage = 0x3000\n"
+        "[Nights]\n"
+        "Module = PeggleNights.exe\n";
+    PatchManifest manifest;
+    std::string error;
+    CHECK(Parse(text, manifest, error));
+    CHECK_EQ(manifest.builds.size(), 6);
+
+    auto select = [&](const char* module, uint32_t timeDateStamp, uint32_t sizeOfImage) {
+        const ManifestBuild* build = SelectManifestBuild(manifest, module, timeDateStamp, sizeOfImage);
+        return build ? build->name : std::string("none");
+    };
+    // Pinned builds win over the generic ones listed before them
+    CHECK(select("Peggle.exe", 0x100, 0x1000) == "Pinned");
+    CHECK(select("peggle.EXE", 0x200, 0x2000) == "Sized");
+    CHECK(select("Peggle.exe", 0x100, 0x2000) == "Pinned");
+    CHECK(select("Peggle.exe", 0x300, 0x3000) == "Both");
+    // A build pinning both needs both to match
+    CHECK(select("Peggle.exe", 0x300, 0x1000) == "Generic");
+    CHECK(select("Peggle.exe", 0x200, 0x3000) == "Generic");
+    CHECK(select("PeggleNights.exe", 0x100, 0x2000) == "Nights");
+    CHECK(select("Peggle", 0x100, 0x2000) == "none");
+    CHECK(select("Bejeweled.exe", 0, 0) == "none");
+}
+
+int main() {
+    TestParse();
+    TestPrecedence();
+    TestRange();
+    TestErrors();
+    TestSelect();
+    puts("PatchManifestTest passed");
+    return 0;
+}
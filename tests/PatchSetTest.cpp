@@ -0,0 +1,225 @@
+// Checks of the patch transaction against a byte buffer with simulated page
+// protection: sites are written with one protection change per run of pages,
+// only while the other threads are suspended, and protection is put back; a
+// failed write, protection change or verification rolls every site back, the
+// one that failed included; Restore() puts the originals back and leaves
+// sites someone else changed.
+
+#include "../Common/PatchSet.h"
+#include "../Common/PatchTargetBuffer.h"
+#include "TestUtil.h"
+#include <cstring>
+#include <vector>
+
+constexpr size_t PAGE = 0x1000;
+constexpr size_t PAGES = 8;
+
+static void Fill(BufferPatchTarget& target) {
+    for (size_t i = 0; i < target.Size(); i++) target.Data()[i] = (uint8_t)(i * 7 + 3);
+}
+
+static uint32_t ValueAt(BufferPatchTarget& target, size_t offset) {
+    uint32_t value;
+    memcpy(&value, target.Data() + offset, sizeof(value));
+    return value;
+}
+
+// Sites across a page boundary, on a writable page, and on two pages far apart
+static void AddSites(PatchSet& set, BufferPatchTarget& target) {
+    CHECK(set.AddValue<uint32_t>("Straddle", target.Base() + PAGE - 2, 0x11111111));
+    CHECK(set.AddValue<uint32_t>("Writable", target.Base() + 3 * PAGE + 16, 0x22222222));
+    CHECK(set.AddValue<uint32_t>("Code", target.Base() + 5 * PAGE + 8, 0x33333333));
+    CHECK(set.AddValue<uint32_t>("Last", target.Base() + PAGES * PAGE - 4, 0x44444444));
+}
+
+static void SetUpProtection(BufferPatchTarget& target) {
+    target.Protect(3, BUFFER_READ | BUFFER_WRITE);
+    target.Protect(5, BUFFER_READ | BUFFER_EXECUTE);
+}
+
+static void CheckProtectionUnchanged(const BufferPatchTarget& target) {
+    for (size_t page = 0; page < PAGES; page++) {
+        uint32_t expected = page == 3 ? (BUFFER_READ | BUFFER_WRITE)
+            : page == 5 ? (BUFFER_READ | BUFFER_EXECUTE) : BUFFER_READ;
+        CHECK_EQ(target.Protection(page), expected);
+    }
+}
+
+static void TestApplyAndRestore() {
+    BufferPatchTarget target(PAGES, PAGE);
+    SetUpProtection(target);
+    Fill(target);
+    std::vector<uint8_t> before(target.Data(), target.Data() + target.Size());
+
+    PatchSet set;
+    AddSites(set, target);
+    CHECK(set.Apply(target));
+    CHECK(set.IsApplied());
+    CHECK_EQ(ValueAt(target, PAGE - 2), 0x11111111);
+    CHECK_EQ(ValueAt(target, 3 * PAGE + 16), 0x22222222);
+    CHECK_EQ(ValueAt(target, 5 * PAGE + 8), 0x33333333);
+    CHECK_EQ(ValueAt(target, PAGES * PAGE - 4), 0x44444444);
+
+    // Pages 0-1, 3, 5 and 7: one change for each run of equal protection
+    CHECK_EQ(target.SetProtectionCalls(), 2 * 4);
+    CheckProtectionUnchanged(target);
+    CHECK_EQ(target.SuspendDepth(), 0);
+    CHECK(!target.TouchedWhileRunning());
+    CHECK_EQ(target.FlushCalls(), 1);
+    for (const MemoryPatch& site : set.Sites()) CHECK(site.applied);
+
+    // Nothing outside the sites changed
+    size_t changed = 0;
+    for (size_t i = 0; i < before.size(); i++) changed += before[i] != target.Data()[i];
+    CHECK(changed <= 16);
+
+    CHECK(!set.Add("Late", target.Base(), "x", 1));
+    CHECK(set.Apply(target));  // already applied
+    CHECK_EQ(set.Restore(target), 4);
+    CHECK(!set.IsApplied());
+    CHECK(memcmp(before.data(), target.Data(), before.size()) == 0);
+    CheckProtectionUnchanged(target);
+    CHECK_EQ(set.Restore(target), 0);
+}
+
+static void TestRestoreSkipsChangedSite() {
+    BufferPatchTarget target(PAGES, PAGE);
+    SetUpProtection(target);
+    Fill(target);
+    std::vector<uint8_t> before(target.Data(), target.Data() + target.Size());
+
+    PatchSet set;
+    AddSites(set, target);
+    CHECK(set.Apply(target));
+
+    // The game rewrote the writable site after it was patched
+    memset(target.Data() + 3 * PAGE + 16, 0x5A, 4);
+    CHECK_EQ(set.Restore(target), 3);
+    CHECK(!set.IsApplied());
+    CHECK_EQ(ValueAt(target, 3 * PAGE + 16), 0x5A5A5A5A);
+    memcpy(target.Data() + 3 * PAGE + 16, before.data() + 3 * PAGE + 16, 4);
+    CHECK(memcmp(before.data(), target.Data(), before.size()) == 0);
+}
+
+// Each failure leaves the buffer and its protection exactly as they were
+static void CheckRolledBack(BufferPatchTarget& target, const std::vector<uint8_t>& before, const PatchSet& set) {
+    CHECK(!set.IsApplied());
+    CHECK(memcmp(before.data(), target.Data(), before.size()) == 0);
+    CheckProtectionUnchanged(target);
+    CHECK_EQ(target.SuspendDepth(), 0);
+    CHECK(!target.TouchedWhileRunning());
+    for (const MemoryPatch& site : set.Sites()) CHECK(!site.applied);
+}
+
+static void TestRollbackOnFailedWrite() {
+    for (size_t failAt = 0; failAt < 4; failAt++) {
+        BufferPatchTarget target(PAGES, PAGE);
+        SetUpProtection(target);
+        Fill(target);
+        std::vector<uint8_t> before(target.Data(), target.Data() + target.Size());
+
+        PatchSet set;
+        AddSites(set, target);
+        target.FailWrite(failAt);
+        CHECK(!set.Apply(target));
+        CheckRolledBack(target, before, set);
+
+        // The set can still be applied once the target behaves
+        target.FailWrite(BUFFER_NEVER);
+        CHECK(set.Apply(target));
+        CHECK_EQ(ValueAt(target, PAGES * PAGE - 4), 0x44444444);
+    }
+}
+
+static void TestRollbackOnFailedProtection() {
+    for (size_t failAt = 0; failAt < 4; failAt++) {
+        BufferPatchTarget target(PAGES, PAGE);
+        SetUpProtection(target);
+        Fill(target);
+        std::vector<uint8_t> before(target.Data(), target.Data() + target.Size());
+
+        PatchSet set;
+        AddSites(set, target);
+        target.FailSetProtection(failAt);
+        CHECK(!set.Apply(target));
+        CheckRolledBack(target, before, set);
+    }
+}
+
+static void TestRollbackOnFailedVerification() {
+    BufferPatchTarget target(PAGES, PAGE);
+    SetUpProtection(target);
+    Fill(target);
+    std::vector<uint8_t> before(target.Data(), target.Data() + target.Size());
+
+    PatchSet set;
+    AddSites(set, target);
+    target.DropWrites(true);
+    CHECK(!set.Apply(target));
+    CheckRolledBack(target, before, set);
+}
+
+// The site's write lands but reads back wrong, so it fails after it was
+// written: it is put back along with the sites before it
+static void TestRollbackOnCorruptVerification() {
+    // Each site reads its original, then verifies its write: reads 2 * i and
+    // 2 * i + 1 for the i-th site by address
+    for (size_t failAt = 1; failAt < 8; failAt += 2) {
+        BufferPatchTarget target(PAGES, PAGE);
+        SetUpProtection(target);
+        Fill(target);
+        std::vector<uint8_t> before(target.Data(), target.Data() + target.Size());
+
+        PatchSet set;
+        AddSites(set, target);
+        target.CorruptRead(failAt);
+        CHECK(!set.Apply(target));
+        CheckRolledBack(target, before, set);
+
+        target.CorruptRead(BUFFER_NEVER);
+        CHECK(set.Apply(target));
+        CHECK_EQ(ValueAt(target, PAGE - 2), 0x11111111);
+    }
+}
+
+static void TestInaccessibleSite() {
+    BufferPatchTarget target(PAGES, PAGE);
+    SetUpProtection(target);
+    Fill(target);
+    std::vector<uint8_t> before(target.Data(), target.Data() + target.Size());
+
+    // A site past the end of the buffer, as a bad manifest address would be:
+    // its protection cannot be queried, so nothing is touched at all
+    PatchSet set;
+    AddSites(set, target);
+    CHECK(set.AddValue<uint32_t>("Outside", target.Base() + target.Size() + PAGE, 0x55555555));
+    CHECK(!set.Apply(target));
+    CheckRolledBack(target, before, set);
+}
+
+static void TestAddLimits() {
+    PatchSet set;
+    uint8_t bytes[MAX_PATCH_SIZE + 1] = {};
+    CHECK(!set.Add("Empty", 0x1000, bytes, 0));
+    CHECK(!set.Add("Large", 0x1000, bytes, MAX_PATCH_SIZE + 1));
+    CHECK(set.Add("Largest", 0x1000, bytes, MAX_PATCH_SIZE));
+    CHECK_EQ(set.Sites().size(), 1);
+
+    BufferPatchTarget target(1, PAGE);
+    PatchSet empty;
+    CHECK(!empty.Apply(target));
+    CHECK_EQ(target.SetProtectionCalls(), 0);
+}
+
+int main() {
+    TestApplyAndRestore();
+    TestRestoreSkipsChangedSite();
+    TestRollbackOnFailedWrite();
+    TestRollbackOnFailedProtection();
+    TestRollbackOnFailedVerification();
+    TestRollbackOnCorruptVerification();
+    TestInaccessibleSite();
+    TestAddLimits();
+    puts("PatchSetTest passed");
+    return 0;
+}
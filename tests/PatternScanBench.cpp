@@ -0,0 +1,61 @@
+// Signature scan throughput over the .text section of a multi-megabyte
+// synthetic executable, per scan path, in GB/s. The patterns are the
+// resolution constants the hook looks for and a longer code signature with
+// wildcards; each is planted once near the end so the whole section is
+// scanned.
+//
+// Usage: PatternScanBench [scale]   (scale 1 = 64 MB of .text)
+
+#include "../Common/CpuFeatures.h"
+#include "../Common/PatternScan.h"
+#include "PeFixture.h"
+#include "TestUtil.h"
+#include <algorithm>
+#include <vector>
+
+int main(int argc, char** argv) {
+    double scale = BenchScale(argc, argv);
+    uint32_t textSize = std::max<uint32_t>(1 << 20, (uint32_t)((64 << 20) * scale));
+
+    PeFixture fixture;
+    CHECK(BuildPeFixture(textSize, 4 << 20, 1 << 20, 1, fixture));
+
+    const char* patterns[] = {
+        "20 03 00 00 58 02 00 00",
+        "8B 0D ?? ?? ?? ?? 85 C9 74 ?? 6A 00 68 ?? ?? ?? ?? FF 15",
+    };
+    std::vector<BytePattern> parsed;
+    for (const char* text : patterns) {
+        BytePattern pattern;
+        CHECK(ParsePattern(text, pattern));
+        std::vector<uint8_t> bytes(pattern.bytes);
+        uint32_t offset = textSize - 4096 * (uint32_t)(parsed.size() + 1);
+        PlantBytes(fixture, ".text", offset, bytes.data(), bytes.size());
+        parsed.push_back(pattern);
+    }
+
+    size_t size;
+    const uint8_t* text = PeSectionData(fixture.image, *FindPeSection(fixture.image, ".text"), size);
+    const char* names[] = { "scalar", "SSE2", "AVX2" };
+    int repeats = std::max(1, (int)(10 * scale));
+
+    for (int path = PATTERN_SCAN_SCALAR; path <= PATTERN_SCAN_AVX2; path++) {
+        if (path == PATTERN_SCAN_SSE2 && !CpuHasSse2()) continue;
+        if (path == PATTERN_SCAN_AVX2 && !CpuHasAvx2()) continue;
+        PatternScanForcePath((PatternScanPath)path);
+
+        for (size_t p = 0; p < parsed.size(); p++) {
+            double start = NowSeconds();
+            size_t found = 0;
+            for (int r = 0; r < repeats; r++) {
+                std::vector<const uint8_t*> matches;
+                found = FindAllPatterns(text, text + size, parsed[p], matches);
+            }
+            double elapsed = NowSeconds() - start;
+            CHECK(found >= 1);
+            printf("%-6s %-60s %6.2f GB/s (%zu MB, %zu match(es))\n", names[path], patterns[p],
+                (double)size * repeats / elapsed / 1e9, size >> 20, found);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,192 @@
+// Checks of the signature scanner and the PE parser it runs on: pattern
+// parsing, every scan path against a naive reference (wildcards at either
+// end, matches at the buffer edges, overlapping matches, match limits), and
+// locating a planted signature in the .text section of a synthetic executable
+// read from disk and in its loaded layout.
+
+#include "../Common/CpuFeatures.h"
+#include "../Common/MappedFile.h"
+#include "../Common/PatternScan.h"
+#include "../Common/PeImage.h"
+#include "PeFixture.h"
+#include "TestUtil.h"
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::vector<PatternScanPath> SupportedPaths() {
+    std::vector<PatternScanPath> paths = { PATTERN_SCAN_SCALAR };
+#ifdef PEGGLE_X86
+    if (CpuHasSse2()) paths.push_back(PATTERN_SCAN_SSE2);
+    if (CpuHasAvx2()) paths.push_back(PATTERN_SCAN_AVX2);
+#endif
+    return paths;
+}
+
+static std::vector<size_t> ReferenceScan(const std::vector<uint8_t>& data, const BytePattern& pattern) {
+    std::vector<size_t> matches;
+    size_t length = pattern.bytes.size();
+    for (size_t i = 0; i + length <= data.size(); i++) {
+        bool match = true;
+        for (size_t j = 0; j < length && match; j++) {
+            match = (data[i + j] & pattern.mask[j]) == pattern.bytes[j];
+        }
+        if (match) matches.push_back(i);
+    }
+    return matches;
+}
+
+static void TestParse() {
+    BytePattern pattern;
+    CHECK(ParsePattern("8B 0D ?? ?? ?? ?? 85 C9", pattern));
+    CHECK_EQ(pattern.bytes.size(), 8);
+    CHECK_EQ(pattern.bytes[1], 0x0D);
+    CHECK_EQ(pattern.mask[2], 0x00);
+    CHECK_EQ(pattern.mask[7], 0xFF);
+    CHECK_EQ(pattern.firstFixed, 0);
+    CHECK_EQ(pattern.lastFixed, 7);
+
+    CHECK(ParsePattern("? ? 58 02 ?", pattern));
+    CHECK_EQ(pattern.bytes.size(), 5);
+    CHECK_EQ(pattern.firstFixed, 2);
+    CHECK_EQ(pattern.lastFixed, 3);
+
+    CHECK(ParsePattern("c9", pattern));
+    CHECK_EQ(pattern.bytes[0], 0xC9);
+
+    CHECK(!ParsePattern("", pattern));
+    CHECK(!ParsePattern("?? ??", pattern));
+    CHECK(!ParsePattern("8G", pattern));
+    CHECK(!ParsePattern("8B 0", pattern));
+
+    // Separators are optional
+    CHECK(ParsePattern("8B0D??C9", pattern));
+    CHECK_EQ(pattern.bytes.size(), 4);
+    CHECK_EQ(pattern.mask[2], 0x00);
+}
+
+static void TestPathsAgainstReference() {
+    std::mt19937 random(7);
+    const char* patterns[] = {
+        "AA",
+        "AA AA",
+        "?? 01 02 ??",
+        "20 03 00 00 58 02 ?? 00",
+        "E8 ?? ?? ?? ?? 83 C4 ?? 85 C0 74 ?? 8B 0D ?? ?? ?? ?? 6A 00 68 ?? ?? ?? ?? 51 FF 15 ?? ?? ?? ?? 90",
+    };
+
+    for (const char* text : patterns) {
+        BytePattern pattern;
+        CHECK(ParsePattern(text, pattern));
+        size_t length = pattern.bytes.size();
+
+        for (size_t size : { length, length + 1, (size_t)31, (size_t)64, (size_t)100, (size_t)4099 }) {
+            if (size < length) continue;
+            // A small alphabet so the filter bytes match often
+            std::vector<uint8_t> data(size);
+            for (uint8_t& b : data) b = (random() & 1) ? 0xAA : (uint8_t)random();
+
+            // Matches at both edges and a few in between
+            for (size_t at : { (size_t)0, size - length, size / 3, size / 2 + 1 }) {
+                if (at > size - length) continue;
+                for (size_t j = 0; j < length; j++) {
+                    data[at + j] = pattern.mask[j] ? pattern.bytes[j] : (uint8_t)random();
+                }
+            }
+
+            std::vector<size_t> expected = ReferenceScan(data, pattern);
+            for (PatternScanPath path : SupportedPaths()) {
+                PatternScanForcePath(path);
+                std::vector<const uint8_t*> found;
+                size_t count = FindAllPatterns(data.data(), data.data() + data.size(), pattern, found);
+                CHECK_EQ(count, expected.size());
+                CHECK_EQ(found.size(), expected.size());
+                for (size_t i = 0; i < found.size(); i++) CHECK_EQ(found[i] - data.data(), expected[i]);
+
+                const uint8_t* first = FindPattern(data.data(), data.data() + data.size(), pattern);
+                CHECK(first == data.data() + expected[0]);
+
+                found.clear();
+                CHECK_EQ(FindAllPatterns(data.data(), data.data() + data.size(), pattern, found, 2),
+                    expected.size() < 2 ? expected.size() : 2);
+            }
+        }
+    }
+}
+
+static void TestEmptyAndShortRanges() {
+    BytePattern pattern;
+    CHECK(ParsePattern("01 02 03", pattern));
+    const uint8_t data[] = { 1, 2 };
+    for (PatternScanPath path : SupportedPaths()) {
+        PatternScanForcePath(path);
+        CHECK(FindPattern(data, data, pattern) == nullptr);
+        CHECK(FindPattern(data, data + 2, pattern) == nullptr);
+    }
+}
+
+static void TestPeFixture() {
+    PeFixture fixture;
+    CHECK(BuildPeFixture(3 << 20, 1 << 20, 256 << 10, 1, fixture));
+    CHECK(!fixture.image.is64);
+    CHECK_EQ(fixture.image.machine, 0x14C);
+    CHECK_EQ(fixture.image.timeDateStamp, FIXTURE_TIMESTAMP);
+    CHECK_EQ(fixture.image.imageBase, FIXTURE_IMAGE_BASE);
+    CHECK_EQ(fixture.image.sections.size(), 3);
+
+    const uint8_t signature[] = { 0x20, 0x03, 0x00, 0x00, 0x58, 0x02, 0x00, 0x00 };
+    uint32_t rva = PlantBytes(fixture, ".text", 0x2ABCDE, signature, sizeof(signature));
+
+    std::string path = TestFilePath("PatternScanFixture.exe");
+    FILE* out = fopen(path.c_str(), "wb");
+    CHECK(out);
+    CHECK(fwrite(fixture.file.data(), 1, fixture.file.size(), out) == fixture.file.size());
+    fclose(out);
+
+    MappedFile mapped;
+    CHECK(MapFileReadOnly(path.c_str(), mapped));
+    CHECK_EQ(mapped.size, fixture.file.size());
+
+    PeImage image;
+    CHECK(ParsePeImage(mapped.data, mapped.size, PE_LAYOUT_FILE, image));
+    const PeSection* text = FindPeSection(image, ".text");
+    CHECK(text);
+    CHECK(text->characteristics & PE_SCN_MEM_EXECUTE);
+    size_t textSize;
+    const uint8_t* textData = PeSectionData(image, *text, textSize);
+    CHECK(textData);
+
+    BytePattern pattern;
+    CHECK(ParsePattern("20 03 00 00 58 02 ?? 00", pattern));
+    for (PatternScanPath path : SupportedPaths()) {
+        PatternScanForcePath(path);
+        const uint8_t* match = FindPattern(textData, textData + textSize, pattern);
+        CHECK(match);
+        CHECK_EQ(text->virtualAddress + (match - textData), rva);
+        CHECK(PeRvaToPointer(image, rva, sizeof(signature)) == match);
+    }
+    UnmapFile(mapped);
+    remove(path.c_str());
+
+    // The same search in the loaded layout, as the hook does it in process
+    std::vector<uint8_t> loaded = MapPeFixture(fixture);
+    CHECK(ParsePeImage(loaded.data(), loaded.size(), PE_LAYOUT_IMAGE, image));
+    textData = PeSectionData(image, *FindPeSection(image, ".text"), textSize);
+    CHECK(FindPattern(textData, textData + textSize, pattern) == loaded.data() + rva);
+
+    // Only the header page of a live module is needed to list the sections
+    CHECK(ParsePeImage(loaded.data(), 0x1000, PE_LAYOUT_IMAGE, image));
+    CHECK_EQ(image.sections.size(), 3);
+    CHECK(PeSectionData(image, image.sections[0], textSize) == nullptr);
+}
+
+int main() {
+    TestParse();
+    TestPathsAgainstReference();
+    TestEmptyAndShortRanges();
+    TestPeFixture();
+    PatternScanForcePath(PatternScanDefaultPath());
+    puts("PatternScanTest passed");
+    return 0;
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "../Common/PeImage.h"
+
+// Synthetic 32-bit PE executables for the pattern scan tests and benchmarks:
+// headers like the linker writes them and .text, .rdata and .data sections of
+// the requested sizes, filled with seeded random bytes. PlantBytes() puts a
+// signature at a known offset of a section.
+
+constexpr uint32_t FIXTURE_FILE_ALIGNMENT = 0x200;
+constexpr uint32_t FIXTURE_SECTION_ALIGNMENT = 0x1000;
+constexpr uint32_t FIXTURE_IMAGE_BASE = 0x400000;
+constexpr uint32_t FIXTURE_TIMESTAMP = 0x4A3B2C1D;
+
+struct PeFixture {
+    std::vector<uint8_t> file;  // file layout
+    PeImage image;              // parsed from file
+};
+
+inline uint32_t AlignUp(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+template <typename T>
+inline void PutAt(std::vector<uint8_t>& data, size_t offset, T value) {
+    memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+inline bool BuildPeFixture(uint32_t textSize, uint32_t rdataSize, uint32_t dataSize, uint32_t seed,
+    PeFixture& fixture) {
+    struct Section {
+        const char* name;
+        uint32_t size;
+        uint32_t characteristics;
+    };
+    const Section sections[] = {
+        { ".text", textSize, PE_SCN_CODE | PE_SCN_MEM_EXECUTE | PE_SCN_MEM_READ },
+        { ".rdata", rdataSize, PE_SCN_INITIALIZED_DATA | PE_SCN_MEM_READ },
+        { ".data", dataSize, PE_SCN_INITIALIZED_DATA | PE_SCN_MEM_READ | PE_SCN_MEM_WRITE },
+    };
+    const uint32_t ntOffset = 0x80;
+    const uint32_t optionalOffset = ntOffset + 4 + 20;
+    const uint32_t optionalSize = 0xE0;
+    const uint32_t sectionTable = optionalOffset + optionalSize;
+    const uint32_t headersSize = AlignUp(sectionTable + 3 * 40, FIXTURE_FILE_ALIGNMENT);
+
+    uint32_t fileSize = headersSize;
+    uint32_t imageSize = FIXTURE_SECTION_ALIGNMENT;
+    for (const Section& section : sections) {
+        fileSize += AlignUp(section.size, FIXTURE_FILE_ALIGNMENT);
+        imageSize += AlignUp(section.size, FIXTURE_SECTION_ALIGNMENT);
+    }
+
+    std::vector<uint8_t>& file = fixture.file;
+    file.assign(fileSize, 0);
+    PutAt<uint16_t>(file, 0, 0x5A4D);
+    PutAt<uint32_t>(file, 0x3C, ntOffset);
+    PutAt<uint32_t>(file, ntOffset, 0x00004550);
+
+    // COFF file header
+    PutAt<uint16_t>(file, ntOffset + 4, 0x14C);
+    PutAt<uint16_t>(file, ntOffset + 6, 3);
+    PutAt<uint32_t>(file, ntOffset + 8, FIXTURE_TIMESTAMP);
+    PutAt<uint16_t>(file, ntOffset + 20, (uint16_t)optionalSize);
+    PutAt<uint16_t>(file, ntOffset + 22, 0x0102);
+
+    // PE32 optional header
+    PutAt<uint16_t>(file, optionalOffset, 0x10B);
+    PutAt<uint32_t>(file, optionalOffset + 16, FIXTURE_SECTION_ALIGNMENT);
+    PutAt<uint32_t>(file, optionalOffset + 28, FIXTURE_IMAGE_BASE);
+    PutAt<uint32_t>(file, optionalOffset + 32, FIXTURE_SECTION_ALIGNMENT);
+    PutAt<uint32_t>(file, optionalOffset + 36, FIXTURE_FILE_ALIGNMENT);
+    PutAt<uint32_t>(file, optionalOffset + 56, imageSize);
+    PutAt<uint32_t>(file, optionalOffset + 60, headersSize);
+
+    std::mt19937 random(seed);
+    uint32_t rawOffset = headersSize;
+    uint32_t rva = FIXTURE_SECTION_ALIGNMENT;
+    for (int i = 0; i < 3; i++) {
+        const Section& section = sections[i];
+        size_t header = sectionTable + i * 40;
+        memcpy(file.data() + header, section.name, strlen(section.name));
+        PutAt<uint32_t>(file, header + 8, section.size);
+        PutAt<uint32_t>(file, header + 12, rva);
+        PutAt<uint32_t>(file, header + 16, AlignUp(section.size, FIXTURE_FILE_ALIGNMENT));
+        PutAt<uint32_t>(file, header + 20, rawOffset);
+        PutAt<uint32_t>(file, header + 36, section.characteristics);
+
+        for (uint32_t j = 0; j < section.size; j++) file[rawOffset + j] = (uint8_t)random();
+        rawOffset += AlignUp(section.size, FIXTURE_FILE_ALIGNMENT);
+        rva += AlignUp(section.size, FIXTURE_SECTION_ALIGNMENT);
+    }
+
+    return ParsePeImage(file.data(), file.size(), PE_LAYOUT_FILE, fixture.image);
+}
+
+// The fixture as the Windows loader would map it: sections at their RVAs.
+inline std::vector<uint8_t> MapPeFixture(const PeFixture& fixture) {
+    std::vector<uint8_t> mapped(fixture.image.sizeOfImage, 0);
+    memcpy(mapped.data(), fixture.file.data(), fixture.image.sizeOfHeaders);
+    for (const PeSection& section : fixture.image.sections) {
+        memcpy(mapped.data() + section.virtualAddress, fixture.file.data() + section.rawOffset,
+            section.rawSize < section.virtualSize ? section.rawSize : section.virtualSize);
+    }
+    return mapped;
+}
+
+// Copy bytes to offset within a section's raw data. Returns the RVA.
+inline uint32_t PlantBytes(PeFixture& fixture, const char* sectionName, uint32_t offset,
+    const uint8_t* bytes, size_t length) {
+    const PeSection* section = FindPeSection(fixture.image, sectionName);
+    memcpy(fixture.file.data() + section->rawOffset + offset, bytes, length);
+    return section->virtualAddress + offset;
+}
@@ -0,0 +1,93 @@
+// Pixel conversion on its own and fused with the scaler. Converting a whole
+// 800x600 frame of RGB565, RGB555 or 8-bit palettized pixels to 32 bits, in
+// milliseconds and megapixels per second, per path; then scaling that frame
+// to 3840x2160 per filter on the default path: from a 32-bit source, from
+// RGB565 and 8-bit sources converted row by row inside the scaler, and from
+// RGB565 converted in a separate pass over the frame first. Rows are the
+// fastest of five batches.
+//
+// Usage: PixelConvertBench [scale]   (scale 1 = 5 batches of 100 conversions
+// and of 20 scaled frames per row)
+
+#include "../Common/ImageScaler.h"
+#include "../Common/PixelConvert.h"
+#include "ImageFixture.h"
+#include "TestUtil.h"
+#include <algorithm>
+#include <random>
+
+struct BenchFormat {
+    ImageFormat format;
+    const char* name;
+};
+
+static const BenchFormat FORMATS[] = {
+    { IMAGE_FORMAT_RGB565, "RGB565" },
+    { IMAGE_FORMAT_RGB555, "RGB555" },
+    { IMAGE_FORMAT_PALETTE8, "palette8" },
+};
+
+static uint32_t g_palette[256];
+
+// Seconds per call of work, fastest of BATCHES batches of count calls
+template <typename Work>
+static double BestOf(int count, Work work) {
+    double best = 1e9;
+    for (int batch = 0; batch < BATCHES; batch++) {
+        double start = NowSeconds();
+        for (int i = 0; i < count; i++) work();
+        best = std::min(best, (NowSeconds() - start) / count);
+    }
+    return best;
+}
+
+static void ConvertFrame(ImageScalePath path, const TestImage& source, TestImage& out) {
+    for (uint32_t y = 0; y < source.view.height; y++) {
+        ConvertPixels(path, source.view.format, ImageRow(source, y), g_palette, source.view.width,
+            reinterpret_cast<uint32_t*>(ImageRow(out, y)));
+    }
+}
+
+int main(int argc, char** argv) {
+    double scale = BenchScale(argc, argv);
+    int conversions = std::max(1, (int)(500 * scale / BATCHES));
+    int frames = std::max(1, (int)(100 * scale / BATCHES));
+    std::mt19937 random(1);
+    for (uint32_t& entry : g_palette) entry = random() & 0xFFFFFF;
+
+    TestImage sources[3];
+    for (int i = 0; i < 3; i++) {
+        MakeImage(800, 600, sources[i], 0, FORMATS[i].format);
+        FillRandom(sources[i], i + 1);
+        sources[i].view.palette = g_palette;
+    }
+    TestImage converted;
+    MakeImage(800, 600, converted, 0);
+
+    for (ImageScalePath path : SupportedScalePaths()) {
+        for (int i = 0; i < 3; i++) {
+            double seconds = BestOf(conversions, [&] { ConvertFrame(path, sources[i], converted); });
+            printf("convert 800x600 %-9s %-6s %6.3f ms  %6.0f MP/s\n", FORMATS[i].name, ScalePathName(path),
+                seconds * 1e3, 800 * 600 / seconds / 1e6);
+        }
+    }
+
+    TestImage target;
+    MakeImage(3840, 2160, target, 0);
+    ImageScalePath path = ImageScaleDefaultPath();
+    for (ImageScaleFilter filter : BENCH_FILTERS) {
+        ImageScaler scaler;
+        ConvertFrame(path, sources[0], converted);
+        double direct = BestOf(frames, [&] { scaler.Scale(converted.view, target.view, filter); });
+        double fused = BestOf(frames, [&] { scaler.Scale(sources[0].view, target.view, filter); });
+        double palette = BestOf(frames, [&] { scaler.Scale(sources[2].view, target.view, filter); });
+        double separate = BestOf(frames, [&] {
+            ConvertFrame(path, sources[0], converted);
+            scaler.Scale(converted.view, target.view, filter);
+        });
+        printf("800x600 -> 3840x2160 %-9s %-6s 32-bit %6.2f ms   RGB565 fused %6.2f ms   palette8 fused %6.2f ms"
+            "   RGB565 separate pass %6.2f ms\n", FilterName(filter), ScalePathName(path), direct * 1e3, fused * 1e3,
+            palette * 1e3, separate * 1e3);
+    }
+    return 0;
+}
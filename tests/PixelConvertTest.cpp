@@ -0,0 +1,182 @@
+// Checks of the 16-bit and palettized pixel conversion (PixelConvert.h) and
+// of scaling such frames: every RGB565 and RGB555 value against the widening
+// worked out bit by bit, every palette index, on every path, at every
+// alignment and at lengths around the vector widths without writing past
+// the end; and a 16-bit or palettized source scaled with every filter, on
+// every path and on a pool of threads, matching the same frame converted to
+// 32 bits first and then scaled.
+
+#include "../Common/ImageScaler.h"
+#include "../Common/PixelConvert.h"
+#include "../Common/WorkerPool.h"
+#include "ImageFixture.h"
+#include "TestUtil.h"
+#include <random>
+#include <vector>
+
+constexpr uint32_t GUARD = 0xDEADBEEF;
+
+static const uint32_t LENGTHS[] = { 0, 1, 7, 8, 9, 15, 16, 17, 31, 32, 33, 255, 256 };
+
+static uint32_t g_palette[256];
+
+// Channel of bits bits at bit shift of value, widened to 8 bits by
+// repeating its top bits below it
+static uint32_t Widen(uint32_t value, uint32_t shift, uint32_t bits) {
+    uint32_t channel = (value >> shift) & ((1u << bits) - 1);
+    uint32_t widened = channel << (8 - bits);
+    for (uint32_t filled = bits; filled < 8; filled += bits) widened |= widened >> filled;
+    return widened & 0xFF;
+}
+
+static uint32_t Expected(ImageFormat format, uint32_t value) {
+    switch (format) {
+    case IMAGE_FORMAT_RGB565:
+        return Widen(value, 11, 5) << 16 | Widen(value, 5, 6) << 8 | Widen(value, 0, 5);
+    case IMAGE_FORMAT_RGB555:
+        return Widen(value, 10, 5) << 16 | Widen(value, 5, 5) << 8 | Widen(value, 0, 5);
+    default:
+        return g_palette[value];
+    }
+}
+
+// Converts count values of the format starting at first, placed offset
+// bytes into a buffer, and checks every result and the guards around them
+static void CheckConversion(ImageScalePath path, ImageFormat format, uint32_t first, uint32_t count,
+    uint32_t offset) {
+    uint32_t bytes = ImageFormatBytes(format);
+    std::vector<uint8_t> input(offset + (size_t)count * bytes + 1);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t value = (first + i) & (bytes == 2 ? 0xFFFF : 0xFF);
+        memcpy(&input[offset + (size_t)i * bytes], &value, bytes);
+    }
+
+    std::vector<uint32_t> output(count + 2, GUARD);
+    ConvertPixels(path, format, input.data() + offset, g_palette, count, output.data() + 1);
+    CHECK_EQ(output[0], GUARD);
+    CHECK_EQ(output[count + 1], GUARD);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t value = (first + i) & (bytes == 2 ? 0xFFFF : 0xFF);
+        if (output[i + 1] != Expected(format, value)) {
+            fprintf(stderr, "Format %d, path %s: %04X became %08X, not %08X\n", format, ScalePathName(path), value,
+                output[i + 1], Expected(format, value));
+            exit(1);
+        }
+    }
+}
+
+static void TestEveryValue() {
+    static const ImageFormat FORMATS[] = { IMAGE_FORMAT_RGB565, IMAGE_FORMAT_RGB555, IMAGE_FORMAT_PALETTE8 };
+    for (ImageScalePath path : SupportedScalePaths()) {
+        for (ImageFormat format : FORMATS) {
+            // Every value in one run
+            CheckConversion(path, format, 0, ImageFormatBytes(format) == 2 ? 65536 : 256, 0);
+
+            // Short runs at every alignment, so the vector paths' tails run
+            for (uint32_t offset = 0; offset < 8; offset++) {
+                for (uint32_t count : LENGTHS) CheckConversion(path, format, 0xF7E5 + offset * 97, count, offset);
+            }
+        }
+    }
+
+    // Black and white stay exact, and X is left 0
+    uint16_t extremes[] = { 0x0000, 0xFFFF, 0x7FFF };
+    uint32_t out[3];
+    ConvertPixels(ImageScaleDefaultPath(), IMAGE_FORMAT_RGB565, (const uint8_t*)extremes, nullptr, 2, out);
+    CHECK_EQ(out[0], 0x000000);
+    CHECK_EQ(out[1], 0xFFFFFF);
+    ConvertPixels(ImageScaleDefaultPath(), IMAGE_FORMAT_RGB555, (const uint8_t*)extremes, nullptr, 3, out);
+    CHECK_EQ(out[1], 0xFFFFFF);
+    CHECK_EQ(out[2], 0xFFFFFF);
+}
+
+static void TestPaletteEntry() {
+    // R G B flags in, B G R X out
+    CHECK_EQ(PaletteEntryToBgrx(0x00332211), 0x00112233);
+    CHECK_EQ(PaletteEntryToBgrx(0x04FF0080), 0x008000FF);
+}
+
+// A 16-bit or palettized frame scaled directly and converted first
+static void CheckFused(ImageFormat format, uint32_t sourceWidth, uint32_t sourceHeight, uint32_t targetWidth,
+    uint32_t targetHeight, ImageScaleFilter filter, WorkerPool* pool) {
+    TestImage source;
+    MakeImage(sourceWidth, sourceHeight, source, 6, format);
+    FillRandom(source, sourceWidth * 31 + targetHeight);
+    source.view.palette = g_palette;
+
+    TestImage converted;
+    MakeImage(sourceWidth, sourceHeight, converted);
+    for (uint32_t y = 0; y < sourceHeight; y++) {
+        ConvertPixels(IMAGE_SCALE_SCALAR, format, ImageRow(source, y), g_palette, sourceWidth,
+            reinterpret_cast<uint32_t*>(ImageRow(converted, y)));
+    }
+
+    TestImage expected;
+    MakeImage(targetWidth, targetHeight, expected);
+    ImageScaler scaler;
+    bool scaled = scaler.Scale(converted.view, expected.view, filter);
+
+    TestImage target;
+    MakeImage(targetWidth, targetHeight, target);
+    ImageScaler fused;
+    fused.SetWorkerPool(pool);
+    CHECK_EQ(fused.Scale(source.view, target.view, filter), scaled);
+    CHECK(PaddingIntact(target));
+    if (scaled && !SamePixels(target, expected)) {
+        fprintf(stderr, "Format %d, filter %d, path %s, %ux%u -> %ux%u: scaled directly differs\n", format, filter,
+            ScalePathName(ImageScaleDefaultPath()), sourceWidth, sourceHeight, targetWidth, targetHeight);
+        exit(1);
+    }
+}
+
+static void TestFusedScaling() {
+    static const ImageFormat FORMATS[] = { IMAGE_FORMAT_RGB565, IMAGE_FORMAT_RGB555, IMAGE_FORMAT_PALETTE8 };
+    static const ImageScaleFilter FILTERS[] = {
+        IMAGE_FILTER_BILINEAR,
+        IMAGE_FILTER_INTEGER,
+        IMAGE_FILTER_BICUBIC,
+        IMAGE_FILTER_LANCZOS3,
+    };
+    static const uint32_t SIZES[][4] = {
+        { 640, 480, 1280, 960 },
+        { 37, 23, 101, 67 },
+        { 101, 67, 37, 23 },
+        { 3, 2, 17, 90 },
+        { 64, 48, 64, 48 },
+    };
+
+    WorkerPool pool(2);
+    for (ImageScalePath path : SupportedScalePaths()) {
+        ImageScaleForcePath(path);
+        for (ImageFormat format : FORMATS) {
+            for (ImageScaleFilter filter : FILTERS) {
+                for (const uint32_t* size : SIZES) {
+                    CheckFused(format, size[0], size[1], size[2], size[3], filter, nullptr);
+                }
+                CheckFused(format, 640, 480, 1280, 960, filter, &pool);
+            }
+        }
+    }
+    ImageScaleForcePath(ImageScaleDefaultPath());
+
+    // A palettized frame needs its palette
+    TestImage source;
+    MakeImage(4, 4, source, 0, IMAGE_FORMAT_PALETTE8);
+    TestImage target;
+    MakeImage(8, 8, target);
+    ImageScaler scaler;
+    CHECK(!scaler.Scale(source.view, target.view));
+    CHECK(PaddingIntact(target));
+}
+
+int main() {
+    // Entries with X set too: they are used as they are
+    std::mt19937 random(7);
+    for (uint32_t& entry : g_palette) entry = random();
+
+    TestEveryValue();
+    TestPaletteEntry();
+    TestFusedScaling();
+    puts("PixelConvertTest passed");
+    return 0;
+}
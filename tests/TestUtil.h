@@ -0,0 +1,48 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Shared helpers for the Linux tests and benchmarks.
+//
+// A failed CHECK prints where it failed and ends the test with exit code 1,
+// which ctest reports as a failure. Benchmarks take an optional iteration
+// scale on the command line; ctest runs them once at a small scale so they
+// are kept building and working, and the numbers come from running them by
+// hand.
+
+#define CHECK(condition)                                                                \
+    do {                                                                                \
+        if (!(condition)) {                                                             \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            exit(1);                                                                    \
+        }                                                                               \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                      \
+    do {                                                                                \
+        long long actualValue = (long long)(actual);                                    \
+        long long expectedValue = (long long)(expected);                                \
+        if (actualValue != expectedValue) {                                             \
+            fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n",           \
+                __FILE__, __LINE__, #actual, #expected, actualValue, expectedValue);    \
+            exit(1);                                                                    \
+        }                                                                               \
+    } while (0)
+
+// Scratch file in the build directory, removed by the caller when done
+inline std::string TestFilePath(const char* name) {
+    return std::string("./") + name;
+}
+
+inline double NowSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Iteration scale from argv[1], 1 if not given
+inline double BenchScale(int argc, char** argv) {
+    if (argc < 2) return 1.0;
+    double scale = atof(argv[1]);
+    return scale > 0 ? scale : 1.0;
+}
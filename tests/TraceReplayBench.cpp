@@ -0,0 +1,158 @@
+// Per-frame cost of the standalone hook's Direct3D 9 hooks (DeviceHooks.cpp)
+// on Peggle-like frames: the call sequences of traces/PeggleFrames.trace are
+// replayed through a mock device's vtable at 60 fps, and the time from the
+// start of each frame to the return of its Present is measured
+//   - unhooked
+//   - through the CreateDevice, Reset and Present hooks
+//   - the same with the frame statistics recording (FrameStats.h)
+// once with free device calls, and once with the driver's share simulated
+// (Present 200 us, DrawPrimitiveUP 2 us). The overhead column is the mean
+// against the unhooked row of the same pass.
+//
+// The 800x600 frames go to a 1600x900 client area, stretched with Letterbox=0
+// and pillarboxed into the middle with Letterbox=1. The hooks read the setting
+// once per process, so each is a run of its own; the rows of the two runs show
+// whether letterboxing adds to the cost of a frame.
+//
+// Usage: TraceReplayBench [scale] [letterbox]   (scale 1 = 600 frames, 10 s,
+// per row; letterbox 0 or 1, 0 by default)
+
+#include "../PeggleResolutionHookStandalone/DeviceHooks.h"
+#include "../Common/FrameStats.h"
+#include "../Common/HookRegistry.h"
+#include "MockCom.h"
+#include "MockTrace.h"
+#include "MockWin32.h"
+#include "TestUtil.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+constexpr double FRAME_SECONDS = 1.0 / 60.0;
+constexpr uint64_t PRESENT_LATENCY_NS = 200000;
+constexpr uint64_t DRAW_LATENCY_NS = 2000;
+
+static std::vector<MockTraceFrame> g_trace;
+static size_t g_frames;
+static HWND g_window;
+
+// What the device was last left with, to show the setting took effect
+static UINT g_backBufferWidth;
+static UINT g_backBufferHeight;
+static bool g_destRect;
+
+struct FrameTimes {
+    double mean;
+    double p50;
+    double p99;
+};
+
+// Replays g_frames frames of the trace, in a loop, on a device created
+// through d3d (hooked if the CreateDevice hook is attached)
+static FrameTimes Replay(IDirect3D9* d3d, bool simulateLatency) {
+    D3DPRESENT_PARAMETERS params = {};
+    params.BackBufferWidth = 800;
+    params.BackBufferHeight = 600;
+    params.BackBufferFormat = D3DFMT_X8R8G8B8;
+    params.hDeviceWindow = g_window;
+    params.Windowed = TRUE;
+    IDirect3DDevice9* device = nullptr;
+    CHECK_EQ(d3d->CreateDevice(0, D3DDEVTYPE_HAL, g_window, 0, &params, &device), D3D_OK);
+
+    MockDevice9* mock = static_cast<MockDevice9*>(device);
+    if (simulateLatency) {
+        mock->SetLatency(ComSlot::IDirect3DDevice9::Present, PRESENT_LATENCY_NS);
+        mock->SetLatency(ComSlot::IDirect3DDevice9::DrawPrimitiveUP, DRAW_LATENCY_NS);
+    }
+
+    std::vector<double> times(g_frames);
+    auto deadline = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < g_frames; i++) {
+        double start = NowSeconds();
+        MockReplayFrame(device, g_trace[i % g_trace.size()]);
+        times[i] = (NowSeconds() - start) * 1e6;
+
+        deadline += std::chrono::microseconds((int64_t)(FRAME_SECONDS * 1e6));
+        std::this_thread::sleep_until(deadline);
+    }
+    CHECK_EQ(mock->Calls(ComSlot::IDirect3DDevice9::Present), g_frames);
+    g_backBufferWidth = mock->params.BackBufferWidth;
+    g_backBufferHeight = mock->params.BackBufferHeight;
+    g_destRect = mock->hasDestRect;
+    device->Release();
+
+    FrameTimes result;
+    result.mean = 0.0;
+    for (double time : times) result.mean += time;
+    result.mean /= g_frames;
+    std::sort(times.begin(), times.end());
+    result.p50 = times[g_frames / 2];
+    result.p99 = times[std::min(g_frames - 1, g_frames * 99 / 100)];
+    return result;
+}
+
+// The hooks are attached for the one row, as the DLL attaches them:
+// CreateDevice first, then Reset and Present of the device it creates
+static FrameTimes ReplayHooked(IDirect3D9* d3d, bool simulateLatency) {
+    CHECK(RequestCreateDeviceHook(d3d));
+    CHECK_EQ(HookCommit(), 1);
+    FrameTimes result = Replay(d3d, simulateLatency);
+    CHECK_EQ(HookDetachAll(), 3);
+    return result;
+}
+
+static void Report(const char* label, const FrameTimes& times, const FrameTimes& base) {
+    printf("%-34s mean %7.1f us (%+6.2f)   p50 %7.1f us   p99 %7.1f us\n", label, times.mean,
+        times.mean - base.mean, times.p50, times.p99);
+}
+
+int main(int argc, char** argv) {
+    g_frames = (size_t)(600 * BenchScale(argc, argv));
+    if (!g_frames) g_frames = 1;
+    bool letterbox = argc > 2 && atoi(argv[2]) != 0;
+    MockSetIni("Settings", "Width", "1600");
+    MockSetIni("Settings", "Height", "900");
+    MockSetIni("Settings", "Letterbox", letterbox ? "1" : "0");
+    CHECK(MockLoadTrace(PEGGLE_TRACE_DIR "/PeggleFrames.trace", g_trace));
+    CHECK(!g_trace.empty());
+
+    g_window = MockCreateWindow(0, 0, 800, 600);
+    MockSetForegroundWindow(g_window);
+    MockDirect3D9* d3d = new MockDirect3D9();
+
+    FrameTimes unhooked[2];
+    FrameTimes hooked[2];
+    FrameTimes recorded[2];
+    for (int latency = 0; latency < 2; latency++) {
+        unhooked[latency] = Replay(d3d, latency != 0);
+        hooked[latency] = ReplayHooked(d3d, latency != 0);
+    }
+
+    std::string csv = TestFilePath("TraceReplayBench.csv");
+    std::string json = TestFilePath("TraceReplayBench.json");
+    CHECK(FrameStatsOpen(csv.c_str(), json.c_str(), 1));
+    for (int latency = 0; latency < 2; latency++) {
+        recorded[latency] = ReplayHooked(d3d, latency != 0);
+    }
+    FrameStatsClose();
+    remove(csv.c_str());
+    remove(json.c_str());
+
+    // Hooked, the backbuffer is the client area's, or 4:3 inside it and
+    // presented into the middle
+    CHECK_EQ(g_backBufferWidth, letterbox ? 1200 : 1600);
+    CHECK_EQ(g_backBufferHeight, 900);
+    CHECK(g_destRect == letterbox);
+
+    static const char* const PASSES[2] = { "free device calls", "simulated driver latency" };
+    for (int latency = 0; latency < 2; latency++) {
+        printf("Letterbox=%d (backbuffer %ux%u), %s, %zu frames at 60 fps:\n", letterbox ? 1 : 0,
+            g_backBufferWidth, g_backBufferHeight, PASSES[latency], g_frames);
+        Report("  unhooked", unhooked[latency], unhooked[latency]);
+        Report("  hooked", hooked[latency], unhooked[latency]);
+        Report("  hooked, frame statistics", recorded[latency], unhooked[latency]);
+    }
+
+    d3d->Release();
+    return 0;
+}
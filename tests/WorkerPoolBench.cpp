@@ -0,0 +1,68 @@
+// The scaler on a worker pool: milliseconds per 800x600 -> 3840x2160 frame
+// per filter (integer scaling included) on 1 to N threads (N the number of
+// cores, at least 4), with the speedup over one thread; and what a run costs
+// the pool itself, as microseconds per run of a job that does nothing, in
+// as many pieces as the scaler gives a full frame (four per thread). Rows
+// are the fastest of five batches. Past the number of cores, threads only
+// add their overhead.
+//
+// Usage: WorkerPoolBench [scale]   (scale 1 = 5 batches of 20 frames and of
+// 2000 empty runs per row)
+
+#include "../Common/ImageScaler.h"
+#include "../Common/WorkerPool.h"
+#include "ImageFixture.h"
+#include "TestUtil.h"
+#include <algorithm>
+#include <thread>
+
+// Seconds per call of work, fastest of BATCHES batches of count calls
+template <typename Work>
+static double BestOf(int count, Work work) {
+    double best = 1e9;
+    for (int batch = 0; batch < BATCHES; batch++) {
+        double start = NowSeconds();
+        for (int i = 0; i < count; i++) work();
+        best = std::min(best, (NowSeconds() - start) / count);
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    double scale = BenchScale(argc, argv);
+    int frames = std::max(1, (int)(100 * scale / BATCHES));
+    int runs = std::max(10, (int)(10000 * scale / BATCHES));
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    unsigned maxThreads = std::max(cores, 4u);
+    printf("%u cores\n", cores);
+
+    TestImage source;
+    MakeImage(800, 600, source, 0);
+    FillRandom(source, 1);
+    TestImage target;
+    MakeImage(3840, 2160, target, 0);
+
+    for (ImageScaleFilter filter : BENCH_FILTERS) {
+        double single = 0.0;
+        for (unsigned threads = 1; threads <= maxThreads; threads++) {
+            WorkerPool pool(threads - 1);
+            ImageScaler scaler;
+            scaler.SetWorkerPool(&pool);
+            CHECK(scaler.Scale(source.view, target.view, filter));
+
+            double seconds = BestOf(frames, [&] { scaler.Scale(source.view, target.view, filter); });
+            if (threads == 1) single = seconds;
+            printf("3840x2160 %-9s %2u threads %7.2f ms  %5.2fx\n", FilterName(filter), threads, seconds * 1e3,
+                single / seconds);
+        }
+    }
+
+    for (unsigned threads = 1; threads <= 2 * maxThreads; threads *= 2) {
+        WorkerPool pool(threads - 1);
+        auto job = [](uint32_t, unsigned) {};
+        uint32_t pieces = 4 * threads;
+        double seconds = BestOf(runs, [&] { pool.Run(pieces, job); });
+        printf("empty run  %2u threads %3u pieces %7.2f us\n", threads, pieces, seconds * 1e6);
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+// Checks of the worker pool and of the scaler on it: every index of a run is
+// handed out exactly once, over and over, with worker numbers in range and
+// never two pieces at a time on one worker (so per-worker scratch is safe),
+// Run returning only once all of them are done; and a scaler spread over 1
+// to 8 threads writing exactly what one thread does, for every filter.
+
+#include "../Common/ImageScaler.h"
+#include "../Common/WorkerPool.h"
+#include "ImageFixture.h"
+#include "TestUtil.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static const unsigned POOL_THREADS[] = { 0, 1, 2, 3, 7 };
+
+static void TestEveryIndexOnce() {
+    for (unsigned threads : POOL_THREADS) {
+        WorkerPool pool(threads);
+        CHECK_EQ(pool.Threads(), threads);
+
+        const uint32_t count = 997;
+        const int runs = 50;
+        std::unique_ptr<std::atomic<int>[]> calls(new std::atomic<int>[count]);
+        for (uint32_t i = 0; i < count; i++) calls[i] = 0;
+        std::unique_ptr<std::atomic<int>[]> busy(new std::atomic<int>[threads + 1]);
+        for (unsigned i = 0; i <= threads; i++) busy[i] = 0;
+        std::atomic<int> badWorker{ 0 };
+        std::atomic<int> overlaps{ 0 };
+
+        auto job = [&](uint32_t index, unsigned worker) {
+            if (worker > threads) {
+                badWorker++;
+                return;
+            }
+            if (busy[worker].exchange(1)) overlaps++;
+            // A little work, so the threads really do share the run
+            volatile uint32_t spin = 0;
+            for (uint32_t i = 0; i < 200 + index % 7 * 100; i++) spin = spin + i;
+            calls[index]++;
+            busy[worker] = 0;
+        };
+
+        for (int run = 1; run <= runs; run++) {
+            pool.Run(count, job);
+            // Counted right after Run returns: it is the barrier
+            for (uint32_t i = 0; i < count; i++) CHECK_EQ(calls[i].load(), run);
+        }
+        CHECK_EQ(badWorker.load(), 0);
+        CHECK_EQ(overlaps.load(), 0);
+    }
+}
+
+static void TestSmallRuns() {
+    WorkerPool pool(3);
+    int calls = 0;
+    unsigned lastWorker = 99;
+    auto job = [&](uint32_t, unsigned worker) {
+        calls++;
+        lastWorker = worker;
+    };
+
+    // Nothing to do, and a single piece is done on the calling thread
+    pool.Run(0, job);
+    CHECK_EQ(calls, 0);
+    pool.Run(1, job);
+    CHECK_EQ(calls, 1);
+    CHECK_EQ(lastWorker, 0);
+
+    // Back to back runs of different sizes
+    std::atomic<uint32_t> total{ 0 };
+    auto sum = [&](uint32_t index, unsigned) { total += index + 1; };
+    for (uint32_t count = 2; count < 40; count++) {
+        total = 0;
+        pool.Run(count, sum);
+        CHECK_EQ(total.load(), count * (count + 1) / 2);
+    }
+}
+
+static void TestThreadCount() {
+    CHECK_EQ(WorkerPoolThreadCount(3, 8), 3);
+    CHECK_EQ(WorkerPoolThreadCount(16, 4), 16);
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    CHECK_EQ(WorkerPoolThreadCount(0, 4), std::min(cores, 4u));
+    CHECK_EQ(WorkerPoolThreadCount(0, 1), 1);
+    CHECK_EQ(WorkerPoolThreadCount(0, 0), 1);
+}
+
+// Bands on any number of threads join up into the single thread's image
+static void TestScaledBands() {
+    struct Size {
+        uint32_t sourceWidth;
+        uint32_t sourceHeight;
+        uint32_t targetWidth;
+        uint32_t targetHeight;
+    };
+    static const Size SIZES[] = {
+        { 800, 600, 1920, 1080 },
+        { 800, 600, 1280, 960 },
+        { 37, 23, 1001, 677 },
+        { 640, 480, 320, 200 },
+        { 3, 2, 17, 900 },
+    };
+    static const ImageScaleFilter FILTERS[] = {
+        IMAGE_FILTER_BILINEAR,
+        IMAGE_FILTER_INTEGER,
+        IMAGE_FILTER_BICUBIC,
+        IMAGE_FILTER_LANCZOS3,
+    };
+
+    for (const Size& size : SIZES) {
+        TestImage source;
+        MakeImage(size.sourceWidth, size.sourceHeight, source);
+        FillRandom(source, size.targetWidth + size.targetHeight);
+
+        for (ImageScaleFilter filter : FILTERS) {
+            TestImage expected;
+            MakeImage(size.targetWidth, size.targetHeight, expected);
+            ImageScaler single;
+            bool scaled = single.Scale(source.view, expected.view, filter);
+
+            for (unsigned threads = 1; threads <= 8; threads++) {
+                WorkerPool pool(threads - 1);
+                ImageScaler scaler;
+                scaler.SetWorkerPool(&pool);
+
+                // Twice, so the second run reuses the tables and scratch
+                for (int run = 0; run < 2; run++) {
+                    TestImage target;
+                    MakeImage(size.targetWidth, size.targetHeight, target);
+                    CHECK_EQ(scaler.Scale(source.view, target.view, filter), scaled);
+                    CHECK(PaddingIntact(target));
+                    if (!scaled) continue;
+                    if (!SamePixels(target, expected)) {
+                        fprintf(stderr, "Filter %d, %ux%u -> %ux%u on %u threads differs\n", filter,
+                            size.sourceWidth, size.sourceHeight, size.targetWidth, size.targetHeight, threads);
+                        exit(1);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    TestEveryIndexOnce();
+    TestSmallRuns();
+    TestThreadCount();
+    TestScaledBands();
+    puts("WorkerPoolTest passed");
+    return 0;
+}
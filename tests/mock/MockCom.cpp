@@ -0,0 +1,444 @@
+#include "MockCom.h"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// The ddraw proxy defines the IID itself (DirectDrawHooks.cpp); this one is
+// for the tests that do not link it
+extern "C" __attribute__((weak)) const GUID IID_IDirectDraw7 = {
+    0x15e65ec0, 0x3b9c, 0x11d2,
+    {0xb9, 0x2f, 0x00, 0x60, 0x97, 0x97, 0xea, 0x5b}
+};
+
+namespace {
+
+struct MockVtable {
+    void** entries;
+    size_t slots;
+};
+
+std::mutex g_vtableLock;
+std::vector<MockVtable> g_vtables;
+
+// Vtables are read-only data; like ComVtable.cpp's PatchVtableSlot, a page
+// made writable stays that way
+bool MakeWritable(void** entry) {
+    uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+    void* page = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(entry) & ~(pageSize - 1));
+    return mprotect(page, pageSize, PROT_READ | PROT_WRITE) == 0;
+}
+
+} // namespace
+
+void MockSpin(uint64_t nanoseconds) {
+    auto end = std::chrono::steady_clock::now() + std::chrono::nanoseconds(nanoseconds);
+    while (std::chrono::steady_clock::now() < end) {}
+}
+
+void MockComRegisterVtable(void** vtable, size_t slots) {
+    std::lock_guard<std::mutex> lock(g_vtableLock);
+    for (const MockVtable& known : g_vtables) {
+        if (known.entries == vtable) return;
+    }
+    g_vtables.push_back(MockVtable{ vtable, slots });
+}
+
+size_t MockComRedirect(void* from, void* to) {
+    std::lock_guard<std::mutex> lock(g_vtableLock);
+    size_t changed = 0;
+    for (const MockVtable& vtable : g_vtables) {
+        for (size_t i = 0; i < vtable.slots; i++) {
+            void** entry = &vtable.entries[i];
+            if (*entry != from || !MakeWritable(entry)) continue;
+            *entry = to;
+            changed++;
+        }
+    }
+    return changed;
+}
+
+DDPIXELFORMAT MockPixelFormat(DWORD bpp) {
+    DDPIXELFORMAT format = {};
+    format.dwSize = sizeof(format);
+    format.dwFlags = DDPF_RGB;
+    format.dwRGBBitCount = bpp;
+    if (bpp == 8) {
+        format.dwFlags |= DDPF_PALETTEINDEXED8;
+    }
+    else if (bpp == 16) {
+        format.dwRBitMask = 0xF800;
+        format.dwGBitMask = 0x07E0;
+        format.dwBBitMask = 0x001F;
+    }
+    else {
+        format.dwRBitMask = 0xFF0000;
+        format.dwGBitMask = 0x00FF00;
+        format.dwBBitMask = 0x0000FF;
+    }
+    return format;
+}
+
+// Direct3D 9
+
+MockDevice9::MockDevice9(const D3DPRESENT_PARAMETERS& params)
+    : MockComObject(ComSlot::IDirect3DDevice9::Count), params(params) {
+    RegisterVtable(ComSlot::IDirect3DDevice9::Count);
+}
+
+HRESULT MockDevice9::Reset(D3DPRESENT_PARAMETERS* params) {
+    Record(ComSlot::IDirect3DDevice9::Reset);
+    if (!params) return D3DERR_INVALIDCALL;
+    if (FAILED(resetResult)) return resetResult;
+    this->params = *params;
+    return D3D_OK;
+}
+
+HRESULT MockDevice9::Present(const RECT*, const RECT* destRect, HWND, const RGNDATA*) {
+    Record(ComSlot::IDirect3DDevice9::Present);
+    hasDestRect = destRect != nullptr;
+    if (destRect) this->destRect = *destRect;
+    return presentResult;
+}
+
+HRESULT MockDevice9::BeginScene() {
+    Record(ComSlot::IDirect3DDevice9::BeginScene);
+    return D3D_OK;
+}
+
+HRESULT MockDevice9::EndScene() {
+    Record(ComSlot::IDirect3DDevice9::EndScene);
+    return D3D_OK;
+}
+
+HRESULT MockDevice9::Clear(DWORD, const D3DRECT*, DWORD, D3DCOLOR, float, DWORD) {
+    Record(ComSlot::IDirect3DDevice9::Clear);
+    return D3D_OK;
+}
+
+HRESULT MockDevice9::SetTransform(D3DTRANSFORMSTATETYPE, const D3DMATRIX*) {
+    Record(ComSlot::IDirect3DDevice9::SetTransform);
+    return D3D_OK;
+}
+
+HRESULT MockDevice9::SetViewport(const D3DVIEWPORT9* viewport) {
+    Record(ComSlot::IDirect3DDevice9::SetViewport);
+    if (!viewport) return D3DERR_INVALIDCALL;
+    this->viewport = *viewport;
+    return D3D_OK;
+}
+
+HRESULT MockDevice9::GetViewport(D3DVIEWPORT9* viewport) {
+    Record(ComSlot::IDirect3DDevice9::GetViewport);
+    if (!viewport) return D3DERR_INVALIDCALL;
+    *viewport = this->viewport;
+    return D3D_OK;
+}
+
+HRESULT MockDevice9::SetRenderState(D3DRENDERSTATETYPE, DWORD) {
+    Record(ComSlot::IDirect3DDevice9::SetRenderState);
+    return D3D_OK;
+}
+
+HRESULT MockDevice9::SetTexture(DWORD, IDirect3DBaseTexture9*) {
+    Record(ComSlot::IDirect3DDevice9::SetTexture);
+    return D3D_OK;
+}
+
+HRESULT MockDevice9::SetTextureStageState(DWORD, D3DTEXTURESTAGESTATETYPE, DWORD) {
+    Record(ComSlot::IDirect3DDevice9::SetTextureStageState);
+    return D3D_OK;
+}
+
+HRESULT MockDevice9::SetSamplerState(DWORD, D3DSAMPLERSTATETYPE, DWORD) {
+    Record(ComSlot::IDirect3DDevice9::SetSamplerState);
+    return D3D_OK;
+}
+
+HRESULT MockDevice9::DrawPrimitive(D3DPRIMITIVETYPE, UINT, UINT primitiveCount) {
+    Record(ComSlot::IDirect3DDevice9::DrawPrimitive);
+    primitives += primitiveCount;
+    return D3D_OK;
+}
+
+HRESULT MockDevice9::DrawPrimitiveUP(D3DPRIMITIVETYPE, UINT primitiveCount, const void* vertices, UINT) {
+    Record(ComSlot::IDirect3DDevice9::DrawPrimitiveUP);
+    if (!vertices) return D3DERR_INVALIDCALL;
+    primitives += primitiveCount;
+    return D3D_OK;
+}
+
+HRESULT MockDevice9::SetFVF(DWORD) {
+    Record(ComSlot::IDirect3DDevice9::SetFVF);
+    return D3D_OK;
+}
+
+HRESULT MockDevice9::SetStreamSource(UINT, IDirect3DVertexBuffer9*, UINT, UINT) {
+    Record(ComSlot::IDirect3DDevice9::SetStreamSource);
+    return D3D_OK;
+}
+
+MockDirect3D9::MockDirect3D9() : MockComObject(ComSlot::IDirect3D9::Count) {
+    RegisterVtable(ComSlot::IDirect3D9::Count);
+}
+
+HRESULT MockDirect3D9::CreateDevice(UINT, D3DDEVTYPE, HWND focusWindow, DWORD, D3DPRESENT_PARAMETERS* params,
+    IDirect3DDevice9** device) {
+    Record(ComSlot::IDirect3D9::CreateDevice);
+    if (!params || !device) return D3DERR_INVALIDCALL;
+    this->focusWindow = focusWindow;
+    *device = new MockDevice9(*params);
+    return D3D_OK;
+}
+
+// DirectDraw
+
+MockPalette::MockPalette() : MockComObject(4 + 3) {
+    RegisterVtable(4 + 3);
+}
+
+HRESULT MockPalette::GetEntries(DWORD, DWORD base, DWORD count, LPPALETTEENTRY entries) {
+    Record(4);
+    if (base + count > 256) return DDERR_INVALIDPARAMS;
+    std::copy(this->entries + base, this->entries + base + count, entries);
+    return DD_OK;
+}
+
+HRESULT MockPalette::SetEntries(DWORD, DWORD start, DWORD count, LPPALETTEENTRY entries) {
+    Record(6);
+    if (start + count > 256) return DDERR_INVALIDPARAMS;
+    std::copy(entries, entries + count, this->entries + start);
+    return DD_OK;
+}
+
+MockClipper::MockClipper() : MockComObject(3 + 6) {
+    RegisterVtable(3 + 6);
+}
+
+HRESULT MockClipper::GetHWnd(HWND* hwnd) {
+    Record(4);
+    *hwnd = window;
+    return DD_OK;
+}
+
+HRESULT MockClipper::SetHWnd(DWORD, HWND hwnd) {
+    Record(8);
+    window = hwnd;
+    return DD_OK;
+}
+
+MockSurface7::MockSurface7(MockDirectDraw7* owner, const DDSURFACEDESC2& desc)
+    : MockComObject(ComSlot::IDirectDrawSurface7::Count), desc(desc), m_owner(owner) {
+    RegisterVtable(ComSlot::IDirectDrawSurface7::Count);
+    this->desc.dwFlags |= DDSD_CAPS | DDSD_WIDTH | DDSD_HEIGHT | DDSD_PITCH | DDSD_PIXELFORMAT;
+    this->desc.lPitch = (LONG)((desc.dwWidth * (desc.ddpfPixelFormat.dwRGBBitCount / 8) + 3) & ~3u);
+    this->desc.lpSurface = nullptr;
+    pixels.assign((size_t)this->desc.lPitch * desc.dwHeight, 0);
+}
+
+MockSurface7::~MockSurface7() {
+    if (backBuffer) backBuffer->Release();
+    if (palette) palette->Release();
+    if (clipper) clipper->Release();
+}
+
+HRESULT MockSurface7::Blt(LPRECT destRect, LPDIRECTDRAWSURFACE7 source, LPRECT sourceRect, DWORD, LPDDBLTFX) {
+    Record(ComSlot::IDirectDrawSurface7::Blt);
+    bltSource = source;
+    bltHasDestRect = destRect != nullptr;
+    if (destRect) bltDestRect = *destRect;
+    bltHasSourceRect = sourceRect != nullptr;
+    if (sourceRect) bltSourceRect = *sourceRect;
+    bltCopied = false;
+    if (!source) return DD_OK;
+
+    // Only mock surfaces are ever passed in
+    MockSurface7* from = static_cast<MockSurface7*>(source);
+    RECT to = destRect ? *destRect : RECT{ 0, 0, (LONG)desc.dwWidth, (LONG)desc.dwHeight };
+    RECT in = sourceRect ? *sourceRect : RECT{ 0, 0, (LONG)from->desc.dwWidth, (LONG)from->desc.dwHeight };
+    LONG width = to.right - to.left;
+    LONG height = to.bottom - to.top;
+    DWORD bytes = desc.ddpfPixelFormat.dwRGBBitCount / 8;
+    if (from->desc.ddpfPixelFormat.dwRGBBitCount != desc.ddpfPixelFormat.dwRGBBitCount ||
+        width != in.right - in.left || height != in.bottom - in.top) {
+        return DD_OK;
+    }
+    if (to.left < 0 || to.top < 0 || to.right > (LONG)desc.dwWidth || to.bottom > (LONG)desc.dwHeight ||
+        in.left < 0 || in.top < 0 || in.right > (LONG)from->desc.dwWidth ||
+        in.bottom > (LONG)from->desc.dwHeight) {
+        return DDERR_INVALIDPARAMS;
+    }
+
+    for (LONG y = 0; y < height; y++) {
+        memcpy(Row(to.top + y) + to.left * bytes, from->Row(in.top + y) + in.left * bytes, width * bytes);
+    }
+    bltCopied = true;
+    return DD_OK;
+}
+
+HRESULT MockSurface7::Flip(LPDIRECTDRAWSURFACE7 targetOverride, DWORD) {
+    Record(ComSlot::IDirectDrawSurface7::Flip);
+    MockSurface7* back = targetOverride ? static_cast<MockSurface7*>(targetOverride) : backBuffer;
+    if (!back || back->pixels.size() != pixels.size()) return DDERR_INVALIDPARAMS;
+    pixels.swap(back->pixels);
+    return DD_OK;
+}
+
+HRESULT MockSurface7::GetAttachedSurface(LPDDSCAPS2 caps, LPDIRECTDRAWSURFACE7* surface) {
+    Record(ComSlot::IDirectDrawSurface7::GetAttachedSurface);
+    if (!backBuffer || !(caps->dwCaps & DDSCAPS_BACKBUFFER)) return DDERR_INVALIDPARAMS;
+    backBuffer->AddRef();
+    *surface = backBuffer;
+    return DD_OK;
+}
+
+HRESULT MockSurface7::GetCaps(LPDDSCAPS2 caps) {
+    Record(ComSlot::IDirectDrawSurface7::GetCaps);
+    *caps = desc.ddsCaps;
+    return DD_OK;
+}
+
+HRESULT MockSurface7::GetClipper(LPDIRECTDRAWCLIPPER* clipper) {
+    Record(ComSlot::IDirectDrawSurface7::GetClipper);
+    if (!this->clipper) return DDERR_NOCLIPPERATTACHED;
+    this->clipper->AddRef();
+    *clipper = this->clipper;
+    return DD_OK;
+}
+
+HRESULT MockSurface7::GetPalette(LPDIRECTDRAWPALETTE* palette) {
+    Record(ComSlot::IDirectDrawSurface7::GetPalette);
+    if (!this->palette) return DDERR_NOPALETTEATTACHED;
+    this->palette->AddRef();
+    *palette = this->palette;
+    return DD_OK;
+}
+
+HRESULT MockSurface7::GetSurfaceDesc(LPDDSURFACEDESC2 desc) {
+    Record(ComSlot::IDirectDrawSurface7::GetSurfaceDesc);
+    *desc = this->desc;
+    return DD_OK;
+}
+
+HRESULT MockSurface7::IsLost() {
+    Record(ComSlot::IDirectDrawSurface7::IsLost);
+    return lost ? DDERR_SURFACELOST : DD_OK;
+}
+
+HRESULT MockSurface7::Lock(LPRECT rect, LPDDSURFACEDESC2 desc, DWORD, HANDLE) {
+    Record(ComSlot::IDirectDrawSurface7::Lock);
+    if (lost) return DDERR_SURFACELOST;
+    *desc = this->desc;
+    desc->lpSurface = pixels.data();
+    if (rect) {
+        DWORD bytes = this->desc.ddpfPixelFormat.dwRGBBitCount / 8;
+        desc->lpSurface = Row(rect->top) + rect->left * bytes;
+    }
+    locks++;
+    return DD_OK;
+}
+
+HRESULT MockSurface7::Restore() {
+    Record(ComSlot::IDirectDrawSurface7::Restore);
+    lost = false;
+    return DD_OK;
+}
+
+HRESULT MockSurface7::SetClipper(LPDIRECTDRAWCLIPPER clipper) {
+    Record(ComSlot::IDirectDrawSurface7::SetClipper);
+    if (clipper) clipper->AddRef();
+    if (this->clipper) this->clipper->Release();
+    this->clipper = static_cast<MockClipper*>(clipper);
+    return DD_OK;
+}
+
+HRESULT MockSurface7::SetPalette(LPDIRECTDRAWPALETTE palette) {
+    Record(ComSlot::IDirectDrawSurface7::SetPalette);
+    if (palette) palette->AddRef();
+    if (this->palette) this->palette->Release();
+    this->palette = static_cast<MockPalette*>(palette);
+    return DD_OK;
+}
+
+HRESULT MockSurface7::Unlock(LPRECT) {
+    Record(ComSlot::IDirectDrawSurface7::Unlock);
+    if (!locks) return DDERR_INVALIDPARAMS;
+    locks--;
+    return DD_OK;
+}
+
+HRESULT MockSurface7::GetDDInterface(LPVOID* dd) {
+    Record(ComSlot::IDirectDrawSurface7::GetDDInterface);
+    m_owner->AddRef();
+    *dd = static_cast<IDirectDraw7*>(m_owner);
+    return DD_OK;
+}
+
+MockDirectDraw7::MockDirectDraw7() : MockComObject(ComSlot::IDirectDraw7::Count) {
+    RegisterVtable(ComSlot::IDirectDraw7::Count);
+}
+
+HRESULT MockDirectDraw7::CreateSurface(LPDDSURFACEDESC2 desc, LPDIRECTDRAWSURFACE7* surface, IUnknown*) {
+    Record(ComSlot::IDirectDraw7::CreateSurface);
+    if (!desc || !surface || !(desc->dwFlags & DDSD_CAPS)) return DDERR_INVALIDPARAMS;
+
+    DDSURFACEDESC2 created = *desc;
+    bool primary = (desc->ddsCaps.dwCaps & DDSCAPS_PRIMARYSURFACE) != 0;
+    if (primary) {
+        created.dwWidth = width;
+        created.dwHeight = height;
+    }
+    else if (!(desc->dwFlags & DDSD_WIDTH) || !(desc->dwFlags & DDSD_HEIGHT)) {
+        return DDERR_INVALIDPARAMS;
+    }
+    if (primary || !(desc->dwFlags & DDSD_PIXELFORMAT)) created.ddpfPixelFormat = MockPixelFormat(bpp);
+
+    MockSurface7* result = new MockSurface7(this, created);
+    surfaces.push_back(result);
+    if (primary && (desc->ddsCaps.dwCaps & DDSCAPS_FLIP) && (desc->dwFlags & DDSD_BACKBUFFERCOUNT) &&
+        desc->dwBackBufferCount) {
+        DDSURFACEDESC2 back = created;
+        back.ddsCaps.dwCaps = (created.ddsCaps.dwCaps & ~(DDSCAPS_PRIMARYSURFACE | DDSCAPS_COMPLEX)) |
+            DDSCAPS_BACKBUFFER;
+        result->backBuffer = new MockSurface7(this, back);
+        surfaces.push_back(result->backBuffer);
+    }
+    *surface = result;
+    return DD_OK;
+}
+
+HRESULT MockDirectDraw7::SetDisplayMode(DWORD width, DWORD height, DWORD bpp, DWORD, DWORD) {
+    Record(ComSlot::IDirectDraw7::SetDisplayMode);
+    if (bpp != 8 && bpp != 16 && bpp != 32) return DDERR_INVALIDPARAMS;
+    this->width = width;
+    this->height = height;
+    this->bpp = bpp;
+    return DD_OK;
+}
+
+MockDirectDraw::MockDirectDraw(bool withDirectDraw7)
+    : MockComObject(ComSlot::IDirectDraw::Count), directDraw7(withDirectDraw7 ? new MockDirectDraw7() : nullptr) {
+    RegisterVtable(ComSlot::IDirectDraw::Count);
+}
+
+MockDirectDraw::~MockDirectDraw() {
+    if (directDraw7) directDraw7->Release();
+}
+
+HRESULT MockDirectDraw::QueryInterface(REFIID iid, void** object) {
+    Record(ComSlot::IDirectDraw::QueryInterface);
+    *object = nullptr;
+    if (iid != IID_IDirectDraw7 || !directDraw7) return E_NOINTERFACE;
+    directDraw7->AddRef();
+    *object = static_cast<IDirectDraw7*>(directDraw7);
+    return S_OK;
+}
+
+HRESULT MockDirectDraw::SetDisplayMode(DWORD width, DWORD height, DWORD bpp) {
+    Record(ComSlot::IDirectDraw::SetDisplayMode);
+    this->width = width;
+    this->height = height;
+    this->bpp = bpp;
+    return DD_OK;
+}
@@ -0,0 +1,229 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <d3d9.h>
+#include <ddraw.h>
+#include "../../Common/ComVtable.h"
+
+// Mock Direct3D 9 and DirectDraw objects for driving the hooks on Linux.
+//
+// The objects implement the interfaces of the mock d3d9.h and ddraw.h, whose
+// vtables have the SDK layout, so compiled code calls them exactly as it
+// calls the real ones and the hooks can patch them: ComHook::PatchVtable
+// writes the slot, and the mock HookRegistry redirects every vtable entry
+// that points at a hooked method, as Detours would patch its code. Every
+// object of a class shares its vtable, as with the real interfaces.
+//
+// Each object counts the calls to every slot and can spin for a simulated
+// latency in any of them (the driver's share of a call). The implemented
+// methods keep what the hooks pass them; see the classes below.
+
+// Spin for about nanoseconds
+void MockSpin(uint64_t nanoseconds);
+
+// Repoint every entry of a mock vtable that holds from to to, as a Detours
+// hook of from would. Returns the number of entries changed.
+size_t MockComRedirect(void* from, void* to);
+
+// Interface plus the call log and reference count every mock keeps
+template <typename Interface>
+class MockComObject : public Interface {
+public:
+    MockComObject(const MockComObject&) = delete;
+    MockComObject& operator=(const MockComObject&) = delete;
+    virtual ~MockComObject() = default;
+
+    HRESULT QueryInterface(REFIID, void** object) override {
+        Record(0);
+        *object = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    ULONG AddRef() override {
+        Record(1);
+        return ++m_refs;
+    }
+
+    ULONG Release() override {
+        Record(2);
+        ULONG refs = --m_refs;
+        if (!refs) delete this;
+        return refs;
+    }
+
+    uint64_t Calls(size_t slot) const { return m_calls[slot]; }
+    ULONG RefCount() const { return m_refs; }
+    void SetLatency(size_t slot, uint64_t nanoseconds) { m_latency[slot] = nanoseconds; }
+
+protected:
+    explicit MockComObject(size_t slots) : m_calls(slots), m_latency(slots) {}
+
+    // Call from the most derived constructor, once the vtable is final
+    void RegisterVtable(size_t slots);
+
+    void Record(size_t slot) {
+        m_calls[slot]++;
+        if (m_latency[slot]) MockSpin(m_latency[slot]);
+    }
+
+private:
+    ULONG m_refs = 1;
+    std::vector<uint64_t> m_calls;
+    std::vector<uint64_t> m_latency;
+};
+
+void MockComRegisterVtable(void** vtable, size_t slots);
+
+template <typename Interface>
+void MockComObject<Interface>::RegisterVtable(size_t slots) {
+    MockComRegisterVtable(*reinterpret_cast<void***>(static_cast<Interface*>(this)), slots);
+}
+
+class MockDevice9 final : public MockComObject<IDirect3DDevice9> {
+public:
+    MockDevice9(const D3DPRESENT_PARAMETERS& params);
+
+    HRESULT Reset(D3DPRESENT_PARAMETERS* params) override;
+    HRESULT Present(const RECT* sourceRect, const RECT* destRect, HWND window, const RGNDATA* dirtyRegion) override;
+    HRESULT BeginScene() override;
+    HRESULT EndScene() override;
+    HRESULT Clear(DWORD count, const D3DRECT* rects, DWORD flags, D3DCOLOR color, float z, DWORD stencil) override;
+    HRESULT SetTransform(D3DTRANSFORMSTATETYPE state, const D3DMATRIX* matrix) override;
+    HRESULT SetViewport(const D3DVIEWPORT9* viewport) override;
+    HRESULT GetViewport(D3DVIEWPORT9* viewport) override;
+    HRESULT SetRenderState(D3DRENDERSTATETYPE state, DWORD value) override;
+    HRESULT SetTexture(DWORD stage, IDirect3DBaseTexture9* texture) override;
+    HRESULT SetTextureStageState(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD value) override;
+    HRESULT SetSamplerState(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD value) override;
+    HRESULT DrawPrimitive(D3DPRIMITIVETYPE type, UINT startVertex, UINT primitiveCount) override;
+    HRESULT DrawPrimitiveUP(D3DPRIMITIVETYPE type, UINT primitiveCount, const void* vertices, UINT stride) override;
+    HRESULT SetFVF(DWORD fvf) override;
+    HRESULT SetStreamSource(UINT stream, IDirect3DVertexBuffer9* buffer, UINT offset, UINT stride) override;
+
+    // Parameters of the creation or the last Reset, as the device got them
+    D3DPRESENT_PARAMETERS params;
+    D3DVIEWPORT9 viewport = {};
+    uint64_t primitives = 0;
+
+    // The last Present; hasDestRect is false for a null destination
+    bool hasDestRect = false;
+    RECT destRect = {};
+    HRESULT presentResult = D3D_OK;
+    HRESULT resetResult = D3D_OK;  // returned by Reset, which fails without effect
+};
+
+class MockDirect3D9 final : public MockComObject<IDirect3D9> {
+public:
+    MockDirect3D9();
+
+    HRESULT CreateDevice(UINT adapter, D3DDEVTYPE type, HWND focusWindow, DWORD flags,
+        D3DPRESENT_PARAMETERS* params, IDirect3DDevice9** device) override;
+
+    HWND focusWindow = nullptr;
+};
+
+class MockPalette final : public MockComObject<IDirectDrawPalette> {
+public:
+    MockPalette();
+
+    HRESULT GetEntries(DWORD flags, DWORD base, DWORD count, LPPALETTEENTRY entries) override;
+    HRESULT SetEntries(DWORD flags, DWORD start, DWORD count, LPPALETTEENTRY entries) override;
+
+    PALETTEENTRY entries[256] = {};
+};
+
+class MockClipper final : public MockComObject<IDirectDrawClipper> {
+public:
+    MockClipper();
+
+    HRESULT GetHWnd(HWND* hwnd) override;
+    HRESULT SetHWnd(DWORD flags, HWND hwnd) override;
+
+    HWND window = nullptr;
+};
+
+class MockDirectDraw7;
+
+// A surface in memory. Lock hands out the memory; Blt copies between
+// surfaces of the same depth, 1:1 (a stretching blit only records its
+// arguments); Flip swaps the memory with the attached back buffer.
+class MockSurface7 final : public MockComObject<IDirectDrawSurface7> {
+public:
+    MockSurface7(MockDirectDraw7* owner, const DDSURFACEDESC2& desc);
+    ~MockSurface7() override;
+
+    HRESULT Blt(LPRECT destRect, LPDIRECTDRAWSURFACE7 source, LPRECT sourceRect, DWORD flags,
+        LPDDBLTFX fx) override;
+    HRESULT Flip(LPDIRECTDRAWSURFACE7 targetOverride, DWORD flags) override;
+    HRESULT GetAttachedSurface(LPDDSCAPS2 caps, LPDIRECTDRAWSURFACE7* surface) override;
+    HRESULT GetCaps(LPDDSCAPS2 caps) override;
+    HRESULT GetClipper(LPDIRECTDRAWCLIPPER* clipper) override;
+    HRESULT GetPalette(LPDIRECTDRAWPALETTE* palette) override;
+    HRESULT GetSurfaceDesc(LPDDSURFACEDESC2 desc) override;
+    HRESULT IsLost() override;
+    HRESULT Lock(LPRECT rect, LPDDSURFACEDESC2 desc, DWORD flags, HANDLE event) override;
+    HRESULT Restore() override;
+    HRESULT SetClipper(LPDIRECTDRAWCLIPPER clipper) override;
+    HRESULT SetPalette(LPDIRECTDRAWPALETTE palette) override;
+    HRESULT Unlock(LPRECT rect) override;
+    HRESULT GetDDInterface(LPVOID* dd) override;
+
+    uint8_t* Row(DWORD y) { return pixels.data() + (size_t)y * desc.lPitch; }
+    uint32_t Pixel32(DWORD x, DWORD y) { return reinterpret_cast<uint32_t*>(Row(y))[x]; }
+
+    DDSURFACEDESC2 desc;  // lpSurface is only set by Lock
+    std::vector<uint8_t> pixels;
+    MockSurface7* backBuffer = nullptr;
+    MockPalette* palette = nullptr;
+    MockClipper* clipper = nullptr;
+    bool lost = false;
+    unsigned locks = 0;  // currently held
+
+    // The last Blt, with the rects copied; a null rect is the whole surface
+    IDirectDrawSurface7* bltSource = nullptr;
+    bool bltHasDestRect = false;
+    RECT bltDestRect = {};
+    bool bltHasSourceRect = false;
+    RECT bltSourceRect = {};
+    bool bltCopied = false;
+
+private:
+    MockDirectDraw7* m_owner;
+};
+
+// Creates surfaces in the display mode last set; the primary is the size of
+// the mode and in its depth
+class MockDirectDraw7 final : public MockComObject<IDirectDraw7> {
+public:
+    MockDirectDraw7();
+
+    HRESULT CreateSurface(LPDDSURFACEDESC2 desc, LPDIRECTDRAWSURFACE7* surface, IUnknown* outer) override;
+    HRESULT SetDisplayMode(DWORD width, DWORD height, DWORD bpp, DWORD refreshRate, DWORD flags) override;
+
+    DWORD width = 640;
+    DWORD height = 480;
+    DWORD bpp = 32;
+
+    // Every surface created, in order; they are not referenced
+    std::vector<MockSurface7*> surfaces;
+};
+
+// DirectDrawCreate's object, with an IDirectDraw7 behind it unless
+// withDirectDraw7 is false
+class MockDirectDraw final : public MockComObject<IDirectDraw> {
+public:
+    explicit MockDirectDraw(bool withDirectDraw7 = true);
+    ~MockDirectDraw() override;
+
+    HRESULT QueryInterface(REFIID iid, void** object) override;
+    HRESULT SetDisplayMode(DWORD width, DWORD height, DWORD bpp) override;
+
+    DWORD width = 640;
+    DWORD height = 480;
+    DWORD bpp = 8;
+    MockDirectDraw7* directDraw7;
+};
+
+// Pixel format of a DirectDraw surface of the given depth: X8R8G8B8, R5G6B5
+// or 8-bit palettized
+DDPIXELFORMAT MockPixelFormat(DWORD bpp);
@@ -0,0 +1,23 @@
+#include "../../Common/FrameClockWin32.h"
+#include <chrono>
+#include <thread>
+
+// Win32FrameClock for the tests, on the steady clock and sleep_until, which
+// is as fine-grained as a high resolution waitable timer
+
+Win32FrameClock::Win32FrameClock() : m_timer(nullptr), m_highResolution(true), m_frequency(1000000000) {}
+
+Win32FrameClock::~Win32FrameClock() {}
+
+int64_t Win32FrameClock::Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Win32FrameClock::SleepUntil(int64_t deadline) {
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(deadline)));
+}
+
+void Win32FrameClock::Relax() {
+    std::this_thread::yield();
+}
@@ -0,0 +1,84 @@
+#include "../../Common/HookRegistry.h"
+#include <mutex>
+#include "MockCom.h"
+
+// HookRegistry.h for the tests. Detours patches the code of the target, so
+// every caller of it ends up in the detour; here the callers are the mock
+// vtables, whose entries pointing at the target are repointed instead. The
+// original stays the target itself, which then acts as the trampoline. The
+// states follow HookRegistry.cpp.
+
+namespace {
+
+constexpr size_t MAX_HOOKS = 64;
+
+struct HookEntry {
+    const char* name;
+    void** original;
+    void* target;
+    void* detour;
+    HookState state;
+};
+
+HookEntry g_hooks[MAX_HOOKS];
+size_t g_hookCount = 0;
+std::mutex g_hookLock;
+
+HookEntry* FindHook(const void* original) {
+    for (size_t i = 0; i < g_hookCount; i++) {
+        if (g_hooks[i].original == original) return &g_hooks[i];
+    }
+    return nullptr;
+}
+
+} // namespace
+
+bool HookRequest(const char* name, void** original, void* target, void* detour) {
+    std::lock_guard<std::mutex> lock(g_hookLock);
+
+    HookEntry* entry = FindHook(original);
+    if (entry && entry->state != HOOK_DETACHED && entry->state != HOOK_FAILED) return false;
+    if (!target) return false;
+    if (!entry) {
+        if (g_hookCount == MAX_HOOKS) return false;
+        entry = &g_hooks[g_hookCount++];
+    }
+
+    *original = target;
+    *entry = HookEntry{ name, original, target, detour, HOOK_PENDING };
+    return true;
+}
+
+size_t HookCommit() {
+    std::lock_guard<std::mutex> lock(g_hookLock);
+
+    // A target no mock vtable points at is one Detours could not reach
+    size_t attached = 0;
+    for (size_t i = 0; i < g_hookCount; i++) {
+        HookEntry& entry = g_hooks[i];
+        if (entry.state != HOOK_PENDING) continue;
+        entry.state = MockComRedirect(entry.target, entry.detour) ? HOOK_ATTACHED : HOOK_FAILED;
+        if (entry.state == HOOK_ATTACHED) attached++;
+    }
+    return attached;
+}
+
+size_t HookDetachAll() {
+    std::lock_guard<std::mutex> lock(g_hookLock);
+
+    size_t detached = 0;
+    for (size_t i = 0; i < g_hookCount; i++) {
+        HookEntry& entry = g_hooks[i];
+        if (entry.state != HOOK_ATTACHED) continue;
+        MockComRedirect(entry.detour, entry.target);
+        entry.state = HOOK_DETACHED;
+        detached++;
+    }
+    return detached;
+}
+
+HookState HookGetState(const void* original) {
+    std::lock_guard<std::mutex> lock(g_hookLock);
+    HookEntry* entry = FindHook(original);
+    return entry ? entry->state : HOOK_DETACHED;
+}
@@ -0,0 +1,151 @@
+#include "MockTrace.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "../../Common/ComVtable.h"
+
+namespace {
+
+#define MOCK_TRACE_METHODS(X) \
+    X(Reset) X(Present) X(BeginScene) X(EndScene) X(Clear) X(SetTransform) X(SetViewport) X(GetViewport) \
+    X(SetRenderState) X(SetTexture) X(SetTextureStageState) X(SetSamplerState) X(DrawPrimitive) \
+    X(DrawPrimitiveUP) X(SetFVF) X(SetStreamSource)
+
+#define MOCK_TRACE_NAME(name) { #name, ComSlot::IDirect3DDevice9::name },
+
+struct TraceMethod {
+    const char* name;
+    size_t slot;
+};
+
+const TraceMethod TRACE_METHODS[] = { MOCK_TRACE_METHODS(MOCK_TRACE_NAME) };
+
+#undef MOCK_TRACE_NAME
+
+// A sprite as the game draws it: two triangles of transformed, textured
+// vertices
+struct SpriteVertex {
+    float x, y, z, rhw;
+    D3DCOLOR color;
+    float u, v;
+};
+
+const SpriteVertex SPRITE[6] = {
+    { 0, 0, 0, 1, 0xFFFFFFFF, 0, 0 }, { 64, 0, 0, 1, 0xFFFFFFFF, 1, 0 }, { 0, 64, 0, 1, 0xFFFFFFFF, 0, 1 },
+    { 64, 0, 0, 1, 0xFFFFFFFF, 1, 0 }, { 64, 64, 0, 1, 0xFFFFFFFF, 1, 1 }, { 0, 64, 0, 1, 0xFFFFFFFF, 0, 1 },
+};
+
+bool ParseCall(const std::string& token, MockTraceCall& call) {
+    std::string name = token;
+    call.repeat = 1;
+    size_t star = token.find('*');
+    if (star != std::string::npos) {
+        name = token.substr(0, star);
+        call.repeat = (uint32_t)strtoul(token.c_str() + star + 1, nullptr, 10);
+        if (!call.repeat) return false;
+    }
+    for (const TraceMethod& method : TRACE_METHODS) {
+        if (name == method.name) {
+            call.slot = method.slot;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Call(IDirect3DDevice9* device, size_t slot) {
+    static D3DPRESENT_PARAMETERS params = { 800, 600, D3DFMT_X8R8G8B8, 1 };
+    static const D3DMATRIX identity = { { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } } };
+    static const D3DVIEWPORT9 viewport = { 0, 0, 800, 600, 0.0f, 1.0f };
+    D3DVIEWPORT9 current;
+
+    switch (slot) {
+    case ComSlot::IDirect3DDevice9::Reset:
+        device->Reset(&params);
+        break;
+    case ComSlot::IDirect3DDevice9::Present:
+        device->Present(nullptr, nullptr, nullptr, nullptr);
+        break;
+    case ComSlot::IDirect3DDevice9::BeginScene:
+        device->BeginScene();
+        break;
+    case ComSlot::IDirect3DDevice9::EndScene:
+        device->EndScene();
+        break;
+    case ComSlot::IDirect3DDevice9::Clear:
+        device->Clear(0, nullptr, D3DCLEAR_TARGET, 0xFF000000, 1.0f, 0);
+        break;
+    case ComSlot::IDirect3DDevice9::SetTransform:
+        device->SetTransform(D3DTS_WORLD, &identity);
+        break;
+    case ComSlot::IDirect3DDevice9::SetViewport:
+        device->SetViewport(&viewport);
+        break;
+    case ComSlot::IDirect3DDevice9::GetViewport:
+        device->GetViewport(&current);
+        break;
+    case ComSlot::IDirect3DDevice9::SetRenderState:
+        device->SetRenderState(D3DRS_ALPHABLENDENABLE, TRUE);
+        break;
+    case ComSlot::IDirect3DDevice9::SetTexture:
+        device->SetTexture(0, nullptr);
+        break;
+    case ComSlot::IDirect3DDevice9::SetTextureStageState:
+        device->SetTextureStageState(0, D3DTSS_COLOROP, 4);
+        break;
+    case ComSlot::IDirect3DDevice9::SetSamplerState:
+        device->SetSamplerState(0, D3DSAMP_MAGFILTER, 2);
+        break;
+    case ComSlot::IDirect3DDevice9::DrawPrimitive:
+        device->DrawPrimitive(D3DPT_TRIANGLELIST, 0, 2);
+        break;
+    case ComSlot::IDirect3DDevice9::DrawPrimitiveUP:
+        device->DrawPrimitiveUP(D3DPT_TRIANGLELIST, 2, SPRITE, sizeof(SpriteVertex));
+        break;
+    case ComSlot::IDirect3DDevice9::SetFVF:
+        device->SetFVF(D3DFVF_XYZRHW | D3DFVF_DIFFUSE | D3DFVF_TEX1);
+        break;
+    case ComSlot::IDirect3DDevice9::SetStreamSource:
+        device->SetStreamSource(0, nullptr, 0, sizeof(SpriteVertex));
+        break;
+    }
+}
+
+} // namespace
+
+bool MockLoadTrace(const char* path, std::vector<MockTraceFrame>& frames) {
+    std::ifstream file(path);
+    if (!file) {
+        fprintf(stderr, "Cannot open trace %s\n", path);
+        return false;
+    }
+
+    std::string line;
+    for (unsigned number = 1; std::getline(file, line); number++) {
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') continue;
+
+        std::istringstream tokens(line);
+        std::string token;
+        MockTraceFrame frame;
+        while (tokens >> token) {
+            MockTraceCall call;
+            if (!ParseCall(token, call)) {
+                fprintf(stderr, "%s:%u: unknown call %s\n", path, number, token.c_str());
+                return false;
+            }
+            frame.push_back(call);
+        }
+        frames.push_back(frame);
+    }
+    return !frames.empty();
+}
+
+void MockReplayFrame(IDirect3DDevice9* device, const MockTraceFrame& frame) {
+    for (const MockTraceCall& call : frame) {
+        for (uint32_t i = 0; i < call.repeat; i++) Call(device, call.slot);
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <d3d9.h>
+
+// Call traces of Direct3D 9 frames, replayed through a device's vtable the
+// way the game calls it.
+//
+// A trace file has one frame per line, as the names of the device methods
+// called, each optionally repeated (SetTexture*40 is forty calls). Blank
+// lines and lines starting with # are skipped:
+//
+//   BeginScene Clear SetTexture*40 DrawPrimitiveUP*180 EndScene Present
+
+struct MockTraceCall {
+    size_t slot;  // ComSlot::IDirect3DDevice9
+    uint32_t repeat;
+};
+
+typedef std::vector<MockTraceCall> MockTraceFrame;
+
+// Prints the offending line and returns false on a method the replay does
+// not know
+bool MockLoadTrace(const char* path, std::vector<MockTraceFrame>& frames);
+
+void MockReplayFrame(IDirect3DDevice9* device, const MockTraceFrame& frame);
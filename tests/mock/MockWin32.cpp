@@ -0,0 +1,154 @@
+#include "MockWin32.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+
+namespace {
+
+std::map<std::string, std::string> g_ini;
+
+struct MockWindow {
+    RECT client;  // in screen coordinates
+};
+std::vector<MockWindow> g_windows;
+HWND g_foreground = nullptr;
+MockWindowPos g_windowPos = {};
+
+std::string IniKey(const char* section, const char* key) {
+    std::string result = section;
+    result += '\n';
+    for (const char* c = key; *c; c++) result += (char)tolower((unsigned char)*c);
+    return result;
+}
+
+// Handles are 1-based indices into g_windows
+MockWindow* FindMockWindow(HWND hwnd) {
+    size_t index = reinterpret_cast<uintptr_t>(hwnd);
+    return index && index <= g_windows.size() ? &g_windows[index - 1] : nullptr;
+}
+
+uint64_t ToFileTime(const timeval& time) {
+    return ((uint64_t)time.tv_sec * 1000000 + (uint64_t)time.tv_usec) * 10;
+}
+
+void SetFileTime(FILETIME* result, uint64_t value) {
+    result->dwLowDateTime = (DWORD)value;
+    result->dwHighDateTime = (DWORD)(value >> 32);
+}
+
+} // namespace
+
+void MockSetIni(const char* section, const char* key, const char* value) {
+    g_ini[IniKey(section, key)] = value;
+}
+
+void MockClearIni() {
+    g_ini.clear();
+}
+
+HWND MockCreateWindow(LONG x, LONG y, LONG width, LONG height) {
+    g_windows.push_back(MockWindow{ RECT{ x, y, x + width, y + height } });
+    return reinterpret_cast<HWND>((uintptr_t)g_windows.size());
+}
+
+void MockSetForegroundWindow(HWND hwnd) {
+    g_foreground = hwnd;
+}
+
+const MockWindowPos& MockLastWindowPos() {
+    return g_windowPos;
+}
+
+DWORD GetModuleFileNameA(HMODULE, LPSTR fileName, DWORD size) {
+    const char* path = "C:\\Games\\Peggle\\Peggle.exe";
+    strcpy_s(fileName, size, path);
+    return (DWORD)strlen(fileName);
+}
+
+UINT GetPrivateProfileIntA(LPCSTR section, LPCSTR key, int defaultValue, LPCSTR) {
+    auto value = g_ini.find(IniKey(section, key));
+    if (value == g_ini.end()) return (UINT)defaultValue;
+    return (UINT)strtol(value->second.c_str(), nullptr, 10);
+}
+
+DWORD GetPrivateProfileStringA(LPCSTR section, LPCSTR key, LPCSTR defaultValue, LPSTR out, DWORD size, LPCSTR) {
+    auto value = g_ini.find(IniKey(section, key));
+    const char* result = value == g_ini.end() ? defaultValue : value->second.c_str();
+    if (!size) return 0;
+    size_t length = std::min(strlen(result), (size_t)size - 1);
+    memcpy(out, result, length);
+    out[length] = 0;
+    return (DWORD)length;
+}
+
+BOOL GetClientRect(HWND hwnd, LPRECT rect) {
+    MockWindow* window = FindMockWindow(hwnd);
+    if (!window) return FALSE;
+    SetRect(rect, 0, 0, window->client.right - window->client.left, window->client.bottom - window->client.top);
+    return TRUE;
+}
+
+int MapWindowPoints(HWND from, HWND to, LPPOINT points, UINT count) {
+    MockWindow* source = FindMockWindow(from);
+    MockWindow* target = FindMockWindow(to);
+    LONG dx = (source ? source->client.left : 0) - (target ? target->client.left : 0);
+    LONG dy = (source ? source->client.top : 0) - (target ? target->client.top : 0);
+    for (UINT i = 0; i < count; i++) {
+        points[i].x += dx;
+        points[i].y += dy;
+    }
+    return (int)((uint32_t)(dy & 0xFFFF) << 16 | (uint32_t)(dx & 0xFFFF));
+}
+
+HWND GetForegroundWindow() {
+    return g_foreground;
+}
+
+// The window keeps its position; only the size of its client area follows
+BOOL SetWindowPos(HWND hwnd, HWND, int x, int y, int cx, int cy, UINT flags) {
+    g_windowPos.calls++;
+    g_windowPos.hwnd = hwnd;
+    g_windowPos.x = x;
+    g_windowPos.y = y;
+    g_windowPos.width = cx;
+    g_windowPos.height = cy;
+    g_windowPos.flags = flags;
+
+    MockWindow* window = FindMockWindow(hwnd);
+    if (!window) return FALSE;
+    if (!(flags & SWP_NOSIZE)) {
+        window->client.right = window->client.left + cx;
+        window->client.bottom = window->client.top + cy;
+    }
+    return TRUE;
+}
+
+ULONGLONG GetTickCount64() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return (ULONGLONG)std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+}
+
+void Sleep(DWORD milliseconds) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+HANDLE GetCurrentProcess() {
+    return reinterpret_cast<HANDLE>(-1);
+}
+
+BOOL GetProcessTimes(HANDLE, FILETIME* creation, FILETIME* exit, FILETIME* kernel, FILETIME* user) {
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return FALSE;
+    SetFileTime(creation, 0);
+    SetFileTime(exit, 0);
+    SetFileTime(kernel, ToFileTime(usage.ru_stime));
+    SetFileTime(user, ToFileTime(usage.ru_utime));
+    return TRUE;
+}
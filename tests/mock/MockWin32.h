@@ -0,0 +1,45 @@
+#pragma once
+#include <Windows.h>
+#include "../../PeggleResolutionHookStandalone/WindowManager.h"
+
+// Test controls for the mock Win32 API (Windows.h) and the fake window
+// manager the Direct3D hooks talk to.
+
+// PeggleResolution.ini: GetPrivateProfile*A return these values, or their
+// defaults for keys never set
+void MockSetIni(const char* section, const char* key, const char* value);
+void MockClearIni();
+
+// A window whose client area is width x height at (x, y) on the screen
+HWND MockCreateWindow(LONG x, LONG y, LONG width, LONG height);
+void MockSetForegroundWindow(HWND hwnd);
+
+// SetWindowPos calls on any window, and the last one
+struct MockWindowPos {
+    unsigned calls;
+    HWND hwnd;
+    int x;
+    int y;
+    int width;
+    int height;
+    UINT flags;
+};
+const MockWindowPos& MockLastWindowPos();
+
+// The window manager (WindowManager.h) records what it is told and answers
+// from here. WindowManagerWaitForActivity sleeps for its timeout unless the
+// window is active.
+struct MockWindowManagerState {
+    HWND window;
+    DWORD clientWidth;
+    DWORD clientHeight;
+    unsigned attaches;
+    RECT imageRect;
+    unsigned imageRectUpdates;
+    bool resetRequested;  // taken by the next WindowManagerTakeResetRequest
+    unsigned resets;
+    WindowActivity activity;
+    unsigned waits;
+    DWORD waitedMs;
+};
+MockWindowManagerState& MockWindowManager();
@@ -0,0 +1,56 @@
+#include "MockWin32.h"
+
+// WindowManager.h for the tests: the subclassing and painting of the real
+// window manager need a message loop, so this one keeps what the hooks tell
+// it in MockWindowManager() for the tests to check and set.
+
+MockWindowManagerState& MockWindowManager() {
+    static MockWindowManagerState state = {};
+    return state;
+}
+
+bool WindowManagerAttach(HWND hwnd, DWORD clientWidth, DWORD clientHeight) {
+    if (!hwnd) return false;
+    MockWindowManagerState& state = MockWindowManager();
+    state.window = hwnd;
+    state.clientWidth = clientWidth;
+    state.clientHeight = clientHeight;
+    state.attaches++;
+    return true;
+}
+
+void WindowManagerDetach() {
+    MockWindowManager().window = nullptr;
+}
+
+HWND WindowManagerGetWindow() {
+    return MockWindowManager().window;
+}
+
+void WindowManagerSetImageRect(const RECT& image) {
+    MockWindowManager().imageRect = image;
+    MockWindowManager().imageRectUpdates++;
+}
+
+bool WindowManagerTakeResetRequest() {
+    bool requested = MockWindowManager().resetRequested;
+    MockWindowManager().resetRequested = false;
+    return requested;
+}
+
+void WindowManagerRecordReset() {
+    MockWindowManager().resets++;
+}
+
+WindowActivity WindowManagerGetActivity() {
+    return MockWindowManager().activity;
+}
+
+bool WindowManagerWaitForActivity(DWORD timeoutMs) {
+    MockWindowManagerState& state = MockWindowManager();
+    state.waits++;
+    if (state.activity == WINDOW_ACTIVE) return true;
+    Sleep(timeoutMs);
+    state.waitedMs += timeoutMs;
+    return state.activity == WINDOW_ACTIVE;
+}
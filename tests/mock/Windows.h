@@ -0,0 +1,190 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <strings.h>
+
+// The part of the Win32 API the hook sources use, for compiling them on
+// Linux against the mock COM objects (MockCom.h).
+//
+// Types keep their Windows sizes (LONG and DWORD are 32 bits). Functions
+// that read the outside world read the state MockWin32.h sets up instead:
+// the ini file is a table, windows are rectangles, and the tick count is the
+// steady clock.
+
+#define WINAPI
+#define CALLBACK
+#define APIENTRY
+#define CONST const
+
+typedef int BOOL;
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef unsigned int UINT;
+typedef uint64_t ULONGLONG;
+typedef int32_t HRESULT;
+typedef void* LPVOID;
+typedef const char* LPCSTR;
+typedef char* LPSTR;
+typedef void* HANDLE;
+
+#define TRUE 1
+#define FALSE 0
+#define MAX_PATH 260
+
+struct HWND__;
+typedef HWND__* HWND;
+struct HINSTANCE__;
+typedef HINSTANCE__* HMODULE;
+struct HMONITOR__;
+typedef HMONITOR__* HMONITOR;
+struct HDC__;
+typedef HDC__* HDC;
+
+#define HWND_DESKTOP ((HWND)0)
+
+struct RECT {
+    LONG left;
+    LONG top;
+    LONG right;
+    LONG bottom;
+};
+typedef RECT* LPRECT;
+
+struct POINT {
+    LONG x;
+    LONG y;
+};
+typedef POINT* LPPOINT;
+
+struct RGNDATAHEADER {
+    DWORD dwSize;
+    DWORD iType;
+    DWORD nCount;
+    DWORD nRgnSize;
+    RECT rcBound;
+};
+
+struct RGNDATA {
+    RGNDATAHEADER rdh;
+    char Buffer[1];
+};
+
+struct FILETIME {
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+};
+
+union ULARGE_INTEGER {
+    struct {
+        DWORD LowPart;
+        DWORD HighPart;
+    };
+    ULONGLONG QuadPart;
+};
+
+struct PALETTEENTRY {
+    BYTE peRed;
+    BYTE peGreen;
+    BYTE peBlue;
+    BYTE peFlags;
+};
+typedef PALETTEENTRY* LPPALETTEENTRY;
+
+// COM
+struct GUID {
+    uint32_t Data1;
+    uint16_t Data2;
+    uint16_t Data3;
+    uint8_t Data4[8];
+};
+typedef GUID IID;
+typedef const GUID& REFIID;
+typedef const GUID& REFGUID;
+
+inline bool operator==(const GUID& a, const GUID& b) {
+    return memcmp(&a, &b, sizeof(GUID)) == 0;
+}
+
+inline bool operator!=(const GUID& a, const GUID& b) {
+    return !(a == b);
+}
+
+struct IUnknown {
+    virtual HRESULT QueryInterface(REFIID riid, void** ppvObject) = 0;
+    virtual ULONG AddRef() = 0;
+    virtual ULONG Release() = 0;
+};
+
+// Slot of an interface method the mocks do not implement (see d3d9.h)
+#define MOCK_COM_PLACEHOLDER(name) \
+    virtual HRESULT name() { return E_NOTIMPL; }
+
+#define S_OK ((HRESULT)0)
+#define S_FALSE ((HRESULT)1)
+#define E_NOTIMPL ((HRESULT)0x80004001)
+#define E_NOINTERFACE ((HRESULT)0x80004002)
+#define E_FAIL ((HRESULT)0x80004005)
+#define E_INVALIDARG ((HRESULT)0x80070057)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+#define SWP_NOSIZE 0x0001
+#define SWP_NOMOVE 0x0002
+#define SWP_NOZORDER 0x0004
+#define SWP_NOACTIVATE 0x0010
+#define SWP_FRAMECHANGED 0x0020
+
+// The executable is C:\Games\Peggle\Peggle.exe
+DWORD GetModuleFileNameA(HMODULE module, LPSTR fileName, DWORD size);
+
+// Values come from MockSetIni; the file name is ignored
+UINT GetPrivateProfileIntA(LPCSTR section, LPCSTR key, int defaultValue, LPCSTR fileName);
+DWORD GetPrivateProfileStringA(LPCSTR section, LPCSTR key, LPCSTR defaultValue, LPSTR out, DWORD size,
+    LPCSTR fileName);
+
+inline int strcpy_s(char* dest, size_t size, const char* source) {
+    size_t length = strlen(source);
+    if (length >= size) {
+        if (size) dest[0] = 0;
+        return 34;  // ERANGE
+    }
+    memcpy(dest, source, length + 1);
+    return 0;
+}
+
+inline int _stricmp(const char* a, const char* b) {
+    return strcasecmp(a, b);
+}
+
+inline BOOL SetRect(RECT* rect, int left, int top, int right, int bottom) {
+    rect->left = left;
+    rect->top = top;
+    rect->right = right;
+    rect->bottom = bottom;
+    return TRUE;
+}
+
+inline BOOL EqualRect(const RECT* a, const RECT* b) {
+    return a->left == b->left && a->top == b->top && a->right == b->right && a->bottom == b->bottom;
+}
+
+inline BOOL IsRectEmpty(const RECT* rect) {
+    return rect->right <= rect->left || rect->bottom <= rect->top;
+}
+
+// Windows are the rectangles set up with MockCreateWindow
+BOOL GetClientRect(HWND hwnd, LPRECT rect);
+int MapWindowPoints(HWND from, HWND to, LPPOINT points, UINT count);
+HWND GetForegroundWindow();
+BOOL SetWindowPos(HWND hwnd, HWND insertAfter, int x, int y, int cx, int cy, UINT flags);
+
+ULONGLONG GetTickCount64();
+void Sleep(DWORD milliseconds);
+
+// The process times are the real ones of the test process
+HANDLE GetCurrentProcess();
+BOOL GetProcessTimes(HANDLE process, FILETIME* creation, FILETIME* exit, FILETIME* kernel, FILETIME* user);
@@ -0,0 +1,269 @@
+#pragma once
+#include "Windows.h"
+
+// IDirect3D9 and IDirect3DDevice9 with the vtable layout of the SDK's d3d9.h,
+// for driving the hooks with the mock objects of MockCom.h.
+//
+// Every method of the SDK interfaces has its slot, in SDK order (MockComTest
+// checks them against ComVtable.h). The methods the hooks and the trace
+// replay call have their SDK signatures and are implemented by the mocks;
+// the others are placeholders without parameters that return E_NOTIMPL.
+// There is no virtual destructor, which would take two slots of its own.
+
+#define D3D_SDK_VERSION 32
+#define D3D_OK S_OK
+#define D3DERR_INVALIDCALL ((HRESULT)0x8876086C)
+#define D3DERR_DEVICELOST ((HRESULT)0x88760868)
+#define S_PRESENT_OCCLUDED ((HRESULT)0x08760868)
+
+#define D3DCREATE_SOFTWARE_VERTEXPROCESSING 0x00000020
+#define D3DCREATE_HARDWARE_VERTEXPROCESSING 0x00000040
+
+#define D3DCLEAR_TARGET 0x00000001
+#define D3DCLEAR_ZBUFFER 0x00000002
+
+#define D3DFVF_XYZRHW 0x004
+#define D3DFVF_DIFFUSE 0x040
+#define D3DFVF_TEX1 0x100
+
+typedef DWORD D3DCOLOR;
+
+enum D3DDEVTYPE {
+    D3DDEVTYPE_HAL = 1,
+    D3DDEVTYPE_REF = 2,
+    D3DDEVTYPE_SW = 3,
+};
+
+enum D3DFORMAT {
+    D3DFMT_UNKNOWN = 0,
+    D3DFMT_X8R8G8B8 = 22,
+    D3DFMT_R5G6B5 = 23,
+    D3DFMT_D16 = 80,
+};
+
+enum D3DMULTISAMPLE_TYPE {
+    D3DMULTISAMPLE_NONE = 0,
+};
+
+enum D3DSWAPEFFECT {
+    D3DSWAPEFFECT_DISCARD = 1,
+    D3DSWAPEFFECT_FLIP = 2,
+    D3DSWAPEFFECT_COPY = 3,
+};
+
+enum D3DPRIMITIVETYPE {
+    D3DPT_POINTLIST = 1,
+    D3DPT_LINELIST = 2,
+    D3DPT_LINESTRIP = 3,
+    D3DPT_TRIANGLELIST = 4,
+    D3DPT_TRIANGLESTRIP = 5,
+    D3DPT_TRIANGLEFAN = 6,
+};
+
+enum D3DTRANSFORMSTATETYPE {
+    D3DTS_VIEW = 2,
+    D3DTS_PROJECTION = 3,
+    D3DTS_WORLD = 256,
+};
+
+enum D3DRENDERSTATETYPE {
+    D3DRS_ZENABLE = 7,
+    D3DRS_SRCBLEND = 19,
+    D3DRS_DESTBLEND = 20,
+    D3DRS_ALPHABLENDENABLE = 27,
+};
+
+enum D3DTEXTURESTAGESTATETYPE {
+    D3DTSS_COLOROP = 1,
+    D3DTSS_ALPHAOP = 4,
+};
+
+enum D3DSAMPLERSTATETYPE {
+    D3DSAMP_MAGFILTER = 5,
+    D3DSAMP_MINFILTER = 6,
+};
+
+struct D3DPRESENT_PARAMETERS {
+    UINT BackBufferWidth;
+    UINT BackBufferHeight;
+    D3DFORMAT BackBufferFormat;
+    UINT BackBufferCount;
+    D3DMULTISAMPLE_TYPE MultiSampleType;
+    DWORD MultiSampleQuality;
+    D3DSWAPEFFECT SwapEffect;
+    HWND hDeviceWindow;
+    BOOL Windowed;
+    BOOL EnableAutoDepthStencil;
+    D3DFORMAT AutoDepthStencilFormat;
+    DWORD Flags;
+    UINT FullScreen_RefreshRateInHz;
+    UINT PresentationInterval;
+};
+
+struct D3DVIEWPORT9 {
+    DWORD X;
+    DWORD Y;
+    DWORD Width;
+    DWORD Height;
+    float MinZ;
+    float MaxZ;
+};
+
+struct D3DRECT {
+    LONG x1;
+    LONG y1;
+    LONG x2;
+    LONG y2;
+};
+
+struct D3DMATRIX {
+    float m[4][4];
+};
+
+struct IDirect3DDevice9;
+struct IDirect3DBaseTexture9 : IUnknown {};
+struct IDirect3DVertexBuffer9 : IUnknown {};
+
+struct IDirect3D9 : IUnknown {
+    MOCK_COM_PLACEHOLDER(RegisterSoftwareDevice)
+    MOCK_COM_PLACEHOLDER(GetAdapterCount)
+    MOCK_COM_PLACEHOLDER(GetAdapterIdentifier)
+    MOCK_COM_PLACEHOLDER(GetAdapterModeCount)
+    MOCK_COM_PLACEHOLDER(EnumAdapterModes)
+    MOCK_COM_PLACEHOLDER(GetAdapterDisplayMode)
+    MOCK_COM_PLACEHOLDER(CheckDeviceType)
+    MOCK_COM_PLACEHOLDER(CheckDeviceFormat)
+    MOCK_COM_PLACEHOLDER(CheckDeviceMultiSampleType)
+    MOCK_COM_PLACEHOLDER(CheckDepthStencilMatch)
+    MOCK_COM_PLACEHOLDER(CheckDeviceFormatConversion)
+    MOCK_COM_PLACEHOLDER(GetDeviceCaps)
+    MOCK_COM_PLACEHOLDER(GetAdapterMonitor)
+    virtual HRESULT CreateDevice(UINT Adapter, D3DDEVTYPE DeviceType, HWND hFocusWindow, DWORD BehaviorFlags,
+        D3DPRESENT_PARAMETERS* pPresentationParameters, IDirect3DDevice9** ppReturnedDeviceInterface) = 0;
+};
+
+struct IDirect3DDevice9 : IUnknown {
+    MOCK_COM_PLACEHOLDER(TestCooperativeLevel)
+    MOCK_COM_PLACEHOLDER(GetAvailableTextureMem)
+    MOCK_COM_PLACEHOLDER(EvictManagedResources)
+    MOCK_COM_PLACEHOLDER(GetDirect3D)
+    MOCK_COM_PLACEHOLDER(GetDeviceCaps)
+    MOCK_COM_PLACEHOLDER(GetDisplayMode)
+    MOCK_COM_PLACEHOLDER(GetCreationParameters)
+    MOCK_COM_PLACEHOLDER(SetCursorProperties)
+    MOCK_COM_PLACEHOLDER(SetCursorPosition)
+    MOCK_COM_PLACEHOLDER(ShowCursor)
+    MOCK_COM_PLACEHOLDER(CreateAdditionalSwapChain)
+    MOCK_COM_PLACEHOLDER(GetSwapChain)
+    MOCK_COM_PLACEHOLDER(GetNumberOfSwapChains)
+    virtual HRESULT Reset(D3DPRESENT_PARAMETERS* pPresentationParameters) = 0;
+    virtual HRESULT Present(const RECT* pSourceRect, const RECT* pDestRect, HWND hDestWindowOverride,
+        const RGNDATA* pDirtyRegion) = 0;
+    MOCK_COM_PLACEHOLDER(GetBackBuffer)
+    MOCK_COM_PLACEHOLDER(GetRasterStatus)
+    MOCK_COM_PLACEHOLDER(SetDialogBoxMode)
+    MOCK_COM_PLACEHOLDER(SetGammaRamp)
+    MOCK_COM_PLACEHOLDER(GetGammaRamp)
+    MOCK_COM_PLACEHOLDER(CreateTexture)
+    MOCK_COM_PLACEHOLDER(CreateVolumeTexture)
+    MOCK_COM_PLACEHOLDER(CreateCubeTexture)
+    MOCK_COM_PLACEHOLDER(CreateVertexBuffer)
+    MOCK_COM_PLACEHOLDER(CreateIndexBuffer)
+    MOCK_COM_PLACEHOLDER(CreateRenderTarget)
+    MOCK_COM_PLACEHOLDER(CreateDepthStencilSurface)
+    MOCK_COM_PLACEHOLDER(UpdateSurface)
+    MOCK_COM_PLACEHOLDER(UpdateTexture)
+    MOCK_COM_PLACEHOLDER(GetRenderTargetData)
+    MOCK_COM_PLACEHOLDER(GetFrontBufferData)
+    MOCK_COM_PLACEHOLDER(StretchRect)
+    MOCK_COM_PLACEHOLDER(ColorFill)
+    MOCK_COM_PLACEHOLDER(CreateOffscreenPlainSurface)
+    MOCK_COM_PLACEHOLDER(SetRenderTarget)
+    MOCK_COM_PLACEHOLDER(GetRenderTarget)
+    MOCK_COM_PLACEHOLDER(SetDepthStencilSurface)
+    MOCK_COM_PLACEHOLDER(GetDepthStencilSurface)
+    virtual HRESULT BeginScene() = 0;
+    virtual HRESULT EndScene() = 0;
+    virtual HRESULT Clear(DWORD Count, const D3DRECT* pRects, DWORD Flags, D3DCOLOR Color, float Z,
+        DWORD Stencil) = 0;
+    virtual HRESULT SetTransform(D3DTRANSFORMSTATETYPE State, const D3DMATRIX* pMatrix) = 0;
+    MOCK_COM_PLACEHOLDER(GetTransform)
+    MOCK_COM_PLACEHOLDER(MultiplyTransform)
+    virtual HRESULT SetViewport(const D3DVIEWPORT9* pViewport) = 0;
+    virtual HRESULT GetViewport(D3DVIEWPORT9* pViewport) = 0;
+    MOCK_COM_PLACEHOLDER(SetMaterial)
+    MOCK_COM_PLACEHOLDER(GetMaterial)
+    MOCK_COM_PLACEHOLDER(SetLight)
+    MOCK_COM_PLACEHOLDER(GetLight)
+    MOCK_COM_PLACEHOLDER(LightEnable)
+    MOCK_COM_PLACEHOLDER(GetLightEnable)
+    MOCK_COM_PLACEHOLDER(SetClipPlane)
+    MOCK_COM_PLACEHOLDER(GetClipPlane)
+    virtual HRESULT SetRenderState(D3DRENDERSTATETYPE State, DWORD Value) = 0;
+    MOCK_COM_PLACEHOLDER(GetRenderState)
+    MOCK_COM_PLACEHOLDER(CreateStateBlock)
+    MOCK_COM_PLACEHOLDER(BeginStateBlock)
+    MOCK_COM_PLACEHOLDER(EndStateBlock)
+    MOCK_COM_PLACEHOLDER(SetClipStatus)
+    MOCK_COM_PLACEHOLDER(GetClipStatus)
+    MOCK_COM_PLACEHOLDER(GetTexture)
+    virtual HRESULT SetTexture(DWORD Stage, IDirect3DBaseTexture9* pTexture) = 0;
+    MOCK_COM_PLACEHOLDER(GetTextureStageState)
+    virtual HRESULT SetTextureStageState(DWORD Stage, D3DTEXTURESTAGESTATETYPE Type, DWORD Value) = 0;
+    MOCK_COM_PLACEHOLDER(GetSamplerState)
+    virtual HRESULT SetSamplerState(DWORD Sampler, D3DSAMPLERSTATETYPE Type, DWORD Value) = 0;
+    MOCK_COM_PLACEHOLDER(ValidateDevice)
+    MOCK_COM_PLACEHOLDER(SetPaletteEntries)
+    MOCK_COM_PLACEHOLDER(GetPaletteEntries)
+    MOCK_COM_PLACEHOLDER(SetCurrentTexturePalette)
+    MOCK_COM_PLACEHOLDER(GetCurrentTexturePalette)
+    MOCK_COM_PLACEHOLDER(SetScissorRect)
+    MOCK_COM_PLACEHOLDER(GetScissorRect)
+    MOCK_COM_PLACEHOLDER(SetSoftwareVertexProcessing)
+    MOCK_COM_PLACEHOLDER(GetSoftwareVertexProcessing)
+    MOCK_COM_PLACEHOLDER(SetNPatchMode)
+    MOCK_COM_PLACEHOLDER(GetNPatchMode)
+    virtual HRESULT DrawPrimitive(D3DPRIMITIVETYPE PrimitiveType, UINT StartVertex, UINT PrimitiveCount) = 0;
+    MOCK_COM_PLACEHOLDER(DrawIndexedPrimitive)
+    virtual HRESULT DrawPrimitiveUP(D3DPRIMITIVETYPE PrimitiveType, UINT PrimitiveCount,
+        const void* pVertexStreamZeroData, UINT VertexStreamZeroStride) = 0;
+    MOCK_COM_PLACEHOLDER(DrawIndexedPrimitiveUP)
+    MOCK_COM_PLACEHOLDER(ProcessVertices)
+    MOCK_COM_PLACEHOLDER(CreateVertexDeclaration)
+    MOCK_COM_PLACEHOLDER(SetVertexDeclaration)
+    MOCK_COM_PLACEHOLDER(GetVertexDeclaration)
+    virtual HRESULT SetFVF(DWORD FVF) = 0;
+    MOCK_COM_PLACEHOLDER(GetFVF)
+    MOCK_COM_PLACEHOLDER(CreateVertexShader)
+    MOCK_COM_PLACEHOLDER(SetVertexShader)
+    MOCK_COM_PLACEHOLDER(GetVertexShader)
+    MOCK_COM_PLACEHOLDER(SetVertexShaderConstantF)
+    MOCK_COM_PLACEHOLDER(GetVertexShaderConstantF)
+    MOCK_COM_PLACEHOLDER(SetVertexShaderConstantI)
+    MOCK_COM_PLACEHOLDER(GetVertexShaderConstantI)
+    MOCK_COM_PLACEHOLDER(SetVertexShaderConstantB)
+    MOCK_COM_PLACEHOLDER(GetVertexShaderConstantB)
+    virtual HRESULT SetStreamSource(UINT StreamNumber, IDirect3DVertexBuffer9* pStreamData, UINT OffsetInBytes,
+        UINT Stride) = 0;
+    MOCK_COM_PLACEHOLDER(GetStreamSource)
+    MOCK_COM_PLACEHOLDER(SetStreamSourceFreq)
+    MOCK_COM_PLACEHOLDER(GetStreamSourceFreq)
+    MOCK_COM_PLACEHOLDER(SetIndices)
+    MOCK_COM_PLACEHOLDER(GetIndices)
+    MOCK_COM_PLACEHOLDER(CreatePixelShader)
+    MOCK_COM_PLACEHOLDER(SetPixelShader)
+    MOCK_COM_PLACEHOLDER(GetPixelShader)
+    MOCK_COM_PLACEHOLDER(SetPixelShaderConstantF)
+    MOCK_COM_PLACEHOLDER(GetPixelShaderConstantF)
+    MOCK_COM_PLACEHOLDER(SetPixelShaderConstantI)
+    MOCK_COM_PLACEHOLDER(GetPixelShaderConstantI)
+    MOCK_COM_PLACEHOLDER(SetPixelShaderConstantB)
+    MOCK_COM_PLACEHOLDER(GetPixelShaderConstantB)
+    MOCK_COM_PLACEHOLDER(DrawRectPatch)
+    MOCK_COM_PLACEHOLDER(DrawTriPatch)
+    MOCK_COM_PLACEHOLDER(DeletePatch)
+    MOCK_COM_PLACEHOLDER(CreateQuery)
+};
+
+typedef IDirect3D9* LPDIRECT3D9;
+typedef IDirect3DDevice9* LPDIRECT3DDEVICE9;
@@ -0,0 +1,236 @@
+#pragma once
+#include "Windows.h"
+
+// IDirectDraw, IDirectDraw7, IDirectDrawSurface7, IDirectDrawPalette and
+// IDirectDrawClipper with the vtable layout of the SDK's ddraw.h, for
+// driving the hooks with the mock objects of MockCom.h. As in d3d9.h, the
+// methods the hooks call have their SDK signatures and the others are
+// placeholders.
+
+#define MAKE_DDHRESULT(code) ((HRESULT)(0x88760000u | (code)))
+
+#define DD_OK S_OK
+#define DDERR_GENERIC E_FAIL
+#define DDERR_INVALIDPARAMS E_INVALIDARG
+#define DDERR_UNSUPPORTED E_NOTIMPL
+#define DDERR_NOCLIPPERATTACHED MAKE_DDHRESULT(205)
+#define DDERR_NOPALETTEATTACHED MAKE_DDHRESULT(255)
+#define DDERR_SURFACELOST MAKE_DDHRESULT(450)
+
+#define DDSD_CAPS 0x00000001
+#define DDSD_HEIGHT 0x00000002
+#define DDSD_WIDTH 0x00000004
+#define DDSD_PITCH 0x00000008
+#define DDSD_BACKBUFFERCOUNT 0x00000020
+#define DDSD_PIXELFORMAT 0x00001000
+
+#define DDSCAPS_BACKBUFFER 0x00000004
+#define DDSCAPS_COMPLEX 0x00000008
+#define DDSCAPS_FLIP 0x00000010
+#define DDSCAPS_OFFSCREENPLAIN 0x00000040
+#define DDSCAPS_OVERLAY 0x00000080
+#define DDSCAPS_PRIMARYSURFACE 0x00000200
+#define DDSCAPS_SYSTEMMEMORY 0x00000800
+#define DDSCAPS_TEXTURE 0x00001000
+#define DDSCAPS_3DDEVICE 0x00002000
+#define DDSCAPS_VIDEOMEMORY 0x00004000
+#define DDSCAPS_ZBUFFER 0x00020000
+
+#define DDPF_PALETTEINDEXED8 0x00000020
+#define DDPF_RGB 0x00000040
+
+#define DDLOCK_SURFACEMEMORYPTR 0x00000000
+#define DDLOCK_WAIT 0x00000001
+#define DDLOCK_READONLY 0x00000010
+#define DDLOCK_WRITEONLY 0x00000020
+
+#define DDBLT_WAIT 0x01000000
+#define DDFLIP_WAIT 0x00000001
+
+#define DDPCAPS_8BIT 0x00000004
+#define DDPCAPS_ALLOW256 0x00000040
+
+struct DDPIXELFORMAT {
+    DWORD dwSize;
+    DWORD dwFlags;
+    DWORD dwFourCC;
+    DWORD dwRGBBitCount;
+    DWORD dwRBitMask;
+    DWORD dwGBitMask;
+    DWORD dwBBitMask;
+    DWORD dwRGBAlphaBitMask;
+};
+typedef DDPIXELFORMAT* LPDDPIXELFORMAT;
+
+struct DDSCAPS2 {
+    DWORD dwCaps;
+    DWORD dwCaps2;
+    DWORD dwCaps3;
+    DWORD dwCaps4;
+};
+typedef DDSCAPS2* LPDDSCAPS2;
+
+struct DDCOLORKEY {
+    DWORD dwColorSpaceLowValue;
+    DWORD dwColorSpaceHighValue;
+};
+
+struct DDSURFACEDESC2 {
+    DWORD dwSize;
+    DWORD dwFlags;
+    DWORD dwHeight;
+    DWORD dwWidth;
+    LONG lPitch;
+    DWORD dwBackBufferCount;
+    DWORD dwRefreshRate;
+    DWORD dwAlphaBitDepth;
+    DWORD dwReserved;
+    LPVOID lpSurface;
+    DDCOLORKEY ddckCKDestOverlay;
+    DDCOLORKEY ddckCKDestBlt;
+    DDCOLORKEY ddckCKSrcOverlay;
+    DDCOLORKEY ddckCKSrcBlt;
+    DDPIXELFORMAT ddpfPixelFormat;
+    DDSCAPS2 ddsCaps;
+    DWORD dwTextureStage;
+};
+typedef DDSURFACEDESC2* LPDDSURFACEDESC2;
+
+struct DDBLTFX {
+    DWORD dwSize;
+    DWORD dwFillColor;
+};
+typedef DDBLTFX* LPDDBLTFX;
+
+struct IDirectDrawSurface7;
+struct IDirectDrawPalette;
+struct IDirectDrawClipper;
+typedef IDirectDrawSurface7* LPDIRECTDRAWSURFACE7;
+typedef IDirectDrawPalette* LPDIRECTDRAWPALETTE;
+typedef IDirectDrawClipper* LPDIRECTDRAWCLIPPER;
+
+extern "C" const GUID IID_IDirectDraw7;
+
+struct IDirectDraw : IUnknown {
+    MOCK_COM_PLACEHOLDER(Compact)
+    MOCK_COM_PLACEHOLDER(CreateClipper)
+    MOCK_COM_PLACEHOLDER(CreatePalette)
+    MOCK_COM_PLACEHOLDER(CreateSurface)
+    MOCK_COM_PLACEHOLDER(DuplicateSurface)
+    MOCK_COM_PLACEHOLDER(EnumDisplayModes)
+    MOCK_COM_PLACEHOLDER(EnumSurfaces)
+    MOCK_COM_PLACEHOLDER(FlipToGDISurface)
+    MOCK_COM_PLACEHOLDER(GetCaps)
+    MOCK_COM_PLACEHOLDER(GetDisplayMode)
+    MOCK_COM_PLACEHOLDER(GetFourCCCodes)
+    MOCK_COM_PLACEHOLDER(GetGDISurface)
+    MOCK_COM_PLACEHOLDER(GetMonitorFrequency)
+    MOCK_COM_PLACEHOLDER(GetScanLine)
+    MOCK_COM_PLACEHOLDER(GetVerticalBlankStatus)
+    MOCK_COM_PLACEHOLDER(Initialize)
+    MOCK_COM_PLACEHOLDER(RestoreDisplayMode)
+    MOCK_COM_PLACEHOLDER(SetCooperativeLevel)
+    virtual HRESULT SetDisplayMode(DWORD dwWidth, DWORD dwHeight, DWORD dwBPP) = 0;
+    MOCK_COM_PLACEHOLDER(WaitForVerticalBlank)
+};
+
+struct IDirectDraw7 : IUnknown {
+    MOCK_COM_PLACEHOLDER(Compact)
+    MOCK_COM_PLACEHOLDER(CreateClipper)
+    MOCK_COM_PLACEHOLDER(CreatePalette)
+    virtual HRESULT CreateSurface(LPDDSURFACEDESC2 lpDDSurfaceDesc2, LPDIRECTDRAWSURFACE7* lplpDDSurface,
+        IUnknown* pUnkOuter) = 0;
+    MOCK_COM_PLACEHOLDER(DuplicateSurface)
+    MOCK_COM_PLACEHOLDER(EnumDisplayModes)
+    MOCK_COM_PLACEHOLDER(EnumSurfaces)
+    MOCK_COM_PLACEHOLDER(FlipToGDISurface)
+    MOCK_COM_PLACEHOLDER(GetCaps)
+    MOCK_COM_PLACEHOLDER(GetDisplayMode)
+    MOCK_COM_PLACEHOLDER(GetFourCCCodes)
+    MOCK_COM_PLACEHOLDER(GetGDISurface)
+    MOCK_COM_PLACEHOLDER(GetMonitorFrequency)
+    MOCK_COM_PLACEHOLDER(GetScanLine)
+    MOCK_COM_PLACEHOLDER(GetVerticalBlankStatus)
+    MOCK_COM_PLACEHOLDER(Initialize)
+    MOCK_COM_PLACEHOLDER(RestoreDisplayMode)
+    MOCK_COM_PLACEHOLDER(SetCooperativeLevel)
+    virtual HRESULT SetDisplayMode(DWORD dwWidth, DWORD dwHeight, DWORD dwBPP, DWORD dwRefreshRate,
+        DWORD dwFlags) = 0;
+    MOCK_COM_PLACEHOLDER(WaitForVerticalBlank)
+    MOCK_COM_PLACEHOLDER(GetAvailableVidMem)
+    MOCK_COM_PLACEHOLDER(GetSurfaceFromDC)
+    MOCK_COM_PLACEHOLDER(RestoreAllSurfaces)
+    MOCK_COM_PLACEHOLDER(TestCooperativeLevel)
+    MOCK_COM_PLACEHOLDER(GetDeviceIdentifier)
+    MOCK_COM_PLACEHOLDER(StartModeTest)
+    MOCK_COM_PLACEHOLDER(EvaluateMode)
+};
+
+struct IDirectDrawSurface7 : IUnknown {
+    MOCK_COM_PLACEHOLDER(AddAttachedSurface)
+    MOCK_COM_PLACEHOLDER(AddOverlayDirtyRect)
+    virtual HRESULT Blt(LPRECT lpDestRect, LPDIRECTDRAWSURFACE7 lpDDSrcSurface, LPRECT lpSrcRect, DWORD dwFlags,
+        LPDDBLTFX lpDDBltFx) = 0;
+    MOCK_COM_PLACEHOLDER(BltBatch)
+    MOCK_COM_PLACEHOLDER(BltFast)
+    MOCK_COM_PLACEHOLDER(DeleteAttachedSurface)
+    MOCK_COM_PLACEHOLDER(EnumAttachedSurfaces)
+    MOCK_COM_PLACEHOLDER(EnumOverlayZOrders)
+    virtual HRESULT Flip(LPDIRECTDRAWSURFACE7 lpDDSurfaceTargetOverride, DWORD dwFlags) = 0;
+    virtual HRESULT GetAttachedSurface(LPDDSCAPS2 lpDDSCaps, LPDIRECTDRAWSURFACE7* lplpDDAttachedSurface) = 0;
+    MOCK_COM_PLACEHOLDER(GetBltStatus)
+    virtual HRESULT GetCaps(LPDDSCAPS2 lpDDSCaps) = 0;
+    virtual HRESULT GetClipper(LPDIRECTDRAWCLIPPER* lplpDDClipper) = 0;
+    MOCK_COM_PLACEHOLDER(GetColorKey)
+    MOCK_COM_PLACEHOLDER(GetDC)
+    MOCK_COM_PLACEHOLDER(GetFlipStatus)
+    MOCK_COM_PLACEHOLDER(GetOverlayPosition)
+    virtual HRESULT GetPalette(LPDIRECTDRAWPALETTE* lplpDDPalette) = 0;
+    MOCK_COM_PLACEHOLDER(GetPixelFormat)
+    virtual HRESULT GetSurfaceDesc(LPDDSURFACEDESC2 lpDDSurfaceDesc) = 0;
+    MOCK_COM_PLACEHOLDER(Initialize)
+    virtual HRESULT IsLost() = 0;
+    virtual HRESULT Lock(LPRECT lpDestRect, LPDDSURFACEDESC2 lpDDSurfaceDesc, DWORD dwFlags, HANDLE hEvent) = 0;
+    MOCK_COM_PLACEHOLDER(ReleaseDC)
+    virtual HRESULT Restore() = 0;
+    virtual HRESULT SetClipper(LPDIRECTDRAWCLIPPER lpDDClipper) = 0;
+    MOCK_COM_PLACEHOLDER(SetColorKey)
+    MOCK_COM_PLACEHOLDER(SetOverlayPosition)
+    virtual HRESULT SetPalette(LPDIRECTDRAWPALETTE lpDDPalette) = 0;
+    virtual HRESULT Unlock(LPRECT lpRect) = 0;
+    MOCK_COM_PLACEHOLDER(UpdateOverlay)
+    MOCK_COM_PLACEHOLDER(UpdateOverlayDisplay)
+    MOCK_COM_PLACEHOLDER(UpdateOverlayZOrder)
+    virtual HRESULT GetDDInterface(LPVOID* lplpDD) = 0;
+    MOCK_COM_PLACEHOLDER(PageLock)
+    MOCK_COM_PLACEHOLDER(PageUnlock)
+    MOCK_COM_PLACEHOLDER(SetSurfaceDesc)
+    MOCK_COM_PLACEHOLDER(SetPrivateData)
+    MOCK_COM_PLACEHOLDER(GetPrivateData)
+    MOCK_COM_PLACEHOLDER(FreePrivateData)
+    MOCK_COM_PLACEHOLDER(GetUniquenessValue)
+    MOCK_COM_PLACEHOLDER(ChangeUniquenessValue)
+    MOCK_COM_PLACEHOLDER(SetPriority)
+    MOCK_COM_PLACEHOLDER(GetPriority)
+    MOCK_COM_PLACEHOLDER(SetLOD)
+    MOCK_COM_PLACEHOLDER(GetLOD)
+};
+
+struct IDirectDrawPalette : IUnknown {
+    MOCK_COM_PLACEHOLDER(GetCaps)
+    virtual HRESULT GetEntries(DWORD dwFlags, DWORD dwBase, DWORD dwNumEntries, LPPALETTEENTRY lpEntries) = 0;
+    MOCK_COM_PLACEHOLDER(Initialize)
+    virtual HRESULT SetEntries(DWORD dwFlags, DWORD dwStartingEntry, DWORD dwCount, LPPALETTEENTRY lpEntries) = 0;
+};
+
+struct IDirectDrawClipper : IUnknown {
+    MOCK_COM_PLACEHOLDER(GetClipList)
+    virtual HRESULT GetHWnd(HWND* lphWnd) = 0;
+    MOCK_COM_PLACEHOLDER(Initialize)
+    MOCK_COM_PLACEHOLDER(IsClipListChanged)
+    MOCK_COM_PLACEHOLDER(SetClipList)
+    virtual HRESULT SetHWnd(DWORD dwFlags, HWND hWnd) = 0;
+};
+
+typedef IDirectDraw* LPDIRECTDRAW;
+typedef IDirectDraw7* LPDIRECTDRAW7;
@@ -0,0 +1,3 @@
+#pragma once
+// Windows headers are case-insensitive; the sources use both spellings
+#include "Windows.h"